@@ -7,6 +7,9 @@
 
 #include "rtbkit/common/account_key.h"
 #include "jml/db/persistent.h"
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
 
 using namespace std;
 using namespace ML;
@@ -50,4 +53,177 @@ reconstitute(ML::DB::Store_Reader & store)
     store.load(static_cast<AccountKeyBase &>(*this));
 }
 
+
+
+/*****************************************************************************/
+/* ACCOUNT KEY TABLE                                                         */
+/*****************************************************************************/
+
+namespace {
+
+struct InternedAccount {
+    AccountKey key;
+    std::string name;
+    std::string dottedName;
+};
+
+/** Entries live in fixed size chunks that are never moved, so that readers
+    don't need to synchronize with a writer that is adding entries.
+
+    Keys are also indexed in a fixed size open addressed table, so that
+    finding the handle of a key that's already interned doesn't need the
+    lock.  Each slot holds the top half of the key's hash and its handle
+    plus one (0 is an empty slot); slots are filled once and never change.
+    Keys that don't find a free slot within ProbeLength of their position
+    are only in the map.
+*/
+struct InternedAccounts {
+    enum {
+        ChunkBits = 12,
+        ChunkSize = 1 << ChunkBits,
+        MaxChunks = 4096,
+        IndexSize = 1 << 16,
+        ProbeLength = 16
+    };
+
+    InternedAccounts()
+        : size(0)
+    {
+        for (auto & c: chunks)
+            c = nullptr;
+        for (auto & s: index)
+            s = 0;
+    }
+
+    std::mutex lock;
+    std::unordered_map<AccountKey, AccountHandle> handles;
+    std::atomic<InternedAccount *> chunks[MaxChunks];
+    std::atomic<uint32_t> size;
+    std::atomic<uint64_t> index[IndexSize];
+
+    static uint64_t slotValue(uint64_t hash, AccountHandle handle)
+    {
+        return (hash & 0xffffffff00000000ULL) | (handle + 1ULL);
+    }
+
+    /** Add a newly interned key to the index.  Called under the lock. */
+    void addToIndex(uint64_t hash, AccountHandle handle)
+    {
+        for (unsigned i = 0;  i < ProbeLength;  ++i) {
+            auto & slot = index[(hash + i) & (IndexSize - 1)];
+            if (slot.load(std::memory_order_relaxed) == 0) {
+                slot.store(slotValue(hash, handle), std::memory_order_release);
+                return;
+            }
+        }
+    }
+
+    const InternedAccount & get(AccountHandle handle) const
+    {
+        if (handle >= size.load(std::memory_order_acquire))
+            throw ML::Exception("unknown account handle %u", handle);
+        InternedAccount * chunk = chunks[handle >> ChunkBits].load();
+        return chunk[handle & (ChunkSize - 1)];
+    }
+};
+
+InternedAccounts & internedAccounts()
+{
+    static InternedAccounts accounts;
+    return accounts;
+}
+
+} // file scope
+
+AccountHandle
+AccountKeyTable::
+intern(const AccountKey & key)
+{
+    InternedAccounts & table = internedAccounts();
+    std::lock_guard<std::mutex> guard(table.lock);
+
+    auto it = table.handles.find(key);
+    if (it != table.handles.end())
+        return it->second;
+
+    AccountHandle handle = table.size.load();
+    if (handle >= InternedAccounts::MaxChunks * InternedAccounts::ChunkSize)
+        throw ML::Exception("too many accounts interned");
+
+    auto & chunk = table.chunks[handle >> InternedAccounts::ChunkBits];
+    if (!chunk.load())
+        chunk = new InternedAccount[InternedAccounts::ChunkSize];
+
+    InternedAccount & entry
+        = chunk.load()[handle & (InternedAccounts::ChunkSize - 1)];
+    entry.key = key;
+    entry.name = key.toString();
+    entry.dottedName = key.toString('.');
+
+    table.handles[key] = handle;
+    table.size.store(handle + 1, std::memory_order_release);
+    table.addToIndex(key.hash(), handle);
+
+    return handle;
+}
+
+AccountHandle
+AccountKeyTable::
+find(const AccountKey & key)
+{
+    InternedAccounts & table = internedAccounts();
+    uint64_t hash = key.hash();
+
+    for (unsigned i = 0;  i < InternedAccounts::ProbeLength;  ++i) {
+        uint64_t slot
+            = table.index[(hash + i) & (InternedAccounts::IndexSize - 1)]
+            .load(std::memory_order_acquire);
+
+        // Keys are indexed in the first free slot, so it isn't there
+        if (slot == 0)
+            return NoHandle;
+
+        if ((slot ^ hash) >> 32)
+            continue;
+
+        AccountHandle handle = (slot & 0xffffffff) - 1;
+        if (table.get(handle).key == key)
+            return handle;
+    }
+
+    // Every slot was taken; the key can only be in the map
+    std::lock_guard<std::mutex> guard(table.lock);
+
+    auto it = table.handles.find(key);
+    return it == table.handles.end() ? (AccountHandle)NoHandle : it->second;
+}
+
+const AccountKey &
+AccountKeyTable::
+key(AccountHandle handle)
+{
+    return internedAccounts().get(handle).key;
+}
+
+const std::string &
+AccountKeyTable::
+name(AccountHandle handle)
+{
+    return internedAccounts().get(handle).name;
+}
+
+const std::string &
+AccountKeyTable::
+dottedName(AccountHandle handle)
+{
+    return internedAccounts().get(handle).dottedName;
+}
+
+size_t
+AccountKeyTable::
+size()
+{
+    return internedAccounts().size.load();
+}
+
 } // namespace RTBKIT
@@ -148,6 +148,51 @@ operator << (std::ostream & stream, const AccountKey & key)
     return stream << key.toString();
 }
 
+
+/*****************************************************************************/
+/* ACCOUNT KEY TABLE                                                         */
+/*****************************************************************************/
+
+/** Dense integer handle for an interned account key. */
+typedef uint32_t AccountHandle;
+
+/** Process wide table of interned account keys.  Accounts are interned as
+    agent configurations are loaded; the bid path then passes handles
+    around and only goes back to the key or to its name at the edges
+    (banker REST calls, logging, metrics).
+
+    Handles are allocated densely from zero in the order in which keys are
+    first seen and are never reused, so they can be used to index a vector.
+    Interning takes a lock; finding the handle of an interned key and going
+    from a handle back to the key or its names are lock free.
+*/
+
+struct AccountKeyTable {
+
+    enum : AccountHandle { NoHandle = 0xffffffff };
+
+    /** Return the handle for the given key, allocating one if the key
+        hasn't been seen before.
+    */
+    static AccountHandle intern(const AccountKey & key);
+
+    /** Return the handle for the given key, or NoHandle if it was never
+        interned.  Lock free.
+    */
+    static AccountHandle find(const AccountKey & key);
+
+    static const AccountKey & key(AccountHandle handle);
+
+    /** The key joined with ':', as in AccountKey::toString(). */
+    static const std::string & name(AccountHandle handle);
+
+    /** The key joined with '.', as used in metric names. */
+    static const std::string & dottedName(AccountHandle handle);
+
+    /** Number of handles allocated so far. */
+    static size_t size();
+};
+
 } // namespace RTBKIT
 
 namespace std {
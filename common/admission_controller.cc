@@ -0,0 +1,155 @@
+/* admission_controller.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Early admission control of bid requests in the exchange connectors.
+*/
+
+#include "admission_controller.h"
+#include "jml/arch/exception.h"
+#include <boost/thread/locks.hpp>
+#include <cmath>
+#include <cstdlib>
+
+
+using namespace std;
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* ROUTER LOAD                                                               */
+/*****************************************************************************/
+
+double
+RouterLoad::
+pressure() const
+{
+    // Queues start to matter once they're half full, and at that point we
+    // shed more and more until we drop everything when they're full.
+    double queuePressure = std::max(0.0, (queueFill - 0.5) * 2.0);
+    return std::min(1.0, queuePressure);
+}
+
+Json::Value
+RouterLoad::
+toJson() const
+{
+    Json::Value result;
+    result["dutyCycle"] = dutyCycle;
+    result["queueFill"] = queueFill;
+    result["expectedLatencyMs"] = expectedLatencyMs;
+    result["pressure"] = pressure();
+    return result;
+}
+
+
+/*****************************************************************************/
+/* ADMISSION CONTROLLER                                                      */
+/*****************************************************************************/
+
+AdmissionController::
+AdmissionController()
+    : priority(0),
+      maxRequestsPerSecond(0.0),
+      minProcessingMs(5.0),
+      shedProbability_(0.0),
+      expectedLatencyMs_(0.0),
+      quotaTokens(0.0)
+{
+}
+
+void
+AdmissionController::
+configure(const Json::Value & config)
+{
+    if (config.isNull())
+        return;
+
+    for (auto it = config.begin(), end = config.end();  it != end;  ++it) {
+        if (it.memberName() == "priority")
+            priority = it->asInt();
+        else if (it.memberName() == "maxRequestsPerSecond")
+            maxRequestsPerSecond = it->asDouble();
+        else if (it.memberName() == "minProcessingMs")
+            minProcessingMs = it->asDouble();
+        else throw ML::Exception("unknown admission parameter "
+                                 + it.memberName());
+    }
+
+    if (maxRequestsPerSecond < 0.0)
+        throw ML::Exception("admission maxRequestsPerSecond must be positive");
+
+    quotaTokens = maxRequestsPerSecond;
+}
+
+void
+AdmissionController::
+updateLoad(const RouterLoad & load)
+{
+    double pressure = load.pressure();
+
+    // Weight the pressure by our priority: higher priority exchanges see
+    // a lower shed probability for the same pressure.
+    double shed = pressure <= 0.0 ? 0.0 : pow(pressure, pow(2.0, priority));
+
+    shedProbability_ = shed;
+    expectedLatencyMs_ = load.expectedLatencyMs;
+}
+
+AdmissionDecision
+AdmissionController::
+admit(double timeLeftMs, Date now)
+{
+    // Requests that can't make their deadline are answered straight away,
+    // whatever the load, rather than timing out in the router.
+    if (timeLeftMs - expectedLatencyMs_ < minProcessingMs)
+        return AD_NO_BID;
+
+    double shed = shedProbability_;
+    if (shed > 0.0 && random() % 1000000 < 1000000 * shed)
+        return AD_DROP;
+
+    if (maxRequestsPerSecond > 0.0 && !takeQuota(now))
+        return AD_DROP;
+
+    return AD_PROCESS;
+}
+
+bool
+AdmissionController::
+takeQuota(Date now)
+{
+    boost::lock_guard<ML::Spinlock> guard(quotaLock);
+
+    if (quotaLastRefill == Date())
+        quotaLastRefill = now;
+
+    double elapsed = now.secondsSince(quotaLastRefill);
+    if (elapsed > 0.0) {
+        quotaTokens = std::min(maxRequestsPerSecond,
+                               quotaTokens + elapsed * maxRequestsPerSecond);
+        quotaLastRefill = now;
+    }
+
+    if (quotaTokens < 1.0)
+        return false;
+
+    quotaTokens -= 1.0;
+    return true;
+}
+
+Json::Value
+AdmissionController::
+toJson() const
+{
+    Json::Value result;
+    result["priority"] = priority;
+    result["maxRequestsPerSecond"] = maxRequestsPerSecond;
+    result["minProcessingMs"] = minProcessingMs;
+    result["shedProbability"] = shedProbability();
+    result["expectedLatencyMs"] = expectedLatencyMs();
+    return result;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,123 @@
+/* admission_controller.h                                          -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Early admission control of bid requests in the exchange connectors.
+*/
+
+#pragma once
+
+#include "soa/types/date.h"
+#include "soa/jsoncpp/json.h"
+#include "jml/arch/spinlock.h"
+#include <atomic>
+
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* ADMISSION DECISION                                                        */
+/*****************************************************************************/
+
+enum AdmissionDecision {
+    AD_PROCESS,  ///< Parse the request and run the auction
+    AD_NO_BID,   ///< Not enough time left to make the deadline; no-bid now
+    AD_DROP      ///< Shed: over quota or too loaded for this exchange
+};
+
+
+/*****************************************************************************/
+/* ROUTER LOAD                                                               */
+/*****************************************************************************/
+
+/** Snapshot of how busy the router is.  Published periodically by the router
+    to the admission controllers of its exchange connectors.
+*/
+struct RouterLoad {
+    RouterLoad()
+        : dutyCycle(0.0), queueFill(0.0), expectedLatencyMs(0.0)
+    {
+    }
+
+    double dutyCycle;          ///< Proportion of time the router loop is busy
+    double queueFill;          ///< Fill of the fullest router queue, in [0, 1]
+
+    /** Time an auction is expected to spend in the router before it can be
+        sent to the agents (augmentation and queueing included).
+    */
+    double expectedLatencyMs;
+
+    /** Proportion of the requests of a default priority exchange that
+        should be shed.  The router's LoadStabilizer sheds on top of this,
+        uniformly across all exchange connectors, through their accept
+        probability.
+    */
+    double pressure() const;
+
+    Json::Value toJson() const;
+};
+
+
+/*****************************************************************************/
+/* ADMISSION CONTROLLER                                                      */
+/*****************************************************************************/
+
+/** Decides, before a bid request is even parsed, whether it's worth
+    processing given the router's load, the time left for the request and the
+    priority and quota of the exchange it comes from.
+
+    updateLoad() is called by the router; admit() is called from the exchange
+    connector threads.  Both are thread safe.
+*/
+struct AdmissionController {
+
+    AdmissionController();
+
+    /** Configure from the "admission" section of an exchange connector's
+        configuration:
+
+        - priority: exchanges with a higher priority are shed later.  At a
+          router pressure of p, requests are shed with probability
+          p ^ (2 ^ priority).  Defaults to 0.
+        - maxRequestsPerSecond: quota of requests for the exchange; requests
+          above it are dropped.  0 (the default) means no quota.
+        - minProcessingMs: time we need on top of the expected router
+          latency to be worth bidding.  Defaults to 5ms.
+    */
+    void configure(const Json::Value & config);
+
+    int priority;
+    double maxRequestsPerSecond;
+    double minProcessingMs;
+
+    /** Publish the current router load. */
+    void updateLoad(const RouterLoad & load);
+
+    /** Return what to do with a request that has the given amount of time
+        left once the network round trip has been taken into account.
+    */
+    AdmissionDecision admit(double timeLeftMs, Date now = Date::now());
+
+    /** Probability with which this exchange's requests are being shed. */
+    double shedProbability() const { return shedProbability_; }
+
+    /** Latency of the router that requests need to be able to absorb. */
+    double expectedLatencyMs() const { return expectedLatencyMs_; }
+
+    Json::Value toJson() const;
+
+private:
+    std::atomic<double> shedProbability_;
+    std::atomic<double> expectedLatencyMs_;
+
+    /** Token bucket used to enforce maxRequestsPerSecond. */
+    bool takeQuota(Date now);
+
+    ML::Spinlock quotaLock;
+    double quotaTokens;
+    Date quotaLastRefill;
+};
+
+} // namespace RTBKIT
@@ -14,6 +14,7 @@
 #include "jml/utils/string_functions.h"
 #include "jml/utils/json_parsing.h"
 #include "jml/db/persistent.h"
+#include <boost/thread/locks.hpp>
 
 #include "ace/Acceptor.h"
 #include <ace/Timer_Heap_T.h>
@@ -212,7 +213,7 @@ createDescription(AuctionResponseDescription & d) {
 
 Auction::
 Auction()
-    : isZombie(false), exchangeConnector(nullptr), data(new Data())
+    : isZombie(false), exchangeConnector(nullptr)
 {
 }
 
@@ -230,7 +231,7 @@ Auction(ExchangeConnector * exchangeConnector,
       requestStrFormat(requestStrFormat),
       exchangeConnector(exchangeConnector),
       handleAuction(handleAuction),
-      data(new Data(numSpots()))
+      data(numSpots())
 {
     ML::atomic_add(created, 1);
 
@@ -241,14 +242,6 @@ Auction(ExchangeConnector * exchangeConnector,
 Auction::
 ~Auction()
 {
-    // Clean up the chain of data pointers
-    Data * d = data;
-    while (d) {
-        Data * d2 = d->oldData;
-        delete d;
-        d = d2;
-    }
-
     ML::atomic_add(destroyed, 1);
 }
 
@@ -269,13 +262,40 @@ timeUsed(Date now) const
     return start.secondsUntil(now);
 }
 
+size_t
+Auction::
+memUsage() const
+{
+    size_t result = sizeof(*this)
+        + requestStr.capacity() + requestStrFormat.capacity()
+        + requestSerialized.capacity();
+
+    // The parsed request holds about as much text as it was parsed from
+    if (request)
+        result += sizeof(BidRequest) + request->imp.size() * sizeof(AdSpot)
+            + requestStr.size();
+
+    for (auto & aug: augmentations)
+        result += sizeof(aug) + aug.first.capacity()
+            + aug.second.size() * sizeof(*aug.second.begin());
+    for (auto & aug: agentAugmentations)
+        result += sizeof(aug) + aug.first.capacity() + aug.second.capacity();
+
+    for (auto & spot: data.responses) {
+        result += spot.capacity() * sizeof(Response);
+        for (auto & response: spot)
+            result += response.agent.capacity() + response.bidData.capacity()
+                + response.meta.capacity() + response.creativeName.capacity();
+    }
+
+    return result;
+}
+
 Auction::WinLoss
 Auction::
 setResponse(int spotNum, Response newResponse)
 {
-    Data * current = this->data;
-
-    if (spotNum < 0 || spotNum >= current->responses.size())
+    if (spotNum < 0 || spotNum >= data.responses.size())
         throw ML::Exception("invalid spot number in response");
 
     if (newResponse.price.maxPrice.isNegative()
@@ -283,50 +303,66 @@ setResponse(int spotNum, Response newResponse)
         || newResponse.creativeId == -1)
         return WinLoss::INVALID;
 
-    if (current->tooLate)
-        return WinLoss::TOOLATE;
+    boost::lock_guard<ML::Spinlock> guard(dataLock);
 
+    if (data.tooLate)
+        return WinLoss::TOOLATE;
 
-    WinLoss result;
+    auto & responses = data.responses[spotNum];
 
-    auto_ptr<Data> newData(new Data());
+    if (!responses.empty()
+        && newResponse.price.priority <= responses[0].price.priority)
+        return WinLoss::LOSS;
 
-    for (;;) {
-        if (current->tooLate)
-            return WinLoss::TOOLATE;
-        
-        if (current->hasValidResponse(spotNum)
-            && newResponse.price.priority
-                <= current->winningResponse(spotNum).price.priority)
-            return WinLoss::LOSS;
-        
-        *newData = *current;
+    newResponse.localStatus = WinLoss::PENDING;
+    responses.push_back(std::move(newResponse));
 
-        bool hasExisting = current->hasValidResponse(spotNum);
+    // Keep the winning response at the front
+    if (responses.size() > 1) {
+        responses[0].localStatus = WinLoss::LOSS;
+        std::swap(responses.front(), responses.back());
+    }
 
-        result = newResponse.localStatus = WinLoss::PENDING;
-        newData->responses[spotNum].push_back(newResponse);
+    return WinLoss::PENDING;
+}
 
-        if (hasExisting) {
-            newData->responses[spotNum][0].localStatus = WinLoss::LOSS;
-            std::swap(newData->responses[spotNum].front(),
-                      newData->responses[spotNum].back());
-        }
+void
+Auction::
+reserveResponses(size_t numBidders)
+{
+    boost::lock_guard<ML::Spinlock> guard(dataLock);
 
-        newData->oldData = current;
+    if (data.tooLate)
+        return;
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
-        return result;
-    }
+    for (auto & responses : data.responses)
+        responses.reserve(numBidders);
 }
 
-const std::vector<std::vector<Auction::Response> > & 
+std::vector<std::vector<Auction::Response> >
 Auction::
 getResponses() const
 {
-    const Data * current = this->data;
-    return current->responses;
+    boost::lock_guard<ML::Spinlock> guard(dataLock);
+    return data.responses;
+}
+
+const Auction::Data *
+Auction::
+getCurrentData() const
+{
+    boost::lock_guard<ML::Spinlock> guard(dataLock);
+    if (!data.tooLate)
+        throw ML::Exception("auction data read before the auction finished");
+    return &data;
+}
+
+Auction::Data
+Auction::
+getSnapshot() const
+{
+    boost::lock_guard<ML::Spinlock> guard(dataLock);
+    return data;
 }
 
 void
@@ -335,61 +371,39 @@ addDataSources(const std::set<std::string> & sources)
 {
     if (sources.empty()) return;
 
-    Data * current = this->data;
-    unique_ptr<Data> newData(new Data);
-
-    for (;;) {
-
-        std::set<std::string> newSources = current->dataSources;
-        newSources.insert(sources.begin(), sources.end());
-
-        // Nothing new was added, just bail.
-        if (newSources.size() == current->dataSources.size()) return;
-
-        if (!newData) newData.reset(new Data);
-        *newData = *current;
-        std::swap(newData->dataSources, newSources);
+    boost::lock_guard<ML::Spinlock> guard(dataLock);
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
-        return;
-    }
+    if (!data.tooLate)
+        data.dataSources.insert(sources.begin(), sources.end());
 }
 
-const std::set<std::string> &
+std::set<std::string>
 Auction::
 getDataSources() const
 {
-    const Data * current = this->data;
-    return current->dataSources;
+    boost::lock_guard<ML::Spinlock> guard(dataLock);
+    return data.dataSources;
 }
 
 bool
 Auction::
 finish()
 {
-    Data * current = this->data;
+    {
+        boost::lock_guard<ML::Spinlock> guard(dataLock);
 
-    for (;;) {
-        if (current->tooLate)
+        if (data.tooLate)
             return false;
 
-        auto_ptr<Data> newData(new Data(*current));
-
         for (unsigned spotNum = 0;  spotNum < numSpots(); ++spotNum) {
-            if (newData->hasValidResponse(spotNum))
-                newData->responses[spotNum][0].localStatus = WinLoss::WIN;
-            
-            for (unsigned i = 1;  i < newData->responses[spotNum].size();  ++i)
-                newData->responses[spotNum][i].localStatus = WinLoss::LOSS;
+            if (data.hasValidResponse(spotNum))
+                data.responses[spotNum][0].localStatus = WinLoss::WIN;
+
+            for (unsigned i = 1;  i < data.responses[spotNum].size();  ++i)
+                data.responses[spotNum][i].localStatus = WinLoss::LOSS;
         }
-        
-        newData->oldData = current;
-        newData->tooLate = true;
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
-        break;
+        data.tooLate = true;
     }
 
     handleAuction(shared_from_this());
@@ -401,28 +415,22 @@ bool
 Auction::
 setError(const std::string & error, const std::string & details)
 {
-    Data * current = this->data;
+    {
+        boost::lock_guard<ML::Spinlock> guard(dataLock);
 
-    for (;;) {
-        if (current->tooLate)
+        if (data.tooLate)
             return false;
 
-        auto_ptr<Data> newData(new Data(*current));
-        
-        newData->error = error;
-        newData->details = details;
+        data.error = error;
+        data.details = details;
 
         for (unsigned spotNum = 0;  spotNum < numSpots();  ++spotNum) {
-            for (unsigned i = 0;  i < newData->responses[spotNum].size();  ++i) {
-                newData->responses[spotNum][i].localStatus = WinLoss::LOSS;
+            for (unsigned i = 0;  i < data.responses[spotNum].size();  ++i) {
+                data.responses[spotNum][i].localStatus = WinLoss::LOSS;
             }
         }
-        newData->oldData = current;
-        newData->tooLate = true;
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
-        break;
+        data.tooLate = true;
     }
 
     handleAuction(shared_from_this());
@@ -434,14 +442,16 @@ bool
 Auction::
 tooLate()
 {
-    return data->tooLate;
+    boost::lock_guard<ML::Spinlock> guard(dataLock);
+    return data.tooLate;
 }
 
 std::string
 Auction::
 status() const
 {
-    Data * current = this->data;
+    Data snapshot = getSnapshot();
+    const Data * current = &snapshot;
 
     string result = ML::format("Auction: %d imp", (int)numSpots());
     if (current->tooLate) result += " tooLate";
@@ -465,7 +475,8 @@ getResponseJson(int spotNum) const
 {
     Json::Value result;
 
-    Data * current = this->data;
+    Data snapshot = getSnapshot();
+    const Data * current = &snapshot;
 
     if (!current->error.empty()) {
         result["error"] = current->error;
@@ -16,6 +16,7 @@
 #include "rtbkit/common/win_cost_model.h"
 #include <boost/function.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include "jml/arch/spinlock.h"
 #include "soa/jsoncpp/json.h"
 #include "soa/types/date.h"
 #include "jml/arch/atomic_ops.h"
@@ -84,6 +85,11 @@ struct Auction : public std::enable_shared_from_this<Auction> {
     /** How much time has been used by the auction (in seconds). */
     double timeUsed(Date now = Date::now()) const;
 
+    /** Approximate number of bytes allocated for the auction and what it
+        owns.  Should only be called once the auction is finished.
+    */
+    size_t memUsage() const;
+
     /** If this value is set, then the bid has already been sent of and it's
         too late to modify the object any more.
     */
@@ -206,13 +212,21 @@ struct Auction : public std::enable_shared_from_this<Auction> {
     */
     WinLoss setResponse(int spotNum, Response newResponse);
 
+    /** Preallocate room in the response table for the given number of
+        bidders on each imp, so that recording their responses doesn't need
+        to allocate.  Should be called before the bid request is sent out.
+    */
+    void reserveResponses(size_t numBidders);
+
     /** Merges the given data sources used to make the bidding decision with the
         ones already already present in the auction.
 
         Thread safe.
      */
     void addDataSources(const std::set<std::string> & sources);
-    const std::set<std::string> & getDataSources() const;
+
+    /** Return a copy of the data sources.  Thread safe. */
+    std::set<std::string> getDataSources() const;
 
     /** Return a status that can be used for debugging. */
     std::string status() const;
@@ -240,23 +254,27 @@ struct Auction : public std::enable_shared_from_this<Auction> {
     /** Return all responses as JSON. */
     Json::Value getResponsesJson() const;
 
-    /** Get the wins, winning first and than any losing bids afterwards.  The
-        auction should be over before this is called.
+    /** Get a copy of the wins, winning first and than any losing bids
+        afterwards.  Thread safe.
     */
-    const std::vector<std::vector<Response> > & getResponses() const;
+    std::vector<std::vector<Response> > getResponses() const;
 
     ExchangeConnector * exchangeConnector; ///< Exchange connector for auction
     HandleAuction handleAuction;   ///< Callback for when auction is finished
 
+    /** Responses and status of the auction.  This is modified in place,
+        under dataLock, until the auction is finished, after which it's
+        immutable.
+    */
     struct Data {
         Data()
-            : tooLate(false), oldData(0)
+            : tooLate(false)
         {
             responses.reserve(8);
         }
 
         Data(int numSpots)
-            : tooLate(false), responses(numSpots), oldData(0)
+            : tooLate(false), responses(numSpots)
         {
         }
 
@@ -284,17 +302,29 @@ struct Auction : public std::enable_shared_from_this<Auction> {
         bool tooLate;
         std::vector<std::vector<Response> > responses;  ///< Losing responses to track
         std::set<std::string> dataSources; // data sources used to make the bid decissions.
-        Data * oldData;  ///< GC list
         std::string error, details;
     };
 
-    const Data * getCurrentData() const
-    {
-        return data;
-    }
+    /** Return the responses and status of a finished auction, which can
+        then be read without a copy as they no longer change.  Throws if the
+        auction isn't finished yet.
+    */
+    const Data * getCurrentData() const;
+
+    /** Return a copy of the responses and status of the auction that is
+        consistent even while the router is still recording responses.
+        Thread safe.
+    */
+    Data getSnapshot() const;
 
 private:
-    Data * data;
+    Data data;
+
+    /** Held while data is read or modified until the auction is finished.
+        Only the router records responses, so it's uncontended on the bid
+        path.
+    */
+    mutable ML::Spinlock dataLock;
 
 public:
     /// Memory leak tracking
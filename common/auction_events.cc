@@ -27,9 +27,15 @@ void
 SubmittedAuctionEvent::
 serialize(ML::DB::Store_Writer & store) const
 {
-    store << (unsigned char)0
+    store << (unsigned char)1
           << auctionId << adSpotId << lossTimeout << augmentations
           << bidRequestStr << bidResponse << bidRequestStrFormat;
+
+    // The parsed request travels with the raw one, so that the receiving
+    // end doesn't need to run the exchange's parser again.
+    store << (bool)bidRequest;
+    if (bidRequest)
+        bidRequest->serialize(store);
 }
 
 void
@@ -38,13 +44,24 @@ reconstitute(ML::DB::Store_Reader & store)
 {
     unsigned char version;
     store >> version;
-    if (version != 0)
+    if (version > 1)
         throw ML::Exception("unknown SubmittedAuctionEvent type");
 
     store >> auctionId >> adSpotId >> lossTimeout >> augmentations
           >> bidRequestStr >> bidResponse >> bidRequestStrFormat;
 
-    bidRequest.reset(BidRequest::parse(bidRequestStrFormat, bidRequestStr));
+    if (version == 0) {
+        bidRequest.reset(BidRequest::parse(bidRequestStrFormat, bidRequestStr));
+        return;
+    }
+
+    bool hasBidRequest;
+    store >> hasBidRequest;
+    if (hasBidRequest) {
+        bidRequest = std::make_shared<BidRequest>();
+        bidRequest->reconstitute(store);
+    }
+    else bidRequest.reset();
 }
 
 SubmittedAuctionEventDescription::
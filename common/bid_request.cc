@@ -674,27 +674,6 @@ createFromJson(const Json::Value & json)
     return result;
 }
 
-void
-AdSpot::
-serialize(ML::DB::Store_Writer & store) const
-{
-    unsigned char version = 2;
-    store << version << toJson().toString();
-}
-
-void
-AdSpot::
-reconstitute(ML::DB::Store_Reader & store)
-{
-    unsigned char version;
-    store >> version;
-    if (version != 2)
-        throw ML::Exception("unknown AdSpot serialization version");
-    string s;
-    store >> s;
-    fromJson(Json::parse(s));
-}
-
 
 /*****************************************************************************/
 /* USER IDS                                                                  */
@@ -704,7 +683,7 @@ void
 UserIds::
 add(const Id & id, IdDomain domain)
 {
-    if (!insert(make_pair(domainToString(domain), id)).second)
+    if (!insert(value_type(domainName(domain), id)).second)
         throw ML::Exception("attempt to double add id %s for %s",
                             id.toString().c_str(), domainToString(domain));
     setStatic(id, domain);
@@ -712,7 +691,7 @@ add(const Id & id, IdDomain domain)
 
 void
 UserIds::
-add(const Id & id, const std::string & domain1, IdDomain domain2)
+add(const Id & id, const InternedName & domain1, IdDomain domain2)
 {
     add(id, domain1);
     add(id, domain2);
@@ -720,10 +699,11 @@ add(const Id & id, const std::string & domain1, IdDomain domain2)
 
 void
 UserIds::
-add(const Id & id, const std::string & domain)
+add(const Id & id, const InternedName & domain)
 {
-    if (!insert(make_pair(domain, id)).second)
-        throw ML::Exception("attempt to double add id " + id.toString() +" for " + domain);
+    if (!insert(value_type(domain, id)).second)
+        throw ML::Exception("attempt to double add id " + id.toString()
+                            + " for " + domain.str());
     setStatic(id, domain);
 }
 
@@ -738,13 +718,28 @@ domainToString(IdDomain domain)
     }
 }
 
+const InternedName &
+UserIds::
+domainName(IdDomain domain)
+{
+    static const InternedName provider(domainToString(ID_PROVIDER));
+    static const InternedName exchange(domainToString(ID_EXCHANGE));
+    static const InternedName unknown("<<<UNKNOWN>>>");
+
+    switch (domain) {
+    case ID_PROVIDER:   return provider;
+    case ID_EXCHANGE:   return exchange;
+    default:            return unknown;
+    }
+}
+
 void
 UserIds::
-setStatic(const Id & id, const std::string & domain)
+setStatic(const Id & id, const InternedName & domain)
 {
-    if (domain == "prov")
+    if (domain == domainName(ID_PROVIDER))
         providerId = id;
-    else if (domain == "xchg")
+    else if (domain == domainName(ID_EXCHANGE))
         exchangeId = id;
 }
 
@@ -761,7 +756,7 @@ setStatic(const Id & id, IdDomain domain)
 
 void
 UserIds::
-set(const Id & id, const std::string & domain)
+set(const Id & id, const InternedName & domain)
 {
     (*this)[domain] = id;
 }
@@ -772,7 +767,7 @@ toJson() const
 {
     Json::Value result;
     for (auto it = begin(), end = this->end();  it != end;  ++it)
-        result[it->first] = it->second.toString();
+        result[it->first.str()] = it->second.toString();
     return result;
 }
 
@@ -791,7 +786,7 @@ createFromJson(const Json::Value & json)
 
     for (auto it = json.begin(), end = json.end(); it != end;  ++it) {
         Id id(it->asString());
-        result.add(id, it.memberName());
+        result.add(id, InternedName::find(it.memberName()));
     }
 
     return result;
@@ -817,8 +812,11 @@ void
 UserIds::
 serialize(ML::DB::Store_Writer & store) const
 {
+    // Same format as the std::map that this used to be
     unsigned char version = 0;
-    store << version << (map<std::string, Id> &)(*this);
+    store << version << compact_size_t(size());
+    for (auto & entry: *this)
+        store << entry.first.str() << entry.second;
 }
 
 void
@@ -829,7 +827,20 @@ reconstitute(ML::DB::Store_Reader & store)
     store >> version;
     if (version != 0)
         throw ML::Exception("invalid UserIds version");
-    store >> (map<std::string, Id> &)*this;
+
+    compact_size_t sz(store);
+
+    UserIds newMe;
+    newMe.reserve(sz);
+
+    for (unsigned i = 0;  i < sz;  ++i) {
+        string domain;
+        Id id;
+        store >> domain >> id;
+        newMe.add(id, InternedName::find(domain));
+    }
+
+    *this = std::move(newMe);
 }
 
 struct UserIdsDescription
@@ -842,7 +853,7 @@ struct UserIdsDescription
             {
                 string key = context.path.fieldName();
                 Id value(context.expectStringAscii());
-                val->add(value, key);
+                val->add(value, InternedName::find(key));
             };
         
         context.forEachMember(onMember);
@@ -854,7 +865,7 @@ struct UserIdsDescription
         context.startObject();
 
         for (auto & id: *val) {
-            context.startMember(id.first);
+            context.startMember(id.first.str());
             context.writeString(id.second.toString());
         }
 
@@ -1259,54 +1270,5 @@ createFromString(const std::string & str)
     return result;
 }
 
-inline ML::DB::Store_Writer &
-operator << (ML::DB::Store_Writer & store, const Json::Value & val)
-{
-    return store << val.toString();
-}
-
-inline ML::DB::Store_Reader &
-operator >> (ML::DB::Store_Reader & store, Json::Value & val)
-{
-    string s;
-    store >> s;
-    val = Json::parse(s);
-    return store;
-}
-
-
-void
-BidRequest::
-serialize(ML::DB::Store_Writer & store) const
-{
-    using namespace ML::DB;
-    unsigned char version = 2;
-    store << version << auctionId << language << protocolVersion
-          << exchange << provider << timestamp << isTest
-          << location << userIds << imp << url << ipAddress << userAgent
-          << restrictions << segments << meta
-          << winSurcharges;
-}
-
-void
-BidRequest::
-reconstitute(ML::DB::Store_Reader & store)
-{
-    using namespace ML::DB;
-
-    unsigned char version;
-
-    store >> version;
-
-    if (version != 2)
-        throw ML::Exception("problem reconstituting BidRequest: "
-                            "invalid version");
-
-    store >> auctionId >> language >> protocolVersion
-          >> exchange >> provider >> timestamp >> isTest
-          >> location >> userIds >> imp >> url >> ipAddress >> userAgent
-          >> restrictions >> segments >> meta >> winSurcharges;
-}
-
 } // namespace RTBKIT
 
@@ -175,13 +175,17 @@ enum IdDomain {
 
 /** Information known about a user and passed in as part of the bid */
 
-struct UserIds : public std::map<std::string, Id> {
+/** User ids by domain.  Domains are interned, so looking one up compares
+    integers.
+*/
+
+struct UserIds : public InternedMap<Id> {
 
     void add(const Id & id, IdDomain domain);
-    void add(const Id & id, const std::string & domain);
-    void add(const Id & id, const std::string & domain, IdDomain domain2);
+    void add(const Id & id, const InternedName & domain);
+    void add(const Id & id, const InternedName & domain, IdDomain domain2);
 
-    void set(const Id & id, const std::string & domain);
+    void set(const Id & id, const InternedName & domain);
     
     // These are always present
     Id exchangeId;
@@ -201,10 +205,11 @@ struct UserIds : public std::map<std::string, Id> {
     static UserIds createFromJson(const Json::Value & json);
 
     /** Update the static entry belonging to a given domain. */
-    void setStatic(const Id & id, const std::string & domain);
+    void setStatic(const Id & id, const InternedName & domain);
     void setStatic(const Id & id, IdDomain domain);
 
     static const char * domainToString(IdDomain domain);
+    static const InternedName & domainName(IdDomain domain);
 
     std::string serializeToString() const;
     static UserIds createFromString(const std::string & str);
@@ -0,0 +1,687 @@
+/* bid_request_serialization.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Binary serialization of bid requests, as used between the router and
+   the post auction loop and for persistence.
+
+   Version 3 is a binary encoding of the whole request and all of its
+   OpenRTB objects:
+   - each object starts with a varint bitmap of which of its fields differ
+     from a default constructed object; only those fields follow, in
+     declaration order
+   - integers are zigzag encoded varints, floats are written raw
+   - strings are interned within a request: the first occurrence is
+     written out, later ones are a reference to it
+
+   Version 2 (JSON for the ad spots) can still be read.
+*/
+
+#include "rtbkit/common/bid_request.h"
+#include "jml/arch/exception.h"
+#include "jml/db/persistent.h"
+#include "jml/db/compact_size_types.h"
+#include <unordered_map>
+#include <cstring>
+
+
+using namespace std;
+using namespace ML;
+using namespace ML::DB;
+
+namespace RTBKIT {
+
+namespace {
+
+/*****************************************************************************/
+/* FIELD LISTS                                                               */
+/*****************************************************************************/
+
+/* The fields of each object, in the order that they are encoded.  Fields
+   must only ever be appended to these lists (and only to the end of the
+   object), so that readers of older data stay correct.  An object can
+   have at most 64 fields.
+
+   The same list is used for writing and reading; the visitor is given
+   the field by const reference and the reader casts it back, as it always
+   operates on a mutable object.
+*/
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::Banner & banner)
+{
+    v(banner.w);  v(banner.h);  v(banner.id);  v(banner.pos);
+    v(banner.btype);  v(banner.battr);  v(banner.mimes);
+    v(banner.topframe);  v(banner.expdir);  v(banner.api);  v(banner.ext);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::Video & video)
+{
+    v(video.mimes);  v(video.linearity);  v(video.minduration);
+    v(video.maxduration);  v(video.protocol);  v(video.w);  v(video.h);
+    v(video.startdelay);  v(video.sequence);  v(video.battr);
+    v(video.maxextended);  v(video.minbitrate);  v(video.maxbitrate);
+    v(video.boxingallowed);  v(video.playbackmethod);  v(video.delivery);
+    v(video.pos);  v(video.companionad);  v(video.api);
+    v(video.companiontype);  v(video.ext);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::Publisher & publisher)
+{
+    v(publisher.id);  v(publisher.name);  v(publisher.cat);
+    v(publisher.domain);  v(publisher.ext);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::Content & content)
+{
+    v(content.id);  v(content.episode);  v(content.title);
+    v(content.series);  v(content.season);  v(content.url);  v(content.cat);
+    v(content.videoquality);  v(content.keywords);  v(content.contentrating);
+    v(content.userrating);  v(content.context);  v(content.livestream);
+    v(content.sourcerelationship);  v(content.producer);  v(content.len);
+    v(content.qagmediarating);  v(content.embeddable);  v(content.language);
+    v(content.ext);
+}
+
+template<typename V>
+void visitContextFields(V & v, const OpenRTB::Context & context)
+{
+    v(context.id);  v(context.name);  v(context.domain);  v(context.cat);
+    v(context.sectioncat);  v(context.pagecat);  v(context.privacypolicy);
+    v(context.publisher);  v(context.content);  v(context.keywords);
+    v(context.ext);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::Site & site)
+{
+    visitContextFields(v, site);
+    v(site.page);  v(site.ref);  v(site.search);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::App & app)
+{
+    visitContextFields(v, app);
+    v(app.ver);  v(app.bundle);  v(app.paid);  v(app.storeurl);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::Geo & geo)
+{
+    v(geo.lat);  v(geo.lon);  v(geo.country);  v(geo.region);
+    v(geo.regionfips104);  v(geo.metro);  v(geo.city);  v(geo.zip);
+    v(geo.type);  v(geo.ext);  v(geo.dma);  v(geo.latlonconsent);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::Device & device)
+{
+    v(device.dnt);  v(device.ua);  v(device.ip);  v(device.geo);
+    v(device.didsha1);  v(device.didmd5);  v(device.dpidsha1);
+    v(device.dpidmd5);  v(device.ipv6);  v(device.carrier);
+    v(device.language);  v(device.make);  v(device.model);  v(device.os);
+    v(device.osv);  v(device.js);  v(device.connectiontype);
+    v(device.devicetype);  v(device.flashver);  v(device.ext);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::Segment & segment)
+{
+    v(segment.id);  v(segment.name);  v(segment.value);  v(segment.ext);
+    v(segment.segmentusecost);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::Data & data)
+{
+    v(data.id);  v(data.name);  v(data.segment);  v(data.ext);
+    v(data.usecostcurrency);  v(data.datausecost);
+}
+
+template<typename V>
+void visitFields(V & v, const OpenRTB::User & user)
+{
+    v(user.id);  v(user.buyeruid);  v(user.yob);  v(user.gender);
+    v(user.keywords);  v(user.customdata);  v(user.geo);  v(user.data);
+    v(user.ext);  v(user.tz);  v(user.sessiondepth);
+}
+
+template<typename V>
+void visitFields(V & v, const AdSpot & spot)
+{
+    v(spot.id);  v(spot.banner);  v(spot.video);  v(spot.displaymanager);
+    v(spot.displaymanagerver);  v(spot.instl);  v(spot.tagid);
+    v(spot.bidfloor);  v(spot.bidfloorcur);  v(spot.iframebuster);
+    v(spot.ext);
+    v(spot.formats);  v(spot.position);  v(spot.reservePrice);
+    v(spot.restrictions);
+}
+
+template<typename V>
+void visitFields(V & v, const BidRequest & br)
+{
+    v(br.auctionId);  v(br.auctionType);  v(br.timeAvailableMs);
+    v(br.timestamp);  v(br.isTest);  v(br.protocolVersion);
+    v(br.exchange);  v(br.provider);  v(br.site);  v(br.app);
+    v(br.device);  v(br.user);  v(br.imp);  v(br.language);
+    v(br.location);  v(br.url);  v(br.ipAddress);  v(br.userAgent);
+    v(br.userIds);  v(br.restrictions);  v(br.segments);  v(br.meta);
+    v(br.unparseable);  v(br.bidCurrency);  v(br.winSurcharges);
+    v(br.ext);
+}
+
+
+/*****************************************************************************/
+/* FIELD PRESENCE                                                            */
+/*****************************************************************************/
+
+/* A field is left out of the encoding when it has the same value as in a
+   default constructed object of its parent's type, as that's what the
+   reader starts from.  This isn't always the default value of the field's
+   own type: a BidRequest has a SECOND_PRICE auctionType, for example.
+   Objects in optional fields and lists are read into a default
+   constructed object of their own type.
+*/
+
+/** Default constructed object to compare the fields of a T against. */
+template<typename T>
+const T & defaultObject()
+{
+    static const T result;
+    return result;
+}
+
+/** The field of dflt at the same place as field is within obj. */
+template<typename T, typename Obj>
+const T & counterpart(const T & field, const Obj & obj, const Obj & dflt)
+{
+    const char * p = reinterpret_cast<const char *>(&field);
+    ptrdiff_t offset = p - reinterpret_cast<const char *>(&obj);
+    if (offset < 0 || size_t(offset) + sizeof(T) > sizeof(Obj))
+        throw ML::Exception("serialized field isn't a member of its object");
+    return *reinterpret_cast<const T *>
+        (reinterpret_cast<const char *>(&dflt) + offset);
+}
+
+template<typename T>
+bool sameValue(const T & a, const T & b)
+{
+    return a == b;
+}
+
+bool sameValue(float a, float b)
+{
+    // Tagged floats default to NaN
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+bool sameValue(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+/// Tagged ints, bools, floats and enums
+template<typename T>
+auto isDefault(const T & x, const T & d) -> decltype(x.val, bool())
+{
+    return sameValue(x.val, d.val);
+}
+
+/// Objects (also the ones which aren't optional) are always encoded
+template<typename T>
+auto isDefault(const T & x, const T & d)
+    -> decltype(visitFields(*(int *)0, x), bool())
+{
+    return false;
+}
+
+template<typename T>
+bool isDefault(const OpenRTB::Optional<T> & x, const OpenRTB::Optional<T> & d)
+{
+    // An unset optional can't be encoded, so it can only be left out
+    if (!x && d)
+        throw ML::Exception("can't serialize an unset optional field "
+                            "that is set by default");
+    return !x;
+}
+
+/// An empty list is encoded if the default isn't empty
+template<typename T>
+bool isDefault(const std::vector<T> & x, const std::vector<T> & d)
+{
+    return x.empty() && d.empty();
+}
+
+template<typename T, size_t N, typename S>
+bool isDefault(const ML::compact_vector<T, N, S> & x,
+               const ML::compact_vector<T, N, S> & d)
+{
+    return x.empty() && d.empty();
+}
+
+bool isDefault(const std::string & x, const std::string & d)
+{
+    return x == d;
+}
+
+bool isDefault(const Utf8String & x, const Utf8String & d)
+{
+    return x.rawString() == d.rawString();
+}
+
+bool isDefault(const Url & x, const Url & d)
+{
+    return x.toString() == d.toString();
+}
+
+bool isDefault(const Id & x, const Id & d) { return x == d; }
+bool isDefault(const Json::Value & x, const Json::Value & d) { return x == d; }
+bool isDefault(const Date & x, const Date & d) { return x == d; }
+bool isDefault(double x, double d) { return sameValue(x, d); }
+bool isDefault(bool x, bool d) { return x == d; }
+
+bool isDefault(const FormatSet & x, const FormatSet & d)
+{
+    return x.empty() && d.empty();
+}
+
+bool isDefault(const SegmentsBySource & x, const SegmentsBySource & d)
+{
+    return x.empty() && d.empty();
+}
+
+bool isDefault(const UserIds & x, const UserIds & d)
+{
+    return x.empty() && d.empty();
+}
+
+bool isDefault(const LineItems & x, const LineItems & d)
+{
+    return x.entries.empty() && d.entries.empty();
+}
+
+bool isDefault(const Location & x, const Location & d) { return false; }
+bool isDefault(const Amount & x, const Amount & d) { return false; }
+
+/** Visitor that works out the presence bitmap of obj, compared to dflt. */
+template<typename Obj>
+struct FieldMask {
+    FieldMask(const Obj & obj, const Obj & dflt)
+        : obj(obj), dflt(dflt), mask(0), bit(0)
+    {
+    }
+
+    template<typename T>
+    void operator () (const T & field)
+    {
+        if (bit == 64)
+            throw ML::Exception("too many fields to serialize");
+        if (!isDefault(field, counterpart(field, obj, dflt)))
+            mask |= 1ULL << bit;
+        ++bit;
+    }
+
+    const Obj & obj;
+    const Obj & dflt;
+    uint64_t mask;
+    int bit;
+};
+
+
+/*****************************************************************************/
+/* BINARY WRITER                                                             */
+/*****************************************************************************/
+
+struct BinaryWriter {
+    BinaryWriter(Store_Writer & store)
+        : store(store)
+    {
+    }
+
+    Store_Writer & store;
+    std::unordered_map<std::string, unsigned> strings;
+
+    void writeVarint(uint64_t val)
+    {
+        store << compact_size_t(val);
+    }
+
+    void write(int64_t val)
+    {
+        // zigzag, so that small negative numbers stay small
+        writeVarint((uint64_t(val) << 1) ^ uint64_t(val >> 63));
+    }
+
+    void write(int val) { write((int64_t)val); }
+    void write(bool val) { writeVarint(val); }
+    void write(float val) { store << val; }
+    void write(double val) { store << val; }
+
+    /** 0 then the string the first time it's seen, or its index + 1 */
+    void write(const std::string & str)
+    {
+        auto res = strings.insert(make_pair(str, strings.size() + 1));
+        if (!res.second) {
+            writeVarint(res.first->second);
+            return;
+        }
+        writeVarint(0);
+        store << str;
+    }
+
+    void write(const Utf8String & str) { write(str.rawString()); }
+    void write(const Url & url) { write(url.toString()); }
+    void write(const Json::Value & val) { write(val.toString()); }
+    void write(const OpenRTB::MimeType & mime) { write(mime.type); }
+    void write(const OpenRTB::ContentCategory & cat) { write(cat.val); }
+    void write(CurrencyCode code) { writeVarint((uint32_t)code); }
+
+    void write(const Id & id) { store << id; }
+    void write(const Date & date) { store << date; }
+    void write(const FormatSet & formats) { formats.serialize(store); }
+    void write(const Location & location) { location.serialize(store); }
+    void write(const UserIds & userIds) { userIds.serialize(store); }
+    void write(const SegmentsBySource & segs) { segs.serialize(store); }
+    void write(const LineItems & items) { items.serialize(store); }
+    void write(const Amount & amount) { amount.serialize(store); }
+
+    template<typename T>
+    auto write(const T & x) -> decltype(x.val, void())
+    {
+        write(x.val);
+    }
+
+    /** An object on its own, as in an optional field or a list, is read
+        into a default constructed one.
+    */
+    template<typename T>
+    auto write(const T & obj) -> decltype(visitFields(*this, obj), void())
+    {
+        writeObject(obj, defaultObject<T>());
+    }
+
+    /** Writes obj, leaving out the fields that are the same as in dflt,
+        which is what the reader will read it into.
+    */
+    template<typename T>
+    void writeObject(const T & obj, const T & dflt)
+    {
+        FieldMask<T> fieldMask(obj, dflt);
+        visitFields(fieldMask, obj);
+        writeVarint(fieldMask.mask);
+
+        Fields<T> fields(*this, fieldMask.mask, obj, dflt);
+        visitFields(fields, obj);
+    }
+
+    /** A field that is an object is read into the parent's default of it. */
+    template<typename T>
+    auto writeField(const T & field, const T & dflt, int)
+        -> decltype(visitFields(*this, field), void())
+    {
+        writeObject(field, dflt);
+    }
+
+    template<typename T>
+    void writeField(const T & field, const T & dflt, long)
+    {
+        write(field);
+    }
+
+    template<typename T>
+    void write(const OpenRTB::Optional<T> & x)
+    {
+        write(*x);
+    }
+
+    template<typename Vec>
+    void writeList(const Vec & vec)
+    {
+        writeVarint(vec.size());
+        for (auto & x: vec)
+            write(x);
+    }
+
+    template<typename T>
+    void write(const std::vector<T> & vec) { writeList(vec); }
+
+    template<typename T, size_t N, typename S>
+    void write(const ML::compact_vector<T, N, S> & vec) { writeList(vec); }
+
+    /** Writes the fields of obj that are in the mask. */
+    template<typename Obj>
+    struct Fields {
+        Fields(BinaryWriter & writer, uint64_t mask,
+               const Obj & obj, const Obj & dflt)
+            : writer(writer), mask(mask), bit(0), obj(obj), dflt(dflt)
+        {
+        }
+
+        template<typename T>
+        void operator () (const T & field)
+        {
+            if (mask & (1ULL << bit++))
+                writer.writeField(field, counterpart(field, obj, dflt), 0);
+        }
+
+        BinaryWriter & writer;
+        uint64_t mask;
+        int bit;
+        const Obj & obj;
+        const Obj & dflt;
+    };
+};
+
+
+/*****************************************************************************/
+/* BINARY READER                                                             */
+/*****************************************************************************/
+
+struct BinaryReader {
+    BinaryReader(Store_Reader & store)
+        : store(store)
+    {
+    }
+
+    Store_Reader & store;
+    std::vector<std::string> strings;
+
+    uint64_t readVarint()
+    {
+        compact_size_t val(store);
+        return val;
+    }
+
+    void read(int64_t & val)
+    {
+        uint64_t zz = readVarint();
+        val = int64_t(zz >> 1) ^ -int64_t(zz & 1);
+    }
+
+    void read(int & val) { int64_t v;  read(v);  val = v; }
+    void read(bool & val) { val = readVarint(); }
+    void read(float & val) { store >> val; }
+    void read(double & val) { store >> val; }
+
+    void read(std::string & str)
+    {
+        uint64_t ref = readVarint();
+        if (ref == 0) {
+            store >> str;
+            strings.push_back(str);
+            return;
+        }
+        if (ref > strings.size())
+            throw ML::Exception("invalid string reference in bid request");
+        str = strings[ref - 1];
+    }
+
+    void read(Utf8String & str) { string s;  read(s);  str = Utf8String(s); }
+    void read(Url & url) { string s;  read(s);  url = Url(s); }
+    void read(Json::Value & val) { string s;  read(s);  val = Json::parse(s); }
+    void read(OpenRTB::MimeType & mime) { read(mime.type); }
+    void read(OpenRTB::ContentCategory & cat) { read(cat.val); }
+    void read(CurrencyCode & code) { code = (CurrencyCode)readVarint(); }
+
+    void read(Id & id) { store >> id; }
+    void read(Date & date) { store >> date; }
+    void read(FormatSet & formats) { formats.reconstitute(store); }
+    void read(Location & location) { location.reconstitute(store); }
+    void read(UserIds & userIds) { userIds.reconstitute(store); }
+    void read(SegmentsBySource & segs) { segs.reconstitute(store); }
+    void read(LineItems & items) { items.reconstitute(store); }
+    void read(Amount & amount) { amount.reconstitute(store); }
+
+    template<typename T>
+    auto read(T & x) -> decltype(x.val, void())
+    {
+        read(x.val);
+    }
+
+    template<typename T>
+    auto read(T & obj) -> decltype(visitFields(*this, obj), void())
+    {
+        Fields fields(*this, readVarint());
+        visitFields(fields, obj);
+    }
+
+    template<typename T>
+    void read(OpenRTB::Optional<T> & x)
+    {
+        x.emplace();
+        read(*x);
+    }
+
+    template<typename Vec>
+    void readList(Vec & vec)
+    {
+        uint64_t size = readVarint();
+        vec.clear();
+        for (uint64_t i = 0;  i < size;  ++i) {
+            vec.emplace_back();
+            read(vec.back());
+        }
+    }
+
+    template<typename T>
+    void read(std::vector<T> & vec) { readList(vec); }
+
+    template<typename T, size_t N, typename S>
+    void read(ML::compact_vector<T, N, S> & vec) { readList(vec); }
+
+    /** Reads the fields that are in the mask. */
+    struct Fields {
+        Fields(BinaryReader & reader, uint64_t mask)
+            : reader(reader), mask(mask), bit(0)
+        {
+        }
+
+        template<typename T>
+        void operator () (const T & field)
+        {
+            if (mask & (1ULL << bit++))
+                reader.read(const_cast<T &>(field));
+        }
+
+        BinaryReader & reader;
+        uint64_t mask;
+        int bit;
+    };
+};
+
+inline ML::DB::Store_Writer &
+operator << (ML::DB::Store_Writer & store, const Json::Value & val)
+{
+    return store << val.toString();
+}
+
+inline ML::DB::Store_Reader &
+operator >> (ML::DB::Store_Reader & store, Json::Value & val)
+{
+    string s;
+    store >> s;
+    val = Json::parse(s);
+    return store;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* AD SPOT                                                                   */
+/*****************************************************************************/
+
+void
+AdSpot::
+serialize(ML::DB::Store_Writer & store) const
+{
+    unsigned char version = 3;
+    store << version;
+    BinaryWriter writer(store);
+    writer.write(*this);
+}
+
+void
+AdSpot::
+reconstitute(ML::DB::Store_Reader & store)
+{
+    unsigned char version;
+    store >> version;
+    if (version == 2) {
+        string s;
+        store >> s;
+        fromJson(Json::parse(s));
+        return;
+    }
+    if (version != 3)
+        throw ML::Exception("unknown AdSpot serialization version");
+
+    *this = AdSpot();
+    BinaryReader reader(store);
+    reader.read(*this);
+}
+
+
+/*****************************************************************************/
+/* BID REQUEST                                                               */
+/*****************************************************************************/
+
+void
+BidRequest::
+serialize(ML::DB::Store_Writer & store) const
+{
+    unsigned char version = 3;
+    store << version;
+    BinaryWriter writer(store);
+    writer.write(*this);
+}
+
+void
+BidRequest::
+reconstitute(ML::DB::Store_Reader & store)
+{
+    unsigned char version;
+
+    store >> version;
+
+    if (version == 2) {
+        store >> auctionId >> language >> protocolVersion
+              >> exchange >> provider >> timestamp >> isTest
+              >> location >> userIds >> imp >> url >> ipAddress >> userAgent
+              >> restrictions >> segments >> meta >> winSurcharges;
+        return;
+    }
+
+    if (version != 3)
+        throw ML::Exception("problem reconstituting BidRequest: "
+                            "invalid version");
+
+    *this = BidRequest();
+    BinaryReader reader(store);
+    reader.read(*this);
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,231 @@
+/* binary_event_log.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Binary, length-prefixed format for the events that the router and the
+   post auction loop publish to the data logger.
+*/
+
+#include "binary_event_log.h"
+
+
+using namespace std;
+
+
+namespace RTBKIT {
+
+const std::string BinaryEventChannel = "EVENTS";
+
+
+/*****************************************************************************/
+/* BINARY EVENT WRITER                                                       */
+/*****************************************************************************/
+
+BinaryEventWriter::
+BinaryEventWriter(int timestampDigits)
+    : timestampDigits(timestampDigits),
+      eventStart(0), numFieldsPos(0), numFields(0)
+{
+    if (timestampDigits < 0
+        || timestampDigits > BinaryEventBatchHeader::TimestampDigitsMask)
+        throw ML::Exception("invalid number of timestamp digits %d",
+                            timestampDigits);
+
+    reset();
+}
+
+void
+BinaryEventWriter::
+reset()
+{
+    buffer.clear();
+    buffer.reserve(65536 + 4096);
+
+    BinaryEventBatchHeader header;
+    header.magic = BinaryEventBatchHeader::Magic;
+    header.version = BinaryEventBatchHeader::Version;
+    header.flags = timestampDigits;
+    header.numEvents = 0;
+    header.eventBytes = 0;
+    append(header);
+}
+
+void
+BinaryEventWriter::
+startEvent(const std::string & channel, int64_t timestamp)
+{
+    if (channel.size() > 65535)
+        throw ML::Exception("binary event channel name too long");
+
+    eventStart = buffer.size();
+    append<uint32_t>(0);  // length; filled in by finishEvent
+    append<int64_t>(timestamp);
+    append<uint16_t>(channel.size());
+    buffer.append(channel);
+    numFieldsPos = buffer.size();
+    append<uint16_t>(0);  // number of fields; filled in by finishEvent
+    numFields = 0;
+}
+
+void
+BinaryEventWriter::
+finishEvent()
+{
+    uint32_t length = buffer.size() - eventStart - sizeof(uint32_t);
+    memcpy(&buffer[eventStart], &length, sizeof(length));
+    memcpy(&buffer[numFieldsPos], &numFields, sizeof(numFields));
+
+    header().numEvents += 1;
+    header().eventBytes = buffer.size() - sizeof(BinaryEventBatchHeader);
+}
+
+std::string
+BinaryEventWriter::
+release()
+{
+    std::string result;
+    result.swap(buffer);
+    reset();
+    return result;
+}
+
+
+/*****************************************************************************/
+/* BINARY EVENT                                                              */
+/*****************************************************************************/
+
+namespace {
+
+template<typename T>
+T read(const char * & p, const char * end)
+{
+    if (p + sizeof(T) > end)
+        throw ML::Exception("truncated binary event");
+    T result;
+    memcpy(&result, p, sizeof(T));
+    p += sizeof(T);
+    return result;
+}
+
+std::string printTimestamp(int64_t micros, int digits)
+{
+    return Date::fromSecondsSinceEpoch(micros / 1000000.0).print(digits);
+}
+
+} // file scope
+
+std::vector<std::string>
+BinaryEvent::
+toText() const
+{
+    std::vector<std::string> result;
+    result.reserve(numFields + 2);
+
+    result.emplace_back(channel, channelLength);
+    if (timestamp != BinaryEventWriter::NoTimestamp)
+        result.emplace_back(printTimestamp(timestamp, timestampDigits));
+
+    const char * p = fields;
+    for (unsigned i = 0;  i < numFields;  ++i) {
+        uint8_t type = read<uint8_t>(p, end);
+        switch (type) {
+        case BEF_STRING: {
+            uint32_t len = read<uint32_t>(p, end);
+            if (p + len > end)
+                throw ML::Exception("truncated binary event string");
+            result.emplace_back(p, len);
+            p += len;
+            break;
+        }
+        case BEF_INT:
+            result.emplace_back(to_string(read<int64_t>(p, end)));
+            break;
+        case BEF_UINT:
+            result.emplace_back(to_string(read<uint64_t>(p, end)));
+            break;
+        case BEF_DOUBLE:
+            result.emplace_back
+                (boost::lexical_cast<std::string>(read<double>(p, end)));
+            break;
+        case BEF_DATE:
+            result.emplace_back(printTimestamp(read<int64_t>(p, end),
+                                               timestampDigits));
+            break;
+        default:
+            throw ML::Exception("unknown binary event field type %d", type);
+        }
+    }
+
+    return result;
+}
+
+void
+forEachBinaryEvent(const char * data, size_t length,
+                   const std::function<void (const BinaryEvent &)> & onEvent)
+{
+    const char * p = data;
+    const char * end = data + length;
+
+    auto header = read<BinaryEventBatchHeader>(p, end);
+    if (header.magic != BinaryEventBatchHeader::Magic)
+        throw ML::Exception("binary event batch has wrong magic");
+    if (header.version != BinaryEventBatchHeader::Version)
+        throw ML::Exception("binary event batch has unknown version %d",
+                            header.version);
+    if (header.eventBytes != end - p)
+        throw ML::Exception("binary event batch has wrong length");
+
+    for (unsigned i = 0;  i < header.numEvents;  ++i) {
+        BinaryEvent event;
+        event.timestampDigits
+            = header.flags & BinaryEventBatchHeader::TimestampDigitsMask;
+        event.start = p;
+
+        uint32_t eventLength = read<uint32_t>(p, end);
+        if (p + eventLength > end)
+            throw ML::Exception("truncated binary event");
+        event.end = p + eventLength;
+
+        event.timestamp = read<int64_t>(p, event.end);
+        event.channelLength = read<uint16_t>(p, event.end);
+        event.channel = p;
+        p += event.channelLength;
+        event.numFields = read<uint16_t>(p, event.end);
+        event.fields = p;
+
+        onEvent(event);
+
+        p = event.end;
+    }
+}
+
+
+/*****************************************************************************/
+/* BINARY EVENT PUBLISHER                                                    */
+/*****************************************************************************/
+
+BinaryEventPublisher::
+BinaryEventPublisher(ZmqNamedPublisher & publisher, size_t maxBatchBytes,
+                     int timestampDigits)
+    : maxBatchBytes(maxBatchBytes), publisher(publisher),
+      writer(timestampDigits)
+{
+}
+
+void
+BinaryEventPublisher::
+flush()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (writer.empty())
+        return;
+    send(writer.release());
+}
+
+void
+BinaryEventPublisher::
+send(const std::string & batch)
+{
+    publisher.publish(BinaryEventChannel, batch);
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,314 @@
+/* binary_event_log.h                                              -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Binary, length-prefixed format for the events that the router and the
+   post auction loop publish to the data logger.
+*/
+
+#pragma once
+
+#include "soa/types/date.h"
+#include "soa/types/id.h"
+#include "soa/service/zmq_named_pub_sub.h"
+#include "jml/arch/exception.h"
+#include <boost/lexical_cast.hpp>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstring>
+
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* BINARY EVENT FORMAT                                                       */
+/*****************************************************************************/
+
+/** A batch of events is sent as the single data frame of an "EVENTS"
+    message, and is also the unit that the data logger writes to disk.  All
+    integers are in host byte order.
+
+    batch   := BinaryEventBatchHeader event*
+    event   := uint32 length of the rest of the event
+               int64  timestamp in microseconds since the epoch, or
+                      NoTimestamp
+               uint16 length of channel, channel
+               uint16 number of fields
+               field*
+    field   := uint8 BinaryEventFieldType, value
+
+    Strings are stored as a uint32 length followed by the bytes; the other
+    types are stored as their 8 byte value.
+
+    The low bits of the header's flags (TimestampDigitsMask) hold the
+    number of decimals that the event timestamps of the batch are printed
+    with in text form, so that the text matches what its publisher used to
+    send.
+*/
+
+enum BinaryEventFieldType {
+    BEF_STRING = 0,
+    BEF_INT = 1,
+    BEF_UINT = 2,
+    BEF_DOUBLE = 3,
+    BEF_DATE = 4
+};
+
+struct BinaryEventBatchHeader {
+    enum {
+        Magic = 0x45425452,  ///< "RTBE"
+        Version = 1,
+        TimestampDigitsMask = 0x000f
+    };
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t numEvents;
+    uint32_t eventBytes;     ///< Bytes of events following the header
+} __attribute__((__packed__));
+
+/** Channel on which batches of binary events are published. */
+extern const std::string BinaryEventChannel;
+
+
+/*****************************************************************************/
+/* BINARY EVENT WRITER                                                       */
+/*****************************************************************************/
+
+/** Appends events to a batch. */
+
+struct BinaryEventWriter {
+
+    enum : int64_t { NoTimestamp = INT64_MIN };
+
+    /** Timestamps of the events are printed with the given number of
+        decimals when converted to text.
+    */
+    BinaryEventWriter(int timestampDigits = 5);
+
+    /** Append an event with the given timestamp (NoTimestamp for none) to
+        the batch.
+    */
+    template<typename... Args>
+    void add(const std::string & channel, Date timestamp, Args &&... args)
+    {
+        startEvent(channel,
+                   timestamp == Date()
+                   ? (int64_t)NoTimestamp
+                   : (int64_t)(timestamp.secondsSinceEpoch() * 1000000.0));
+        addFields(std::forward<Args>(args)...);
+        finishEvent();
+    }
+
+    size_t numEvents() const { return header().numEvents; }
+    size_t size() const { return buffer.size(); }
+    bool empty() const { return numEvents() == 0; }
+
+    /** Return the batch and start a new one. */
+    std::string release();
+
+private:
+    int timestampDigits;
+    std::string buffer;
+    size_t eventStart;
+    size_t numFieldsPos;
+    uint16_t numFields;
+
+    BinaryEventBatchHeader & header()
+    {
+        return *(BinaryEventBatchHeader *)&buffer[0];
+    }
+
+    const BinaryEventBatchHeader & header() const
+    {
+        return *(const BinaryEventBatchHeader *)&buffer[0];
+    }
+
+    void reset();
+    void startEvent(const std::string & channel, int64_t timestamp);
+    void finishEvent();
+
+    template<typename T>
+    void append(const T & val)
+    {
+        buffer.append((const char *)&val, sizeof(val));
+    }
+
+    void appendString(const char * str, size_t len)
+    {
+        append<uint8_t>(BEF_STRING);
+        append<uint32_t>(len);
+        buffer.append(str, len);
+        ++numFields;
+    }
+
+    void addFields()
+    {
+    }
+
+    template<typename First, typename... Rest>
+    void addFields(First && first, Rest &&... rest)
+    {
+        addField(std::forward<First>(first));
+        addFields(std::forward<Rest>(rest)...);
+    }
+
+    void addField(const std::string & str)
+    {
+        appendString(str.c_str(), str.size());
+    }
+
+    void addField(const char * str)
+    {
+        appendString(str, strlen(str));
+    }
+
+    void addField(const Id & id)
+    {
+        addField(id.toString());
+    }
+
+    void addField(Date date)
+    {
+        append<uint8_t>(BEF_DATE);
+        append<int64_t>(date.secondsSinceEpoch() * 1000000.0);
+        ++numFields;
+    }
+
+    void addField(const std::vector<std::string> & strs)
+    {
+        for (auto & s: strs)
+            addField(s);
+    }
+
+    void addField(double val)
+    {
+        append<uint8_t>(BEF_DOUBLE);
+        append<double>(val);
+        ++numFields;
+    }
+
+    void addField(float val)
+    {
+        addField((double)val);
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value
+                            && std::is_signed<T>::value>::type
+    addField(T val)
+    {
+        append<uint8_t>(BEF_INT);
+        append<int64_t>(val);
+        ++numFields;
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value
+                            && !std::is_signed<T>::value>::type
+    addField(T val)
+    {
+        append<uint8_t>(BEF_UINT);
+        append<uint64_t>(val);
+        ++numFields;
+    }
+
+    /** Anything else is written as its text representation. */
+    template<typename T>
+    typename std::enable_if<!std::is_arithmetic<T>::value>::type
+    addField(const T & val)
+    {
+        addField(boost::lexical_cast<std::string>(val));
+    }
+};
+
+
+/*****************************************************************************/
+/* BINARY EVENT                                                              */
+/*****************************************************************************/
+
+/** View onto an event within a batch.  Only valid as long as the batch. */
+
+struct BinaryEvent {
+    int64_t timestamp;
+    int timestampDigits;     ///< Decimals of the timestamp in text form
+    const char * channel;
+    uint16_t channelLength;
+    uint16_t numFields;
+    const char * fields;     ///< Start of the encoded fields
+    const char * end;        ///< End of the event
+
+    /** Start and length of the whole encoded event, length prefix
+        included.
+    */
+    const char * start;
+    size_t length() const { return end - start; }
+
+    std::string channelStr() const
+    {
+        return std::string(channel, channelLength);
+    }
+
+    /** Return the message that would have been published in text form:
+        channel, timestamp (if there is one) and fields.
+    */
+    std::vector<std::string> toText() const;
+};
+
+/** Call onEvent for each event of the given batch.  Throws if the batch is
+    malformed.
+*/
+void forEachBinaryEvent(const char * data, size_t length,
+                        const std::function<void (const BinaryEvent &)> & onEvent);
+
+
+/*****************************************************************************/
+/* BINARY EVENT PUBLISHER                                                    */
+/*****************************************************************************/
+
+/** Batches events and publishes them on a ZmqNamedPublisher.  Batches are
+    sent once they reach maxBatchBytes, or when flush() is called; the owner
+    is expected to call flush() every few milliseconds.
+
+    Thread safe.
+*/
+
+struct BinaryEventPublisher {
+
+    BinaryEventPublisher(ZmqNamedPublisher & publisher,
+                         size_t maxBatchBytes = 65536,
+                         int timestampDigits = 5);
+
+    template<typename... Args>
+    void publish(const std::string & channel, Date timestamp,
+                 Args &&... args)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        writer.add(channel, timestamp, std::forward<Args>(args)...);
+        if (writer.size() >= maxBatchBytes)
+            send(writer.release());
+    }
+
+    /** Send anything that has been batched up. */
+    void flush();
+
+    size_t maxBatchBytes;
+
+private:
+    ZmqNamedPublisher & publisher;
+
+    /** Also held while a batch is sent, so that batches go out in the
+        order their events were added.
+    */
+    std::mutex lock;
+    BinaryEventWriter writer;
+
+    void send(const std::string & batch);
+};
+
+} // namespace RTBKIT
@@ -2,7 +2,9 @@
 
 LIBBIDREQUEST_SOURCES := \
 	bid_request.cc \
+	bid_request_serialization.cc \
 	segments.cc \
+	interned_name.cc \
 	json_holder.cc \
 	currency.cc \
 
@@ -18,10 +20,16 @@ LIBRTB_SOURCES := \
 	bids.cc \
 	auction_events.cc \
 	exchange_connector.cc \
+	admission_controller.cc \
+	binary_event_log.cc \
+	post_auction_proxy.cc \
+	metric_registry.cc \
+	thread_placement.cc \
+	frequency_cap_store.cc \
     win_cost_model.cc \
 
 LIBRTB_LINK := \
-	ACE arch utils jsoncpp boost_thread endpoint boost_regex zmq opstats bid_request
+	ACE arch utils jsoncpp boost_thread endpoint boost_regex zmq opstats bid_request services
 
 $(eval $(call library,rtb,$(LIBRTB_SOURCES),$(LIBRTB_LINK)))
 
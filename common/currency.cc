@@ -5,6 +5,7 @@
 */
 
 #include "rtbkit/common/currency.h"
+#include <algorithm>
 
 using namespace std;
 using namespace ML;
@@ -264,7 +265,9 @@ reconstitute(ML::DB::Store_Reader & store)
 
 Amount bidPriceCeiling(CurrencyCode code)
 {
-    if (code == CurrencyCode::CC_USD) return USD_CPM(200);
+    static const Amount usdCeiling = USD_CPM(200);
+
+    if (code == CurrencyCode::CC_USD) return usdCeiling;
 
     ExcCheck(false, "Undefined bid price ceiling for currency " + toString(code));
 }
@@ -392,6 +395,62 @@ isSameOrPastVersion(const CurrencyPool & otherPool)
     return true;
 }
 
+
+/*****************************************************************************/
+/* CURRENCY TOTALS                                                           */
+/*****************************************************************************/
+
+CurrencyTotals::
+CurrencyTotals(const CurrencyPool & pool)
+{
+    clear();
+    for (auto & am: pool.currencyAmounts) {
+        if (am.currencyCode == CurrencyCode::CC_NONE)
+            continue;
+        int s = slot(am.currencyCode);
+        values[s] += am.value;
+        present |= 1 << s;
+    }
+}
+
+CurrencyCode
+CurrencyTotals::
+currency(int slot)
+{
+    return slot == 1 ? CurrencyCode::CC_IMP : CurrencyCode::CC_USD;
+}
+
+void
+CurrencyTotals::
+throwUnsupported(CurrencyCode code)
+{
+    throw ML::Exception("currency code %08x can't be totalled",
+                        (uint32_t)code);
+}
+
+CurrencyPool
+CurrencyTotals::
+toPool() const
+{
+    CurrencyPool result;
+    for (unsigned i = 0;  i < NumCurrencies;  ++i) {
+        if (values[i] || (present & (1 << i)))
+            result.currencyAmounts.push_back(Amount(currency(i), values[i]));
+    }
+
+    std::sort(result.currencyAmounts.begin(), result.currencyAmounts.end(),
+              [] (Amount am1, Amount am2)
+              { return am1.currencyCode < am2.currencyCode; });
+
+    return result;
+}
+
+std::ostream & operator << (std::ostream & stream, const CurrencyTotals & totals)
+{
+    return stream << totals.toPool();
+}
+
+
 /*****************************************************************************/
 /* LINE ITEMS                                                                */
 /*****************************************************************************/
@@ -10,6 +10,8 @@
 #include "soa/service/service_base.h"
 #include "rtbkit/common/auction.h"
 #include "rtbkit/common/win_cost_model.h"
+#include "rtbkit/common/admission_controller.h"
+#include "rtbkit/common/thread_placement.h"
 #include "jml/utils/unnamed_bool.h"
 
 namespace RTBKIT {
@@ -59,6 +61,17 @@ struct ExchangeConnector: public ServiceBase {
     /** Probability that we will accept a given auction. */
     double acceptAuctionProbability;
 
+    /** Load and deadline based admission control of bid requests.  The
+        router publishes its load into it; the connector asks it whether
+        each request is worth parsing.
+    */
+    AdmissionController admission;
+
+    /** Where the connector's threads run, under "exchange.<name>".  Set by
+        the router before the connector is started; may be null.
+    */
+    std::shared_ptr<ThreadPlacement> threadPlacement;
+
     /*************************************************************************/
     /* METHODS CALLED BY THE ROUTER TO CONTROL THE EXCHANGE CONNECTOR        */
     /*************************************************************************/
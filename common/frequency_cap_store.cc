@@ -0,0 +1,220 @@
+/* frequency_cap_store.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Counts of the ads shown to each user, for frequency capping in the
+   router.
+*/
+
+#include "frequency_cap_store.h"
+#include "jml/arch/exception.h"
+#include <city.h>
+#include <algorithm>
+#include <cmath>
+
+
+using namespace std;
+using namespace ML;
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* FREQUENCY CAP STORE                                                       */
+/*****************************************************************************/
+
+const std::string FrequencyCapChannel = "FREQCAP";
+
+FrequencyCapStore::
+FrequencyCapStore(size_t capacity, double bucketSeconds)
+    : bucketSeconds_(bucketSeconds),
+      numUsed(0), numEvicted(0), numAdded(0)
+{
+    if (bucketSeconds <= 0.0)
+        throw ML::Exception("frequency cap buckets must have a length");
+
+    // Round up to a power of two so that the position is a mask of the key
+    size_t size = ProbeLength;
+    while (size < capacity)
+        size *= 2;
+
+    slots = std::vector<Slot>(size);
+    mask = size - 1;
+}
+
+uint64_t
+FrequencyCapStore::
+userKey(const UserIds & ids)
+{
+    if (ids.providerId)
+        return key(ids.providerId.hash(), ID_PROVIDER);
+    if (ids.exchangeId)
+        return key(ids.exchangeId.hash(), ID_EXCHANGE);
+    return 0;
+}
+
+uint64_t
+FrequencyCapStore::
+scopeKey(const AccountKey & account,
+         FrequencyCapScope scope,
+         FrequencyCapEvent event)
+{
+    string name = scope == FCS_CAMPAIGN
+        ? account.at(0, "") : account.toString();
+    return CityHash64WithSeed(name.c_str(), name.size(), event + 1);
+}
+
+uint64_t
+FrequencyCapStore::
+key(uint64_t userKey, uint64_t scopeKey)
+{
+    uint64_t result = Hash128to64(uint128(userKey, scopeKey));
+    return result ? result : 1;
+}
+
+uint32_t
+FrequencyCapStore::
+windowBuckets(double seconds) const
+{
+    double buckets = std::ceil(seconds / bucketSeconds_);
+    return std::max<double>(1, std::min<double>(buckets, NumBuckets));
+}
+
+FrequencyCapStore::Slot *
+FrequencyCapStore::
+find(uint64_t key)
+{
+    for (unsigned i = 0;  i < ProbeLength;  ++i) {
+        Slot & slot = slots[(key + i) & mask];
+        if (slot.key.load(std::memory_order_relaxed) == key)
+            return &slot;
+    }
+    return nullptr;
+}
+
+const FrequencyCapStore::Slot *
+FrequencyCapStore::
+find(uint64_t key) const
+{
+    for (unsigned i = 0;  i < ProbeLength;  ++i) {
+        const Slot & slot = slots[(key + i) & mask];
+        if (slot.key.load(std::memory_order_acquire) == key)
+            return &slot;
+    }
+    return nullptr;
+}
+
+void
+FrequencyCapStore::
+add(uint64_t key, uint32_t bucket, uint32_t count)
+{
+    numAdded.fetch_add(1, std::memory_order_relaxed);
+
+    Slot * slot = find(key);
+
+    if (!slot) {
+        // Take a free slot, or else the one that was updated longest ago
+        Slot * oldest = nullptr;
+        for (unsigned i = 0;  i < ProbeLength;  ++i) {
+            Slot & candidate = slots[(key + i) & mask];
+            if (candidate.key.load(std::memory_order_relaxed) == 0) {
+                oldest = &candidate;
+                numUsed.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            if (!oldest || candidate.lastBucket < oldest->lastBucket)
+                oldest = &candidate;
+        }
+
+        slot = oldest;
+        if (slot->key.load(std::memory_order_relaxed) != 0) {
+            if (slot->lastBucket + NumBuckets > bucket)
+                numEvicted.fetch_add(1, std::memory_order_relaxed);
+
+            // Hide the slot from readers while it's being reset
+            slot->key.store(0, std::memory_order_release);
+        }
+
+        for (auto & c: slot->counts)
+            c.store(0, std::memory_order_relaxed);
+        slot->lastBucket.store(bucket, std::memory_order_relaxed);
+        slot->key.store(key, std::memory_order_release);
+    }
+
+    uint32_t last = slot->lastBucket.load(std::memory_order_relaxed);
+
+    if (bucket > last) {
+        // Reset the buckets that we are moving past
+        for (uint32_t b = last + 1;  b <= bucket && b <= last + NumBuckets;
+             ++b)
+            slot->counts[b % NumBuckets].store(0, std::memory_order_relaxed);
+        slot->lastBucket.store(bucket, std::memory_order_release);
+    }
+    else if (bucket + NumBuckets <= last)
+        return;  // Too old to be counted any more
+
+    auto & counter = slot->counts[bucket % NumBuckets];
+    uint32_t total = counter.load(std::memory_order_relaxed) + count;
+    counter.store(std::min<uint32_t>(total, 0xffff),
+                  std::memory_order_relaxed);
+}
+
+size_t
+FrequencyCapStore::
+apply(const std::string & batch)
+{
+    if (batch.size() % sizeof(FrequencyCapDelta) != 0)
+        throw ML::Exception("frequency cap batch of %zd bytes isn't made of "
+                            "deltas", batch.size());
+
+    size_t n = batch.size() / sizeof(FrequencyCapDelta);
+    auto deltas = reinterpret_cast<const FrequencyCapDelta *>(batch.data());
+    for (size_t i = 0;  i < n;  ++i)
+        add(deltas[i]);
+
+    return n;
+}
+
+uint32_t
+FrequencyCapStore::
+count(uint64_t key, uint32_t bucket, uint32_t windowBuckets) const
+{
+    const Slot * slot = find(key);
+    if (!slot)
+        return 0;
+
+    windowBuckets = std::min<uint32_t>(windowBuckets, NumBuckets);
+
+    uint32_t last = slot->lastBucket.load(std::memory_order_acquire);
+
+    // Buckets in the window for which the slot has counts
+    int64_t first = std::max<int64_t>({ int64_t(bucket) - windowBuckets + 1,
+                                        int64_t(last) - NumBuckets + 1,
+                                        0 });
+    int64_t end = std::min(bucket, last);
+
+    uint32_t result = 0;
+    for (int64_t b = first;  b <= end;  ++b)
+        result += slot->counts[b % NumBuckets].load(std::memory_order_relaxed);
+
+    // The slot was given to another counter while we were reading it
+    if (slot->key.load(std::memory_order_acquire) != key)
+        return 0;
+
+    return result;
+}
+
+Json::Value
+FrequencyCapStore::
+getStats() const
+{
+    Json::Value result;
+    result["capacity"] = (Json::UInt64)slots.size();
+    result["used"] = (Json::UInt64)numUsed.load();
+    result["evicted"] = (Json::UInt64)numEvicted.load();
+    result["added"] = (Json::UInt64)numAdded.load();
+    result["bucketSeconds"] = bucketSeconds_;
+    return result;
+}
+
+} // namespace RTBKIT
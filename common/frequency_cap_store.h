@@ -0,0 +1,175 @@
+/* frequency_cap_store.h                                           -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Counts of the ads shown to each user, for frequency capping in the
+   router.
+*/
+
+#pragma once
+
+#include "rtbkit/common/bid_request.h"
+#include "rtbkit/common/account_key.h"
+#include "soa/types/date.h"
+#include "soa/jsoncpp/json.h"
+#include <atomic>
+#include <vector>
+#include <string>
+
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* FREQUENCY CAP EVENT                                                       */
+/*****************************************************************************/
+
+/** What is counted towards a frequency cap. */
+enum FrequencyCapEvent {
+    FCE_WIN,            ///< Wins matched by the post auction loop
+    FCE_IMPRESSION      ///< IMPRESSION campaign events
+};
+
+/** How much of an agent's account a frequency cap applies to. */
+enum FrequencyCapScope {
+    FCS_CAMPAIGN,       ///< The first element of the account
+    FCS_ACCOUNT         ///< The whole account
+};
+
+
+/*****************************************************************************/
+/* FREQUENCY CAP DELTA                                                       */
+/*****************************************************************************/
+
+/** Increment of a counter, as published by the post auction loops to the
+    routers.  Deltas are sent in batches, as the packed array making up the
+    single data frame of a message on FrequencyCapChannel.  They carry the
+    time of the events rather than their bucket so that the publishers
+    don't need to know how long the routers' buckets are.
+*/
+
+struct FrequencyCapDelta {
+    uint64_t key;       ///< FrequencyCapStore::key() of user and scope
+    uint32_t seconds;   ///< When the events happened, since the epoch
+    uint32_t count;
+} __attribute__((__packed__));
+
+/** Channel of the post auction loop's logger that deltas are sent on. */
+extern const std::string FrequencyCapChannel;
+
+
+/*****************************************************************************/
+/* FREQUENCY CAP STORE                                                       */
+/*****************************************************************************/
+
+/** Number of events per (user, campaign or account) over the last day or
+    so, in a fixed amount of memory.
+
+    Each counter is a slot of an open addressed table holding the key and
+    the counts of the last NumBuckets time buckets (an hour long by
+    default); buckets that fall out of the window are reset as the counter
+    moves on to new ones, so nothing needs to be expired.  When the slots
+    near a key's position are all in use, the one that was updated the
+    longest ago is reused, so that the least active users are forgotten
+    first (and can then be shown an ad more often than their cap).
+
+    add() must only be called by a single thread; count() is lock free and
+    may be called from any thread while it runs.  A count taken while its
+    counter is being updated may be off by that update.
+*/
+
+struct FrequencyCapStore {
+
+    enum {
+        NumBuckets = 24,
+        ProbeLength = 8,
+        DefaultBucketSeconds = 3600,
+
+        /// Longest window that the router's store can count
+        MaxWindowSeconds = NumBuckets * DefaultBucketSeconds
+    };
+
+    FrequencyCapStore(size_t capacity = 1 << 20,
+                      double bucketSeconds = DefaultBucketSeconds);
+
+    /** Key of the user of a request: its provider id, or else its exchange
+        id.  0 if it has neither.
+    */
+    static uint64_t userKey(const UserIds & ids);
+
+    /** Key of the counter of the given event for the given scope of an
+        account.
+    */
+    static uint64_t scopeKey(const AccountKey & account,
+                             FrequencyCapScope scope,
+                             FrequencyCapEvent event);
+
+    /** Key of the counter of a user for a scope. */
+    static uint64_t key(uint64_t userKey, uint64_t scopeKey);
+
+    /** Bucket of events that happen at the given date. */
+    uint32_t bucketOf(Date date) const
+    {
+        return date.secondsSinceEpoch() / bucketSeconds_;
+    }
+
+    /** Number of buckets that make up a window of the given length,
+        counting the current one, which has only just started at the
+        beginning of a bucket.  A length that isn't a whole number of
+        buckets is rounded up.  At most NumBuckets.
+    */
+    uint32_t windowBuckets(double seconds) const;
+
+    /** Add events to a counter.  Single writer. */
+    void add(uint64_t key, uint32_t bucket, uint32_t count = 1);
+
+    void add(const FrequencyCapDelta & delta)
+    {
+        add(delta.key, delta.seconds / bucketSeconds_, delta.count);
+    }
+
+    /** Apply a batch of deltas as published on FrequencyCapChannel.
+        Returns the number of deltas.  Single writer.
+    */
+    size_t apply(const std::string & batch);
+
+    /** Return the number of events of the counter over the window of
+        the given number of buckets ending with the given bucket.
+    */
+    uint32_t count(uint64_t key, uint32_t bucket,
+                   uint32_t windowBuckets) const;
+
+    double bucketSeconds() const { return bucketSeconds_; }
+
+    size_t capacity() const { return slots.size(); }
+
+    Json::Value getStats() const;
+
+private:
+    struct Slot {
+        Slot()
+            : key(0), lastBucket(0)
+        {
+            for (auto & c: counts)
+                c = 0;
+        }
+
+        std::atomic<uint64_t> key;          ///< 0 if never used
+        std::atomic<uint32_t> lastBucket;   ///< Newest bucket counted
+        std::atomic<uint16_t> counts[NumBuckets];
+    };
+
+    std::vector<Slot> slots;
+    uint64_t mask;
+    double bucketSeconds_;
+
+    std::atomic<uint64_t> numUsed;
+    std::atomic<uint64_t> numEvicted;
+    std::atomic<uint64_t> numAdded;
+
+    Slot * find(uint64_t key);
+    const Slot * find(uint64_t key) const;
+};
+
+} // namespace RTBKIT
@@ -0,0 +1,214 @@
+/* interned_name.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Process wide table of interned names.
+*/
+
+#include "interned_name.h"
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+
+
+using namespace std;
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* INTERNED NAME                                                             */
+/*****************************************************************************/
+
+namespace {
+
+struct InternedNames {
+    enum {
+        ChunkBits = 10,
+        ChunkSize = 1 << ChunkBits,
+        MaxChunks = InternedName::MaxNames / ChunkSize
+    };
+
+    InternedNames()
+        : size(0)
+    {
+        for (auto & chunk: chunks)
+            chunk = nullptr;
+
+        // The empty string is handle 0, so that it needs no interning
+        chunks[0] = new std::string[ChunkSize];
+        size = 1;
+        handles[""] = InternedName::Empty;
+    }
+
+    std::mutex lock;
+    std::unordered_map<std::string, InternedName::Handle> handles;
+
+    std::atomic<std::string *> chunks[MaxChunks];
+    std::atomic<InternedName::Handle> size;
+
+    const std::string & get(InternedName::Handle handle) const
+    {
+        static const std::string none;
+        if (handle >= size.load(std::memory_order_acquire))
+            return none;
+        return chunks[handle >> ChunkBits].load(std::memory_order_relaxed)
+            [handle & (ChunkSize - 1)];
+    }
+};
+
+InternedNames & internedNames()
+{
+    // Never destroyed, as names are used until the very end of the process
+    static InternedNames * names = new InternedNames();
+    return *names;
+}
+
+/** Names of the table that the calling thread has already looked up.  Only
+    names that are in the table are cached, so it is bounded by the table's
+    size.
+*/
+std::unordered_map<std::string, InternedName::Handle> & threadCache()
+{
+    static __thread std::unordered_map<std::string, InternedName::Handle>
+        * cache = 0;
+    if (!cache)
+        cache = new std::unordered_map<std::string, InternedName::Handle>();
+    return *cache;
+}
+
+/** Names that the calling thread looked up with find() and that weren't in
+    the table, so that names an exchange keeps sending that nobody uses
+    don't take the table's lock (and a copy of the string) every time.  An
+    entry is only good while the table has the size that it had when the
+    name was missed.  Emptied when it reaches MaxEntries.
+*/
+struct MissedNames {
+    enum { MaxEntries = 1024 };
+
+    struct Entry {
+        InternedName::Handle tableSize;
+        std::shared_ptr<const std::string> name;
+    };
+
+    std::unordered_map<std::string, Entry> entries;
+};
+
+MissedNames & threadMisses()
+{
+    static __thread MissedNames * misses = 0;
+    if (!misses)
+        misses = new MissedNames();
+    return *misses;
+}
+
+} // file scope
+
+InternedName::Handle
+InternedName::
+intern(const std::string & name)
+{
+    if (name.empty())
+        return Empty;
+
+    auto & cache = threadCache();
+    auto cached = cache.find(name);
+    if (cached != cache.end())
+        return cached->second;
+
+    InternedNames & table = internedNames();
+    Handle handle;
+
+    {
+        std::lock_guard<std::mutex> guard(table.lock);
+
+        auto it = table.handles.find(name);
+        if (it != table.handles.end())
+            handle = it->second;
+        else {
+            handle = table.size.load();
+            if (handle >= MaxNames) {
+                // The table is full; the caller keeps the name itself
+                return None;
+            }
+
+            auto & chunk = table.chunks[handle >> InternedNames::ChunkBits];
+            if (!chunk.load())
+                chunk = new std::string[InternedNames::ChunkSize];
+            chunk.load()[handle & (InternedNames::ChunkSize - 1)] = name;
+
+            table.handles[name] = handle;
+            table.size.store(handle + 1, std::memory_order_release);
+        }
+    }
+
+    cache[name] = handle;
+    return handle;
+}
+
+InternedName
+InternedName::
+find(const std::string & name)
+{
+    InternedName result;
+    if (name.empty())
+        return result;
+
+    auto & cache = threadCache();
+    auto cached = cache.find(name);
+    if (cached != cache.end()) {
+        result.handle = cached->second;
+        return result;
+    }
+
+    InternedNames & table = internedNames();
+
+    auto & misses = threadMisses().entries;
+    auto missed = misses.find(name);
+    if (missed != misses.end()) {
+        if (missed->second.tableSize == table.size.load()) {
+            result.handle = None;
+            result.uninterned = missed->second.name;
+            return result;
+        }
+        // The table grew since, so the name may be in it now
+        misses.erase(missed);
+    }
+
+    Handle tableSize;
+    {
+        std::lock_guard<std::mutex> guard(table.lock);
+        auto it = table.handles.find(name);
+        if (it != table.handles.end())
+            result.handle = it->second;
+        else result.handle = None;
+        tableSize = table.size.load();
+    }
+
+    if (result.handle == None) {
+        result.uninterned.reset(new std::string(name));
+        if (misses.size() >= MissedNames::MaxEntries)
+            misses.clear();
+        misses[name] = MissedNames::Entry{ tableSize, result.uninterned };
+        return result;
+    }
+
+    cache[name] = result.handle;
+    return result;
+}
+
+const std::string &
+InternedName::
+nameOf(Handle handle)
+{
+    return internedNames().get(handle);
+}
+
+size_t
+InternedName::
+tableSize()
+{
+    return internedNames().size.load();
+}
+
+} // namespace RTBKIT
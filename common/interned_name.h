@@ -0,0 +1,299 @@
+/* interned_name.h                                                 -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Process wide table of the names used as keys in bid requests (user id
+   domains, segment sources) and a small flat map keyed by them.
+*/
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <cstdint>
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* INTERNED NAME                                                             */
+/*****************************************************************************/
+
+/** Handle on a name held in a process wide table.  Names are interned the
+    first time they are seen and are never freed; there are only a few
+    dozen of them in practice (one per user id domain and segment source
+    used by the code and the agent configurations).
+
+    Names that come from bid requests are looked up with find(), which
+    never grows the table: a name that isn't in it is kept uninterned,
+    holding its own copy of the string, so that arbitrary keys sent by an
+    exchange can't fill the table up.  The table is also capped at
+    MaxNames; past that, interning gives uninterned names too.
+
+    Two interned names are equal if their handles are, so comparing them is
+    an integer comparison; uninterned names are compared by their strings.
+    Names are ordered like their strings, so that containers keyed by them
+    iterate in the same order as the std::map keyed by strings that they
+    replace, and they convert implicitly to the string.
+
+    Interning goes through a per thread cache of the names in the table
+    (so bounded like it) before taking the table's lock; going from a
+    handle back to the name is lock free.  find() also remembers, per
+    thread and up to a bound, the names it didn't find while the table
+    doesn't change, so missing names don't take the lock either.
+*/
+
+struct InternedName {
+
+    typedef uint32_t Handle;
+
+    enum : Handle {
+        Empty = 0,              ///< The empty string, always interned
+        None = 0xffffffff       ///< Not in the table
+    };
+
+    enum { MaxNames = 65536 };
+
+    InternedName()
+        : handle(Empty)
+    {
+    }
+
+    InternedName(const std::string & name)
+        : handle(intern(name))
+    {
+        if (handle == None)
+            uninterned.reset(new std::string(name));
+    }
+
+    InternedName(const char * name)
+        : handle(intern(name))
+    {
+        if (handle == None)
+            uninterned.reset(new std::string(name));
+    }
+
+    /** Return the interned name for the string or, if it was never
+        interned, an uninterned name (with a handle of None) that holds the
+        string.  Doesn't grow the table, so it is the one to use for
+        strings that come from outside.
+    */
+    static InternedName find(const std::string & name);
+
+    const std::string & str() const
+    {
+        return uninterned ? *uninterned : nameOf(handle);
+    }
+
+    const char * c_str() const { return str().c_str(); }
+
+    operator const std::string & () const { return str(); }
+
+    bool empty() const { return handle == Empty; }
+
+    bool interned() const { return !uninterned; }
+
+    bool operator == (const InternedName & other) const
+    {
+        if (!uninterned && !other.uninterned)
+            return handle == other.handle;
+        return str() == other.str();
+    }
+
+    bool operator != (const InternedName & other) const
+    {
+        return !operator == (other);
+    }
+
+    bool operator < (const InternedName & other) const
+    {
+        if (!uninterned && !other.uninterned && handle == other.handle)
+            return false;
+        return str() < other.str();
+    }
+
+    /** Number of names interned so far. */
+    static size_t tableSize();
+
+    Handle handle;
+
+private:
+    /// The name, for those that aren't in the table
+    std::shared_ptr<const std::string> uninterned;
+
+    static Handle intern(const std::string & name);
+    static const std::string & nameOf(Handle handle);
+};
+
+inline bool operator == (const InternedName & name, const std::string & str)
+{
+    return name.str() == str;
+}
+
+inline bool operator == (const std::string & str, const InternedName & name)
+{
+    return name.str() == str;
+}
+
+inline bool operator == (const InternedName & name, const char * str)
+{
+    return name.str() == str;
+}
+
+inline bool operator != (const InternedName & name, const std::string & str)
+{
+    return name.str() != str;
+}
+
+inline bool operator != (const InternedName & name, const char * str)
+{
+    return name.str() != str;
+}
+
+inline std::ostream & operator << (std::ostream & stream,
+                                   const InternedName & name)
+{
+    return stream << name.str();
+}
+
+
+/*****************************************************************************/
+/* INTERNED MAP                                                              */
+/*****************************************************************************/
+
+/** Map from interned names to values, kept in a vector sorted by name.
+
+    This is meant for the handful of entries that a bid request has per
+    map: a lookup is a scan comparing integers (or strings, for uninterned
+    names), and the map is one
+    allocation however many entries it has.  It has the subset of the
+    interface of std::map that the bid request's containers need; the key
+    of an entry converts to a string where one is expected.
+*/
+
+template<typename Value>
+struct InternedMap {
+
+    typedef InternedName key_type;
+    typedef Value mapped_type;
+    typedef std::pair<InternedName, Value> value_type;
+    typedef std::vector<value_type> Entries;
+    typedef typename Entries::iterator iterator;
+    typedef typename Entries::const_iterator const_iterator;
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear() { entries.clear(); }
+    void reserve(size_t n) { entries.reserve(n); }
+
+    iterator find(const InternedName & name)
+    {
+        for (auto it = entries.begin(), end = entries.end();  it != end;  ++it)
+            if (it->first == name)
+                return it;
+        return entries.end();
+    }
+
+    const_iterator find(const InternedName & name) const
+    {
+        for (auto it = entries.begin(), end = entries.end();  it != end;  ++it)
+            if (it->first == name)
+                return it;
+        return entries.end();
+    }
+
+    size_t count(const InternedName & name) const
+    {
+        return find(name) != end();
+    }
+
+    Value & at(const InternedName & name)
+    {
+        auto it = find(name);
+        if (it == end())
+            throw std::out_of_range("InternedMap::at: " + name.str());
+        return it->second;
+    }
+
+    const Value & at(const InternedName & name) const
+    {
+        auto it = find(name);
+        if (it == end())
+            throw std::out_of_range("InternedMap::at: " + name.str());
+        return it->second;
+    }
+
+    Value & operator [] (const InternedName & name)
+    {
+        auto it = find(name);
+        if (it != end())
+            return it->second;
+        return insertNew(name, Value())->second;
+    }
+
+    /** Insert the entry unless there's already one for its name.  Returns
+        the entry for the name and whether it was inserted.
+    */
+    std::pair<iterator, bool> insert(const value_type & entry)
+    {
+        auto it = find(entry.first);
+        if (it != end())
+            return std::make_pair(it, false);
+        return std::make_pair(insertNew(entry.first, entry.second), true);
+    }
+
+    size_t erase(const InternedName & name)
+    {
+        auto it = find(name);
+        if (it == end())
+            return 0;
+        entries.erase(it);
+        return 1;
+    }
+
+    iterator erase(iterator it)
+    {
+        return entries.erase(it);
+    }
+
+    void swap(InternedMap & other)
+    {
+        entries.swap(other.entries);
+    }
+
+    bool operator == (const InternedMap & other) const
+    {
+        return entries == other.entries;
+    }
+
+    bool operator != (const InternedMap & other) const
+    {
+        return entries != other.entries;
+    }
+
+private:
+    Entries entries;
+
+    iterator insertNew(const InternedName & name, const Value & value)
+    {
+        auto pos = std::lower_bound(entries.begin(), entries.end(), name,
+                                    [] (const value_type & entry,
+                                        const InternedName & name)
+                                    {
+                                        return entry.first < name;
+                                    });
+        return entries.insert(pos, value_type(name, value));
+    }
+};
+
+} // namespace RTBKIT
@@ -0,0 +1,217 @@
+/* metric_registry.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Counters whose names are resolved once.
+*/
+
+#include "metric_registry.h"
+#include "jml/arch/exception.h"
+#include <city.h>
+#include <cstring>
+
+
+using namespace std;
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* METRIC REGISTRY                                                           */
+/*****************************************************************************/
+
+MetricRegistry::Chunk::
+Chunk()
+{
+    for (auto & metric: metrics)
+        metric.lastFlushed = 0;
+    for (auto & shard: counts)
+        for (auto & count: shard)
+            count = 0;
+}
+
+MetricRegistry::
+MetricRegistry(EventRecorder & recorder)
+    : recorder(recorder), numMetrics(0)
+{
+    for (auto & chunk: chunks)
+        chunk = nullptr;
+}
+
+MetricRegistry::
+~MetricRegistry()
+{
+    for (auto & chunk: chunks)
+        delete chunk.load();
+}
+
+int
+MetricRegistry::
+threadShard()
+{
+    static std::atomic<int> nextShard(0);
+    static __thread int shard = -1;
+
+    if (JML_UNLIKELY(shard == -1))
+        shard = nextShard.fetch_add(1) % NumShards;
+    return shard;
+}
+
+MetricHandle
+MetricRegistry::
+counter(const std::string & name)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = handles.find(name);
+    if (it != handles.end())
+        return it->second;
+
+    MetricHandle handle = numMetrics.load();
+    if (handle >= MaxChunks * ChunkSize)
+        throw ML::Exception("too many metrics registered");
+
+    auto & chunk = chunks[handle >> ChunkBits];
+    if (!chunk.load())
+        chunk = new Chunk();
+
+    chunk.load()->metrics[handle & (ChunkSize - 1)].name = name;
+
+    handles[name] = handle;
+    numMetrics.store(handle + 1, std::memory_order_release);
+
+    return handle;
+}
+
+const MetricRegistry::Metric &
+MetricRegistry::
+metric(MetricHandle handle) const
+{
+    if (handle >= numMetrics.load(std::memory_order_acquire))
+        throw ML::Exception("unknown metric handle %u", handle);
+    return chunks[handle >> ChunkBits].load()
+        ->metrics[handle & (ChunkSize - 1)];
+}
+
+const std::string &
+MetricRegistry::
+name(MetricHandle handle) const
+{
+    return metric(handle).name;
+}
+
+void
+MetricRegistry::
+outcome(MetricHandle handle, double value) const
+{
+    recorder.recordEvent(name(handle).c_str(), ET_OUTCOME, value);
+}
+
+uint64_t
+MetricRegistry::
+total(MetricHandle handle) const
+{
+    metric(handle);  // check that the handle is valid
+
+    Chunk * chunk = chunks[handle >> ChunkBits].load();
+    uint64_t result = 0;
+    for (unsigned i = 0;  i < NumShards;  ++i)
+        result += chunk->counts[i][handle & (ChunkSize - 1)]
+            .load(std::memory_order_relaxed);
+    return result;
+}
+
+void
+MetricRegistry::
+flush()
+{
+    uint32_t n = numMetrics.load(std::memory_order_acquire);
+
+    for (MetricHandle handle = 0;  handle < n;  ++handle) {
+        Chunk * chunk = chunks[handle >> ChunkBits].load();
+        Metric & metric = chunk->metrics[handle & (ChunkSize - 1)];
+
+        uint64_t current = total(handle);
+        if (current == metric.lastFlushed)
+            continue;
+
+        recorder.recordEvent(metric.name.c_str(), ET_COUNT,
+                             current - metric.lastFlushed);
+        metric.lastFlushed = current;
+    }
+}
+
+
+/*****************************************************************************/
+/* METRIC FAMILY                                                             */
+/*****************************************************************************/
+
+MetricFamily::
+MetricFamily(MetricRegistry & registry,
+             const std::string & prefix,
+             const std::string & suffix)
+    : registry(registry), prefix_(prefix), suffix_(suffix)
+{
+    for (auto & entry: table) {
+        entry.hash = 0;
+        entry.handle = 0;
+    }
+}
+
+uint64_t
+MetricFamily::
+hashKey(const char * key)
+{
+    uint64_t hash = CityHash64(key, strlen(key));
+    return hash ? hash : 1;
+}
+
+MetricHandle
+MetricFamily::
+resolve(const char * key)
+{
+    uint64_t hash = hashKey(key);
+
+    for (unsigned i = 0;  i < ProbeLength;  ++i) {
+        const Entry & entry = table[(hash + i) % TableSize];
+        uint64_t entryHash = entry.hash.load(std::memory_order_acquire);
+        if (entryHash == hash)
+            return entry.handle;
+        if (entryHash == 0)
+            break;
+    }
+
+    return resolveSlow(key, hash);
+}
+
+MetricHandle
+MetricFamily::
+resolveSlow(const char * key, uint64_t hash)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Entries are only added under the lock, so this can't race with
+    // another insertion
+    for (unsigned i = 0;  i < ProbeLength;  ++i) {
+        Entry & entry = table[(hash + i) % TableSize];
+        uint64_t entryHash = entry.hash.load(std::memory_order_relaxed);
+        if (entryHash == hash)
+            return entry.handle;
+        if (entryHash != 0)
+            continue;
+
+        entry.handle = registry.counter(prefix_ + key + suffix_);
+        entry.hash.store(hash, std::memory_order_release);
+        return entry.handle;
+    }
+
+    auto it = overflow.find(hash);
+    if (it != overflow.end())
+        return it->second;
+
+    MetricHandle handle = registry.counter(prefix_ + key + suffix_);
+    overflow[hash] = handle;
+    return handle;
+}
+
+} // namespace RTBKIT
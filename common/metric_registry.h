@@ -0,0 +1,179 @@
+/* metric_registry.h                                               -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Counters whose names are resolved once, for the hot paths of the router.
+*/
+
+#pragma once
+
+#include "soa/service/service_base.h"
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* METRIC REGISTRY                                                           */
+/*****************************************************************************/
+
+typedef uint32_t MetricHandle;
+
+/** Registry of named counters.  A counter's name is turned into a handle
+    once (typically when an agent is configured); after that, counting a hit
+    is a relaxed atomic increment with no formatting, allocation or lock.
+
+    Counts are kept in a number of shards, each thread picking one, so that
+    threads counting the same event don't all hit the same cache line.
+    flush() adds up the shards and records the increase of every counter
+    since the last flush on the EventRecorder; it should be called
+    periodically from a single thread.
+
+    Outcomes (for which every value matters) are forwarded to the
+    EventRecorder immediately, but still under their pre-built name.
+*/
+
+struct MetricRegistry {
+
+    MetricRegistry(EventRecorder & recorder);
+
+    ~MetricRegistry();
+
+    /** Return the handle of the counter with the given name, creating it if
+        necessary.  Takes a lock.
+    */
+    MetricHandle counter(const std::string & name);
+
+    /** Count hits on a counter.  Thread safe and lock free. */
+    void hit(MetricHandle handle, uint64_t count = 1)
+    {
+        shardFor(handle)[handle & (ChunkSize - 1)]
+            .fetch_add(count, std::memory_order_relaxed);
+    }
+
+    /** Record an outcome under the name of the given counter. */
+    void outcome(MetricHandle handle, double value) const;
+
+    /** Record the counts accumulated since the last flush. */
+    void flush();
+
+    /** Name of the given counter. */
+    const std::string & name(MetricHandle handle) const;
+
+    /** Current total of the given counter.  For testing. */
+    uint64_t total(MetricHandle handle) const;
+
+    size_t size() const { return numMetrics.load(); }
+
+    enum {
+        NumShards = 8,
+        ChunkBits = 10,
+        ChunkSize = 1 << ChunkBits,
+        MaxChunks = 1024
+    };
+
+private:
+    EventRecorder & recorder;
+
+    struct Metric {
+        std::string name;
+        uint64_t lastFlushed;
+    };
+
+    /** Counts of ChunkSize metrics in each of the shards. */
+    struct Chunk {
+        Chunk();
+
+        Metric metrics[ChunkSize];
+        std::atomic<uint64_t> counts[NumShards][ChunkSize];
+    };
+
+    std::mutex lock;
+    std::unordered_map<std::string, MetricHandle> handles;
+    std::atomic<Chunk *> chunks[MaxChunks];
+    std::atomic<uint32_t> numMetrics;
+
+    static int threadShard();
+
+    std::atomic<uint64_t> * shardFor(MetricHandle handle) const
+    {
+        return chunks[handle >> ChunkBits].load(std::memory_order_relaxed)
+            ->counts[threadShard()];
+    }
+
+    const Metric & metric(MetricHandle handle) const;
+};
+
+
+/*****************************************************************************/
+/* METRIC FAMILY                                                             */
+/*****************************************************************************/
+
+/** Set of counters named prefix + key + suffix, for keys (like filter or
+    error reasons) that are only known as they come up.  Each key is
+    resolved on first use and remembered by a hash of its text.
+
+    Resolved keys are kept in a small open addressed table whose entries are
+    published with a release store, so that counting a key that was seen
+    before only costs a hash and a few probes, with no lock.  Resolving a
+    new key takes a lock; if the table is full the key goes to an overflow
+    map that is only read under that lock.
+*/
+
+struct MetricFamily {
+
+    MetricFamily(MetricRegistry & registry,
+                 const std::string & prefix,
+                 const std::string & suffix = "");
+
+    /** Return the handle for the given key.  Lock free for the keys that
+        are in the table.
+    */
+    MetricHandle resolve(const char * key);
+
+    void hit(const char * key, uint64_t count = 1)
+    {
+        registry.hit(resolve(key), count);
+    }
+
+    void outcome(const char * key, double value)
+    {
+        registry.outcome(resolve(key), value);
+    }
+
+    const std::string & prefix() const { return prefix_; }
+
+    enum {
+        TableSize = 256,
+        ProbeLength = 16
+    };
+
+private:
+    MetricRegistry & registry;
+    std::string prefix_;
+    std::string suffix_;
+
+    // Keys are identified by a 64 bit hash; a collision between two
+    // metric names isn't worth the cost of storing and comparing them.
+    // A hash of zero marks an empty entry.
+    struct Entry {
+        std::atomic<uint64_t> hash;
+        MetricHandle handle;
+    };
+
+    Entry table[TableSize];
+
+    std::mutex lock;
+    std::unordered_map<uint64_t, MetricHandle> overflow;
+
+    static uint64_t hashKey(const char * key);
+
+    MetricHandle resolveSlow(const char * key, uint64_t hash);
+};
+
+} // namespace RTBKIT
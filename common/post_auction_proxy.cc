@@ -0,0 +1,124 @@
+/* post_auction_proxy.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Connection to a (possibly sharded) post auction service.
+*/
+
+#include "post_auction_proxy.h"
+#include "jml/arch/exception.h"
+#include "jml/arch/format.h"
+
+
+using namespace std;
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* POST AUCTION SHARDS                                                       */
+/*****************************************************************************/
+
+const std::string PostAuctionShards::ConfigPath = "postAuctionShards";
+const std::string PostAuctionShards::ServiceClass = "rtbPostAuctionService";
+
+int
+PostAuctionShards::
+shardFor(const Id & auctionId, int numShards)
+{
+    // Lamping and Veach, "A Fast, Minimal Memory, Consistent Hash Algorithm"
+    uint64_t key = auctionId.hash();
+    int64_t b = -1, j = 0;
+    while (j < numShards) {
+        b = j;
+        key = key * 2862933555777941757ULL + 1;
+        j = (b + 1) * (double(1LL << 31) / double((key >> 33) + 1));
+    }
+    return b;
+}
+
+std::string
+PostAuctionShards::
+serviceClass(int shard, int numShards)
+{
+    if (numShards <= 1)
+        return ServiceClass;
+    return ML::format("%sShard%dof%d", ServiceClass.c_str(), shard, numShards);
+}
+
+void
+PostAuctionShards::
+publish(ConfigurationService & config, int numShards)
+{
+    Json::Value map;
+    map["numShards"] = numShards;
+    config.set(ConfigPath, map);
+}
+
+int
+PostAuctionShards::
+discover(ConfigurationService & config)
+{
+    Json::Value map = config.getJson(ConfigPath);
+    if (map.isNull() || !map.isMember("numShards"))
+        return 1;
+
+    int numShards = map["numShards"].asInt();
+    if (numShards < 1)
+        throw ML::Exception("invalid number of post auction shards %d",
+                            numShards);
+    return numShards;
+}
+
+
+/*****************************************************************************/
+/* POST AUCTION PROXY                                                        */
+/*****************************************************************************/
+
+PostAuctionProxy::
+PostAuctionProxy(std::shared_ptr<zmq::context_t> context)
+    : context(context)
+{
+}
+
+void
+PostAuctionProxy::
+init(std::shared_ptr<ConfigurationService> config)
+{
+    this->config = config;
+}
+
+void
+PostAuctionProxy::
+connect(const std::string & endpointName)
+{
+    if (!config)
+        throw ML::Exception("post auction proxy connected before init");
+    if (!shards.empty())
+        throw ML::Exception("post auction proxy already connected");
+
+    int numShards = PostAuctionShards::discover(*config);
+
+    for (int i = 0;  i < numShards;  ++i) {
+        std::unique_ptr<ZmqNamedProxy> shard(new ZmqNamedProxy(context));
+        shard->init(config, ZMQ_XREQ);
+        shard->connectToServiceClass
+            (PostAuctionShards::serviceClass(i, numShards), endpointName);
+        shards.push_back(std::move(shard));
+    }
+}
+
+bool
+PostAuctionProxy::
+isConnected() const
+{
+    if (shards.empty())
+        return false;
+
+    for (auto & shard: shards)
+        if (!shard->isConnected())
+            return false;
+    return true;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,113 @@
+/* post_auction_proxy.h                                            -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Connection to a (possibly sharded) post auction service.
+*/
+
+#pragma once
+
+#include "soa/service/service_base.h"
+#include "soa/service/zmq_endpoint.h"
+#include "soa/types/id.h"
+#include <memory>
+#include <vector>
+
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* POST AUCTION SHARDS                                                       */
+/*****************************************************************************/
+
+/** The post auction service can be split into a number of shards, each of
+    which owns the auctions whose ID falls into its part of the hash space.
+    Everything about an auction (the submitted bid, its win or loss and its
+    campaign events) must go to the same shard.
+
+    Each shard registers as a provider of both "rtbPostAuctionService" (so
+    that agents and data loggers, which talk to every post auction loop,
+    find it) and of its shard's service class.  The number of shards is
+    published in the configuration service under ConfigPath.
+*/
+
+struct PostAuctionShards {
+
+    /** Path in the configuration service where the shard map lives. */
+    static const std::string ConfigPath;
+
+    /** Service class of the unsharded service, that all shards also
+        register as.
+    */
+    static const std::string ServiceClass;
+
+    /** Return which of numShards shards owns the given auction.  Uses jump
+        consistent hashing, so that going from n to n + 1 shards only moves
+        1 / (n + 1) of the auctions.
+    */
+    static int shardFor(const Id & auctionId, int numShards);
+
+    /** Service class under which the given shard registers. */
+    static std::string serviceClass(int shard, int numShards);
+
+    /** Publish the shard map to the configuration service. */
+    static void publish(ConfigurationService & config, int numShards);
+
+    /** Read the number of shards from the configuration service.  Returns
+        1 if the service isn't sharded.
+    */
+    static int discover(ConfigurationService & config);
+};
+
+
+/*****************************************************************************/
+/* POST AUCTION PROXY                                                        */
+/*****************************************************************************/
+
+/** Sends messages about an auction to the post auction shard that owns it.
+    With a single shard this behaves exactly like a ZmqNamedProxy connected
+    to the "rtbPostAuctionService" class.
+*/
+
+struct PostAuctionProxy {
+
+    PostAuctionProxy(std::shared_ptr<zmq::context_t> context);
+
+    void init(std::shared_ptr<ConfigurationService> config);
+
+    /** Discover the shard map and connect to the given endpoint of every
+        shard.  The shards should have been started before this is called;
+        if no shard map can be found, the service is assumed to be
+        unsharded.
+    */
+    void connect(const std::string & endpointName = "events");
+
+    /** Send a message about the given auction to the shard that owns it.
+        Does nothing if connect() hasn't been called, as for a router that
+        runs without a post auction loop.  Thread safe.
+    */
+    template<typename... Args>
+    void sendMessage(const Id & auctionId, Args &&... args)
+    {
+        if (shards.empty())
+            return;
+
+        int shard = shards.size() == 1
+            ? 0 : PostAuctionShards::shardFor(auctionId, shards.size());
+        shards[shard]->sendMessage(std::forward<Args>(args)...);
+    }
+
+    /** Are we connected to every shard? */
+    bool isConnected() const;
+
+    int numShards() const { return shards.size(); }
+
+private:
+    std::shared_ptr<zmq::context_t> context;
+    std::shared_ptr<ConfigurationService> config;
+    std::vector<std::unique_ptr<ZmqNamedProxy> > shards;
+};
+
+} // namespace RTBKIT
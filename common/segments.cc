@@ -101,7 +101,7 @@ printJsonTyped(const SegmentsBySource * val,
 {
     context.startObject();
     for (const auto & v: *val) {
-        context.startMember(v.first);
+        context.startMember(v.first.str());
         inner->printJsonTyped(v.second.get(), context);
     }
     context.endObject();
@@ -480,16 +480,12 @@ SegmentsBySource()
 {
 }
 
-SegmentsBySource::
-SegmentsBySource(SegmentsBySourceBase && other)
-    : SegmentsBySourceBase(other)
-{
-}
-
 SegmentsBySource::
 SegmentsBySource(const SegmentsBySourceBase & other)
-    : SegmentsBySourceBase(other)
 {
+    reserve(other.size());
+    for (auto & entry: other)
+        insert(value_type(entry.first, entry.second));
 }
 
 void
@@ -503,11 +499,11 @@ sortAll()
 
 const SegmentList &
 SegmentsBySource::
-get(const std::string & str) const
+get(const InternedName & source) const
 {
     static const SegmentList NONE;
     
-    auto it = find(str);
+    auto it = find(source);
     if (it == end()) return NONE;
     if (!it->second)
         throw ML::Exception("invalid segment list in segments");
@@ -516,55 +512,55 @@ get(const std::string & str) const
 
 void
 SegmentsBySource::
-addSegment(const std::string & source,
+addSegment(const InternedName & source,
            const std::shared_ptr<SegmentList> & segs)
 {
-    if (!insert(make_pair(source, segs)).second)
+    if (!insert(value_type(source, segs)).second)
         throw ML::Exception("attempt to add same segments twice");
 }
 
 void
 SegmentsBySource::
-addInts(const std::string & source,
+addInts(const InternedName & source,
         const std::vector<int> & segs)
 {
-    if (!insert(make_pair(source, std::make_shared<SegmentList>(segs))).second)
+    if (!insert(value_type(source, std::make_shared<SegmentList>(segs))).second)
         throw ML::Exception("attempt to add same segments twice");
 }
 
 void
 SegmentsBySource::
-addStrings(const std::string & source,
+addStrings(const InternedName & source,
            const std::vector<string> & segs)
 {
-    if (!insert(make_pair(source, std::make_shared<SegmentList>(segs))).second)
+    if (!insert(value_type(source, std::make_shared<SegmentList>(segs))).second)
         throw ML::Exception("attempt to add same segments twice");
 }
 
 void
 SegmentsBySource::
-addWeightedInts(const std::string & source,
+addWeightedInts(const InternedName & source,
                 const std::vector<pair<int, float> > & segs)
 {
-    if (!insert(make_pair(source, std::make_shared<SegmentList>(segs))).second)
+    if (!insert(value_type(source, std::make_shared<SegmentList>(segs))).second)
         throw ML::Exception("attempt to add same segments twice");
 }
 
 void
 SegmentsBySource::
-add(const std::string & source, const std::string & segment, float weight)
+add(const InternedName & source, const std::string & segment, float weight)
 {
     auto & entry = (*this)[source];
-    if (!entry) entry.reset(new SegmentList());
+    if (!entry) entry = std::make_shared<SegmentList>();
     entry->add(segment, weight);
 }
 
 void
 SegmentsBySource::
-add(const std::string & source, int segment, float weight)
+add(const InternedName & source, int segment, float weight)
 {
     auto & entry = (*this)[source];
-    if (!entry) entry.reset(new SegmentList());
+    if (!entry) entry = std::make_shared<SegmentList>();
     entry->add(segment, weight);
 }
 
@@ -574,7 +570,7 @@ toJson() const
 {
     Json::Value result;
     for (auto it = begin(), end = this->end();  it != end;  ++it)
-        result[it->first] = it->second->toJson();
+        result[it->first.str()] = it->second->toJson();
     return result;
 }
 
@@ -588,7 +584,7 @@ createFromJson(const Json::Value & json)
         if (it->isNull()) continue;
         auto segs = std::make_shared<SegmentList>();
         *segs = SegmentList::createFromJson(*it);
-        result.addSegment(it.memberName(), segs);
+        result.addSegment(InternedName::find(it.memberName()), segs);
     }
     
     return result;
@@ -602,7 +598,7 @@ serialize(ML::DB::Store_Writer & store) const
     store << version;
     store << compact_size_t(size());
     for (auto it = begin(), end = this->end();  it != end;  ++it) {
-        store << it->first;
+        store << it->first.str();
         it->second->serialize(store);
     }
 }
@@ -617,14 +613,15 @@ reconstitute(ML::DB::Store_Reader & store)
         throw ML::Exception("invalid version");
     compact_size_t sz(store);
     
-    SegmentsBySourceBase newMe;
+    SegmentsBySource newMe;
+    newMe.reserve(sz);
     
     for (unsigned i = 0;  i < sz;  ++i) {
         string k;
         store >> k;
         auto l = std::make_shared<SegmentList>();
         store >> *l;
-        newMe[k] = l;
+        newMe[InternedName::find(k)] = l;
     }
     
     swap(newMe);
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "jml/utils/compact_vector.h"
+#include "rtbkit/common/interned_name.h"
 #include "jml/db/persistent_fwd.h"
 #include "soa/jsoncpp/json.h"
 #include "soa/types/value_description.h"
@@ -97,48 +98,50 @@ operator << (std::ostream & stream, const SegmentList & segs)
 /* SEGMENTS BY SOURCE                                                        */
 /*****************************************************************************/
 
+/** What SegmentsBySource used to be; still accepted by its constructor. */
 typedef std::map<std::string, std::shared_ptr<SegmentList> >
 SegmentsBySourceBase;
 
-/** A set of segments per segment provider. */
+/** A set of segments per segment provider.  Sources are interned, so
+    looking one up compares integers.
+*/
 
 struct SegmentsBySource
-    : public SegmentsBySourceBase {
+    : public InternedMap<std::shared_ptr<SegmentList> > {
 
     SegmentsBySource();
 
-    SegmentsBySource(SegmentsBySourceBase && other);
     SegmentsBySource(const SegmentsBySourceBase & other);
 
-    const SegmentList & get(const std::string & str) const;
+    const SegmentList & get(const InternedName & source) const;
 
     void sortAll();
     
-    void add(const std::string & source,
+    void add(const InternedName & source,
              const std::shared_ptr<SegmentList> & segs)
     {
         addSegment(source, segs);
     }
 
-    void addSegment(const std::string & source,
+    void addSegment(const InternedName & source,
                     const std::shared_ptr<SegmentList> & segs);
-    void addInts(const std::string & source,
+    void addInts(const InternedName & source,
                  const std::vector<int> & segs);
-    void addWeightedInts(const std::string & source,
+    void addWeightedInts(const InternedName & source,
                          const std::vector<std::pair<int, float> > & segs);
-    void addStrings(const std::string & source,
+    void addStrings(const InternedName & source,
                     const std::vector<std::string> & segs);
 
     /** Add the given segment to the given source, creating if it didn't
         exist already.
     */
-    void add(const std::string & source, const std::string & segment,
+    void add(const InternedName & source, const std::string & segment,
                 float weight = 1.0);
 
     /** Add the given segment to the given source, creating if it didn't
         exist already.
     */
-    void add(const std::string & source, int segment,
+    void add(const InternedName & source, int segment,
              float weight = 1.0);
 
     Json::Value toJson() const;
@@ -0,0 +1,85 @@
+/** admission_controller_test.cc                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Tests for the admission controller of the exchange connectors.
+
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/admission_controller.h"
+
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+BOOST_AUTO_TEST_CASE( admissionDeadline )
+{
+    AdmissionController admission;
+
+    BOOST_CHECK_EQUAL(admission.admit(100.0), AD_PROCESS);
+    BOOST_CHECK_EQUAL(admission.admit(4.0), AD_NO_BID);
+
+    RouterLoad load;
+    load.expectedLatencyMs = 50.0;
+    admission.updateLoad(load);
+
+    BOOST_CHECK_EQUAL(admission.admit(100.0), AD_PROCESS);
+    BOOST_CHECK_EQUAL(admission.admit(54.0), AD_NO_BID);
+}
+
+BOOST_AUTO_TEST_CASE( admissionPriority )
+{
+    Json::Value config;
+    config["priority"] = 1;
+
+    AdmissionController low, high;
+    high.configure(config);
+
+    RouterLoad load;
+    load.queueFill = 0.75;
+    BOOST_CHECK_EQUAL(load.pressure(), 0.5);
+
+    low.updateLoad(load);
+    high.updateLoad(load);
+
+    BOOST_CHECK_EQUAL(low.shedProbability(), 0.5);
+    BOOST_CHECK_EQUAL(high.shedProbability(), 0.25);
+
+    load.queueFill = 1.0;
+    low.updateLoad(load);
+    high.updateLoad(load);
+
+    for (unsigned i = 0;  i < 100;  ++i) {
+        BOOST_CHECK_EQUAL(low.admit(100.0), AD_DROP);
+        BOOST_CHECK_EQUAL(high.admit(100.0), AD_DROP);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( admissionQuota )
+{
+    Json::Value config;
+    config["maxRequestsPerSecond"] = 10;
+
+    AdmissionController admission;
+    admission.configure(config);
+
+    Date now = Date::now();
+
+    int admitted = 0;
+    for (unsigned i = 0;  i < 100;  ++i)
+        admitted += admission.admit(100.0, now) == AD_PROCESS;
+    BOOST_CHECK_EQUAL(admitted, 10);
+
+    admitted = 0;
+    for (unsigned i = 0;  i < 100;  ++i)
+        admitted += admission.admit(100.0, now.plusSeconds(0.5)) == AD_PROCESS;
+    BOOST_CHECK_EQUAL(admitted, 5);
+
+    BOOST_CHECK_THROW(admission.configure(Json::parse("{\"unknown\":1}")),
+                      ML::Exception);
+}
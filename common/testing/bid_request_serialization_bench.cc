@@ -0,0 +1,119 @@
+/** bid_request_serialization_bench.cc                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Cost and size of the binary bid request serialization compared to
+    going through JSON, which is what the router used to hand to the post
+    auction loop.
+
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/bid_request.h"
+#include "jml/arch/timers.h"
+#include "jml/utils/environment.h"
+
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <fstream>
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+Env_Option<string> requestFile("BID_REQUEST_BENCH_FILE", "");
+
+namespace {
+
+/** A typical web request in the canonical format, with a couple of ad
+    spots.
+*/
+const char * sampleRequest =
+    "{\"id\":\"3b9f2d0a-8e6c-4b1a-9d2f-7c1e5a0f4b21\","
+    "\"timestamp\":1370000000.123,\"exchange\":\"openrtb\","
+    "\"provider\":\"openrtb\",\"ipAddress\":\"64.124.253.1\","
+    "\"url\":\"http://www.example.com/1234.html\","
+    "\"imp\":[{\"id\":\"1\",\"banner\":{\"w\":300,\"h\":250,\"pos\":1,"
+    "\"battr\":[9,10]},\"bidfloor\":0.5,\"bidfloorcur\":\"USD\"},"
+    "{\"id\":\"2\",\"banner\":{\"w\":728,\"h\":90,\"pos\":3}}],"
+    "\"site\":{\"id\":\"102855\",\"cat\":[\"IAB3-1\"],"
+    "\"domain\":\"www.example.com\","
+    "\"page\":\"http://www.example.com/1234.html\","
+    "\"publisher\":{\"id\":\"8953\",\"name\":\"example.com\","
+    "\"cat\":[\"IAB3-1\"],\"domain\":\"example.com\"}},"
+    "\"device\":{\"ua\":\"Mozilla/5.0 (Macintosh; Intel Mac OS X 10_6_8) "
+    "AppleWebKit/534.51.22 (KHTML, like Gecko) Version/5.1.1 "
+    "Safari/534.51.22\",\"ip\":\"64.124.253.1\",\"language\":\"en\","
+    "\"geo\":{\"country\":\"USA\",\"region\":\"CA\",\"city\":\"San Diego\","
+    "\"zip\":\"92101\"},\"os\":\"OS X\",\"js\":1,\"devicetype\":2},"
+    "\"user\":{\"id\":\"45asdf987656789adfad4678rew656789\","
+    "\"buyeruid\":\"5df678asd8987656asdf78987654\"}}";
+
+string loadRequest()
+{
+    if (requestFile.get().empty())
+        return sampleRequest;
+
+    ifstream stream(requestFile.get().c_str());
+    return string(istreambuf_iterator<char>(stream),
+                  istreambuf_iterator<char>());
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( bench_bid_request_serialization )
+{
+    std::unique_ptr<BidRequest> br(
+            BidRequest::parse("datacratic", loadRequest()));
+
+    enum { NumIterations = 100000 };
+
+    string binary = br->serializeToString();
+    string json = br->toJsonStr();
+
+    {
+        Timer timer;
+        size_t bytes = 0;
+        for (unsigned i = 0;  i < NumIterations;  ++i)
+            bytes += br->serializeToString().size();
+        double elapsed = timer.elapsed_wall();
+        BOOST_CHECK_GT(bytes, 0);
+        cerr << "binary serialize:   " << elapsed * 1e9 / NumIterations
+             << "ns" << endl;
+    }
+
+    {
+        Timer timer;
+        for (unsigned i = 0;  i < NumIterations;  ++i)
+            BidRequest::createFromString(binary);
+        double elapsed = timer.elapsed_wall();
+        cerr << "binary reconstitute: " << elapsed * 1e9 / NumIterations
+             << "ns" << endl;
+    }
+
+    {
+        Timer timer;
+        size_t bytes = 0;
+        for (unsigned i = 0;  i < NumIterations;  ++i)
+            bytes += br->toJsonStr().size();
+        double elapsed = timer.elapsed_wall();
+        BOOST_CHECK_GT(bytes, 0);
+        cerr << "json serialize:     " << elapsed * 1e9 / NumIterations
+             << "ns" << endl;
+    }
+
+    {
+        Timer timer;
+        for (unsigned i = 0;  i < NumIterations;  ++i)
+            BidRequest::createFromJson(Json::parse(json));
+        double elapsed = timer.elapsed_wall();
+        cerr << "json reconstitute:   " << elapsed * 1e9 / NumIterations
+             << "ns" << endl;
+    }
+
+    cerr << "size: binary " << binary.size() << " bytes, json "
+         << json.size() << " bytes" << endl;
+
+    BOOST_CHECK_LT(binary.size(), json.size());
+}
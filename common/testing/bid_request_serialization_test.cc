@@ -0,0 +1,348 @@
+/** bid_request_serialization_test.cc                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Round trip tests for the binary bid request serialization.
+
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/bid_request.h"
+#include "jml/db/persistent.h"
+
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <sstream>
+#include <random>
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+namespace {
+
+struct RandomRequest {
+    RandomRequest(unsigned seed)
+        : rng(seed)
+    {
+    }
+
+    std::mt19937 rng;
+
+    bool coin() { return rng() % 2; }
+    int number(int max) { return rng() % max; }
+
+    /// Small pool of values, so that strings are repeated within a request
+    string str()
+    {
+        static const vector<string> pool = {
+            "", "a", "en", "USA", "example.com", "http://example.com/page",
+            "Mozilla/5.0 (X11; Linux x86_64)", "IAB1", "IAB2-3"
+        };
+        return pool[number(pool.size())];
+    }
+
+    Id id()
+    {
+        switch (number(4)) {
+        case 0: return Id();
+        case 1: return Id(number(100000));
+        case 2: return Id("3b9f2d0a-8e6c-4b1a-9d2f-000000" + to_string(100000 + number(100000)));
+        default: return Id(str() + "id" + to_string(number(100)));
+        }
+    }
+
+    Json::Value ext()
+    {
+        Json::Value result;
+        if (coin()) {
+            result["key"] = str();
+            result["num"] = number(100);
+        }
+        return result;
+    }
+
+    OpenRTB::Banner banner()
+    {
+        OpenRTB::Banner banner;
+        banner.w.push_back(300);
+        banner.h.push_back(250);
+        if (coin()) banner.id = id();
+        if (coin()) banner.pos.val = number(4);
+        if (coin()) {
+            OpenRTB::CreativeAttribute attr;
+            attr.val = number(10);
+            banner.battr.push_back(attr);
+        }
+        if (coin()) banner.topframe.val = number(2);
+        banner.ext = ext();
+        return banner;
+    }
+
+    AdSpot spot(int n)
+    {
+        AdSpot spot;
+        spot.id = Id(n + 1);
+        if (coin()) spot.banner.emplace(banner());
+        if (coin()) {
+            spot.video.emplace();
+            spot.video->minduration.val = number(30);
+            spot.video->w.val = 640;
+            spot.video->h.val = 480;
+            spot.video->companionad.push_back(banner());
+        }
+        if (coin()) spot.tagid = str();
+        if (coin()) spot.bidfloor.val = number(1000) / 100.0;
+        if (coin()) spot.bidfloorcur = "USD";
+        if (coin()) spot.iframebuster.push_back(str());
+        if (coin()) spot.instl.val = 1;
+        spot.ext = ext();
+        spot.formats.push_back(Format(300, 250));
+        if (coin()) spot.formats.push_back(Format(728, 90));
+        if (coin()) spot.reservePrice = USD_CPM(number(1000) / 100.0);
+        if (coin()) spot.restrictions.addStrings("blacklist", { str(), str() });
+        return spot;
+    }
+
+    OpenRTB::Geo geo()
+    {
+        OpenRTB::Geo geo;
+        if (coin()) { geo.lat.val = 45.5;  geo.lon.val = -73.6; }
+        if (coin()) geo.country = str();
+        if (coin()) geo.city = Utf8String("Montréal");
+        if (coin()) geo.type.val = number(3) + 1;
+        return geo;
+    }
+
+    BidRequest request()
+    {
+        BidRequest br;
+        br.auctionId = id();
+        if (coin()) br.auctionType.val = number(2) + 1;
+        br.timeAvailableMs = number(200);
+        br.timestamp = Date::fromSecondsSinceEpoch(1370000000 + number(100000));
+        br.isTest = coin();
+        br.protocolVersion = coin() ? "2.1" : "";
+        br.exchange = str();
+        br.provider = br.exchange;
+
+        if (coin()) {
+            br.site.emplace();
+            br.site->id = id();
+            br.site->page = Url("http://example.com/page");
+            if (coin()) br.site->ref = Url("http://referrer.com/");
+            if (coin()) br.site->cat.push_back(OpenRTB::ContentCategory(str()));
+            if (coin()) {
+                br.site->publisher.emplace();
+                br.site->publisher->id = id();
+                br.site->publisher->name = Utf8String(str());
+            }
+            if (coin()) br.site->keywords.push_back(str());
+        }
+        else if (coin()) {
+            br.app.emplace();
+            br.app->id = id();
+            br.app->bundle = str();
+            if (coin()) br.app->paid.val = 1;
+            if (coin()) {
+                br.app->content.emplace();
+                br.app->content->title = Utf8String(str());
+                br.app->content->episode.val = number(20);
+            }
+        }
+
+        if (coin()) {
+            br.device.emplace();
+            br.device->ua = Utf8String(str());
+            br.device->ip = "192.168.0." + to_string(number(255));
+            if (coin()) br.device->geo.emplace(geo());
+            if (coin()) br.device->devicetype.val = number(3) + 1;
+            if (coin()) br.device->js.val = 1;
+        }
+
+        if (coin()) {
+            br.user.emplace();
+            br.user->id = id();
+            if (coin()) br.user->buyeruid = id();
+            if (coin()) br.user->yob.val = 1950 + number(50);
+            if (coin()) br.user->geo = geo();
+            if (coin()) {
+                OpenRTB::Data data;
+                data.id = id();
+                data.name = str();
+                OpenRTB::Segment segment;
+                segment.id = id();
+                segment.value = str();
+                data.segment.push_back(segment);
+                br.user->data.push_back(data);
+            }
+        }
+
+        for (int i = 0, n = number(4);  i < n;  ++i)
+            br.imp.push_back(spot(i));
+
+        br.language = Utf8String(str());
+        if (coin()) {
+            br.location.countryCode = "CA";
+            br.location.regionCode = "QC";
+            br.location.cityName = Utf8String("Montréal");
+            br.location.dma = number(1000);
+        }
+        if (coin()) br.url = Url("http://example.com/page?q=" + str());
+        br.ipAddress = "10.0.0." + to_string(number(255));
+        br.userAgent = Utf8String(str());
+        if (coin()) br.userIds.add(id(), ID_EXCHANGE);
+        if (coin()) br.userIds.add(Id(number(1000) + 1), ID_PROVIDER);
+        if (coin()) br.segments.addInts("ints", { number(100), number(100) });
+        if (coin()) br.segments.addStrings("strings", { str() });
+        if (coin()) br.restrictions.addStrings("restriction", { str() });
+        if (coin()) br.meta["campaign"] = str();
+        if (coin()) br.unparseable["field"] = number(10);
+        if (coin()) br.bidCurrency.push_back(CurrencyCode::CC_USD);
+        if (coin()) br.winSurcharges["surcharge"] += MicroUSD(number(1000));
+        br.ext = ext();
+
+        return br;
+    }
+};
+
+/** An ad spot as version 2 wrote it: its JSON form. */
+struct V2AdSpot {
+    V2AdSpot(const AdSpot & spot)
+        : spot(spot)
+    {
+    }
+
+    AdSpot spot;
+};
+
+ML::DB::Store_Writer &
+operator << (ML::DB::Store_Writer & store, const V2AdSpot & v2)
+{
+    unsigned char version = 2;
+    return store << version << v2.spot.toJson().toString();
+}
+
+/** A bid request as version 2 wrote it. */
+string serializeV2(const BidRequest & br)
+{
+    vector<V2AdSpot> imp(br.imp.begin(), br.imp.end());
+
+    ostringstream stream;
+    {
+        ML::DB::Store_Writer store(stream);
+        unsigned char version = 2;
+        store << version << br.auctionId << br.language << br.protocolVersion
+              << br.exchange << br.provider << br.timestamp << br.isTest
+              << br.location << br.userIds << imp << br.url << br.ipAddress
+              << br.userAgent << br.restrictions << br.segments
+              << br.meta.toString() << br.winSurcharges;
+    }
+    return stream.str();
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_bid_request_serialization_round_trip )
+{
+    RandomRequest random(1);
+
+    for (unsigned i = 0;  i < 2000;  ++i) {
+        BidRequest br = random.request();
+
+        string serialized = br.serializeToString();
+        BidRequest br2 = BidRequest::createFromString(serialized);
+
+        BOOST_REQUIRE_EQUAL(br2.toJsonStr(), br.toJsonStr());
+
+        // Not part of the JSON representation
+        BOOST_REQUIRE_EQUAL(br2.auctionType.val, br.auctionType.val);
+        BOOST_REQUIRE_EQUAL(br2.timeAvailableMs, br.timeAvailableMs);
+
+        // Same request gives the same bytes
+        BOOST_REQUIRE_EQUAL(br2.serializeToString(), serialized);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_bid_request_serialization_default )
+{
+    BidRequest br;
+    string serialized = br.serializeToString();
+    BidRequest br2 = BidRequest::createFromString(serialized);
+    BOOST_CHECK_EQUAL(br2.toJsonStr(), br.toJsonStr());
+
+    // Version byte, presence bitmap and the always written objects
+    cerr << "empty request: " << serialized.size() << " bytes" << endl;
+    BOOST_CHECK_LT(serialized.size(), 64);
+}
+
+BOOST_AUTO_TEST_CASE( test_bid_request_serialization_bad_input )
+{
+    RandomRequest random(2);
+    BidRequest br = random.request();
+    br.imp.push_back(random.spot(10));
+    string serialized = br.serializeToString();
+
+    // Unknown version
+    string badVersion = serialized;
+    badVersion[0] = 42;
+    BOOST_CHECK_THROW(BidRequest::createFromString(badVersion),
+                      std::exception);
+
+    // Truncated data is an error, not a partial request
+    for (size_t len: { size_t(1), serialized.size() / 2, serialized.size() - 1 })
+        BOOST_CHECK_THROW(BidRequest::createFromString(serialized.substr(0, len)),
+                          std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_bid_request_serialization_version_2 )
+{
+    RandomRequest random(3);
+
+    for (unsigned i = 0;  i < 200;  ++i) {
+        BidRequest br = random.request();
+        BidRequest br2 = BidRequest::createFromString(serializeV2(br));
+
+        // Only what version 2 carried
+        BOOST_REQUIRE_EQUAL(br2.auctionId.toString(), br.auctionId.toString());
+        BOOST_REQUIRE_EQUAL(br2.language.rawString(), br.language.rawString());
+        BOOST_REQUIRE_EQUAL(br2.protocolVersion, br.protocolVersion);
+        BOOST_REQUIRE_EQUAL(br2.exchange, br.exchange);
+        BOOST_REQUIRE_EQUAL(br2.provider, br.provider);
+        BOOST_REQUIRE_EQUAL(br2.timestamp.secondsSinceEpoch(),
+                            br.timestamp.secondsSinceEpoch());
+        BOOST_REQUIRE_EQUAL(br2.isTest, br.isTest);
+        BOOST_REQUIRE_EQUAL(br2.location.toJson(), br.location.toJson());
+        BOOST_REQUIRE_EQUAL(br2.userIds.toJson(), br.userIds.toJson());
+        BOOST_REQUIRE_EQUAL(br2.url.toString(), br.url.toString());
+        BOOST_REQUIRE_EQUAL(br2.ipAddress, br.ipAddress);
+        BOOST_REQUIRE_EQUAL(br2.userAgent.rawString(), br.userAgent.rawString());
+        BOOST_REQUIRE_EQUAL(br2.restrictions.toJson(),
+                            br.restrictions.toJson());
+        BOOST_REQUIRE_EQUAL(br2.segments.toJson(), br.segments.toJson());
+        BOOST_REQUIRE_EQUAL(br2.meta, br.meta);
+        BOOST_REQUIRE_EQUAL(br2.winSurcharges, br.winSurcharges);
+
+        BOOST_REQUIRE_EQUAL(br2.imp.size(), br.imp.size());
+        for (unsigned j = 0;  j < br.imp.size();  ++j)
+            BOOST_REQUIRE_EQUAL(br2.imp[j].toJsonStr(), br.imp[j].toJsonStr());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_bid_request_serialization_parent_default )
+{
+    // A BidRequest defaults to a second price auction, not to the default
+    // of AuctionType, so an unspecified one has to be written out
+    BidRequest br;
+    BOOST_REQUIRE_EQUAL(br.auctionType.val, AuctionType::SECOND_PRICE);
+
+    for (auto type: { AuctionType::UNSPECIFIED, AuctionType::FIRST_PRICE,
+                      AuctionType::SECOND_PRICE }) {
+        br.auctionType.val = type;
+        string serialized = br.serializeToString();
+        BidRequest br2 = BidRequest::createFromString(serialized);
+        BOOST_CHECK_EQUAL(br2.auctionType.val, type);
+        BOOST_CHECK_EQUAL(br2.serializeToString(), serialized);
+    }
+}
@@ -0,0 +1,80 @@
+/** binary_event_log_test.cc                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Tests for the binary event log format.
+
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/binary_event_log.h"
+
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+BOOST_AUTO_TEST_CASE( binaryEventRoundTrip )
+{
+    Date now = Date::fromSecondsSinceEpoch(1368153863.25);
+
+    BinaryEventWriter writer;
+    writer.add("BID", now, "agent1", Id("auction1"), 12, (size_t)34, 0.5);
+    writer.add("BEHAVIOUR", Date(), string("seg"),
+               vector<string>({ "a", "b" }));
+
+    BOOST_CHECK_EQUAL(writer.numEvents(), 2);
+
+    string batch = writer.release();
+    BOOST_CHECK(writer.empty());
+
+    vector<vector<string> > events;
+    forEachBinaryEvent(batch.c_str(), batch.size(),
+                       [&] (const BinaryEvent & event)
+                       {
+                           events.push_back(event.toText());
+                       });
+
+    BOOST_REQUIRE_EQUAL(events.size(), 2);
+
+    vector<string> expected = {
+        "BID", now.print(5), "agent1", "auction1", "12", "34", "0.5"
+    };
+    BOOST_CHECK_EQUAL_COLLECTIONS(events[0].begin(), events[0].end(),
+                                  expected.begin(), expected.end());
+
+    expected = { "BEHAVIOUR", "seg", "a", "b" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(events[1].begin(), events[1].end(),
+                                  expected.begin(), expected.end());
+
+    // A truncated batch must be rejected rather than misread
+    BOOST_CHECK_THROW(forEachBinaryEvent(batch.c_str(), batch.size() - 1,
+                                         [] (const BinaryEvent &) {}),
+                      ML::Exception);
+}
+
+BOOST_AUTO_TEST_CASE( binaryEventTimestampDigits )
+{
+    Date now = Date::fromSecondsSinceEpoch(1368153863.125);
+
+    // The ad server's events keep the 3 decimals they had as text
+    BinaryEventWriter writer(3);
+    writer.add("WIN", now, "auction1", now);
+    string batch = writer.release();
+
+    vector<string> text;
+    forEachBinaryEvent(batch.c_str(), batch.size(),
+                       [&] (const BinaryEvent & event)
+                       {
+                           text = event.toText();
+                       });
+
+    vector<string> expected = { "WIN", now.print(3), "auction1", now.print(3) };
+    BOOST_CHECK_EQUAL_COLLECTIONS(text.begin(), text.end(),
+                                  expected.begin(), expected.end());
+
+    BOOST_CHECK_THROW(BinaryEventWriter(16), ML::Exception);
+}
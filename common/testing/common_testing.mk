@@ -3,3 +3,12 @@ $(eval $(call library,bid_test_utils,exchange_source.cc,bid_request rtb))
 $(eval $(call library,bid_request_synth,bid_request_synth.cc,arch utils jsoncpp))
 $(eval $(call test,bid_request_synth_test,bid_request_synth,boost))
 $(eval $(call test,currency_test,bid_request,boost))
+$(eval $(call test,bid_request_serialization_test,bid_request,boost))
+$(eval $(call test,bid_request_serialization_bench,bid_request,boost manual))
+$(eval $(call test,interned_name_test,bid_request,boost))
+$(eval $(call test,admission_controller_test,rtb,boost))
+$(eval $(call test,binary_event_log_test,rtb,boost))
+$(eval $(call test,metric_registry_test,rtb services,boost))
+$(eval $(call test,thread_placement_test,rtb services,boost))
+$(eval $(call test,thread_placement_bench,rtb services,boost manual))
+$(eval $(call test,frequency_cap_store_test,rtb,boost))
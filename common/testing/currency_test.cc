@@ -59,3 +59,29 @@ BOOST_AUTO_TEST_CASE( currencyValues )
     // precision issue i.e. the value is rounded to the closed 1K
     BOOST_CHECK_EQUAL(1000, (double) MicroUSD_CPM(1000));
 }
+
+BOOST_AUTO_TEST_CASE( currencyTotals )
+{
+    CurrencyTotals totals;
+    totals += USD(2);
+    totals += Amount(CurrencyCode::CC_IMP, 10);
+    totals -= USD(2);
+
+    BOOST_CHECK_EQUAL(totals.getAvailable(CurrencyCode::CC_USD), USD(0));
+    BOOST_CHECK_EQUAL(totals.getAvailable(CurrencyCode::CC_IMP).value, 10);
+
+    // A currency that has been added to stays in the pool, as for
+    // CurrencyPool
+    CurrencyPool pool;
+    pool += USD(2);
+    pool += Amount(CurrencyCode::CC_IMP, 10);
+    pool -= USD(2);
+    BOOST_CHECK_EQUAL(totals.toPool(), pool);
+    BOOST_CHECK_EQUAL(CurrencyTotals(pool).toPool(), pool);
+
+    // Currencies without a slot aren't silently totalled as dollars
+    Amount unknown((CurrencyCode)('E' << 24 | 'U' << 16 | 'R' << 8), 1);
+    BOOST_CHECK_THROW(totals += unknown, ML::Exception);
+    BOOST_CHECK_THROW(totals -= unknown, ML::Exception);
+    BOOST_CHECK_EQUAL(totals.toPool(), pool);
+}
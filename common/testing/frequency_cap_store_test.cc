@@ -0,0 +1,102 @@
+/* frequency_cap_store_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test for the router's frequency cap counters.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/frequency_cap_store.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( test_window )
+{
+    FrequencyCapStore store(1024);
+
+    BOOST_CHECK_EQUAL(store.windowBuckets(1.0), 1);
+    BOOST_CHECK_EQUAL(store.windowBuckets(3600.0), 1);
+    BOOST_CHECK_EQUAL(store.windowBuckets(3601.0), 2);
+    BOOST_CHECK_EQUAL(store.windowBuckets(7 * 86400.0),
+                      FrequencyCapStore::NumBuckets);
+
+    store.add(1, 100);
+    store.add(1, 100);
+    store.add(1, 102, 3);
+
+    BOOST_CHECK_EQUAL(store.count(1, 102, 1), 3);
+    BOOST_CHECK_EQUAL(store.count(1, 102, 3), 5);
+    BOOST_CHECK_EQUAL(store.count(1, 101, 2), 2);
+    BOOST_CHECK_EQUAL(store.count(2, 102, 3), 0);
+
+    // Old buckets are reset when the counter moves past them, and late
+    // events are counted where they belong
+    store.add(1, 100 + FrequencyCapStore::NumBuckets);
+    BOOST_CHECK_EQUAL(store.count(1, 100 + FrequencyCapStore::NumBuckets,
+                                  FrequencyCapStore::NumBuckets), 4);
+    store.add(1, 90);
+    BOOST_CHECK_EQUAL(store.count(1, 100 + FrequencyCapStore::NumBuckets,
+                                  FrequencyCapStore::NumBuckets), 4);
+    store.add(1, 110);
+    BOOST_CHECK_EQUAL(store.count(1, 100 + FrequencyCapStore::NumBuckets,
+                                  FrequencyCapStore::NumBuckets), 5);
+}
+
+BOOST_AUTO_TEST_CASE( test_eviction )
+{
+    FrequencyCapStore store(FrequencyCapStore::ProbeLength);
+    BOOST_CHECK_EQUAL(store.capacity(), FrequencyCapStore::ProbeLength);
+
+    // All keys land in the same slots; the least recently updated goes
+    for (unsigned i = 1;  i <= FrequencyCapStore::ProbeLength;  ++i)
+        store.add(i, i);
+    store.add(100, 10);
+
+    BOOST_CHECK_EQUAL(store.count(1, 10, 24), 0);
+    BOOST_CHECK_EQUAL(store.count(2, 10, 24), 1);
+    BOOST_CHECK_EQUAL(store.count(100, 10, 24), 1);
+    BOOST_CHECK_EQUAL(store.getStats()["evicted"].asInt(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_deltas )
+{
+    FrequencyCapStore store;
+    Date now = Date::now();
+
+    UserIds ids;
+    BOOST_CHECK_EQUAL(FrequencyCapStore::userKey(ids), 0);
+    ids.add(Id("user1"), ID_EXCHANGE);
+    uint64_t user = FrequencyCapStore::userKey(ids);
+    BOOST_CHECK_NE(user, 0);
+
+    AccountKey account("campaign:strategy");
+    uint64_t campaign
+        = FrequencyCapStore::scopeKey(account, FCS_CAMPAIGN, FCE_WIN);
+    BOOST_CHECK_EQUAL(campaign,
+                      FrequencyCapStore::scopeKey(AccountKey("campaign:other"),
+                                                  FCS_CAMPAIGN, FCE_WIN));
+    BOOST_CHECK_NE(campaign,
+                   FrequencyCapStore::scopeKey(account, FCS_ACCOUNT, FCE_WIN));
+    BOOST_CHECK_NE(campaign,
+                   FrequencyCapStore::scopeKey(account, FCS_CAMPAIGN,
+                                               FCE_IMPRESSION));
+
+    vector<FrequencyCapDelta> deltas(2);
+    deltas[0].key = deltas[1].key = FrequencyCapStore::key(user, campaign);
+    deltas[0].seconds = deltas[1].seconds = now.secondsSinceEpoch();
+    deltas[0].count = 1;
+    deltas[1].count = 2;
+
+    string batch((const char *)deltas.data(),
+                 deltas.size() * sizeof(FrequencyCapDelta));
+    BOOST_CHECK_EQUAL(store.apply(batch), 2);
+    BOOST_CHECK_EQUAL(store.count(deltas[0].key, store.bucketOf(now), 1), 3);
+
+    BOOST_CHECK_THROW(store.apply(batch.substr(1)), std::exception);
+}
@@ -0,0 +1,197 @@
+/* interned_name_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test for the interned names and the containers of the bid request that
+   are keyed by them.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/bid_request.h"
+#include <thread>
+
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+BOOST_AUTO_TEST_CASE( test_interned_name )
+{
+    InternedName empty;
+    BOOST_CHECK(empty.empty());
+    BOOST_CHECK_EQUAL(empty, InternedName(""));
+    BOOST_CHECK_EQUAL(empty.str(), "");
+
+    InternedName a("testSourceA"), a2(string("testSourceA"));
+    BOOST_CHECK_EQUAL(a.handle, a2.handle);
+    BOOST_CHECK_EQUAL(a, "testSourceA");
+    BOOST_CHECK_EQUAL(a.str(), "testSourceA");
+
+    InternedName b("testSourceB");
+    BOOST_CHECK(a != b);
+    BOOST_CHECK(a < b);
+    BOOST_CHECK(!(b < a));
+    BOOST_CHECK(!(a < a));
+
+    // Interning from another thread gives the same handle
+    InternedName::Handle other = InternedName::None;
+    std::thread([&] () { other = InternedName("testSourceB").handle; }).join();
+    BOOST_CHECK_EQUAL(other, b.handle);
+
+    // Finding doesn't grow the table
+    size_t size = InternedName::tableSize();
+    BOOST_CHECK_EQUAL(InternedName::find("testSourceA"), a);
+    InternedName missing = InternedName::find("testNeverInterned");
+    BOOST_CHECK_EQUAL(missing.handle, InternedName::None);
+    BOOST_CHECK(!missing.interned());
+    BOOST_CHECK(missing != empty);
+    BOOST_CHECK_EQUAL(InternedName::tableSize(), size);
+
+    // Names that weren't found still work as names, and match the same name
+    // if it's interned later
+    BOOST_CHECK_EQUAL(missing.str(), "testNeverInterned");
+    BOOST_CHECK(missing == InternedName::find("testNeverInterned"));
+    BOOST_CHECK(missing < a);
+    InternedName later("testInternedLater");
+    BOOST_CHECK(InternedName::find("testInternedLater").interned());
+    BOOST_CHECK(InternedName::find("testInternedLater") == later);
+}
+
+BOOST_AUTO_TEST_CASE( test_interned_map )
+{
+    InternedMap<int> map;
+    map["zz"] = 1;
+    map["aa"] = 2;
+    BOOST_CHECK(map.insert(make_pair(InternedName("mm"), 3)).second);
+    BOOST_CHECK(!map.insert(make_pair(InternedName("mm"), 4)).second);
+
+    // Iterated in the order of the names, like a std::map
+    vector<string> names;
+    for (auto & entry: map)
+        names.push_back(entry.first);
+    BOOST_CHECK_EQUAL(names.size(), 3);
+    BOOST_CHECK_EQUAL(names[0], "aa");
+    BOOST_CHECK_EQUAL(names[1], "mm");
+    BOOST_CHECK_EQUAL(names[2], "zz");
+
+    BOOST_CHECK_EQUAL(map.at("mm"), 3);
+    BOOST_CHECK_THROW(map.at("nn"), std::out_of_range);
+    BOOST_CHECK_EQUAL(map.count(InternedName::find("testNeverInterned")), 0);
+
+    BOOST_CHECK_EQUAL(map.erase("aa"), 1);
+    BOOST_CHECK_EQUAL(map.erase("aa"), 0);
+    BOOST_CHECK_EQUAL(map.size(), 2);
+    BOOST_CHECK(map.find("aa") == map.end());
+}
+
+BOOST_AUTO_TEST_CASE( test_user_ids )
+{
+    UserIds ids;
+    ids.add(Id(1), ID_EXCHANGE);
+    ids.add(Id(2), "cookieSync");
+    BOOST_CHECK_THROW(ids.add(Id(3), "cookieSync"), std::exception);
+
+    BOOST_CHECK_EQUAL(ids.exchangeId, Id(1));
+    BOOST_CHECK_EQUAL(ids.at("xchg"), Id(1));
+    BOOST_CHECK_EQUAL(ids.at("cookieSync"), Id(2));
+
+    UserIds ids2 = UserIds::createFromString(ids.serializeToString());
+    BOOST_CHECK(ids2 == ids);
+    BOOST_CHECK_EQUAL(ids2.exchangeId, Id(1));
+
+    UserIds ids3 = UserIds::createFromJson(ids.toJson());
+    BOOST_CHECK(ids3 == ids);
+
+    // Domains that come from requests don't grow the table
+    size_t size = InternedName::tableSize();
+    Json::Value json;
+    for (unsigned i = 0;  i < 100;  ++i)
+        json["testDomain" + to_string(i)] = "id" + to_string(i);
+    UserIds ids4 = UserIds::createFromJson(json);
+    BOOST_CHECK_EQUAL(InternedName::tableSize(), size);
+    BOOST_CHECK_EQUAL(ids4.size(), 100);
+    BOOST_CHECK_EQUAL(ids4.at(InternedName::find("testDomain42")), Id("id42"));
+    BOOST_CHECK(UserIds::createFromString(ids4.serializeToString()) == ids4);
+    BOOST_CHECK_EQUAL(InternedName::tableSize(), size);
+}
+
+BOOST_AUTO_TEST_CASE( test_segments_by_source )
+{
+    SegmentsBySource segs;
+    segs.add("dmp", 1);
+    segs.add("dmp", 2);
+    segs.add("contextual", "sports");
+    segs.sortAll();
+
+    BOOST_CHECK_EQUAL(segs.size(), 2);
+    BOOST_CHECK(segs.get("dmp").contains(2));
+    BOOST_CHECK(segs.get("contextual").contains("sports"));
+
+    SegmentsBySource segs2
+        = SegmentsBySource::createFromJson(segs.toJson());
+    BOOST_CHECK_EQUAL(segs2.toJson(), segs.toJson());
+
+    // Sources that come from requests don't grow the table
+    size_t size = InternedName::tableSize();
+    Json::Value json = segs.toJson();
+    json["testNewSource"] = segs.get("dmp").toJson();
+    SegmentsBySource segs4 = SegmentsBySource::createFromJson(json);
+    BOOST_CHECK_EQUAL(InternedName::tableSize(), size);
+    BOOST_CHECK(segs4.get(InternedName::find("testNewSource")).contains(1));
+    BOOST_CHECK(segs4.get("dmp").contains(1));
+
+    // Still constructible from a map keyed by strings
+    SegmentsBySourceBase map;
+    map["dmp"] = segs.find("dmp")->second;
+    SegmentsBySource segs3(map);
+    BOOST_CHECK_EQUAL(segs3.size(), 1);
+    BOOST_CHECK(segs3.get("dmp").contains(1));
+}
+
+BOOST_AUTO_TEST_CASE( test_find_missing_names )
+{
+    // Remembered misses are forgotten once the name is interned, even by
+    // another thread
+    for (unsigned i = 0;  i < 3;  ++i)
+        BOOST_CHECK(!InternedName::find("testMissedThenInterned").interned());
+    InternedName::Handle handle;
+    std::thread([&] () {
+            handle = InternedName("testMissedThenInterned").handle;
+        }).join();
+    InternedName found = InternedName::find("testMissedThenInterned");
+    BOOST_CHECK(found.interned());
+    BOOST_CHECK_EQUAL(found.handle, handle);
+
+    // More misses than are remembered
+    size_t size = InternedName::tableSize();
+    for (unsigned round = 0;  round < 2;  ++round) {
+        for (unsigned i = 0;  i < 5000;  ++i) {
+            string name = "testMissed" + to_string(i);
+            InternedName missing = InternedName::find(name);
+            BOOST_REQUIRE(!missing.interned());
+            BOOST_REQUIRE_EQUAL(missing.str(), name);
+        }
+    }
+    BOOST_CHECK_EQUAL(InternedName::tableSize(), size);
+}
+
+BOOST_AUTO_TEST_CASE( test_full_table )
+{
+    // Once the table is full, names are kept uninterned instead
+    while (InternedName::tableSize() < InternedName::MaxNames)
+        InternedName("testFill" + to_string(InternedName::tableSize()));
+
+    InternedName overflow("testOverflow");
+    BOOST_CHECK(!overflow.interned());
+    BOOST_CHECK_EQUAL(InternedName::tableSize(), InternedName::MaxNames);
+    BOOST_CHECK_EQUAL(overflow, InternedName("testOverflow"));
+    BOOST_CHECK_EQUAL(overflow.str(), "testOverflow");
+
+    InternedMap<int> map;
+    map[overflow] = 1;
+    map["testFill1"] = 2;
+    BOOST_CHECK_EQUAL(map.at("testOverflow"), 1);
+    BOOST_CHECK_EQUAL(map.at("testFill1"), 2);
+}
@@ -0,0 +1,106 @@
+/* metric_registry_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the registry of pre-resolved counters.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/metric_registry.h"
+#include <thread>
+#include <map>
+
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+/** Event service that sums up the counts it is given. */
+struct SummingEventService : public EventService {
+    virtual void onEvent(const std::string & name,
+                         const char * event,
+                         EventType type,
+                         float value)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (type == ET_COUNT)
+            counts[event] += value;
+        else outcomes[event].push_back(value);
+    }
+
+    std::mutex lock;
+    std::map<std::string, double> counts;
+    std::map<std::string, std::vector<float> > outcomes;
+};
+
+BOOST_AUTO_TEST_CASE( test_metric_registry )
+{
+    auto proxies = std::make_shared<ServiceProxies>();
+    auto events = std::make_shared<SummingEventService>();
+    proxies->events = events;
+    ServiceBase service("metrics", proxies);
+
+    MetricRegistry registry(service);
+
+    MetricHandle bids = registry.counter("accounts.a.bids");
+    BOOST_CHECK_EQUAL(registry.counter("accounts.a.bids"), bids);
+    BOOST_CHECK_EQUAL(registry.name(bids), "accounts.a.bids");
+
+    enum { NumThreads = 4, NumHits = 100000 };
+
+    auto runThread = [&] () {
+        for (unsigned i = 0;  i < NumHits;  ++i)
+            registry.hit(bids);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0;  i < NumThreads;  ++i)
+        threads.emplace_back(runThread);
+    for (auto & t: threads)
+        t.join();
+
+    BOOST_CHECK_EQUAL(registry.total(bids), NumThreads * NumHits);
+
+    registry.flush();
+    BOOST_CHECK_EQUAL(events->counts["accounts.a.bids"], NumThreads * NumHits);
+
+    // Only the increase since the last flush is recorded
+    registry.hit(bids, 5);
+    registry.flush();
+    registry.flush();
+    BOOST_CHECK_EQUAL(events->counts["accounts.a.bids"],
+                      NumThreads * NumHits + 5);
+
+    MetricFamily filters(registry, "accounts.a.filter.");
+    filters.hit("static.040_hourOfWeek");
+    filters.hit("static.040_hourOfWeek");
+    std::string dynamic = "dynamic.segments.missing";
+    filters.hit(dynamic.c_str());
+    filters.outcome("metric.timeLeftMs", 2.5);
+
+    BOOST_CHECK_EQUAL(filters.resolve("static.040_hourOfWeek"),
+                      registry.counter("accounts.a.filter.static.040_hourOfWeek"));
+
+    registry.flush();
+    BOOST_CHECK_EQUAL(events->counts["accounts.a.filter.static.040_hourOfWeek"], 2);
+    BOOST_CHECK_EQUAL(events->counts["accounts.a.filter.dynamic.segments.missing"], 1);
+    BOOST_CHECK_EQUAL(events->outcomes["accounts.a.filter.metric.timeLeftMs"].size(), 1);
+
+    BOOST_CHECK_THROW(registry.name(registry.size()), ML::Exception);
+
+    // Keys that don't fit in the table still resolve to the right counter
+    MetricFamily many(registry, "many.");
+    for (unsigned i = 0;  i < 2 * MetricFamily::TableSize;  ++i) {
+        std::string key = std::to_string(i);
+        MetricHandle handle = many.resolve(key.c_str());
+        BOOST_CHECK_EQUAL(registry.name(handle), "many." + key);
+    }
+    for (unsigned i = 0;  i < 2 * MetricFamily::TableSize;  ++i) {
+        std::string key = std::to_string(i);
+        BOOST_CHECK_EQUAL(many.resolve(key.c_str()),
+                          registry.counter("many." + key));
+    }
+}
@@ -0,0 +1,150 @@
+/* thread_placement_bench.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Cost of the hand-off between two threads through ring buffers, like the
+   one from the exchange connectors to the router loop, for different
+   placements of the threads and of the buffers.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/thread_placement.h"
+#include "jml/utils/ring_buffer.h"
+#include "jml/arch/format.h"
+#include <sched.h>
+#include <thread>
+#include <atomic>
+#include <map>
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+struct Scenario {
+    std::string name;
+    Json::Value placement;
+    std::string bufferOwner;    ///< Thread on whose node the buffers are
+};
+
+vector<int> allowedCpus()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+
+    vector<int> result;
+    for (int cpu = 0;  cpu < CPU_SETSIZE;  ++cpu)
+        if (CPU_ISSET(cpu, &set))
+            result.push_back(cpu);
+    return result;
+}
+
+vector<Scenario> scenarios()
+{
+    vector<Scenario> result;
+    result.push_back({ "unpinned", Json::Value(), "consumer" });
+
+    // Group the CPUs that we may use by node
+    map<int, vector<int> > nodes;
+    for (int cpu: allowedCpus())
+        nodes[ThreadPlacement::numaNodeOf(cpu)].push_back(cpu);
+
+    auto pinned = [] (int producer, int consumer)
+        {
+            Json::Value result;
+            result["producer"]["cpus"][0] = producer;
+            result["consumer"]["cpus"][0] = consumer;
+            return result;
+        };
+
+    for (auto & node: nodes) {
+        if (node.second.size() < 2)
+            continue;
+        result.push_back({ "sameNode", pinned(node.second[0], node.second[1]),
+                           "consumer" });
+        break;
+    }
+
+    if (nodes.size() >= 2) {
+        int producer = nodes.begin()->second[0];
+        int consumer = nodes.rbegin()->second[0];
+        result.push_back({ "crossNode", pinned(producer, consumer),
+                           "consumer" });
+        result.push_back({ "crossNodeRemoteBuffers",
+                           pinned(producer, consumer), "producer" });
+    }
+
+    return result;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( bench_ring_buffer_placement )
+{
+    enum { BufferSize = 4096 };
+    double duration = 2.0;
+
+    auto proxies = std::make_shared<ServiceProxies>();
+    ServiceBase service("threadPlacementBench", proxies);
+
+    cerr << "placement                  round trips/s   ns/trip"
+         << "  migrations" << endl;
+
+    for (auto & scenario: scenarios()) {
+        auto placement = std::make_shared<ThreadPlacement>(scenario.placement);
+
+        std::unique_ptr<RingBufferSRMW<uint64_t> > requests, replies;
+        {
+            ThreadPlacement::LocalAllocation
+                local(placement.get(), scenario.bufferOwner);
+            requests.reset(new RingBufferSRMW<uint64_t>(BufferSize));
+            replies.reset(new RingBufferSRMW<uint64_t>(BufferSize));
+        }
+
+        std::atomic<bool> stop(false);
+        uint64_t roundTrips = 0;
+
+        std::thread consumer([&] ()
+            {
+                placement->apply("consumer");
+                uint64_t value;
+                while (!stop) {
+                    if (requests->tryPop(value))
+                        replies->push(value);
+                }
+            });
+
+        std::thread producer([&] ()
+            {
+                placement->apply("producer");
+                uint64_t value;
+                for (;  !stop;  ++roundTrips) {
+                    requests->push(roundTrips);
+                    while (!replies->tryPop(value) && !stop) ;
+                }
+            });
+
+        std::this_thread::sleep_for
+            (std::chrono::milliseconds(int(duration * 1000)));
+
+        placement->recordStats(service);
+        Json::Value stats = placement->getStats();
+        stop = true;
+        producer.join();
+        consumer.join();
+
+        cerr << ML::format("%-25s %14.0f %9.1f %11d",
+                           scenario.name.c_str(),
+                           roundTrips / duration,
+                           duration * 1e9 / roundTrips,
+                           stats["producer"]["migrations"].asInt()
+                           + stats["consumer"]["migrations"].asInt())
+             << endl;
+    }
+}
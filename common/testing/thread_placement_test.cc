@@ -0,0 +1,133 @@
+/* thread_placement_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test for the placement of threads.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/thread_placement.h"
+#include <sched.h>
+#include <thread>
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+/** CPUs the test may run on. */
+vector<int> allowedCpus()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+
+    vector<int> result;
+    for (int cpu = 0;  cpu < CPU_SETSIZE;  ++cpu)
+        if (CPU_ISSET(cpu, &set))
+            result.push_back(cpu);
+    return result;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_parse_cpu_list )
+{
+    BOOST_CHECK_EQUAL(ThreadPlacement::parseCpuList("3"), vector<int>({ 3 }));
+    BOOST_CHECK_EQUAL(ThreadPlacement::parseCpuList("0-3,8"),
+                      vector<int>({ 0, 1, 2, 3, 8 }));
+    BOOST_CHECK_EQUAL(ThreadPlacement::parseCpuList(" 1, 4-5 "),
+                      vector<int>({ 1, 4, 5 }));
+    BOOST_CHECK(ThreadPlacement::parseCpuList("").empty());
+    BOOST_CHECK_THROW(ThreadPlacement::parseCpuList("3-1"), std::exception);
+    BOOST_CHECK_THROW(ThreadPlacement::parseCpuList("a"), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_placement )
+{
+    int cpu = allowedCpus().back();
+
+    Json::Value config;
+    config["router"] = to_string(cpu);
+    config["exchange"]["cpus"][0] = cpu;
+    config["exchange"]["spread"] = true;
+
+    ThreadPlacement placement(config);
+
+    BOOST_REQUIRE(placement.find("router"));
+    BOOST_CHECK_EQUAL(placement.find("router")->cpus, vector<int>({ cpu }));
+
+    // Families are found by the part of their name before the dot
+    BOOST_CHECK_EQUAL(placement.find("exchange.rubicon"),
+                      placement.find("exchange"));
+    BOOST_CHECK(!placement.find("logger"));
+
+    config["logger"] = "100000";
+    BOOST_CHECK_THROW(placement.parse(config), std::exception);
+
+    Json::Value unknown;
+    unknown["router"]["cores"] = 1;
+    BOOST_CHECK_THROW(placement.parse(unknown), std::exception);
+
+    Json::Value spreadNowhere;
+    spreadNowhere["exchange"]["spread"] = true;
+    BOOST_CHECK_THROW(placement.parse(spreadNowhere), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_spread )
+{
+    ThreadPlacement::Entry entry;
+    entry.cpus = { 4, 5, 6 };
+
+    BOOST_CHECK_EQUAL(entry.cpusFor(1), entry.cpus);
+
+    entry.spread = true;
+    BOOST_CHECK_EQUAL(entry.cpusFor(-1), entry.cpus);
+    BOOST_CHECK_EQUAL(entry.cpusFor(0), vector<int>({ 4 }));
+    BOOST_CHECK_EQUAL(entry.cpusFor(4), vector<int>({ 5 }));
+}
+
+BOOST_AUTO_TEST_CASE( test_apply )
+{
+    int cpu = allowedCpus().back();
+
+    Json::Value config;
+    config["pinned"] = to_string(cpu);
+    auto placement = std::make_shared<ThreadPlacement>(config);
+
+    std::thread([&] ()
+        {
+            BOOST_CHECK(placement->apply("pinned"));
+
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            sched_getaffinity(0, sizeof(set), &set);
+            BOOST_CHECK_EQUAL(CPU_COUNT(&set), 1);
+            BOOST_CHECK(CPU_ISSET(cpu, &set));
+            BOOST_CHECK_EQUAL(sched_getcpu(), cpu);
+
+            // Placing a thread again does nothing
+            BOOST_CHECK(placement->apply("pinned"));
+        }).join();
+
+    // Threads without a placement are only reported on
+    BOOST_CHECK(!placement->apply("unpinned"));
+
+    Json::Value stats = placement->getStats();
+    BOOST_CHECK_EQUAL(stats["pinned"]["cpus"][0].asInt(), cpu);
+    BOOST_CHECK(stats.isMember("unpinned"));
+    BOOST_CHECK_EQUAL(stats["unpinned"]["cpus"].size(), 0);
+
+    // The pinned thread has exited, so it's no longer reported on
+    auto proxies = std::make_shared<ServiceProxies>();
+    ServiceBase service("threads", proxies);
+    placement->recordStats(service);
+    stats = placement->getStats();
+    BOOST_CHECK(!stats.isMember("pinned"));
+    BOOST_CHECK(stats.isMember("unpinned"));
+}
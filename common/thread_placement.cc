@@ -0,0 +1,456 @@
+/* thread_placement.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Declarative CPU and NUMA placement of the named threads of a process.
+*/
+
+#include "thread_placement.h"
+#include "jml/arch/exception.h"
+#include "jml/arch/format.h"
+#include <boost/algorithm/string.hpp>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sched.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+
+using namespace std;
+using namespace ML;
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* THREAD PLACEMENT                                                          */
+/*****************************************************************************/
+
+namespace {
+
+enum { MaxNumaNodes = 256 };
+
+int currentTid()
+{
+    return syscall(SYS_gettid);
+}
+
+} // file scope
+
+std::vector<int>
+ThreadPlacement::Entry::
+cpusFor(int index) const
+{
+    if (!spread || index < 0 || cpus.empty())
+        return cpus;
+    return { cpus[index % cpus.size()] };
+}
+
+ThreadPlacement::
+ThreadPlacement()
+{
+}
+
+ThreadPlacement::
+ThreadPlacement(const Json::Value & config)
+{
+    parse(config);
+}
+
+void
+ThreadPlacement::
+parse(const Json::Value & config)
+{
+    entries.clear();
+
+    if (config.isNull())
+        return;
+    if (!config.isObject())
+        throw ML::Exception("thread placement must be an object: "
+                            + config.toString());
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+        throw ML::Exception(errno, "sched_getaffinity");
+
+    auto parseCpus = [] (const std::string & name, const Json::Value & val)
+        {
+            if (val.isString())
+                return parseCpuList(val.asString());
+
+            if (!val.isArray())
+                throw ML::Exception("thread placement for %s: invalid cpus %s",
+                                    name.c_str(), val.toString().c_str());
+
+            vector<int> result;
+            for (auto & cpu: val)
+                result.push_back(cpu.asInt());
+            return result;
+        };
+
+    for (auto it = config.begin(), end = config.end();  it != end;  ++it) {
+        string name = it.memberName();
+        const Json::Value & val = *it;
+        Entry entry;
+
+        if (val.isObject()) {
+            for (auto jt = val.begin(), jend = val.end();  jt != jend;  ++jt) {
+                string field = jt.memberName();
+                if (field == "cpus")
+                    entry.cpus = parseCpus(name, *jt);
+                else if (field == "numaNode")
+                    entry.numaNode = jt->asInt();
+                else if (field == "spread")
+                    entry.spread = jt->asBool();
+                else throw ML::Exception("thread placement for %s: "
+                                         "unknown field %s",
+                                         name.c_str(), field.c_str());
+            }
+        }
+        else entry.cpus = parseCpus(name, val);
+
+        if (entry.numaNode != -1) {
+            if (entry.numaNode < 0 || entry.numaNode >= MaxNumaNodes)
+                throw ML::Exception("thread placement for %s: invalid NUMA "
+                                    "node %d", name.c_str(), entry.numaNode);
+            auto nodeCpus = numaNodeCpus(entry.numaNode);
+            if (entry.cpus.empty())
+                entry.cpus = nodeCpus;
+            entry.memoryNode = entry.numaNode;
+        }
+
+        for (int cpu: entry.cpus) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+                throw ML::Exception("thread placement for %s: CPU %d is not "
+                                    "available to this process",
+                                    name.c_str(), cpu);
+        }
+
+        // Without an explicit node, prefer the one all the CPUs are on
+        if (entry.memoryNode == -1 && !entry.cpus.empty()) {
+            int node = numaNodeOf(entry.cpus[0]);
+            for (int cpu: entry.cpus)
+                if (numaNodeOf(cpu) != node)
+                    node = -1;
+            entry.memoryNode = node;
+        }
+
+        if (entry.spread && entry.cpus.empty())
+            throw ML::Exception("thread placement for %s: spread without "
+                                "any CPUs", name.c_str());
+
+        entries[name] = entry;
+    }
+}
+
+const ThreadPlacement::Entry *
+ThreadPlacement::
+find(const std::string & name) const
+{
+    auto it = entries.find(name);
+    if (it != entries.end())
+        return &it->second;
+
+    auto dot = name.find('.');
+    if (dot != string::npos) {
+        it = entries.find(name.substr(0, dot));
+        if (it != entries.end())
+            return &it->second;
+    }
+
+    return nullptr;
+}
+
+bool
+ThreadPlacement::
+apply(const std::string & name, int index)
+{
+    int tid = currentTid();
+    const Entry * entry = find(name);
+
+    std::unique_lock<std::mutex> guard(lock);
+
+    if (threads.count(tid))
+        return entry;
+
+    Thread & thread = threads[tid];
+    thread.tid = tid;
+    thread.name = index < 0 ? name : ML::format("%s.%d", name.c_str(), index);
+    thread.cpuPercentName = "threads." + thread.name + ".cpuPercent";
+    thread.migrationsName = "threads." + thread.name + ".migrations";
+    thread.cpuName = "threads." + thread.name + ".cpu";
+
+    if (entry) {
+        thread.cpus = entry->cpusFor(index);
+        thread.memoryNode = entry->memoryNode;
+
+        if (!thread.cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu: thread.cpus)
+                CPU_SET(cpu, &set);
+
+            // A pid of 0 is the calling thread
+            if (sched_setaffinity(0, sizeof(set), &set) == -1)
+                throw ML::Exception(errno, "placing thread " + thread.name,
+                                    "sched_setaffinity");
+        }
+
+        if (thread.memoryNode != -1)
+            setMemoryNode(thread.memoryNode);
+    }
+
+    Usage usage;
+    if (readUsage(tid, usage)) {
+        thread.lastCpuSeconds = usage.cpuSeconds;
+        thread.lastCpu = usage.cpu;
+        if (usage.migrations >= 0)
+            thread.baseMigrations = thread.migrations
+                = thread.reportedMigrations = usage.migrations;
+    }
+    thread.lastSample = Date::now();
+
+    return entry;
+}
+
+void
+ThreadPlacement::
+placeLoop(MessageLoop & loop, const std::string & name)
+{
+    auto placement = shared_from_this();
+
+    // Once the thread is placed, this is a lookup in a small map
+    loop.addPeriodic("ThreadPlacement::" + name, 1.0,
+                     [=] (uint64_t) { placement->apply(name); });
+}
+
+void
+ThreadPlacement::
+recordStats(EventRecorder & recorder)
+{
+    Date now = Date::now();
+
+    std::unique_lock<std::mutex> guard(lock);
+
+    for (auto it = threads.begin();  it != threads.end();) {
+        Thread & thread = it->second;
+
+        Usage usage;
+        if (!readUsage(thread.tid, usage)) {
+            // The thread has exited
+            it = threads.erase(it);
+            continue;
+        }
+
+        double elapsed = now.secondsSince(thread.lastSample);
+        if (elapsed > 0.0)
+            thread.cpuPercent
+                = 100.0 * (usage.cpuSeconds - thread.lastCpuSeconds)
+                / elapsed;
+
+        // Without scheduler statistics, only the moves that we see count
+        if (usage.migrations >= 0)
+            thread.migrations = usage.migrations;
+        else if (usage.cpu != thread.lastCpu)
+            ++thread.migrations;
+
+        recorder.recordEvent(thread.cpuPercentName.c_str(), ET_LEVEL,
+                             thread.cpuPercent);
+        recorder.recordEvent(thread.migrationsName.c_str(), ET_LEVEL,
+                             thread.migrations - thread.reportedMigrations);
+        recorder.recordEvent(thread.cpuName.c_str(), ET_LEVEL, usage.cpu);
+
+        thread.lastCpuSeconds = usage.cpuSeconds;
+        thread.lastSample = now;
+        thread.lastCpu = usage.cpu;
+        thread.reportedMigrations = thread.migrations;
+        ++it;
+    }
+}
+
+Json::Value
+ThreadPlacement::
+getStats() const
+{
+    Json::Value result(Json::objectValue);
+
+    std::unique_lock<std::mutex> guard(lock);
+
+    for (auto & entry: threads) {
+        const Thread & thread = entry.second;
+        Json::Value & stats = result[thread.name];
+
+        stats["tid"] = thread.tid;
+        stats["cpus"] = Json::Value(Json::arrayValue);
+        for (int cpu: thread.cpus)
+            stats["cpus"].append(cpu);
+        if (thread.memoryNode != -1)
+            stats["memoryNode"] = thread.memoryNode;
+        stats["cpu"] = thread.lastCpu;
+        stats["cpuSeconds"] = thread.lastCpuSeconds;
+        stats["cpuPercent"] = thread.cpuPercent;
+        stats["migrations"] = Json::UInt64(thread.migrations
+                                           - thread.baseMigrations);
+    }
+
+    return result;
+}
+
+std::vector<int>
+ThreadPlacement::
+parseCpuList(const std::string & list)
+{
+    vector<int> result;
+
+    vector<string> ranges;
+    boost::split(ranges, list, boost::is_any_of(","));
+
+    for (string range: ranges) {
+        boost::trim(range);
+        if (range.empty())
+            continue;
+
+        char * end;
+        long first = strtol(range.c_str(), &end, 10), last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        if (end == range.c_str() || *end != 0 || first < 0 || last < first)
+            throw ML::Exception("invalid CPU list '%s'", list.c_str());
+
+        for (long cpu = first;  cpu <= last;  ++cpu)
+            result.push_back(cpu);
+    }
+
+    return result;
+}
+
+std::vector<int>
+ThreadPlacement::
+numaNodeCpus(int node)
+{
+    string filename
+        = ML::format("/sys/devices/system/node/node%d/cpulist", node);
+    std::ifstream stream(filename.c_str());
+    string list;
+    if (!getline(stream, list))
+        throw ML::Exception("NUMA node %d doesn't exist", node);
+    return parseCpuList(list);
+}
+
+int
+ThreadPlacement::
+numaNodeOf(int cpu)
+{
+    for (int node = 0;  node < MaxNumaNodes;  ++node) {
+        string filename
+            = ML::format("/sys/devices/system/node/node%d/cpulist", node);
+        std::ifstream stream(filename.c_str());
+        string list;
+        if (!getline(stream, list))
+            break;  // nodes are numbered contiguously
+
+        for (int nodeCpu: parseCpuList(list))
+            if (nodeCpu == cpu)
+                return node;
+    }
+
+    return -1;
+}
+
+bool
+ThreadPlacement::
+readUsage(int tid, Usage & usage)
+{
+    std::ifstream stat(ML::format("/proc/self/task/%d/stat", tid).c_str());
+    string line;
+    if (!getline(stat, line))
+        return false;
+
+    // The command name is in brackets and may contain anything
+    auto pos = line.rfind(')');
+    if (pos == string::npos)
+        return false;
+
+    std::istringstream stream(line.substr(pos + 1));
+    vector<string> fields;  // fields[0] is field 3 of proc(5)
+    string field;
+    while (stream >> field)
+        fields.push_back(field);
+    if (fields.size() < 37)
+        return false;
+
+    static const double ticksPerSecond = sysconf(_SC_CLK_TCK);
+    usage.cpuSeconds
+        = (strtoull(fields[11].c_str(), 0, 10)      // utime
+           + strtoull(fields[12].c_str(), 0, 10))   // stime
+        / ticksPerSecond;
+    usage.cpu = atoi(fields[36].c_str());           // processor
+
+    // Only there with scheduler debugging, which most kernels have
+    usage.migrations = -1;
+    std::ifstream sched(ML::format("/proc/self/task/%d/sched", tid).c_str());
+    while (getline(sched, line)) {
+        if (line.compare(0, 16, "se.nr_migrations") != 0)
+            continue;
+        pos = line.find(':');
+        if (pos != string::npos)
+            usage.migrations = strtoll(line.c_str() + pos + 1, 0, 10);
+        break;
+    }
+
+    return true;
+}
+
+void
+ThreadPlacement::
+setMemoryNode(int node)
+{
+    int res;
+
+    if (node < 0) {
+        res = syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+    }
+    else {
+        unsigned long mask[MaxNumaNodes / (8 * sizeof(unsigned long))] = { 0 };
+        mask[node / (8 * sizeof(unsigned long))]
+            |= 1UL << (node % (8 * sizeof(unsigned long)));
+
+        // The kernel reads one bit less than it is told
+        res = syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                      8 * sizeof(mask) + 1);
+    }
+
+    // Memory placement is an optimization; kernels without NUMA support
+    // refuse it, which is no reason not to run.
+    if (res == -1)
+        cerr << "warning: couldn't set the memory policy for NUMA node "
+             << node << ": " << strerror(errno) << endl;
+}
+
+
+/*****************************************************************************/
+/* LOCAL ALLOCATION                                                          */
+/*****************************************************************************/
+
+ThreadPlacement::LocalAllocation::
+LocalAllocation(const ThreadPlacement * placement, const std::string & name)
+    : active(false)
+{
+    const Entry * entry = placement ? placement->find(name) : nullptr;
+    if (entry && entry->memoryNode != -1) {
+        setMemoryNode(entry->memoryNode);
+        active = true;
+    }
+}
+
+ThreadPlacement::LocalAllocation::
+~LocalAllocation()
+{
+    if (active)
+        setMemoryNode(-1);
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,183 @@
+/* thread_placement.h                                              -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Declarative CPU and NUMA placement of the named threads of a process.
+*/
+
+#pragma once
+
+#include "soa/service/message_loop.h"
+#include "soa/service/service_base.h"
+#include "soa/jsoncpp/json.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <map>
+
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* THREAD PLACEMENT                                                          */
+/*****************************************************************************/
+
+/** Says on which CPUs and NUMA node each named thread of the process runs,
+    and keeps track of how much CPU each of them uses and how often the
+    scheduler moved it.
+
+    The configuration maps thread names to placements:
+
+        "threadPlacement": {
+            "router":           { "cpus": [2] },
+            "augmentationLoop": { "cpus": "3" },
+            "logger":           "12-13",
+            "exchange":         { "numaNode": 0, "spread": true },
+            "postAuction":      { "cpus": "14", "numaNode": 1 }
+        }
+
+    A placement is either a CPU list (as in /sys: "0-3,8") or an object
+    with:
+    - cpus: a CPU list, as a string or an array of CPU numbers;
+    - numaNode: a NUMA node whose memory is preferred by the thread and,
+      if cpus is not given, whose CPUs it runs on;
+    - spread: for a family of threads (the event loops of an exchange
+      connector), give each thread one of the CPUs, round robin, instead of
+      the whole set.
+
+    The placement of a thread named "exchange.rubicon" is looked up under
+    that name, then under "exchange".  Threads without a placement are
+    left alone but are still reported on.
+
+    A placed thread prefers the memory of its NUMA node (the one given, or
+    the one all of its CPUs are on), so what it allocates is local to it.
+    What is allocated for it by another thread, like the ring buffers of
+    the router which are built with the router itself, can be placed on
+    the same node with a LocalAllocation guard.
+
+    Must be held by a shared_ptr.
+*/
+
+struct ThreadPlacement
+    : public std::enable_shared_from_this<ThreadPlacement> {
+
+    ThreadPlacement();
+
+    /** Parse the given section.  Throws if it names CPUs that the process
+        may not run on or a NUMA node that doesn't exist.
+    */
+    ThreadPlacement(const Json::Value & config);
+
+    void parse(const Json::Value & config);
+
+    struct Entry {
+        Entry()
+            : numaNode(-1), memoryNode(-1), spread(false)
+        {
+        }
+
+        std::vector<int> cpus;   ///< Empty means any
+        int numaNode;            ///< As configured
+        int memoryNode;          ///< Preferred node; -1 means no policy
+        bool spread;
+
+        /** CPUs for the given member of a family of threads, or for a
+            thread on its own if index is -1.
+        */
+        std::vector<int> cpusFor(int index) const;
+    };
+
+    /** Return the placement of the given thread, or null. */
+    const Entry * find(const std::string & name) const;
+
+    bool empty() const { return entries.empty(); }
+
+    /** Place the calling thread, which is the index'th of the family of
+        threads of that name (or on its own if index is -1), and start
+        reporting on it.  Does nothing if the thread was already placed.
+        Returns true if there was a placement for it.
+    */
+    bool apply(const std::string & name, int index = -1);
+
+    /** Place the thread of the given message loop.  This is done from a
+        periodic callback in the loop, so must be called before the loop is
+        started; the thread is placed on its first wakeup.
+    */
+    void placeLoop(MessageLoop & loop, const std::string & name);
+
+    /** Sets the preferred memory node of the calling thread to the one of
+        the given placement for as long as it exists, so that what the
+        calling thread allocates for the other one is local to it.
+    */
+    struct LocalAllocation {
+        LocalAllocation(const ThreadPlacement * placement,
+                        const std::string & name);
+        ~LocalAllocation();
+
+    private:
+        bool active;
+    };
+
+    /** Per thread CPU usage and migrations since the last call, recorded as
+        threads.<name>.cpuPercent, .migrations and .cpu levels.
+    */
+    void recordStats(EventRecorder & recorder);
+
+    /** Placement, CPU and migration totals of every placed thread. */
+    Json::Value getStats() const;
+
+    /** Parse a CPU list like "0-3,8". */
+    static std::vector<int> parseCpuList(const std::string & list);
+
+    /** CPUs of the given NUMA node.  Throws if there is no such node. */
+    static std::vector<int> numaNodeCpus(int node);
+
+    /** NUMA node of the given CPU, or -1 if the kernel doesn't say. */
+    static int numaNodeOf(int cpu);
+
+private:
+    std::map<std::string, Entry> entries;
+
+    struct Thread {
+        Thread()
+            : tid(0), memoryNode(-1), lastCpuSeconds(0.0), cpuPercent(0.0),
+              lastCpu(-1), baseMigrations(0), migrations(0),
+              reportedMigrations(0)
+        {
+        }
+
+        std::string name;       ///< With the index for families
+        int tid;
+        std::vector<int> cpus;
+        int memoryNode;
+
+        std::string cpuPercentName;
+        std::string migrationsName;
+        std::string cpuName;
+
+        double lastCpuSeconds;
+        Date lastSample;
+        double cpuPercent;
+        int lastCpu;
+        uint64_t baseMigrations;      ///< When the thread was placed
+        uint64_t migrations;
+        uint64_t reportedMigrations;
+    };
+
+    mutable std::mutex lock;
+    std::map<int, Thread> threads;  ///< By tid
+
+    struct Usage {
+        double cpuSeconds;
+        int cpu;
+        int64_t migrations;     ///< -1 if the kernel doesn't say
+    };
+
+    static bool readUsage(int tid, Usage & usage);
+    static void setMemoryNode(int node);
+};
+
+} // namespace RTBKIT
@@ -14,6 +14,7 @@
 
 #define CRYPTOPP_ENABLE_NAMESPACE_WEAK 1
 #include "crypto++/md5.h"
+#include <cmath>
 
 
 using namespace std;
@@ -290,6 +291,7 @@ toJson() const
     if (!config.isNull()) result["config"] = config;
     if (!filters.empty()) result["filters"] = filters.toJson();
     if (required) result["required"] = true;
+    if (cacheTtl != 0.0) result["cacheTtl"] = cacheTtl;
 
     return result;
 }
@@ -305,9 +307,21 @@ fromJson(const Json::Value& json)
         if      (m == "config") config = val;
         else if (m == "filters") filters.fromJson(val, "augmentor.filters");
         else if (m == "required") required = val.asBool();
+        else if (m == "cacheTtl") cacheTtl = val.asDouble();
 
         else ExcCheck(false, "Unknown AugmentorInfo field: " + m);
     }
+
+    ExcCheckGreaterEqual(cacheTtl, 0.0, "cacheTtl must not be negative");
+
+    updateHash();
+}
+
+void
+AugmentationConfig::
+updateHash()
+{
+    configHash = std::hash<std::string>()(name + ":" + config.toString());
 }
 
 AugmentationConfig
@@ -320,6 +334,94 @@ createFromJson(const Json::Value& json, const std::string& name)
 }
 
 
+/*****************************************************************************/
+/* FREQUENCY CAP                                                             */
+/*****************************************************************************/
+
+FrequencyCap::
+FrequencyCap()
+    : count(0), windowSeconds(86400.0), scope(FCS_CAMPAIGN), event(FCE_WIN),
+      scopeKey(0)
+{
+}
+
+void
+FrequencyCap::
+update(const AccountKey & account)
+{
+    scopeKey = FrequencyCapStore::scopeKey(account, scope, event);
+}
+
+bool
+FrequencyCap::
+isCapped(const FrequencyCapStore & store, uint64_t userKey,
+         uint32_t bucket) const
+{
+    if (!userKey || !enabled())
+        return false;
+
+    uint64_t key = FrequencyCapStore::key(userKey, scopeKey);
+    return store.count(key, bucket, store.windowBuckets(windowSeconds))
+        >= count;
+}
+
+void
+FrequencyCap::
+fromJson(const Json::Value & json)
+{
+    for (auto it = json.begin(), end = json.end();  it != end;  ++it) {
+        if (it.memberName() == "count")
+            count = it->asUInt();
+        else if (it.memberName() == "windowSeconds") {
+            windowSeconds = it->asDouble();
+            if (windowSeconds <= 0.0)
+                throw Exception("frequencyCap windowSeconds must be positive");
+            if (windowSeconds > FrequencyCapStore::MaxWindowSeconds)
+                throw Exception("frequencyCap windowSeconds can't be more "
+                                "than %d", FrequencyCapStore::MaxWindowSeconds);
+
+            // Counts are kept per clock hour; a shorter or partial window
+            // would silently be rounded up to whole ones
+            if (std::fmod(windowSeconds,
+                          FrequencyCapStore::DefaultBucketSeconds) != 0.0)
+                throw Exception("frequencyCap windowSeconds must be a "
+                                "multiple of %d",
+                                FrequencyCapStore::DefaultBucketSeconds);
+        }
+        else if (it.memberName() == "scope") {
+            string s = ML::lowercase(it->asString());
+            if (s == "campaign")
+                scope = FCS_CAMPAIGN;
+            else if (s == "account")
+                scope = FCS_ACCOUNT;
+            else throw Exception("invalid frequencyCap scope " + s);
+        }
+        else if (it.memberName() == "event") {
+            string s = ML::lowercase(it->asString());
+            if (s == "win")
+                event = FCE_WIN;
+            else if (s == "impression")
+                event = FCE_IMPRESSION;
+            else throw Exception("invalid frequencyCap event " + s);
+        }
+        else throw Exception("frequencyCap has invalid key: %s",
+                             it.memberName().c_str());
+    }
+}
+
+Json::Value
+FrequencyCap::
+toJson() const
+{
+    Json::Value result;
+    result["count"] = count;
+    result["windowSeconds"] = windowSeconds;
+    result["scope"] = scope == FCS_CAMPAIGN ? "CAMPAIGN" : "ACCOUNT";
+    result["event"] = event == FCE_WIN ? "WIN" : "IMPRESSION";
+    return result;
+}
+
+
 
 /*****************************************************************************/
 /* AGENT CONFIG                                                             */
@@ -327,7 +429,8 @@ createFromJson(const Json::Value& json, const std::string& name)
 
 AgentConfig::
 AgentConfig()
-    : externalId(0),
+    : accountHandle(AccountKeyTable::NoHandle),
+      externalId(0),
       test(false), roundRobinWeight(0),
       bidProbability(1.0), minTimeAvailableMs(5.0),
       maxInFlight(100),
@@ -623,6 +726,9 @@ createFromJson(const Json::Value & json)
                                      jt.memberName().c_str());
             }
         }
+        else if (it.memberName() == "frequencyCap") {
+            newConfig.frequencyCap.fromJson(*it);
+        }
         else if (it.memberName() == "visits") {
             for (auto jt = it->begin(), jend = it->end();
                  jt != jend;  ++jt) {
@@ -676,7 +782,9 @@ createFromJson(const Json::Value & json)
 
     if (newConfig.account.empty())
         throw Exception("each agent must have an account specified");
-    
+    newConfig.accountHandle = AccountKeyTable::intern(newConfig.account);
+    newConfig.frequencyCap.update(newConfig.account);
+
     if (newConfig.creatives.empty())
         throw Exception("can't configure a agent with no creatives");
 
@@ -729,7 +837,7 @@ toJson(bool includeCreatives) const
         result["exchangeFilter"] = exchangeFilter.toJson();
     if (!requiredIds.empty()) {
         for (unsigned i = 0;  i < requiredIds.size();  ++i)
-            result["requiredIds"][i] = requiredIds[i];
+            result["requiredIds"][i] = requiredIds[i].str();
     }
     if (!userPartition.empty())
         result["userPartition"] = userPartition.toJson();
@@ -745,7 +853,7 @@ toJson(bool includeCreatives) const
         Json::Value segmentInfo;
         for (auto it = segments.begin(), end = segments.end();
              it != end;  ++it) {
-            segmentInfo[it->first] = it->second.toJson();
+            segmentInfo[it->first.str()] = it->second.toJson();
         }
         result["segmentFilter"] = segmentInfo;
     }
@@ -783,6 +891,9 @@ toJson(bool includeCreatives) const
         }
     }
 
+    if (frequencyCap.enabled())
+        result["frequencyCap"] = frequencyCap.toJson();
+
     if (!visitChannels.empty()) {
         Json::Value & v = result["visits"];
         v["channels"] = visitChannels.toJson();
@@ -928,7 +1039,7 @@ isBiddableRequest(const ExchangeConnector * exchangeConnector,
                 ML::atomic_inc(stats.requiredIdMissing);
                 if (doFilterStat)
                     doFilterStat(("static.030_missingRequiredId_"
-                                  + requiredIds[i]).c_str());
+                                  + requiredIds[i].str()).c_str());
                 return BiddableSpots();
             }
         }
@@ -989,7 +1100,8 @@ isBiddableRequest(const ExchangeConnector * exchangeConnector,
             ML::atomic_inc(stats.segmentsMissing);
             if (exclude) {
                 if (doFilterStat) doFilterStat(
-                        ("static.080_segmentInfoMissing_" + it->first).c_str());
+                        ("static.080_segmentInfoMissing_"
+                         + it->first.str()).c_str());
             }
         }
         else {
@@ -1005,7 +1117,8 @@ isBiddableRequest(const ExchangeConnector * exchangeConnector,
             case IE_NOT_INCLUDED:
             case IE_EXCLUDED:
                 if (doFilterStat) doFilterStat(
-                             ("static.080_segmentExcluded_" + it->first).c_str());
+                             ("static.080_segmentExcluded_"
+                              + it->first.str()).c_str());
                 exclude = true;
                 break;
             case IE_PASSED:
@@ -1084,6 +1197,8 @@ addAugmentation(AugmentationConfig info)
         if (a.name == info.name)
             throw ML::Exception("augmentor " + a.name + " is specified twice");
 
+    info.updateHash();
+
     augmentations.push_back(std::move(info));
 
     std::sort(augmentations.begin(), augmentations.end());
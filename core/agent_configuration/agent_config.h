@@ -16,6 +16,7 @@
 #include "rtbkit/common/bid_request.h"
 #include "include_exclude.h"
 #include "rtbkit/common/account_key.h"
+#include "rtbkit/common/frequency_cap_store.h"
 
 namespace RTBKIT {
 
@@ -161,7 +162,7 @@ struct UserPartition {
 struct AugmentationConfig
 {
     AugmentationConfig(const std::string& name = "") :
-        name(name), required(false)
+        name(name), required(false), cacheTtl(0.0), configHash(0)
     {}
 
     std::string name;
@@ -169,6 +170,19 @@ struct AugmentationConfig
     IncludeExclude<std::string> filters;
     bool required;
 
+    /** Number of seconds for which the router may reuse a response from this
+        augmentor for the same user instead of asking the augmentor again.
+        0 disables caching.
+    */
+    double cacheTtl;
+
+    /** Hash of the config passed to the augmentor; used to key the router's
+        augmentation cache.  Updated by updateHash().
+    */
+    uint64_t configHash;
+
+    void updateHash();
+
     bool operator < (const AugmentationConfig & other) const
     {
         return name < other.name;
@@ -199,6 +213,51 @@ enum BlacklistScope {
 };
 
 
+/*****************************************************************************/
+/* FREQUENCY CAP                                                             */
+/*****************************************************************************/
+
+/** Limit on the number of times an agent's campaign (or account) is shown
+    to a user, enforced by the router from the counts that the post auction
+    loops publish (see FrequencyCapStore).  Users without a provider or
+    exchange id aren't capped.
+
+    Counts are kept per clock hour, so the window is a whole number of
+    hours: a window of N hours counts the events of the current clock hour
+    and of the N - 1 before it.  It starts on the hour, and so covers
+    between N - 1 and N hours of history; the events of its oldest hour
+    stop counting all at once when a new hour starts.
+*/
+
+struct FrequencyCap {
+    FrequencyCap();
+
+    uint32_t count;          ///< Most events in the window; 0 means no cap
+    /// A multiple of an hour, at most FrequencyCapStore::MaxWindowSeconds
+    double windowSeconds;
+    FrequencyCapScope scope;
+    FrequencyCapEvent event;
+
+    /** FrequencyCapStore::scopeKey() of the agent's account; set by
+        update().
+    */
+    uint64_t scopeKey;
+
+    bool enabled() const { return count != 0; }
+
+    void update(const AccountKey & account);
+
+    /** Has the user already reached the cap, according to the counts of
+        the store at the given bucket?
+    */
+    bool isCapped(const FrequencyCapStore & store, uint64_t userKey,
+                  uint32_t bucket) const;
+
+    void fromJson(const Json::Value & json);
+    Json::Value toJson() const;
+};
+
+
 /*****************************************************************************/
 /* BID CONTROL TYPE                                                          */
 /*****************************************************************************/
@@ -242,6 +301,11 @@ struct AgentConfig {
 
     AccountKey account;   ///< Who to bill this to
 
+    /** Interned handle for account; set by createFromJson.  Code that sets
+        account directly needs to intern it itself.
+    */
+    AccountHandle accountHandle;
+
     uint64_t externalId;  ///< Simplifies id reconciliation with external systems
 
     bool test;            ///< Can't make real bids
@@ -254,7 +318,7 @@ struct AgentConfig {
 
     int maxInFlight;
 
-    std::vector<std::string> requiredIds;
+    std::vector<InternedName> requiredIds;
 
     IncludeExclude<DomainMatcher> hostFilter;
     IncludeExclude<CachedRegex<boost::regex, std::string> > urlFilter;
@@ -281,7 +345,7 @@ struct AgentConfig {
         Json::Value toJson() const;
     };
 
-    std::map<std::string, SegmentInfo> segments;
+    std::map<InternedName, SegmentInfo> segments;
 
     IncludeExclude<std::string> exchangeFilter;
 
@@ -319,6 +383,8 @@ struct AgentConfig {
         return blacklistType != BL_OFF && blacklistTime > 0.0;
     }
 
+    FrequencyCap frequencyCap;
+
     BidControlType bidControlType;
     uint32_t fixedBidCpmInMicros;
 
@@ -36,13 +36,12 @@ forEachAccountAgent(const AccountKey & account,
     const AllAgentConfig * ac = allAgents;
     if (!ac) return;
 
-    auto it = ac->accountIndex.find(account);
-    if (it == ac->accountIndex.end())
+    AccountHandle handle = AccountKeyTable::find(account);
+    if (handle >= ac->accountIndex.size())
         return;
 
-    for (auto jt = it->second.begin(), jend = it->second.end();
-         jt != jend;  ++jt)
-        onAgent(ac->at(*jt));
+    for (int i: ac->accountIndex[handle])
+        onAgent(ac->at(i));
 }
 
 AgentConfigEntry
@@ -103,7 +102,7 @@ onMessage(const std::vector<std::string> & message)
 
         int i = newConfig->size() - 1;
         newConfig->agentIndex[c.name] = i;
-        newConfig->accountIndex[newConfig->back().config->account].push_back(i);
+        newConfig->addToAccountIndex(newConfig->back().config->account, i);
     }
     if (!found && config) {
         AgentConfigEntry ce;
@@ -113,7 +112,7 @@ onMessage(const std::vector<std::string> & message)
 
         int i = newConfig->size() - 1;
         newConfig->agentIndex[agent] = i;
-        newConfig->accountIndex[newConfig->back().config->account].push_back(i);
+        newConfig->addToAccountIndex(newConfig->back().config->account, i);
     }
 
     if (ML::cmp_xchg(allAgents, ac, (AllAgentConfig *)newConfig.get())) {
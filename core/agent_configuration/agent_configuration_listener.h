@@ -37,7 +37,17 @@ struct AgentConfigEntry {
 */
 struct AllAgentConfig : public std::vector<AgentConfigEntry> {
     std::unordered_map<std::string, int> agentIndex;
-    std::unordered_map<AccountKey, std::vector<int> > accountIndex;
+
+    /** Agents for each account, indexed by account handle. */
+    std::vector<std::vector<int> > accountIndex;
+
+    void addToAccountIndex(const AccountKey & account, int agentIndex)
+    {
+        AccountHandle handle = AccountKeyTable::intern(account);
+        if (accountIndex.size() <= handle)
+            accountIndex.resize(handle + 1);
+        accountIndex[handle].push_back(agentIndex);
+    }
 };
 
 
@@ -95,19 +95,17 @@ matches(const BidRequest & bidRequest,
     }
 }
 
-void
+Blacklist::Entries::ExpiryStats
 Blacklist::
-doExpiries()
+doExpiries(Date now, size_t maxEntries)
 {
-    Date start = Date::now();
-
     auto onBlacklistFinished = [&] (const Id & userId,
                                     BlacklistInfo & info)
         {
-            return info.expire(start);
+            return info.expire(now);
         };
 
-    entries.expire(onBlacklistFinished, start);
+    return entries.expire(onBlacklistFinished, now, maxEntries);
 }
 
 bool
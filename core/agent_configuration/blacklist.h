@@ -12,7 +12,7 @@
 #include <vector>
 #include "rtbkit/common/bid_request.h"
 #include "rtbkit/core/router/router_types.h"
-#include "soa/service/timeout_map.h"
+#include "rtbkit/core/router/timer_wheel.h"
 
 
 namespace RTBKIT {
@@ -63,7 +63,12 @@ struct BlacklistInfo {
 
 /** Indexed on user ID */
 struct Blacklist {
-    void doExpiries();
+    typedef TimerWheel<Id, BlacklistInfo> Entries;
+
+    /** Expire the entries that are due, at most maxEntries of them. */
+    Entries::ExpiryStats
+    doExpiries(Date now = Date::now(),
+               size_t maxEntries = std::numeric_limits<size_t>::max());
 
     size_t size() const { return entries.size(); }
     
@@ -75,7 +80,6 @@ struct Blacklist {
              const std::string & agent,
              const AgentConfig & agentConfig);
     
-    typedef TimeoutMap<Id, BlacklistInfo> Entries;
     Entries entries;
 };
 
@@ -788,6 +788,59 @@ operator << (std::ostream & stream, const AccountSummary & summary)
     return stream;
 }
 
+
+/*****************************************************************************/
+/* ACCOUNT SUMMARY TOTALS                                                    */
+/*****************************************************************************/
+
+/** The totals of an AccountSummary that are rolled up from sub-accounts,
+    kept in fixed currency slots so that adding a child in is a handful of
+    integer additions.
+*/
+
+struct AccountSummaryTotals {
+    AccountSummaryTotals()
+    {
+    }
+
+    AccountSummaryTotals(const Account & a)
+        : inFlight(CurrencyTotals(a.commitmentsMade)
+                   - CurrencyTotals(a.commitmentsRetired)),
+          spent(a.spent),
+          adjustments(CurrencyTotals(a.adjustmentsIn)
+                      - CurrencyTotals(a.adjustmentsOut))
+    {
+        effectiveBudget += CurrencyTotals(a.budgetIncreases);
+        effectiveBudget -= CurrencyTotals(a.budgetDecreases);
+        effectiveBudget += CurrencyTotals(a.recycledIn);
+        effectiveBudget -= CurrencyTotals(a.recycledOut);
+        effectiveBudget += CurrencyTotals(a.allocatedIn);
+        effectiveBudget -= CurrencyTotals(a.allocatedOut);
+    }
+
+    AccountSummaryTotals & operator += (const AccountSummaryTotals & other)
+    {
+        effectiveBudget += other.effectiveBudget;
+        inFlight += other.inFlight;
+        spent += other.spent;
+        adjustments += other.adjustments;
+        return *this;
+    }
+
+    void clear()
+    {
+        effectiveBudget.clear();
+        inFlight.clear();
+        spent.clear();
+        adjustments.clear();
+    }
+
+    CurrencyTotals effectiveBudget;
+    CurrencyTotals inFlight;
+    CurrencyTotals spent;
+    CurrencyTotals adjustments;
+};
+
 /*****************************************************************************/
 /* ACCOUNTS                                                                  */
 /*****************************************************************************/
@@ -992,6 +1045,18 @@ struct Accounts {
 
         Json::Value summaries;
 
+        if (simplified) {
+            // Simplified summaries don't include sub-accounts, so the whole
+            // tree can be rolled up in a single pass
+            auto onSummary = [&] (const AccountKey & key,
+                                  const AccountSummary & summary)
+                {
+                    summaries[key.toString()] = summary.toJson(true);
+                };
+            forEachAccountSummaryImpl(onSummary);
+            return summaries;
+        }
+
         for (const auto & it: accounts) {
             const AccountKey & key = it.first;
             AccountSummary summary = getAccountSummaryImpl(key, 0, maxDepth);
@@ -1258,6 +1323,55 @@ private:
         return result;
     }
 
+    /** Call onSummary with the summary (without sub-accounts) of every
+        account, in one bottom-up pass.
+
+        Accounts are visited in reverse key order, which puts every account
+        just after all of its descendants.  pending[d] accumulates the
+        totals of the accounts at depth d seen since the last account at
+        depth d - 1, which are exactly the children of the next account at
+        depth d - 1 to be visited.  This makes the whole rollup linear in
+        the number of accounts instead of quadratic in the depth.
+    */
+    void forEachAccountSummaryImpl(const std::function<void (const AccountKey &,
+                                                             const AccountSummary &)>
+                                   & onSummary) const
+    {
+        std::vector<AccountSummaryTotals> pending;
+
+        for (auto it = accounts.rbegin(), end = accounts.rend();
+             it != end;  ++it) {
+            const AccountKey & key = it->first;
+            const Account & a = it->second;
+            size_t depth = key.size() - 1;
+
+            if (pending.size() < depth + 2)
+                pending.resize(depth + 2);
+
+            AccountSummaryTotals totals(a);
+            totals += pending[depth + 1];
+            pending[depth + 1].clear();
+
+            AccountSummary summary;
+            summary.account = a;
+            summary.budget = (CurrencyTotals(a.budgetIncreases)
+                              - CurrencyTotals(a.budgetDecreases)).toPool();
+            summary.effectiveBudget = totals.effectiveBudget.toPool();
+            summary.inFlight = totals.inFlight.toPool();
+            summary.spent = totals.spent.toPool();
+            summary.adjustments = totals.adjustments.toPool();
+
+            CurrencyTotals adjustedSpent = totals.spent - totals.adjustments;
+            summary.adjustedSpent = adjustedSpent.toPool();
+            summary.available = (totals.effectiveBudget - adjustedSpent
+                                 - totals.inFlight).toPool();
+
+            onSummary(key, summary);
+
+            pending[depth] += totals;
+        }
+    }
+
     bool checkBudgetConsistencyImpl(const AccountKey & accountKey,
                                     int maxRecursion, int currentLevel) const;
 };
@@ -1393,6 +1507,19 @@ struct ShadowAccounts {
         return (outOfSyncAccounts.count(accountKey) == 0
                 && getAccountImpl(accountKey).authorizeBid(item, amount));
     }
+
+    /** Same as above, but for an interned account.  Avoids hashing and
+        comparing the account key on every bid.
+    */
+    bool authorizeBid(AccountHandle account,
+                      const std::string & item,
+                      Amount amount)
+    {
+        Guard guard(lock);
+        return ((outOfSyncAccounts.empty()
+                 || outOfSyncAccounts.count(AccountKeyTable::key(account)) == 0)
+                && getAccountImpl(account).authorizeBid(item, amount));
+    }
     
     void commitBid(const AccountKey & accountKey,
                    const std::string & item,
@@ -1409,6 +1536,12 @@ struct ShadowAccounts {
         Guard guard(lock);
         return getAccountImpl(accountKey).cancelBid(item);
     }
+
+    void cancelBid(AccountHandle account, const std::string & item)
+    {
+        Guard guard(lock);
+        return getAccountImpl(account).cancelBid(item);
+    }
     
     void forceWinBid(const AccountKey & accountKey,
                      Amount amountPaid,
@@ -1489,6 +1622,18 @@ private:
         return it->second;
     }
 
+    AccountEntry & getAccountImpl(AccountHandle account)
+    {
+        if (account < accountsByHandle.size() && accountsByHandle[account])
+            return *accountsByHandle[account];
+
+        AccountEntry & entry = getAccountImpl(AccountKeyTable::key(account));
+        if (accountsByHandle.size() <= account)
+            accountsByHandle.resize(account + 1);
+        accountsByHandle[account] = &entry;
+        return entry;
+    }
+
     typedef ML::Spinlock Lock;
     typedef std::unique_lock<Lock> Guard;
     mutable Lock lock;
@@ -1496,6 +1641,10 @@ private:
     typedef std::map<AccountKey, AccountEntry> AccountMap;
     AccountMap accounts;
 
+    /// Entries of accounts indexed by account handle.  Accounts are never
+    /// removed from the map, so the pointers stay valid.
+    std::vector<AccountEntry *> accountsByHandle;
+
     typedef std::unordered_set<AccountKey> AccountSet;
     AccountSet outOfSyncAccounts;
 
@@ -305,6 +305,24 @@ public:
         return commitBid(account, item, Amount(), LineItems());
     }
 
+    /** Versions of authorizeBid and cancelBid that take an interned
+        account (see AccountKeyTable), for the router's bid path.  The
+        default implementations look up the key and forward to the versions
+        above.
+    */
+    virtual bool authorizeBid(AccountHandle account,
+                              const std::string & item,
+                              Amount amount)
+    {
+        return authorizeBid(AccountKeyTable::key(account), item, amount);
+    }
+
+    virtual void cancelBid(AccountHandle account,
+                           const std::string & item)
+    {
+        return cancelBid(AccountKeyTable::key(account), item);
+    }
+
     virtual void winBid(const AccountKey & account,
                         const std::string & item,
                         Amount amountPaid,
@@ -46,6 +46,8 @@ class NullBanker: public Banker {
 public:
     NullBanker(bool authorize = false);
 
+    using Banker::authorizeBid;
+
     virtual bool authorizeBid(const AccountKey & account,
                               const std::string & item,
                               Amount amount);
@@ -131,6 +131,21 @@ struct SlaveBanker : public Banker, public RestProxy {
         return accounts.authorizeBid(account, item, amount);
     }
 
+    virtual bool authorizeBid(AccountHandle account,
+                              const std::string & item,
+                              Amount amount)
+    {
+        return accounts.authorizeBid(account, item, amount);
+    }
+
+    using Banker::cancelBid;
+
+    virtual void cancelBid(AccountHandle account,
+                           const std::string & item)
+    {
+        accounts.cancelBid(account, item);
+    }
+
     virtual void commitBid(const AccountKey & account,
                            const std::string & item,
                            Amount amountPaid,
@@ -0,0 +1,70 @@
+/* account_handle_bench.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Per-bid cost of the banker and metric name operations done by the router,
+   going through an AccountKey versus through an interned account handle.
+   The correctness checks live in account_handle_test.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/account_key.h"
+#include "rtbkit/core/banker/account.h"
+#include "jml/arch/timers.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( bench_bid_path_by_key_and_handle )
+{
+    enum { NumAccounts = 100, NumBids = 1000000 };
+
+    Accounts master;
+    ShadowAccounts shadow;
+    vector<AccountKey> keys;
+    vector<AccountHandle> handles;
+
+    for (unsigned i = 0;  i < NumAccounts;  ++i) {
+        AccountKey budget{"campaign" + to_string(i)};
+        AccountKey key = budget.childKey("strategy");
+        master.createBudgetAccount(budget);
+        master.setBudget(budget, USD(1000));
+        master.createSpendAccount(key);
+        master.setBalance(key, USD(100), AT_NONE);
+        shadow.activateAccount(key);
+        keys.push_back(key);
+        handles.push_back(AccountKeyTable::intern(key));
+    }
+    shadow.syncFrom(master);
+
+    string item = "auction-spot-agent";
+    size_t totalLength = 0;
+
+    Timer byKey;
+    for (unsigned i = 0;  i < NumBids;  ++i) {
+        const AccountKey & key = keys[i % NumAccounts];
+        totalLength += key.toString('.').size();
+        BOOST_REQUIRE(shadow.authorizeBid(key, item, MicroUSD(1)));
+        shadow.cancelBid(key, item);
+    }
+    double keyTime = byKey.elapsed_wall();
+
+    Timer byHandle;
+    for (unsigned i = 0;  i < NumBids;  ++i) {
+        AccountHandle handle = handles[i % NumAccounts];
+        totalLength += AccountKeyTable::dottedName(handle).size();
+        BOOST_REQUIRE(shadow.authorizeBid(handle, item, MicroUSD(1)));
+        shadow.cancelBid(handle, item);
+    }
+    double handleTime = byHandle.elapsed_wall();
+
+    cerr << "by key:    " << keyTime * 1e9 / NumBids << "ns/bid" << endl;
+    cerr << "by handle: " << handleTime * 1e9 / NumBids << "ns/bid" << endl;
+    cerr << "speedup:   " << keyTime / handleTime << "x" << endl;
+    BOOST_CHECK_GT(totalLength, 0);
+}
@@ -0,0 +1,86 @@
+/* account_handle_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test for interned account keys and for the shadow account operations
+   that go through account handles.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/account_key.h"
+#include "rtbkit/core/banker/account.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( test_account_key_table )
+{
+    AccountKey key{"campaign", "strategy"};
+
+    AccountHandle handle = AccountKeyTable::intern(key);
+    BOOST_CHECK_EQUAL(AccountKeyTable::intern(key), handle);
+    BOOST_CHECK_EQUAL(AccountKeyTable::find(key), handle);
+    BOOST_CHECK_EQUAL(AccountKeyTable::key(handle), key);
+    BOOST_CHECK_EQUAL(AccountKeyTable::name(handle), "campaign:strategy");
+    BOOST_CHECK_EQUAL(AccountKeyTable::dottedName(handle), "campaign.strategy");
+
+    AccountKey other{"campaign", "other"};
+    BOOST_CHECK_EQUAL(AccountKeyTable::find(other),
+                      (AccountHandle)AccountKeyTable::NoHandle);
+    BOOST_CHECK_EQUAL(AccountKeyTable::intern(other), handle + 1);
+
+    BOOST_CHECK_THROW(AccountKeyTable::key(AccountKeyTable::size()),
+                      ML::Exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_account_key_table_many )
+{
+    // Enough keys for some of them to share index slots
+    vector<AccountHandle> handles;
+    for (unsigned i = 0;  i < 20000;  ++i)
+        handles.push_back(AccountKeyTable::intern(
+                                  { "many", "strategy" + to_string(i) }));
+
+    for (unsigned i = 0;  i < handles.size();  ++i) {
+        AccountKey key{ "many", "strategy" + to_string(i) };
+        BOOST_REQUIRE_EQUAL(AccountKeyTable::find(key), handles[i]);
+    }
+
+    BOOST_CHECK_EQUAL(AccountKeyTable::find({ "many", "missing" }),
+                      (AccountHandle)AccountKeyTable::NoHandle);
+}
+
+BOOST_AUTO_TEST_CASE( test_shadow_bid_by_handle )
+{
+    AccountKey budget{"handleCampaign"};
+    AccountKey key = budget.childKey("strategy");
+
+    Accounts master;
+    master.createBudgetAccount(budget);
+    master.setBudget(budget, USD(10));
+    master.createSpendAccount(key);
+    master.setBalance(key, USD(2), AT_NONE);
+
+    ShadowAccounts shadow;
+    shadow.activateAccount(key);
+    shadow.syncFrom(master);
+
+    // Bids through the handle and through the key share the same account
+    AccountHandle handle = AccountKeyTable::intern(key);
+    BOOST_CHECK(shadow.authorizeBid(handle, "item1", USD(1)));
+    BOOST_CHECK(shadow.authorizeBid(key, "item2", USD(1)));
+    BOOST_CHECK(!shadow.authorizeBid(handle, "item3", USD(1)));
+    BOOST_CHECK_EQUAL(shadow.getAccount(key).commitmentsMade,
+                      CurrencyPool(USD(2)));
+
+    shadow.cancelBid(handle, "item2");
+    BOOST_CHECK(shadow.authorizeBid(handle, "item3", USD(1)));
+    shadow.cancelBid(key, "item1");
+    shadow.cancelBid(handle, "item3");
+    BOOST_CHECK_EQUAL(shadow.getAccount(key).commitmentsMade, CurrencyPool());
+}
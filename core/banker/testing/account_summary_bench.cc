@@ -0,0 +1,55 @@
+/* account_summary_bench.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Cost of summarizing every account in the banker, recursively for each
+   account versus in a single rollup over fixed slot currency totals.
+   The correctness checks live in account_summary_test.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/banker/account.h"
+#include "jml/arch/timers.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( bench_account_summaries )
+{
+    enum { NumBudgets = 1000, NumChildren = 100 };
+
+    Accounts accounts;
+
+    for (unsigned i = 0;  i < NumBudgets;  ++i) {
+        AccountKey budget{"campaign" + to_string(i)};
+        accounts.createBudgetAccount(budget);
+        accounts.setBudget(budget, USD(1000));
+
+        for (unsigned j = 0;  j < NumChildren;  ++j) {
+            AccountKey key = budget.childKey("strategy" + to_string(j));
+            accounts.createSpendAccount(key);
+            accounts.setBalance(key, USD(1), AT_NONE);
+        }
+    }
+
+    Timer recursive;
+    Json::Value expected;
+    for (const AccountKey & key: accounts.getAccountKeys())
+        expected[key.toString()] = accounts.getAccountSummary(key).toJson(true);
+    double recursiveTime = recursive.elapsed_wall();
+
+    Timer rollup;
+    Json::Value summaries = accounts.getAccountSummariesJson(true);
+    double rollupTime = rollup.elapsed_wall();
+
+    BOOST_CHECK_EQUAL(summaries, expected);
+
+    cerr << "recursive: " << recursiveTime << "s" << endl;
+    cerr << "rollup:    " << rollupTime << "s" << endl;
+    cerr << "speedup:   " << recursiveTime / rollupTime << "x" << endl;
+}
@@ -0,0 +1,47 @@
+/* account_summary_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test that the single pass rollup of account summaries gives the same
+   result as summarizing each account recursively.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/banker/account.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( test_account_summary_rollup )
+{
+    enum { NumBudgets = 5, NumChildren = 4 };
+
+    Accounts accounts;
+
+    for (unsigned i = 0;  i < NumBudgets;  ++i) {
+        // Impressions too, so that both currency slots are used
+        AccountKey budget{"campaign" + to_string(i)};
+        accounts.createBudgetAccount(budget);
+        accounts.setBudget(budget, CurrencyPool(USD(1000))
+                           + Amount(CurrencyCode::CC_IMP, 1000));
+
+        for (unsigned j = 0;  j < NumChildren;  ++j) {
+            AccountKey key = budget.childKey("strategy" + to_string(j));
+            accounts.createSpendAccount(key);
+            accounts.setBalance(key, CurrencyPool(USD(j + 1))
+                                + Amount(CurrencyCode::CC_IMP, 10 * j),
+                                AT_NONE);
+        }
+    }
+
+    Json::Value expected;
+    for (const AccountKey & key: accounts.getAccountKeys())
+        expected[key.toString()] = accounts.getAccountSummary(key).toJson(true);
+
+    BOOST_CHECK_EQUAL(accounts.getAccountSummariesJson(true), expected);
+}
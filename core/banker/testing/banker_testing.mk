@@ -31,5 +31,9 @@ $(eval $(call test,slave_banker_test,banker mock_banker_persistence,boost))
 $(eval $(call test,banker_account_test,banker,boost))
 $(eval $(call test,banker_behaviour_test,banker banker_temporary_server,boost))
 $(eval $(call test,redis_persistence_test,banker,boost))
+$(eval $(call test,account_handle_test,banker,boost))
+$(eval $(call test,account_handle_bench,banker,boost manual))
+$(eval $(call test,account_summary_test,banker,boost))
+$(eval $(call test,account_summary_bench,banker,boost manual))
 
-banker_tests: master_banker_test slave_banker_test banker_account_test banker_behaviour_test redis_persistence_test
+banker_tests: master_banker_test slave_banker_test banker_account_test banker_behaviour_test redis_persistence_test account_handle_test account_summary_test
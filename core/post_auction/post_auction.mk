@@ -10,3 +10,5 @@ $(eval $(call library,post_auction,$(LIBRTB_POST_AUCTION_SOURCES),$(LIBRTB_POST_
 
 # post auction runner
 $(eval $(call program,post_auction_runner,post_auction services banker boost_program_options))
+
+$(eval $(call include_sub_make,post_auction_testing,testing,post_auction_testing.mk))
@@ -35,7 +35,7 @@ serializeToString() const
 {
     ostringstream stream;
     ML::DB::Store_Writer writer(stream);
-    int version = 5;
+    int version = 6;
     writer << version
            << bidRequestStr
            << bidRequestStrFormat
@@ -43,6 +43,9 @@ serializeToString() const
            << earlyWinEvents
            << earlyCampaignEvents;
     bid.serialize(writer);
+    writer << (bool)bidRequest;
+    if (bidRequest)
+        bidRequest->serialize(writer);
     return stream.str();
 }
 
@@ -54,10 +57,10 @@ reconstituteFromString(const std::string & str)
     ML::DB::Store_Reader store(stream);
     int version;
     store >> version;
-    if (version < 1 || version > 5)
+    if (version < 1 || version > 6)
         throw ML::Exception("bad version %d", version);
     store >> bidRequestStr;
-    if (version == 5)
+    if (version >= 5)
     {
         store >> bidRequestStrFormat ;
     }
@@ -85,7 +88,16 @@ reconstituteFromString(const std::string & str)
     }
     bid.reconstitute(store);
 
-    if (bidRequestStr != "")
+    if (version > 5) {
+        bool hasBidRequest;
+        store >> hasBidRequest;
+        if (hasBidRequest) {
+            bidRequest = std::make_shared<BidRequest>();
+            bidRequest->reconstitute(store);
+        }
+        else bidRequest.reset();
+    }
+    else if (bidRequestStr != "")
         bidRequest.reset(BidRequest::parse(bidRequestStrFormat, bidRequestStr));
     else bidRequest.reset();
 }
@@ -183,7 +195,7 @@ serializeToString() const
 {
     ostringstream stream;
     ML::DB::Store_Writer writer(stream);
-    int version = 6;
+    int version = 7;
     writer << version
            << auctionTime << auctionId << adSpotId
            << bidRequestStr << bidTime <<bidRequestStrFormat;
@@ -194,6 +206,9 @@ serializeToString() const
     writer << fromOldRouter
            << augmentations.toString();
     writer << visitChannels << uids << visits;
+    writer << (bool)bidRequest;
+    if (bidRequest)
+        bidRequest->serialize(writer);
 
     return stream.str();
 }
@@ -206,7 +221,7 @@ reconstituteFromString(const std::string & str)
     ML::DB::Store_Reader store(stream);
     int version, istatus;
     store >> version;
-    if (version > 6)
+    if (version > 7)
         throw ML::Exception("bad version %d", version);
     if (version < 6)
         throw ML::Exception("version %d no longer supported", version);
@@ -214,7 +229,7 @@ reconstituteFromString(const std::string & str)
     string auctionIdStr, adSpotIdStr;
 
     store >> auctionTime >> auctionId >> adSpotId
-          >> bidRequestStr >> bidTime;
+          >> bidRequestStr >> bidTime >> bidRequestStrFormat;
     bid.reconstitute(store);
 
     store >> winTime >> istatus >> winPrice >> winMeta;
@@ -234,7 +249,16 @@ reconstituteFromString(const std::string & str)
 
     reportedStatus = (BidStatus)istatus;
 
-    bidRequest.reset(BidRequest::parse(bidRequestStrFormat, bidRequestStr));
+    if (version > 6) {
+        bool hasBidRequest;
+        store >> hasBidRequest;
+        if (hasBidRequest) {
+            bidRequest = std::make_shared<BidRequest>();
+            bidRequest->reconstitute(store);
+        }
+        else bidRequest.reset();
+    }
+    else bidRequest.reset(BidRequest::parse(bidRequestStrFormat, bidRequestStr));
 }
 
 
@@ -246,7 +270,10 @@ PostAuctionLoop::
 PostAuctionLoop(std::shared_ptr<ServiceProxies> proxies,
                 const std::string & serviceName)
     : ServiceBase(serviceName, proxies),
+      shard(0), numShards(1),
+      numWins(0), numLosses(0), numCampaignEvents(0),
       logger(getZmqContext()),
+      eventLog(logger),
       monitorProviderClient(getZmqContext(), *this),
       auctions(65536),
       events(65536),
@@ -262,7 +289,10 @@ PostAuctionLoop::
 PostAuctionLoop(ServiceBase & parent,
                 const std::string & serviceName)
     : ServiceBase(serviceName, parent),
+      shard(0), numShards(1),
+      numWins(0), numLosses(0), numCampaignEvents(0),
       logger(getZmqContext()),
+      eventLog(logger),
       monitorProviderClient(getZmqContext(), *this),
       auctions(65536),
       events(65536),
@@ -282,11 +312,30 @@ init()
     monitorProviderClient.init(getServices()->config);
 }
 
+void
+PostAuctionLoop::
+setShard(int shard, int numShards)
+{
+    if (numShards < 1 || shard < 0 || shard >= numShards)
+        throw ML::Exception("invalid post auction shard %d of %d",
+                            shard, numShards);
+
+    this->shard = shard;
+    this->numShards = numShards;
+}
+
 void
 PostAuctionLoop::
 initConnections()
 {
-    registerServiceProvider(serviceName(), { "rtbPostAuctionService" });
+    if (numShards > 1) {
+        registerServiceProvider(serviceName(), {
+                    PostAuctionShards::ServiceClass,
+                    PostAuctionShards::serviceClass(shard, numShards)
+                });
+        PostAuctionShards::publish(*getServices()->config, numShards);
+    }
+    else registerServiceProvider(serviceName(), { "rtbPostAuctionService" });
 
     cerr << "post auction logger on " << serviceName() + "/logger" << endl;
     logger.init(getServices()->config, serviceName() + "/logger");
@@ -320,6 +369,14 @@ initConnections()
                      std::bind<void>(&PostAuctionLoop::checkExpiredAuctions,
                                      this));
 
+    // Send out the batched up log messages every 10ms
+    loop.addPeriodic("PostAuctionLoop::flushEventLog", 0.01,
+                     [=] (uint64_t)
+                     {
+                         eventLog.flush();
+                         flushFrequencyCaps();
+                     });
+
     // Initialize zeromq endpoints
     endpoint.init(getServices()->config, ZMQ_XREP, serviceName() + "/events");
     toAgents.init(getServices()->config, serviceName() + "/agents");
@@ -381,6 +438,8 @@ shutdown()
 {
     loopMonitor.shutdown();
     loop.shutdown();
+    eventLog.flush();
+    flushFrequencyCaps();
     logger.shutdown();
     toAgents.shutdown();
     endpoint.shutdown();
@@ -1197,6 +1256,11 @@ doCampaignEvent(const std::shared_ptr<PostAuctionEvent> & event)
 
         finished.update(key, finishedInfo);
 
+        if (label == "IMPRESSION" && finishedInfo.bidRequest)
+            countFrequencyCapEvent(finishedInfo.bidRequest->userIds,
+                                   finishedInfo.bid.account,
+                                   FCE_IMPRESSION);
+
         routePostAuctionEvent(label, finishedInfo,
                               SegmentList(), false /* filterChannels */);
     }
@@ -1400,6 +1464,9 @@ doBidResult(const Id & auctionId,
         banker->winBid(account, makeBidId(auctionId, adSpotId, agent), price,
                        LineItems());
 
+        countFrequencyCapEvent(submission.bidRequest->userIds, account,
+                               FCE_WIN);
+
         //++info.stats->wins;
         // local win; send it back
 
@@ -1431,15 +1498,30 @@ doBidResult(const Id & auctionId,
                account.toString(),
                submission.bidRequestStrFormat);
 
-    sendAgentMessage(response.agent, msg, timestamp,
-                     confidence, auctionId,
-                     to_string(adspot_num),
-                     price.toString(),
-                     submission.bidRequestStrFormat,
-                     submission.bidRequestStr,
-                     response.bidData,
-                     response.meta,
-                     submission.augmentations);
+    // Results are sent in the agent's win or loss format, as the router
+    // does.  Lightweight results only carry the ids and the price; agents
+    // that need more can keep their requests in a cache.
+    auto agentConfig = configListener.getAgentEntry(response.agent).config;
+    BidResultFormat format = BRF_FULL;
+    if (agentConfig)
+        format = status == BS_WIN
+            ? agentConfig->winFormat : agentConfig->lossFormat;
+
+    if (format == BRF_LIGHTWEIGHT)
+        sendAgentMessage(response.agent, msg, timestamp,
+                         confidence, auctionId,
+                         to_string(adspot_num),
+                         price.toString());
+    else if (format == BRF_FULL)
+        sendAgentMessage(response.agent, msg, timestamp,
+                         confidence, auctionId,
+                         to_string(adspot_num),
+                         price.toString(),
+                         submission.bidRequestStrFormat,
+                         submission.bidRequestStr,
+                         response.bidData,
+                         response.meta,
+                         submission.augmentations);
 
     // Finally, place it in the finished queue
     FinishedInfo i;
@@ -1507,6 +1589,49 @@ notifyFinishedSpot(const Id & auctionId, const Id & adSpotId)
     throw ML::Exception("notifyFinishedSpot(): not implemented");
 }
 
+void
+PostAuctionLoop::
+countFrequencyCapEvent(const UserIds & uids,
+                       const AccountKey & account,
+                       FrequencyCapEvent event)
+{
+    uint64_t user = FrequencyCapStore::userKey(uids);
+    if (!user)
+        return;
+
+    // Counted when we hear about it, which is close enough for caps that
+    // are hours long and doesn't trust the clocks of the ad servers.
+    FrequencyCapDelta delta;
+    delta.seconds = Date::now().secondsSinceEpoch();
+    delta.count = 1;
+
+    uint64_t campaign
+        = FrequencyCapStore::scopeKey(account, FCS_CAMPAIGN, event);
+    uint64_t whole
+        = FrequencyCapStore::scopeKey(account, FCS_ACCOUNT, event);
+
+    delta.key = FrequencyCapStore::key(user, campaign);
+    frequencyCapDeltas.push_back(delta);
+
+    if (whole != campaign) {
+        delta.key = FrequencyCapStore::key(user, whole);
+        frequencyCapDeltas.push_back(delta);
+    }
+}
+
+void
+PostAuctionLoop::
+flushFrequencyCaps()
+{
+    if (frequencyCapDeltas.empty())
+        return;
+
+    string batch((const char *)frequencyCapDeltas.data(),
+                 frequencyCapDeltas.size() * sizeof(FrequencyCapDelta));
+    logger.publish(FrequencyCapChannel, batch);
+    frequencyCapDeltas.clear();
+}
+
 std::string
 PostAuctionLoop::
 makeBidId(Id auctionId, Id spotId, const std::string & agent)
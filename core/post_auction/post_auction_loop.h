@@ -13,6 +13,10 @@
 #include "soa/service/typed_message_channel.h"
 #include "rtbkit/common/auction.h"
 #include "rtbkit/common/auction_events.h"
+#include "rtbkit/common/binary_event_log.h"
+#include "rtbkit/common/frequency_cap_store.h"
+#include "rtbkit/common/post_auction_proxy.h"
+#include "rtbkit/common/thread_placement.h"
 #include "soa/service/loop_monitor.h"
 #include "soa/service/zmq_endpoint.h"
 #include "soa/service/zmq_message_router.h"
@@ -193,8 +197,26 @@ struct PostAuctionLoop : public ServiceBase, public MonitorProvider
         banker = newBanker;
     }
 
+    /** Run the loop's thread where the given placement says, under
+        "postAuction".  Must be called before start().
+    */
+    void setThreadPlacement(const std::shared_ptr<ThreadPlacement> & placement)
+    {
+        placement->placeLoop(loop, "postAuction");
+    }
+
     std::shared_ptr<Banker> banker;
 
+    /** Make this loop the given shard of a post auction service split in
+        numShards shards.  It will then only be sent the auctions (and wins,
+        losses and events) whose ID hashes to its shard.  Must be called
+        before init().
+    */
+    void setShard(int shard, int numShards);
+
+    int shard;
+    int numShards;
+
     /* ROUTERSHARED */
     uint64_t numWins;
     uint64_t numLosses;
@@ -219,13 +241,16 @@ struct PostAuctionLoop : public ServiceBase, public MonitorProvider
     
     ZmqNamedPublisher logger;
 
+    /** Batches the logged messages into binary events sent on logger. */
+    BinaryEventPublisher eventLog;
+
     /** Log a given message to the given channel. */
     template<typename... Args>
     void logMessage(const std::string & channel, Args... args)
     {
         using namespace std;
         //cerr << "********* logging message to " << channel << endl;
-        logger.publish(channel, Date::now().print(5), args...);
+        eventLog.publish(channel, Date::now(), args...);
     }
 
     /** Log a router error. */
@@ -234,8 +259,8 @@ struct PostAuctionLoop : public ServiceBase, public MonitorProvider
                     const std::string & exception,
                     Args... args)
     {
-        logger.publish("PAERROR", Date::now().print(5),
-                       function, exception, args...);
+        eventLog.publish("PAERROR", Date::now(),
+                         function, exception, args...);
         recordHit("error.%s", function);
     }
 
@@ -410,6 +435,19 @@ private:
                      const std::string & winLossMeta,
                      const UserIds & uids);
 
+    /** Count a win or impression of the given account towards the
+        frequency caps of the user, in both of its scopes.
+    */
+    void countFrequencyCapEvent(const UserIds & uids,
+                                const AccountKey & account,
+                                FrequencyCapEvent event);
+
+    /** Publish the counted events to the routers on FrequencyCapChannel. */
+    void flushFrequencyCaps();
+
+    /** Frequency cap increments that haven't been published yet. */
+    std::vector<FrequencyCapDelta> frequencyCapDeltas;
+
     /** List of auctions we're currently tracking as submitted.  Note that an
         auction may be both submitted and in flight (if we had submitted a bid
         from one agent but were waiting on bids for another agent).
@@ -10,6 +10,7 @@
 
 #include "rtbkit/core/banker/slave_banker.h"
 #include "soa/service/service_utils.h"
+#include "jml/arch/format.h"
 
 #include "post_auction_loop.h"
 
@@ -22,10 +23,16 @@ using namespace RTBKIT;
 int main(int argc, char ** argv)
 {
     ServiceProxyArguments proxyArgs;
+    int shard = 0;
+    int numShards = 1;
 
     options_description all_opt;
     all_opt.add(proxyArgs.makeProgramOptions());
     all_opt.add_options()
+        ("shard", value<int>(&shard),
+         "index of the shard of the post auction service to run")
+        ("num-shards", value<int>(&numShards),
+         "number of shards the post auction service is split into")
         ("help,h", "print this message");
     
     variables_map vm;
@@ -43,7 +50,10 @@ int main(int argc, char ** argv)
     shared_ptr<ServiceProxies> proxies = proxyArgs.makeServiceProxies();
 
     // First start up the post auction loop
-    PostAuctionLoop service(proxies, proxyArgs.serviceName("postAuction"));
+    string defaultName = numShards > 1
+        ? ML::format("postAuction%d", shard) : string("postAuction");
+    PostAuctionLoop service(proxies, proxyArgs.serviceName(defaultName));
+    service.setShard(shard, numShards);
 
     auto banker = make_shared<SlaveBanker>(proxies->zmqContext,
                                            proxies->config,
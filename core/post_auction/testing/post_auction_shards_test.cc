@@ -0,0 +1,121 @@
+/* post_auction_shards_test.cc
+   Copyright (c) 2013 Datacratic Inc.  All rights reserved.
+
+   Runs several post auction shards in process and checks that the ad server
+   connector routes each auction's events to the shard that owns it.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/post_auction/post_auction_loop.h"
+#include "rtbkit/core/banker/null_banker.h"
+#include "rtbkit/plugins/adserver/adserver_connector.h"
+#include "rtbkit/common/post_auction_proxy.h"
+#include "jml/arch/format.h"
+#include "jml/arch/timers.h"
+#include "jml/utils/testing/watchdog.h"
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( test_shard_distribution )
+{
+    enum { NumShards = 4, NumAuctions = 100000 };
+
+    vector<int> counts(NumShards);
+    for (unsigned i = 0;  i < NumAuctions;  ++i) {
+        int shard = PostAuctionShards::shardFor(Id(i + 1), NumShards);
+        BOOST_REQUIRE(shard >= 0 && shard < NumShards);
+        ++counts[shard];
+    }
+
+    for (int count: counts) {
+        BOOST_CHECK_GT(count, NumAuctions / NumShards * 0.9);
+        BOOST_CHECK_LT(count, NumAuctions / NumShards * 1.1);
+    }
+
+    // Adding a shard should only move the auctions that go to the new shard
+    for (unsigned i = 0;  i < 1000;  ++i) {
+        Id id(i + 1);
+        int before = PostAuctionShards::shardFor(id, NumShards);
+        int after = PostAuctionShards::shardFor(id, NumShards + 1);
+        BOOST_CHECK(after == before || after == NumShards);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_unconnected_proxy )
+{
+    auto proxies = std::make_shared<ServiceProxies>();
+
+    // A router without a post auction loop never connects its proxy
+    PostAuctionProxy proxy(proxies->zmqContext);
+    proxy.init(proxies->config);
+    BOOST_CHECK(!proxy.isConnected());
+    BOOST_CHECK_EQUAL(proxy.numShards(), 0);
+    proxy.sendMessage(Id("auction"), "AUCTION", "message");
+}
+
+BOOST_AUTO_TEST_CASE( test_sharded_post_auction_loops )
+{
+    ML::Watchdog watchdog(30.0);
+
+    enum { NumShards = 3, NumWins = 300 };
+
+    auto proxies = std::make_shared<ServiceProxies>();
+
+    vector<std::shared_ptr<PostAuctionLoop> > shards;
+    for (int i = 0;  i < NumShards;  ++i) {
+        auto shard = std::make_shared<PostAuctionLoop>
+            (proxies, ML::format("postAuction%d", i));
+        shard->setShard(i, NumShards);
+        shard->setBanker(std::make_shared<NullBanker>(true));
+        shard->init();
+        shard->monitorProviderClient.inhibit_ = true;
+        shard->bindTcp();
+        shard->start();
+        shards.push_back(shard);
+    }
+
+    BOOST_CHECK_EQUAL(PostAuctionShards::discover(*proxies->config),
+                      NumShards);
+
+    AdServerConnector adserver("adserver", proxies);
+    adserver.init(proxies->config);
+    adserver.start();
+
+    vector<uint64_t> expected(NumShards);
+    for (unsigned i = 0;  i < NumWins;  ++i) {
+        Id auctionId(ML::format("auction-%d", i));
+        ++expected[PostAuctionShards::shardFor(auctionId, NumShards)];
+
+        adserver.publishWin(auctionId, Id(1), USD_CPM(1),
+                            Date::now(), JsonHolder(), UserIds(),
+                            { "campaign", "strategy" }, Date::now());
+    }
+
+    auto numReceived = [&] ()
+        {
+            uint64_t result = 0;
+            for (auto & shard: shards)
+                result += shard->numWins;
+            return result;
+        };
+
+    while (numReceived() < NumWins)
+        ML::sleep(0.01);
+
+    for (int i = 0;  i < NumShards;  ++i) {
+        cerr << "shard " << i << " got " << shards[i]->numWins
+             << " wins" << endl;
+        BOOST_CHECK_EQUAL(shards[i]->numWins, expected[i]);
+    }
+
+    adserver.shutdown();
+    for (auto & shard: shards)
+        shard->shutdown();
+}
@@ -0,0 +1,3 @@
+# RTBKIT post auction testing makefile
+
+$(eval $(call test,post_auction_shards_test,post_auction adserver_connector,boost))
@@ -0,0 +1,264 @@
+/* auction_deduplicator.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Suppression of the copies of an impression that reach the router from
+   several exchanges.
+*/
+
+#include "auction_deduplicator.h"
+#include "jml/arch/exception.h"
+#include <city.h>
+#include <limits>
+
+
+using namespace std;
+using namespace ML;
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* AUCTION DEDUPLICATOR                                                      */
+/*****************************************************************************/
+
+namespace {
+
+uint64_t hashField(const std::string & str, uint64_t seed)
+{
+    return CityHash64WithSeed(str.c_str(), str.size(), seed);
+}
+
+} // file scope
+
+AuctionDeduplicator::
+AuctionDeduplicator(const Json::Value & config)
+    : windowMs(100.0), policy(FIRST), fields(USER_ID | URL | SIZES),
+      numChecked(0), numUnfingerprinted(0), numSuppressed(0),
+      numCheaperCopies(0), numSameExchange(0), numTableFull(0)
+{
+    size_t capacity = 1 << 20;
+
+    for (auto it = config.begin(), end = config.end();  it != end;  ++it) {
+        if (it.memberName() == "windowMs")
+            windowMs = it->asDouble();
+        else if (it.memberName() == "policy") {
+            string name = it->asString();
+            if (name == "first")
+                policy = FIRST;
+            else if (name == "cheapest")
+                policy = CHEAPEST;
+            else throw ML::Exception("unknown deduplication policy " + name);
+        }
+        else if (it.memberName() == "fields") {
+            fields = 0;
+            for (auto & field: *it) {
+                string name = field.asString();
+                if (name == "userId")
+                    fields |= USER_ID;
+                else if (name == "url")
+                    fields |= URL;
+                else if (name == "sizes")
+                    fields |= SIZES;
+                else if (name == "ipAddress")
+                    fields |= IP_ADDRESS;
+                else if (name == "userAgent")
+                    fields |= USER_AGENT;
+                else throw ML::Exception("unknown deduplication field "
+                                         + name);
+            }
+        }
+        else if (it.memberName() == "capacity")
+            capacity = it->asUInt();
+        else throw ML::Exception("unknown deduplication parameter "
+                                 + it.memberName());
+    }
+
+    if (windowMs <= 0.0 || windowMs > 30000.0)
+        throw ML::Exception("deduplication window must be between 0 and 30s");
+    if (!fields)
+        throw ML::Exception("deduplication needs at least one field");
+    if (capacity < ProbeLength)
+        throw ML::Exception("deduplication capacity is too small");
+
+    // Round up to a power of two so that the bucket is a mask of the hash
+    size_t size = ProbeLength;
+    while (size < capacity)
+        size *= 2;
+
+    slots = std::vector<Slot>(size);
+    mask = size - 1;
+    windowTicks = std::max<uint64_t>(1, windowMs);
+}
+
+uint64_t
+AuctionDeduplicator::
+fingerprint(const BidRequest & request) const
+{
+    uint64_t result = 0;
+    bool any = false;
+
+    if (fields & USER_ID) {
+        const Id & id = request.userIds.providerId
+            ? request.userIds.providerId : request.userIds.exchangeId;
+        if (id) {
+            result = hashField(id.toString(), result);
+            any = true;
+        }
+        else result = hashField("", result);
+    }
+
+    if (fields & URL) {
+        string url = request.url.toString();
+        if (url.empty() && request.app)
+            url = request.app->bundle;
+        any = any || !url.empty();
+        result = hashField(url, result);
+    }
+
+    if (fields & SIZES) {
+        string sizes;
+        for (auto & spot: request.imp)
+            sizes += spot.format() + ";";
+        any = any || !request.imp.empty();
+        result = hashField(sizes, result);
+    }
+
+    if (fields & IP_ADDRESS) {
+        any = any || !request.ipAddress.empty();
+        result = hashField(request.ipAddress, result);
+    }
+
+    if (fields & USER_AGENT) {
+        string ua = request.userAgent.rawString();
+        any = any || !ua.empty();
+        result = hashField(ua, result);
+    }
+
+    if (!any)
+        return 0;
+    return result ? result : 1;
+}
+
+uint32_t
+AuctionDeduplicator::
+floorOf(const BidRequest & request)
+{
+    int64_t result = std::numeric_limits<uint32_t>::max();
+
+    for (auto & spot: request.imp) {
+        int64_t floor = spot.reservePrice.value;
+        if (spot.reservePrice.isZero())
+            floor = spot.bidfloor.value() * 1000;   // CPM to per impression
+        result = std::min(result, floor);
+    }
+
+    return std::max<int64_t>(result, 0);
+}
+
+AuctionDeduplicator::Result
+AuctionDeduplicator::
+check(const BidRequest & request, Date now)
+{
+    numChecked.fetch_add(1, std::memory_order_relaxed);
+
+    Result result;
+
+    uint64_t hash = fingerprint(request);
+    if (!hash) {
+        numUnfingerprinted.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    uint64_t tag = hash & ~uint64_t(StampMask);
+    if (!tag)
+        tag = StampMask + 1;
+
+    uint64_t stamp = uint64_t(now.secondsSinceEpoch() * 1000.0) & StampMask;
+    uint64_t key = tag | stamp;
+
+    InternedName exchange(request.exchange);
+    uint32_t floor = policy == CHEAPEST ? floorOf(request) : 0;
+
+    // If another thread takes the free slot we found first, look again in
+    // case it was a copy of this request.
+    for (unsigned attempt = 0;  attempt < 2;  ++attempt) {
+        Slot * free = nullptr;
+        uint64_t freeKey = 0;
+
+        for (unsigned i = 0;  i < ProbeLength;  ++i) {
+            Slot & slot = slots[(hash + i) & mask];
+            uint64_t current = slot.key.load(std::memory_order_acquire);
+
+            if (!live(current, stamp)) {
+                if (!free) {
+                    free = &slot;
+                    freeKey = current;
+                }
+                continue;
+            }
+
+            if ((current & ~uint64_t(StampMask)) != tag)
+                continue;
+
+            // Another request from the same exchange, such as for another
+            // slot of the same size on the page, isn't a copy
+            uint64_t seen = slot.value.load(std::memory_order_relaxed);
+            if (InternedName::Handle(seen >> 32) == exchange.handle) {
+                numSameExchange.fetch_add(1, std::memory_order_relaxed);
+                return result;
+            }
+
+            // It's a copy
+            result.firstExchange.handle = seen >> 32;
+
+            if (policy == CHEAPEST) {
+                while (floor < uint32_t(seen)) {
+                    if (slot.value.compare_exchange_weak
+                        (seen, packValue(exchange, floor))) {
+                        numCheaperCopies.fetch_add
+                            (1, std::memory_order_relaxed);
+                        return result;
+                    }
+                }
+            }
+
+            numSuppressed.fetch_add(1, std::memory_order_relaxed);
+            result.duplicate = true;
+            return result;
+        }
+
+        if (!free) {
+            numTableFull.fetch_add(1, std::memory_order_relaxed);
+            return result;
+        }
+
+        if (free->key.compare_exchange_strong(freeKey, key)) {
+            // Readers may briefly see the previous value of a reused slot
+            free->value.store(packValue(exchange, floor),
+                              std::memory_order_release);
+            return result;
+        }
+    }
+
+    return result;
+}
+
+Json::Value
+AuctionDeduplicator::
+getStats() const
+{
+    Json::Value result;
+    result["checked"] = (Json::UInt64)numChecked.load();
+    result["unfingerprinted"] = (Json::UInt64)numUnfingerprinted.load();
+    result["suppressed"] = (Json::UInt64)numSuppressed.load();
+    result["cheaperCopies"] = (Json::UInt64)numCheaperCopies.load();
+    result["sameExchange"] = (Json::UInt64)numSameExchange.load();
+    result["tableFull"] = (Json::UInt64)numTableFull.load();
+    result["capacity"] = (Json::UInt64)slots.size();
+    result["windowMs"] = windowMs;
+    result["policy"] = policy == CHEAPEST ? "cheapest" : "first";
+    return result;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,164 @@
+/* auction_deduplicator.h                                          -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Suppression of the copies of an impression that reach the router from
+   several exchanges.
+*/
+
+#pragma once
+
+#include "rtbkit/common/bid_request.h"
+#include "rtbkit/common/interned_name.h"
+#include "soa/types/date.h"
+#include "soa/jsoncpp/json.h"
+#include <atomic>
+#include <vector>
+
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* AUCTION DEDUPLICATOR                                                      */
+/*****************************************************************************/
+
+/** Recognizes bid requests for an impression that was already offered to
+    the router a few milliseconds earlier, typically by another exchange
+    reselling the same inventory, so that the copies don't go through the
+    filters, augmentors and agents and end up bidding against each other.
+
+    Two requests are copies if they come from different exchanges, have
+    the same fingerprint (a hash of the configured fields of the request)
+    and arrive within the window of each other.  Requests from the same
+    exchange are never copies of each other, as an exchange can offer
+    several slots of the same size on a page to the same user.  Fingerprints are remembered in a fixed size open addressed
+    table of atomic slots, each stamped with the time it was claimed; a
+    slot older than the window is free to be reused, so nothing needs to
+    be expired.  check() is lock free and may be called from any thread.
+
+    The table is approximate: two copies that arrive at the same instant
+    on different threads may both be let through, a fingerprint that finds
+    no free slot near its bucket isn't remembered, and two different
+    requests whose fingerprints collide on 44 bits are taken as copies.
+*/
+
+struct AuctionDeduplicator {
+
+    /** Which of the copies of an impression to bid on. */
+    enum Policy {
+        FIRST,      ///< The first one to arrive; later copies are dropped
+        CHEAPEST    ///< Only copies with a lower floor than those seen
+    };
+
+    /** Fields of the request that go into the fingerprint. */
+    enum Field {
+        USER_ID     = 1 << 0,   ///< Provider id, or else exchange user id
+        URL         = 1 << 1,   ///< Page url, or else app bundle
+        SIZES       = 1 << 2,   ///< Formats of all the impressions
+        IP_ADDRESS  = 1 << 3,
+        USER_AGENT  = 1 << 4
+    };
+
+    /** Configure from the "deduplication" section of the router's
+        configuration:
+
+        - windowMs: how long after a request its copies are suppressed.
+          Defaults to 100ms; at most 30s.
+        - policy: "first" (the default) or "cheapest".
+        - fields: the fields making up the fingerprint, among "userId",
+          "url", "sizes", "ipAddress" and "userAgent".  Defaults to
+          userId, url and sizes.
+        - capacity: number of fingerprints remembered.  Should be a few
+          times the number of requests arriving in a window.  Defaults to
+          2^20.
+    */
+    AuctionDeduplicator(const Json::Value & config = Json::Value());
+
+    double windowMs;
+    Policy policy;
+    int fields;
+
+    /** Outcome of checking a request. */
+    struct Result {
+        Result()
+            : duplicate(false)
+        {
+        }
+
+        bool duplicate;             ///< This request should be dropped
+        InternedName firstExchange; ///< Exchange of the copy it duplicates
+    };
+
+    /** Remember the request and tell whether it's a copy of one that was
+        seen from another exchange within the window.  Requests without any of the fingerprint's
+        fields are always let through.
+    */
+    Result check(const BidRequest & request, Date now = Date::now());
+
+    /** Hash of the fingerprint fields of the request, or 0 if it has none
+        of them.
+    */
+    uint64_t fingerprint(const BidRequest & request) const;
+
+    /** Floor of the request, in micro currency units per impression: the
+        lowest reserve price of its impressions.
+    */
+    static uint32_t floorOf(const BidRequest & request);
+
+    /** Totals since startup. */
+    Json::Value getStats() const;
+
+    size_t capacity() const { return slots.size(); }
+
+private:
+    enum {
+        ProbeLength = 8,        ///< Slots looked at from a bucket
+        StampBits = 20,
+        StampMask = (1 << StampBits) - 1
+    };
+
+    /** A slot holds the fingerprint's 44 high bits and the millisecond
+        it was claimed at in its key, and the exchange and floor of the
+        cheapest copy seen in its value.  A key of 0 was never claimed.
+    */
+    struct Slot {
+        Slot()
+            : key(0), value(0)
+        {
+        }
+
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> value;
+    };
+
+    std::vector<Slot> slots;
+    uint64_t mask;
+    uint64_t windowTicks;
+
+    std::atomic<uint64_t> numChecked;
+    std::atomic<uint64_t> numUnfingerprinted;
+    std::atomic<uint64_t> numSuppressed;
+    std::atomic<uint64_t> numCheaperCopies;
+    std::atomic<uint64_t> numSameExchange;
+    std::atomic<uint64_t> numTableFull;
+
+    static uint64_t packValue(InternedName exchange, uint32_t floor)
+    {
+        return (uint64_t(exchange.handle) << 32) | floor;
+    }
+
+    /** Is a slot with the given key still within the window?  Threads
+        don't read the clock in order, so a slot may have been claimed a
+        little after the given stamp.
+    */
+    bool live(uint64_t key, uint64_t stamp) const
+    {
+        uint64_t age = (stamp - key) & StampMask;
+        return key != 0
+            && (age < windowTicks || age > StampMask - windowTicks);
+    }
+};
+
+} // namespace RTBKIT
@@ -25,6 +25,57 @@ using namespace ML;
 namespace RTBKIT {
 
 
+/*****************************************************************************/
+/* AUGMENTATION CACHE                                                        */
+/*****************************************************************************/
+
+const AugmentationList *
+AugmentationCache::
+find(const Key & key, Date now) const
+{
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.expiry <= now)
+        return 0;
+    return &it->second.list;
+}
+
+void
+AugmentationCache::
+insert(const Key & key, const AugmentationList & list, Date expiry)
+{
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        it->second.list = list;
+        it->second.expiry = expiry;
+        entries.updateTimeout(it, expiry);
+        return;
+    }
+
+    if (entries.size() >= maxEntries)
+        return;
+
+    Value value;
+    value.list = list;
+    value.expiry = expiry;
+    entries.insert(key, value, expiry);
+}
+
+void
+AugmentationCache::
+expire(Date now)
+{
+    if (entries.earliest > now)
+        return;
+
+    auto onExpired = [&] (const Key & key, Value & value) -> Date
+        {
+            return Date();
+        };
+
+    entries.expire(onExpired, now);
+}
+
+
 /*****************************************************************************/
 /* AUGMENTATION LOOP                                                         */
 /*****************************************************************************/
@@ -102,6 +153,12 @@ init()
                 return;
             }
 
+            augmentFromCache(*entry, now);
+            if (entry->outstanding.empty()) {
+                entry->onFinished(entry->info);
+                return;
+            }
+
             // TODO: wake up loop if slower...
             // TODO: DRY with other function...
             augmenting.insert(entry->info->auction->id, entry,
@@ -276,6 +333,9 @@ checkExpiries()
         recordEvent(eventName.c_str(), ET_LEVEL,
                     aug.inFlight.size());
     }
+
+    cache.expire(now);
+    recordLevel(cache.size(), "cache.numEntries");
     
 #if 0
     vector<string> deadAugmentors;
@@ -384,6 +444,18 @@ augment(const std::shared_ptr<AugmentationInfo> & info,
     // Get a set of all augmentors
     std::set<std::string> augmentors;
 
+    /* A response can only be cached if every agent asking for the augmentor
+       allows it, in which case the shortest TTL wins.  The config hash
+       covers the agents and their augmentation configs since both shape the
+       augmentor's response.
+    */
+    struct CachePolicy {
+        CachePolicy() : ttl(-1.0), configHash(0) {}
+        double ttl;
+        uint64_t configHash;
+    };
+    std::map<std::string, CachePolicy> cachePolicies;
+
     // Now go through and find all of the bidders
     for (unsigned i = 0;  i < info->potentialGroups.size();  ++i) {
         const GroupPotentialBidders & group = info->potentialGroups[i];
@@ -391,12 +463,22 @@ augment(const std::shared_ptr<AugmentationInfo> & info,
             const PotentialBidder & bidder = group[j];
             const AgentConfig & config = *bidder.config;
             for (unsigned k = 0;  k < config.augmentations.size();  ++k) {
-                const std::string & name = config.augmentations[k].name;
-                augmentors.insert(name);
+                const AugmentationConfig & aug = config.augmentations[k];
+                augmentors.insert(aug.name);
+
+                CachePolicy & policy = cachePolicies[aug.name];
+                policy.ttl = policy.ttl < 0.0
+                    ? aug.cacheTtl : std::min(policy.ttl, aug.cacheTtl);
+                policy.configHash ^= aug.configHash * 31
+                    + std::hash<std::string>()(bidder.agent);
             }
         }
     }
 
+    const UserIds & userIds = info->auction->request->userIds;
+    const Id & userId = userIds.providerId
+        ? userIds.providerId : userIds.exchangeId;
+
     //cerr << "need augmentors " << augmentors << endl;
 
     // Find which ones are actually available...
@@ -431,6 +513,15 @@ augment(const std::shared_ptr<AugmentationInfo> & info,
             }
             else {
                 entry->outstanding.insert(*it1);
+
+                const CachePolicy & policy = cachePolicies[*it1];
+                if (policy.ttl > 0.0 && userId) {
+                    CacheSlot & slot = entry->cacheSlots[*it1];
+                    slot.key.augmentor = *it1;
+                    slot.key.userId = userId;
+                    slot.key.configHash = policy.configHash;
+                    slot.ttl = policy.ttl;
+                }
             }
 
             ++it1;
@@ -561,7 +652,7 @@ doResponse(const std::vector<std::string> & message)
 {
     recordEvent("augmentation.response");
     //cerr << "doResponse " << message << endl;
-    if (message.size() != 7)
+    if (message.size() != 7 && message.size() != 8)
         throw ML::Exception("response message has wrong size: %zd",
                             message.size());
     const string & version = message[2];
@@ -573,6 +664,9 @@ doResponse(const std::vector<std::string> & message)
     const std::string & augmentor = message[5];
     const std::string & augmentation = message[6];
 
+    // Augmentors can ask for a response not to be reused
+    bool cacheable = message.size() == 7 || message[7] != "nocache";
+
     ML::Timer timer;
 
     AugmentationList augmentationList;
@@ -587,13 +681,14 @@ doResponse(const std::vector<std::string> & message)
             string eventName = "augmentor." + augmentor
                 + ".responseParsingExceptions";
             recordEvent(eventName.c_str(), ET_COUNT);
+            cacheable = false;
         }
     }
 
     recordLevel(timer.elapsed_wall(), "responseParseTimeMs");
 
+    double timeTakenMs = startTime.secondsUntil(Date::now()) * 1000.0;
     {
-        double timeTakenMs = startTime.secondsUntil(Date::now()) * 1000.0;
         string eventName = "augmentor." + augmentor + ".timeTakenMs";
         recordEvent(eventName.c_str(), ET_OUTCOME, timeTakenMs);
     }
@@ -617,6 +712,11 @@ doResponse(const std::vector<std::string> & message)
         auto & entry = *augmentors[augmentor];
         entry.inFlight.erase(id);
         entry.numInFlight = entry.inFlight.size();
+
+        // Used to report how much time the cache saves us
+        entry.avgTimeTakenMs = entry.avgTimeTakenMs == 0.0
+            ? timeTakenMs
+            : 0.99 * entry.avgTimeTakenMs + 0.01 * timeTakenMs;
     }
 
     auto it = augmenting.find(id);
@@ -628,6 +728,12 @@ doResponse(const std::vector<std::string> & message)
         return;
     }
 
+    auto slot = it->second->cacheSlots.find(augmentor);
+    if (cacheable && slot != it->second->cacheSlots.end()) {
+        cache.insert(slot->second.key, augmentationList,
+                     Date::now().plusSeconds(slot->second.ttl));
+    }
+
     it->second->info->auction->augmentations[augmentor].mergeWith(augmentationList);
 
     it->second->outstanding.erase(augmentor);
@@ -644,4 +750,47 @@ augmentationExpired(const Id & id, const Entry & entry)
     entry.onFinished(entry.info);
 }                     
 
+void
+AugmentationLoop::
+augmentFromCache(Entry & entry, Date now)
+{
+    if (entry.cacheSlots.empty())
+        return;
+
+    auto & auction = *entry.info->auction;
+
+    for (auto it = entry.outstanding.begin();
+         it != entry.outstanding.end();  /* no inc */) {
+
+        auto slot = entry.cacheSlots.find(*it);
+        if (slot == entry.cacheSlots.end()) {
+            ++it;
+            continue;
+        }
+
+        const AugmentationList * cached = cache.find(slot->second.key, now);
+        if (!cached) {
+            string eventName = "augmentor." + *it + ".cacheMiss";
+            recordEvent(eventName.c_str());
+            ++it;
+            continue;
+        }
+
+        auction.augmentations[*it].mergeWith(*cached);
+
+        recordEvent("augmentation.cacheHit");
+        string eventName = "augmentor." + *it + ".cacheHit";
+        recordEvent(eventName.c_str());
+
+        auto aug = augmentors.find(*it);
+        if (aug != augmentors.end()) {
+            eventName = "augmentor." + *it + ".cacheLatencySavedMs";
+            recordEvent(eventName.c_str(), ET_OUTCOME,
+                        aug->second->avgTimeTakenMs);
+        }
+
+        it = entry.outstanding.erase(it);
+    }
+}
+
 } // namespace RTBKIT
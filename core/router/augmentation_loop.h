@@ -33,7 +33,7 @@ namespace RTBKIT {
 /** Information about a given augmentor. */
 struct AugmentorInfo {
     AugmentorInfo()
-        : numInFlight(0)
+        : numInFlight(0), avgTimeTakenMs(0.0)
     {
     }
 
@@ -41,6 +41,67 @@ struct AugmentorInfo {
     std::string name;                   ///< What the augmentation is called
     std::map<Id, Date> inFlight;
     int numInFlight;
+    double avgTimeTakenMs;   ///< Moving average of the response latency
+};
+
+
+/*****************************************************************************/
+/* AUGMENTATION CACHE                                                        */
+/*****************************************************************************/
+
+/** Router-side cache of augmentor responses.  An entry is keyed on the
+    augmentor, the user and a hash of the augmentation configs of the agents
+    that asked for it, and lives for the cacheTtl set in those configs.
+
+    Not thread safe; it's owned by the augmentation loop and protected by its
+    lock.
+*/
+struct AugmentationCache {
+
+    AugmentationCache(size_t maxEntries = 1 << 20)
+        : maxEntries(maxEntries)
+    {
+    }
+
+    struct Key {
+        std::string augmentor;
+        Id userId;
+        uint64_t configHash;
+
+        bool operator < (const Key & other) const
+        {
+            if (configHash != other.configHash)
+                return configHash < other.configHash;
+            if (userId != other.userId)
+                return userId < other.userId;
+            return augmentor < other.augmentor;
+        }
+    };
+
+    /** Returns the cached augmentation for the key or null if there is no
+        unexpired entry for it.
+    */
+    const AugmentationList * find(const Key & key, Date now) const;
+
+    /** Record the augmentation for the given key until expiry.  Silently
+        ignored if the cache is full.
+    */
+    void insert(const Key & key, const AugmentationList & list, Date expiry);
+
+    /** Drop every entry that has expired. */
+    void expire(Date now);
+
+    size_t size() const { return entries.size(); }
+
+    size_t maxEntries;
+
+private:
+    struct Value {
+        AugmentationList list;
+        Date expiry;
+    };
+
+    TimeoutMap<Key, Value> entries;
 };
 
 // Information about an auction being augmented
@@ -91,9 +152,18 @@ struct AugmentationLoop : public ServiceBase, public MessageLoop {
                  Date timeout,
                  const OnFinished & onFinished);
 
+    /** How the response of a given augmentor can be cached for an
+        auction.
+    */
+    struct CacheSlot {
+        AugmentationCache::Key key;
+        double ttl;
+    };
+
     struct Entry {
         std::shared_ptr<AugmentationInfo> info;
         std::set<std::string> outstanding;
+        std::map<std::string, CacheSlot> cacheSlots; ///< Per augmentor
         OnFinished onFinished;
         Date timeout;
     };
@@ -104,6 +174,9 @@ struct AugmentationLoop : public ServiceBase, public MessageLoop {
     typedef TimeoutMap<Id, std::shared_ptr<Entry> > Augmenting;
     Augmenting augmenting;
 
+    /** Responses that can be reused for later auctions of the same user. */
+    AugmentationCache cache;
+
     /** Currently configured augmentors.  Indexed by the augmentor name. */
     std::map<std::string, std::shared_ptr<AugmentorInfo> > augmentors;
 
@@ -156,6 +229,11 @@ struct AugmentationLoop : public ServiceBase, public MessageLoop {
     void doAugment(const std::vector<std::string> & message);
 
     void augmentationExpired(const Id & id, const Entry & entry);
+
+    /** Fill in the outstanding augmentations of the entry that are present
+        in the cache, removing them from the outstanding set.
+    */
+    void augmentFromCache(Entry & entry, Date now);
 };
 
 } // namespace RTBKIT
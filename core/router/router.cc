@@ -28,6 +28,7 @@
 #include "rtbkit/core/banker/banker.h"
 #include "rtbkit/core/banker/null_banker.h"
 #include <boost/algorithm/string.hpp>
+#include <cmath>
 #include "rtbkit/common/bids.h"
 #include "rtbkit/common/auction_events.h"
 #include "rtbkit/common/messages.h"
@@ -113,15 +114,24 @@ Router(ServiceBase & parent,
        bool logAuctions,
        bool logBids)
     : ServiceBase(serviceName, parent),
+      frequencyCapCapacity(1 << 20),
+      frequencyCapUpdates(getZmqContext()),
       shutdown_(false),
       agentEndpoint(getZmqContext()),
+      postAuctionEndpoint(getZmqContext()),
       configBuffer(1024),
       startBiddingBuffer(65536),
       submittedBuffer(65536),
-      auctionGraveyard(65536),
       augmentationLoop(*this),
       loopMonitor(*this),
       loadStabilizer(loopMonitor),
+      retiredAuctionsBatch(256),
+      auctionGraveyard(1024),
+      numStartBiddingQueued(0),
+      routerLatencyMeanMs(0.0),
+      routerLatencyVarMs(0.0),
+      routerLatencySampled(false),
+      maxQueuedAuctions(8192),
       secondsUntilLossAssumed_(secondsUntilLossAssumed),
       globalBidProbability(1.0),
       bidsErrorRate(0.0),
@@ -133,6 +143,12 @@ Router(ServiceBase & parent,
       logAuctions(logAuctions),
       logBids(logBids),
       logger(getZmqContext()),
+      eventLog(logger),
+      metrics(*this),
+      exchangeRequests(metrics, "exchange.", ".requests"),
+      exchangeImpressions(metrics, "exchange.", ".imp"),
+      bidErrorReasons(metrics, "bidErrors."),
+      duplicates(metrics, "dedup."),
       doDebug(false),
       numAuctions(0), numBids(0), numNonEmptyBids(0),
       numAuctionsWithBid(0), numNoPotentialBidders(0),
@@ -151,16 +167,24 @@ Router(std::shared_ptr<ServiceProxies> services,
        bool logAuctions,
        bool logBids)
     : ServiceBase(serviceName, services),
+      frequencyCapCapacity(1 << 20),
+      frequencyCapUpdates(getZmqContext()),
       shutdown_(false),
       agentEndpoint(getZmqContext()),
       postAuctionEndpoint(getZmqContext()),
       configBuffer(1024),
       startBiddingBuffer(65536),
       submittedBuffer(65536),
-      auctionGraveyard(65536),
       augmentationLoop(*this),
       loopMonitor(*this),
       loadStabilizer(loopMonitor),
+      retiredAuctionsBatch(256),
+      auctionGraveyard(1024),
+      numStartBiddingQueued(0),
+      routerLatencyMeanMs(0.0),
+      routerLatencyVarMs(0.0),
+      routerLatencySampled(false),
+      maxQueuedAuctions(8192),
       secondsUntilLossAssumed_(secondsUntilLossAssumed),
       globalBidProbability(1.0),
       bidsErrorRate(0.0),
@@ -172,6 +196,12 @@ Router(std::shared_ptr<ServiceProxies> services,
       logAuctions(logAuctions),
       logBids(logBids),
       logger(getZmqContext()),
+      eventLog(logger),
+      metrics(*this),
+      exchangeRequests(metrics, "exchange.", ".requests"),
+      exchangeImpressions(metrics, "exchange.", ".imp"),
+      bidErrorReasons(metrics, "bidErrors."),
+      duplicates(metrics, "dedup."),
       doDebug(false),
       numAuctions(0), numBids(0), numNonEmptyBids(0),
       numAuctionsWithBid(0), numNoPotentialBidders(0),
@@ -210,7 +240,27 @@ init()
             cerr << "agent " << agent << " disconnected from router" << endl;
         };
 
-    postAuctionEndpoint.init(getServices()->config, ZMQ_XREQ);
+    postAuctionEndpoint.init(getServices()->config);
+
+    if (frequencyCapCapacity)
+        frequencyCaps.reset(new FrequencyCapStore(frequencyCapCapacity));
+
+    frequencyCapUpdates.init(getServices()->config);
+    frequencyCapUpdates.messageHandler
+        = [=] (const std::vector<zmq::message_t> & message)
+        {
+            if (!frequencyCaps)
+                return;
+            if (message.size() != 2) {
+                recordHit("frequencyCaps.badMessage");
+                return;
+            }
+            try {
+                frequencyCaps->apply(message[1].toString());
+            } catch (const std::exception &) {
+                recordHit("frequencyCaps.badMessage");
+            }
+        };
 
     configListener.onConfigChange = [=] (const std::string & agent,
                                          std::shared_ptr<const AgentConfig> config)
@@ -232,10 +282,22 @@ init()
     loopMonitor.init();
     loopMonitor.addMessageLoop("augmentationLoop", &augmentationLoop);
     loopMonitor.addMessageLoop("logger", &logger);
+    loopMonitor.addMessageLoop("frequencyCapUpdates", &frequencyCapUpdates);
     loopMonitor.addMessageLoop("configListener", &configListener);
     loopMonitor.addMessageLoop("monitorClient", &monitorClient);
     loopMonitor.addMessageLoop("monitorProviderClient", &monitorProviderClient);
 
+    if (threadPlacement) {
+        threadPlacement->placeLoop(augmentationLoop, "augmentationLoop");
+        threadPlacement->placeLoop(logger, "logger");
+        threadPlacement->placeLoop(frequencyCapUpdates,
+                                   "frequencyCapUpdates");
+        threadPlacement->placeLoop(configListener, "configListener");
+        threadPlacement->placeLoop(monitorClient, "monitorClient");
+        threadPlacement->placeLoop(monitorProviderClient,
+                                   "monitorProviderClient");
+    }
+
     loopMonitor.onLoadChange = [=] (double)
         {
             double keepProb = 1.0 - loadStabilizer.shedProbability();
@@ -267,6 +329,30 @@ setBanker(const std::shared_ptr<Banker> & newBanker)
     banker = newBanker;
 }
 
+void
+Router::
+setThreadPlacement(const std::shared_ptr<ThreadPlacement> & placement)
+{
+    ExcAssert(!initialized);
+    threadPlacement = placement;
+}
+
+void
+Router::
+setDeduplication(const Json::Value & config)
+{
+    ExcAssert(!initialized);
+    deduplicator.reset(new AuctionDeduplicator(config));
+}
+
+void
+Router::
+setFrequencyCapCapacity(size_t capacity)
+{
+    ExcAssert(!initialized);
+    frequencyCapCapacity = capacity;
+}
+
 void
 Router::
 bindTcp()
@@ -323,40 +409,45 @@ start(boost::function<void ()> onStop)
 
     auto runfn = [=] ()
         {
+            if (threadPlacement)
+                threadPlacement->apply("router");
             this->run();
             if (onStop) onStop();
         };
 
-    logger.start();
-    augmentationLoop.start();
-    runThread.reset(new boost::thread(runfn));
-
-    if (connectPostAuctionLoop) {
-        postAuctionEndpoint.connectToServiceClass("rtbPostAuctionService", "events");
-    }
-
-    configListener.init(getServices()->config);
-    configListener.start();
-
     /* This is an extra thread which sits there deleting auctions
        to take this out of the hands of the main loop (it can easily use
        up nearly 20% of the capacity of the main loop).
     */
     auto auctionDeleter = [=] ()
         {
+            if (threadPlacement)
+                threadPlacement->apply("auctionCleanup");
+
+            std::shared_ptr<AuctionBatch> batch;
             while (!this->shutdown_) {
-                std::shared_ptr<Auction> toDelete;
-                auctionGraveyard.tryPop(toDelete, 0.05);
-                int numDeleted = 1;
-                while (this->auctionGraveyard.tryPop(toDelete))
-                    ++numDeleted;
-                //cerr << "deleted " << numDeleted << " auctions"
-                //     << endl;
-                ML::sleep(0.001);
+                if (auctionGraveyard.tryPop(batch, 0.05))
+                    this->destroyAuctions(*batch);
             }
         };
 
+    logger.start();
+    frequencyCapUpdates.start();
+    augmentationLoop.start();
     cleanupThread.reset(new boost::thread(auctionDeleter));
+    runThread.reset(new boost::thread(runfn));
+
+    if (connectPostAuctionLoop) {
+        postAuctionEndpoint.connect("events");
+
+        if (frequencyCaps)
+            frequencyCapUpdates.connectAllServiceProviders
+                (PostAuctionShards::ServiceClass, "logger",
+                 { FrequencyCapChannel });
+    }
+
+    configListener.init(getServices()->config);
+    configListener.start();
 
     monitorClient.start();
     monitorProviderClient.start();
@@ -418,7 +509,8 @@ run()
     };
 
     double last_check = ML::wall_time(), last_check_pace = last_check,
-        lastPings = last_check;
+        lastPings = last_check, lastLoad = last_check,
+        lastEventFlush = last_check;
 
     //cerr << "server listening" << endl;
 
@@ -430,6 +522,7 @@ run()
     double lastTimestamp = 0;
 
     double totalActive = 0;
+    double totalActiveAtLastLoad = 0;
     double lastTotalActive = 0; // member variable for the lambda.
     loopMonitor.addCallback("routerLoop",
             [&, lastTotalActive] (double elapsed) mutable {
@@ -478,7 +571,9 @@ run()
             rc = zmq_poll(items, 2, 0);
         if (rc == 0) {
             ++numTimesCouldSleep;
-            checkExpiredAuctions();
+
+            // Don't hold on to a partial batch while there's nothing to do
+            flushRetiredAuctions();
 
 #if 1
             // Try to sleep only once per 1/2 a millisecond to avoid too many
@@ -514,6 +609,7 @@ run()
             double atStart = getTime();
             std::shared_ptr<AugmentationInfo> info;
             while (startBiddingBuffer.tryPop(info)) {
+                --numStartBiddingQueued;
                 doStartBidding(info);
             }
 
@@ -574,7 +670,8 @@ run()
             wakeupMainLoop.read();
         }
 
-        //checkExpiredAuctions();
+        // Expire whether or not we're busy, a slice at a time
+        checkExpiredAuctions();
 
         double now = ML::wall_time();
         double beforeChecks = getTime();
@@ -587,6 +684,22 @@ run()
             lastPings = now;
         }
 
+        if (now - lastLoad > 0.01) {
+            // Tell the exchange connectors how loaded we are so that they
+            // can shed requests before parsing them.
+            double dutyCycle = (totalActive - totalActiveAtLastLoad)
+                / (now - lastLoad);
+            publishLoad(std::min(1.0, dutyCycle));
+
+            totalActiveAtLastLoad = totalActive;
+            lastLoad = now;
+        }
+
+        if (now - lastEventFlush > 0.01) {
+            eventLog.flush();
+            lastEventFlush = now;
+        }
+
         if (now - last_check_pace > 10.0) {
             recordEvent("numTimesCouldSleep", ET_LEVEL,
                         numTimesCouldSleep);
@@ -600,6 +713,9 @@ run()
         if (now - last_check > 10.0) {
             logUsageMetrics(10.0);
 
+            if (threadPlacement)
+                threadPlacement->recordStats(*this);
+
             logMessage("MARK",
                        Date::fromSecondsSinceEpoch(last_check).print(),
                        format("active: %zd augmenting, %zd inFlight, "
@@ -648,6 +764,7 @@ run()
 
         if (now - lastTimestamp >= 1.0) {
             banker->logBidEvents(*this);
+            metrics.flush();
             //issueTimestamp();
             lastTimestamp = now;
         }
@@ -667,6 +784,7 @@ shutdown()
     loopMonitor.shutdown();
 
     configListener.shutdown();
+    frequencyCapUpdates.shutdown();
 
     shutdown_ = true;
     futex_wake(shutdown_);
@@ -681,6 +799,13 @@ shutdown()
         cleanupThread->join();
     cleanupThread.reset();
 
+    std::shared_ptr<AuctionBatch> batch;
+    while (auctionGraveyard.tryPop(batch))
+        destroyAuctions(*batch);
+    if (retiredAuctions)
+        destroyAuctions(*retiredAuctions);
+
+    eventLog.flush();
     logger.shutdown();
     banker.reset();
 
@@ -776,21 +901,24 @@ handleAgentMessage(const std::vector<std::string> & message)
 
         if (request == "CONFIG") {
             string configName = message.at(2);
-            if (!agents.count(configName)) {
+            auto it = agents.find(configName);
+            if (it == agents.end()) {
                 // We don't yet know about its configuration
                 sendAgentMessage(address, "NEEDCONFIG", getCurrentTime());
                 return;
             }
-            agents[configName].address = address;
+            it->second.address = address;
             return;
         }
 
-        if (!agents.count(address)) {
+        // The only lookup of the agent for this message
+        auto it = agents.find(address);
+        if (it == agents.end()) {
             cerr << "doing NEEDCONFIG for " << address << endl;
             return;
         }
 
-        AgentInfo & info = agents[address];
+        AgentInfo & info = it->second;
         info.gotHeartbeat(Date::now());
 
         if (!info.configured) {
@@ -798,7 +926,7 @@ handleAgentMessage(const std::vector<std::string> & message)
         }
 
         if (request[0] == 'B' && request == "BID") {
-            doBid(message);
+            doBid(message, info);
             return;
         }
 
@@ -857,6 +985,87 @@ logUsageMetrics(double period)
                                      acceptAuctionProbability / numExchanges);
 }
 
+void
+Router::
+retireAuction(const std::shared_ptr<Auction> & auction)
+{
+    if (!retiredAuctions) {
+        retiredAuctions = std::make_shared<AuctionBatch>();
+        retiredAuctions->reserve(retiredAuctionsBatch);
+    }
+
+    retiredAuctions->push_back(auction);
+    if (retiredAuctions->size() >= retiredAuctionsBatch)
+        flushRetiredAuctions();
+}
+
+void
+Router::
+flushRetiredAuctions()
+{
+    if (!retiredAuctions || retiredAuctions->empty())
+        return;
+
+    // If the cleanup thread can't keep up, we have no choice but to
+    // destroy them in the main loop.
+    if (!auctionGraveyard.tryPush(retiredAuctions)) {
+        recordHit("retiredAuctions.overflow");
+        destroyAuctions(*retiredAuctions);
+    }
+
+    retiredAuctions.reset();
+}
+
+void
+Router::
+destroyAuctions(AuctionBatch & batch)
+{
+    if (batch.empty())
+        return;
+
+    size_t bytes = 0;
+    for (auto & auction: batch)
+        bytes += auction->memUsage();
+
+    size_t n = batch.size();
+    batch.clear();
+
+    recordOutcome(n, "retiredAuctions.destroyed");
+    recordOutcome(bytes / n, "retiredAuctions.bytesPerAuction");
+}
+
+void
+Router::
+publishLoad(double dutyCycle)
+{
+    RouterLoad load;
+    load.dutyCycle = dutyCycle;
+
+    double queued = augmentationLoop.numAugmenting() + numStartBiddingQueued;
+    load.queueFill = std::min(1.0, queued / maxQueuedAuctions);
+
+    // Without new samples (for example because the admission controllers
+    // are turning everything away) let the estimate decay, halving about
+    // every 0.7s, so that requests are let through again to measure it.
+    if (!routerLatencySampled) {
+        routerLatencyMeanMs *= 0.99;
+        routerLatencyVarMs *= 0.98;
+    }
+    routerLatencySampled = false;
+
+    // Budget for the 99th percentile rather than the mean
+    load.expectedLatencyMs
+        = routerLatencyMeanMs + 2.33 * sqrt(routerLatencyVarMs);
+
+    forAllExchanges([&] (const std::shared_ptr<ExchangeConnector> & exchange)
+        {
+            exchange->admission.updateLoad(load);
+        });
+
+    recordLevel(load.queueFill * 100.0, "admission.queueFillPercentage");
+    recordLevel(load.expectedLatencyMs, "admission.expectedLatencyMs");
+}
+
 void
 Router::
 checkDeadAgents()
@@ -868,59 +1077,51 @@ checkDeadAgents()
 
     std::vector<Agents::iterator> deadAgents;
 
-    for (auto it = agents.begin(), end = agents.end();  it != end;
-         ++it) {
-        auto & info = it->second;
-
-        const std::string & account = info.config->account.toString('.');
-
-        Date now = Date::now();
-        double oldest = 0.0;
-        double total = 0.0;
-
-        vector<Id> toExpire;
-
-        // Check for in flight timeouts.  This shouldn't happen, but there
-        // appears to be a way in which we lose track of an inflight auction
-        auto onInFlight = [&] (const Id & id, const Date & date)
-            {
-                double secondsSince = now.secondsSince(date);
+    Date now = Date::now();
 
-                oldest = std::max(oldest, secondsSince);
-                total += secondsSince;
+    // Age of the bids in flight of each agent, from the lists of bidders
+    // of the auctions in flight.
+    struct InFlightAges {
+        InFlightAges()
+            : oldest(0.0), total(0.0)
+        {
+        }
 
-                if (secondsSince > 30.0) {
+        double oldest;
+        double total;
+    };
 
-                    this->recordHit("accounts.%s.lostBids", account);
+    std::vector<InFlightAges> ages(agentSlots.size());
+    for (auto & auction: inFlight) {
+        for (auto & bidder: auction.second.bidders) {
+            if (!getAgent(bidder.first)) continue;
+            double secondsSince = now.secondsSince(bidder.second.bidTime);
+            InFlightAges & agentAges = ages[bidder.first.slot];
+            agentAges.oldest = std::max(agentAges.oldest, secondsSince);
+            agentAges.total += secondsSince;
+        }
+    }
 
-                    this->sendBidResponse(it->first,
-                                          info,
-                                          BS_LOSTBID,
-                                          this->getCurrentTime(),
-                                          "guaranteed", id);
+    for (auto it = agents.begin(), end = agents.end();  it != end;
+         ++it) {
+        auto & info = it->second;
 
-                    toExpire.push_back(id);
-                }
-            };
+        const std::string & account
+            = AccountKeyTable::dottedName(info.config->accountHandle);
 
-        info.forEachInFlight(onInFlight);
+        const InFlightAges & agentAges = ages.at(info.handle.slot);
 
         this->recordLevel(info.numBidsInFlight(),
                           "accounts.%s.inFlight.numInFlight", account);
-        this->recordLevel(oldest,
+        this->recordLevel(agentAges.oldest,
                           "accounts.%s.inFlight.oldestAgeSeconds", account);
         double averageAge = 0.0;
         if (info.numBidsInFlight() != 0)
-            averageAge = total / info.numBidsInFlight();
+            averageAge = agentAges.total / info.numBidsInFlight();
 
         this->recordLevel(averageAge,
                           "accounts.%s.inFlight.averageAgeSeconds", account);
 
-        for (auto jt = toExpire.begin(), jend = toExpire.end();  jt != jend;
-             ++jt) {
-            info.expireBidInFlight(*jt);
-        }
-
         double timeSinceHeartbeat
             = now.secondsSince(info.status->lastHeartbeat);
 
@@ -930,18 +1131,11 @@ checkDeadAgents()
         if (timeSinceHeartbeat > 5.0) {
             info.status->dead = true;
             if (it->second.numBidsInFlight() != 0) {
+                // They go when their auctions expire
                 cerr << "agent " << it->first
                      << " has " << it->second.numBidsInFlight()
-                     << " undead auctions: " << endl;
-
-                auto onInFlight = [&] (const Id & id, Date date)
-                    {
-                        cerr << "  " << id << " --> "
-                        << date << " (" << now.secondsSince(date)
-                        << "s ago)" << endl;
-                    };
-
-                info.forEachInFlight(onInFlight);
+                     << " undead auctions, the oldest "
+                     << agentAges.oldest << "s old" << endl;
             }
             else {
                 // agent is dead
@@ -958,7 +1152,7 @@ checkDeadAgents()
         cerr << "WARNING: dead agent doesn't clean up its state properly"
              << endl;
         // TODO: undo all bids in progress
-        agents.erase(*it);
+        removeAgent(*it);
     }
 
     if (!deadAgents.empty())
@@ -971,7 +1165,7 @@ checkDeadAgents()
 
 void
 Router::
-checkExpiredAuctions()
+checkExpiredAuctions(size_t maxEntries)
 {
     //recentlySubmitted.clear();
 
@@ -990,25 +1184,22 @@ checkExpiredAuctions()
                 for (auto it = auctionInfo.bidders.begin(),
                          end = auctionInfo.bidders.end();
                      it != end;  ++it) {
-                    string agent = it->first;
-                    if (!agents.count(agent)) continue;
-
-                    if (agents[agent].expireBidInFlight(auctionId)) {
-                        AgentInfo & info = this->agents[agent];
-                        ++info.stats->tooLate;
-
-                        this->recordHit("accounts.%s.droppedBids",
-                                        info.config->account.toString('.'));
-
-                        this->sendBidResponse(agent,
-                                              info,
-                                              BS_DROPPEDBID,
-                                              this->getCurrentTime(),
-                                              "guaranteed",
-                                              auctionId,
-                                              0, Amount(),
-                                              auctionInfo.auction.get());
-                    }
+                    AgentInfo * info = this->getAgent(it->first);
+                    if (!info) continue;  // agent is gone
+
+                    info->expireBidInFlight();
+                    ++info->stats->tooLate;
+
+                    this->metrics.hit(info->metrics->droppedBids);
+
+                    this->sendBidResponse(this->getAgentName(it->first),
+                                          *info,
+                                          BS_DROPPEDBID,
+                                          this->getCurrentTime(),
+                                          "guaranteed",
+                                          auctionId,
+                                          0, Amount(),
+                                          auctionInfo.auction.get());
                 }
 
 #if 0
@@ -1020,7 +1211,8 @@ checkExpiredAuctions()
                 for (auto it = auctionInfo.bidders.begin(),
                          end = auctionInfo.bidders.end();
                      it != end;  ++it)
-                    msg += ' ' + it->first + "->" + it->second.bidTime.print(5);
+                    msg += ' ' + getAgentName(it->first)
+                        + "->" + it->second.bidTime.print(5);
                 cerr << Date::now().print(5) << " " << msg << endl;
                 dumpAuction(auctionId);
                 this->logRouterError("checkExpiredAuctions.inFlight",
@@ -1029,7 +1221,7 @@ checkExpiredAuctions()
 #endif
 
                 // end the auction when it expires in case we're waiting on dead agents
-        if(!auctionInfo.auction->getResponses().empty()) {
+        if(auctionInfo.auction->numSpots() != 0) {
                     if(!auctionInfo.auction->finish()) {
                 this->recordHit("tooLateToFinish");
             }
@@ -1038,12 +1230,22 @@ checkExpiredAuctions()
                 return Date();
             };
 
-        inFlight.expire(onExpiredInFlight, start);
+        auto stats = inFlight.expire(onExpiredInFlight, start, maxEntries);
+        if (stats.numExpired) {
+            recordOutcome(stats.numExpired, "inFlight.expired");
+            recordOutcome(stats.maxLateness * 1000.0,
+                          "inFlight.expiryLatenessMs");
+        }
+        if (!stats.done)
+            recordHit("inFlight.expiryBacklog");
     }
 
     {
         RouterProfiler profiler(dutyCycleCurrent.nsExpireBlacklist);
-        blacklist.doExpiries();
+        auto stats = blacklist.doExpiries(start, maxEntries);
+        if (stats.numExpired)
+            recordOutcome(stats.maxLateness * 1000.0,
+                          "blacklist.expiryLatenessMs");
     }
 
     if (doDebug) {
@@ -1113,7 +1315,14 @@ Json::Value
 Router::
 getServiceStatus() const
 {
-    return getStats();
+    Json::Value result = getStats();
+    if (threadPlacement)
+        result["threads"] = threadPlacement->getStats();
+    if (deduplicator)
+        result["deduplication"] = deduplicator->getStats();
+    if (frequencyCaps)
+        result["frequencyCaps"] = frequencyCaps->getStats();
+    return result;
 }
 
 void
@@ -1140,6 +1349,7 @@ augmentAuction(const std::shared_ptr<AugmentationInfo> & info)
             }
 
             // Send it off to be farmed out to the bidders
+            ++numStartBiddingQueued;
             startBiddingBuffer.push(info);
             wakeupMainLoop.signal();
         };
@@ -1177,18 +1387,24 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
     /* Parse out the adimp. */
     const vector<AdSpot> & imp = auction->request->imp;
 
-    recordCount(imp.size(), "exchange.%s.imp", exchange.c_str());
-    recordHit("exchange.%s.requests", exchange.c_str());
+    exchangeImpressions.hit(exchange.c_str(), imp.size());
+    exchangeRequests.hit(exchange.c_str());
 
     // List of possible agents per round robin group
     std::map<string, GroupPotentialBidders> groupAgents;
 
     double timeLeftMs = auction->timeAvailable() * 1000.0;
 
-    bool traceAuction = auction->id.hash() % 10 == 0;
-
     AgentConfig::RequestFilterCache cache(*auction->request);
 
+    // Frequency caps are looked up for this user, in the current bucket
+    uint64_t capUser = 0;
+    uint32_t capBucket = 0;
+    if (frequencyCaps) {
+        capUser = FrequencyCapStore::userKey(auction->request->userIds);
+        capBucket = frequencyCaps->bucketOf(now);
+    }
+
     auto exchangeConnector = auction->exchangeConnector;
 
     auto checkAgent = [&] (const AgentInfoEntry & entry)
@@ -1199,11 +1415,7 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
 
             auto doFilterStat = [&] (const char * reason)
             {
-                if (!traceAuction) return;
-
-                this->recordHit("accounts.%s.filter.%s",
-                                config.account.toString('.'),
-                                reason);
+                entry.metrics->filters.hit(reason);
             };
 
             ML::atomic_inc(stats.intoFilters);
@@ -1238,6 +1450,15 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
             if (biddableSpots.empty())
                 return;
 
+            /* Check that the user hasn't seen this campaign too often. */
+            if (frequencyCaps
+                && config.frequencyCap.isCapped(*frequencyCaps, capUser,
+                                                capBucket)) {
+                ML::atomic_inc(stats.frequencyCapped);
+                doFilterStat("static.110_frequencyCapped");
+                return;
+            }
+
             ML::atomic_inc(stats.passedStaticFilters);
             doFilterStat("passedStaticFilters");
 
@@ -1246,6 +1467,7 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
 
             PotentialBidder bidder;
             bidder.agent = agentName;
+            bidder.handle = entry.handle;
             bidder.imp = biddableSpots;
             bidder.config = entry.config;
             bidder.stats = entry.stats;
@@ -1319,6 +1541,17 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
     //static const char *fName = "Router::doStartBidding:";
     RouterProfiler profiler(dutyCycleCurrent.nsStartBidding);
 
+    {
+        // Track how long auctions spend in the router before they can be
+        // sent out, for the admission controllers of the exchanges.
+        double latencyMs = Date::now().secondsSince(augInfo->auction->doneParsing)
+            * 1000.0;
+        double delta = latencyMs - routerLatencyMeanMs;
+        routerLatencyMeanMs += 0.01 * delta;
+        routerLatencyVarMs = 0.99 * (routerLatencyVarMs + 0.01 * delta * delta);
+        routerLatencySampled = true;
+    }
+
     try {
         Id auctionId = augInfo->auction->id;
 
@@ -1348,6 +1581,9 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                                                augInfo->lossTimeout);
         auto auction = augInfo->auction;
 
+        // At most one agent per round-robin group gets to bid
+        auction->reserveResponses(groupAgents.size());
+
         Date now = Date::now();
 
         auction->inStartBidding = now;
@@ -1368,26 +1604,20 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
             for (unsigned i = 0;  i < bidders.size();  ++i) {
                 PotentialBidder & bidder = bidders[i];
-                if (!agents.count(bidder.agent)) continue;
-                AgentInfo & info = agents[bidder.agent];
+                AgentInfo * agentInfo = getAgent(bidder.handle);
+                if (!agentInfo) continue;
+                AgentInfo & info = *agentInfo;
                 const AgentConfig & config = *bidder.config;
 
                 auto doFilterStat = [&] (const char * reason)
                     {
-                        if (!traceAuction) return;
-
-                        this->recordHit("accounts.%s.filter.%s",
-                                        config.account.toString('.'),
-                                        reason);
+                        info.metrics->filters.hit(reason);
                     };
 
                 auto doFilterMetric = [&] (const char * reason, float val)
                     {
                         if (!traceAuction) return;
-
-                        this->recordOutcome(val, "accounts.%s.filter.%s",
-                                            config.account.toString('.'),
-                                            reason);
+                        info.metrics->filters.outcome(reason, val);
                     };
 
 
@@ -1521,13 +1751,14 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
             // Best one is the first one
             PotentialBidder & winner = bidders[best];
-            string agent = winner.agent;
+            const string & agent = winner.agent;
 
-            if (!agents.count(agent)) {
+            AgentInfo * agentInfo = getAgent(winner.handle);
+            if (!agentInfo) {
                 //cerr << "!!!AGENT IS GONE" << endl;
                 continue;  // agent is gone
             }
-            AgentInfo & info = agents[agent];
+            AgentInfo & info = *agentInfo;
 
             ++info.stats->auctions;
 
@@ -1545,12 +1776,16 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
             bidInfo.bidTime = Date::now();
             bidInfo.imp = winner.imp;
 
-            auctionInfo.bidders.insert(make_pair(agent, std::move(bidInfo)));  // create empty bid response
-            if (!info.trackBidInFlight(auctionId, bidInfo.bidTime))
+            if (auctionInfo.findBidder(winner.handle)
+                != auctionInfo.bidders.end())
                 throwException("doStartBidding.agentAlreadyBidding",
                                "agent %s is already processing auction %s",
                                agent.c_str(),
                                auctionId.toString().c_str());
+            // create empty bid response
+            auctionInfo.bidders.push_back(make_pair(winner.handle,
+                                                    std::move(bidInfo)));
+            info.trackBidInFlight();
 
             WinCostModel wcm = auction->exchangeConnector->getWinCostModel(*auction,
                                                                            *winner.config);
@@ -1635,6 +1870,19 @@ static bool failBid(double proportion)
 void
 Router::
 doBid(const std::vector<std::string> & message)
+{
+    auto it = message.empty() ? agents.end() : agents.find(message[0]);
+    if (it == agents.end()) {
+        returnErrorResponse(message, "unknown agent");
+        return;
+    }
+
+    doBid(message, it->second);
+}
+
+void
+Router::
+doBid(const std::vector<std::string> & message, AgentInfo & info)
 {
     //static const char *fName = "Router::doBid:";
     if (failBid(bidsErrorRate)) {
@@ -1706,17 +1954,12 @@ doBid(const std::vector<std::string> & message)
 
     debugAuction(auctionId, "BID", message);
 
-    if (!agents.count(agent)) {
-        returnErrorResponse(message, "unknown agent");
-        return;
-    }
-
     doProfileEvent(2, "agents");
 
-    AgentInfo & info = agents[agent];
-
-    /* One less in flight. */
-    if (!info.expireBidInFlight(auctionId)) {
+    // The agent is bidding on the auction if it's still in flight and has
+    // the agent in its list of bidders.
+    auto it = inFlight.find(auctionId);
+    if (it == inFlight.end()) {
         recordHit("bidError.agentNotBidding");
         returnErrorResponse(message, "agent wasn't bidding on this auction");
         return;
@@ -1724,28 +1967,25 @@ doBid(const std::vector<std::string> & message)
 
     doProfileEvent(3, "inFlight");
 
-    auto it = inFlight.find(auctionId);
-    if (it == inFlight.end()) {
-        recordHit("bidError.unknownAuction");
-        returnErrorResponse(message, "unknown auction");
-        return;
-    }
-
-    doProfileEvent(4, "account");
-
     AuctionInfo & auctionInfo = it->second;
 
-    auto biddersIt = auctionInfo.bidders.find(agent);
+    auto biddersIt = auctionInfo.findBidder(info.handle);
     if (biddersIt == auctionInfo.bidders.end()) {
-        recordHit("bidError.agentSkippedAuction");
-        returnErrorResponse(message,
-                            "agent shouldn't bid on this auction");
+        recordHit("bidError.agentNotBidding");
+        returnErrorResponse(message, "agent wasn't bidding on this auction");
         return;
     }
 
+    /* One less in flight. */
+    info.expireBidInFlight();
+
+    doProfileEvent(4, "account");
+
     auto & config = *biddersIt->second.agentConfig;
 
-    recordHit("accounts.%s.bids", config.account.toString('.'));
+    AccountMetrics & accountCounters = *info.metrics;
+
+    metrics.hit(accountCounters.bids);
 
     doProfileEvent(5, "auctionInfo");
 
@@ -1758,12 +1998,9 @@ doBid(const std::vector<std::string> & message)
     auto returnInvalidBid = [&] (int i, const char * reason,
                                  const char * message, ...)
         {
-            this->recordHit("bidErrors.%s");
-            this->recordHit("accounts.%s.bidErrors.total",
-                            config.account.toString('.'));
-            this->recordHit("accounts.%s.bidErrors.%s",
-                            config.account.toString('.'),
-                            reason);
+            this->bidErrorReasons.hit(reason);
+            this->metrics.hit(accountCounters.bidErrors);
+            accountCounters.bidErrorReasons.hit(reason);
 
             ++info.stats->invalid;
 
@@ -1894,7 +2131,7 @@ doBid(const std::vector<std::string> & message)
         // authorize an amount of money computed from the win cost model.
         Amount price = wcm.evaluate(bid, bid.price);
 
-        if (!banker->authorizeBid(config.account, auctionKey, price)
+        if (!banker->authorizeBid(config.accountHandle, auctionKey, price)
                 || failBid(budgetErrorRate))
         {
             ++info.stats->noBudget;
@@ -1940,7 +2177,8 @@ doBid(const std::vector<std::string> & message)
         response.creativeName = creative.name;
 
         Auction::WinLoss localResult
-            = auctionInfo.auction->setResponse(spotIndex, response);
+            = auctionInfo.auction->setResponse(spotIndex,
+                                               std::move(response));
 
         doProfileEvent(6, "bidSubmission");
         ++numValidBids;
@@ -1976,7 +2214,7 @@ doBid(const std::vector<std::string> & message)
             else if (localResult.val == Auction::WinLoss::INVALID)
                 ++info.stats->invalid;
 
-            banker->cancelBid(config.account, auctionKey);
+            banker->cancelBid(config.accountHandle, auctionKey);
 
             BidStatus status;
             switch (localResult.val) {
@@ -2034,9 +2272,7 @@ doBid(const std::vector<std::string> & message)
     //cerr << "campaign " << info.config->campaign << " bidTime "
     //     << 1000.0 * bidTime << endl;
 
-    recordOutcome(1000.0 * bidTime,
-                  "accounts.%s.bidResponseTimeMs",
-                  config.account.toString('.'));
+    metrics.outcome(accountCounters.bidResponseTimeMs, 1000.0 * bidTime);
 
     doProfileEvent(9, "postTiming");
 
@@ -2096,8 +2332,9 @@ doSubmitted(std::shared_ptr<Auction> auction)
 
     //cerr << "SUBMITTED " << auctionId << endl;
 
+    // The auction is finished, so its responses don't change any more
     const std::vector<std::vector<Auction::Response> > & allResponses
-        = auction->getResponses();
+        = auction->getCurrentData()->responses;
 
     if (doDebug)
         debugAuction(auctionId, ML::format("SUBMITTED %d slots",
@@ -2137,9 +2374,10 @@ doSubmitted(std::shared_ptr<Auction> auction)
 
             //cerr << "doing response " << i << endl;
 
-            if (!agents.count(response.agent)) continue;
+            auto agentIt = agents.find(response.agent);
+            if (agentIt == agents.end()) continue;
 
-            AgentInfo & info = agents[response.agent];
+            AgentInfo & info = agentIt->second;
 
             Amount bid_price = response.price.maxPrice;
 
@@ -2152,7 +2390,8 @@ doSubmitted(std::shared_ptr<Auction> auction)
             ML::Call_Guard guard
                 ([&] ()
                  {
-                     banker->cancelBid(response.agentConfig->account, auctionKey);
+                     banker->cancelBid(response.agentConfig->accountHandle,
+                                       auctionKey);
                  });
 
             // No bid
@@ -2221,9 +2460,8 @@ doSubmitted(std::shared_ptr<Auction> auction)
 
     //cerr << "auction.use_count() = " << auction.use_count() << endl;
 
-    if (auction.unique()) {
-        auctionGraveyard.tryPush(auction);
-    }
+    if (auction.unique())
+        retireAuction(auction);
 }
 
 std::string
@@ -2276,6 +2514,18 @@ onNewAuction(std::shared_ptr<Auction> auction)
 
     //cerr << "AUCTION GOT THROUGH" << endl;
 
+    if (deduplicator) {
+        auto dedup = deduplicator->check(*auction->request);
+        if (dedup.duplicate) {
+            string key = dedup.firstExchange.str() + "."
+                + auction->request->exchange + ".suppressed";
+            duplicates.hit(key.c_str());
+            recordHit("auctionDropped.duplicate");
+            auction->finish();
+            return;
+        }
+    }
+
     if (logAuctions)
         // Send AUCTION to logger
         logMessage("AUCTION", auction->id, auction->requestStr);
@@ -2342,14 +2592,19 @@ updateAllAgents()
 
             AgentInfoEntry entry;
             entry.name = it->first;
+            entry.handle = it->second.handle;
             entry.config = it->second.config;
             entry.stats = it->second.stats;
             entry.status = it->second.status;
+            entry.metrics = it->second.metrics;
             int i = newInfo->size();
             newInfo->push_back(entry);
 
             newInfo->agentIndex[it->first] = i;
-            newInfo->accountIndex[it->second.config->account].push_back(i);
+            AccountHandle account = it->second.config->accountHandle;
+            if (newInfo->accountIndex.size() <= account)
+                newInfo->accountIndex.resize(account + 1);
+            newInfo->accountIndex[account].push_back(i);
         }
 
         if (ML::cmp_xchg(allAgents, current, newInfo.get())) {
@@ -2375,8 +2630,9 @@ doConfig(const std::string & agent,
     auto newConfig = std::make_shared<AgentConfig>(*config);
     if (newConfig->roundRobinGroup == "")
         newConfig->roundRobinGroup = agent;
+    newConfig->accountHandle = AccountKeyTable::intern(newConfig->account);
 
-    AgentInfo & info = agents[agent];
+    AgentInfo & info = getOrAddAgent(agent);
 
     if (info.configured) {
         unconfigure(agent, *info.config);
@@ -2384,6 +2640,7 @@ doConfig(const std::string & agent,
     }
 
     info.config = newConfig;
+    info.metrics = getAccountMetrics(newConfig->accountHandle);
     //cerr << "configured " << agent << " strategy : " << info.config->strategy << " campaign "
     //     <<  info.config->campaign << endl;
 
@@ -2398,6 +2655,60 @@ doConfig(const std::string & agent,
     updateAllAgents();
 }
 
+AgentInfo &
+Router::
+getOrAddAgent(const std::string & name)
+{
+    auto res = agents.insert(make_pair(name, AgentInfo()));
+    AgentInfo & info = res.first->second;
+    if (!res.second)
+        return info;
+
+    uint32_t slot;
+    if (!freeAgentSlots.empty()) {
+        slot = freeAgentSlots.back();
+        freeAgentSlots.pop_back();
+    }
+    else {
+        slot = agentSlots.size();
+        agentSlots.emplace_back();
+    }
+
+    AgentSlot & entry = agentSlots[slot];
+    entry.info = &info;
+    entry.name = name;
+    info.handle = AgentHandle(slot, entry.generation);
+
+    return info;
+}
+
+void
+Router::
+removeAgent(Agents::iterator it)
+{
+    AgentSlot & entry = agentSlots.at(it->second.handle.slot);
+    entry.info = 0;
+    entry.name.clear();
+    ++entry.generation;   // handles to the removed agent are now stale
+    freeAgentSlots.push_back(it->second.handle.slot);
+
+    agents.erase(it);
+}
+
+std::shared_ptr<AccountMetrics>
+Router::
+getAccountMetrics(AccountHandle account)
+{
+    if (accountMetrics.size() <= account)
+        accountMetrics.resize(account + 1);
+
+    auto & result = accountMetrics[account];
+    if (!result)
+        result = std::make_shared<AccountMetrics>
+            (metrics, AccountKeyTable::dottedName(account));
+    return result;
+}
+
 void
 Router::
 unconfigure(const std::string & agent, const AgentConfig & config)
@@ -2551,7 +2862,8 @@ doPong(int level, const std::vector<std::string> & message)
     auto & info = it->second;
     info.gotPong(level, sentTime, receivedTime, now);
 
-    const string & account = it->second.config->account.toString('.');
+    const string & account
+        = AccountKeyTable::dottedName(it->second.config->accountHandle);
     recordOutcome(roundTripTime * 1000.0,
                   "accounts.%s.ping%d.roundTripTimeMs", account, level);
     recordOutcome(outgoingTime * 1000.0,
@@ -2624,13 +2936,12 @@ forEachAccountAgent(const AccountKey & account,
     const AllAgentInfo * ac = allAgents;
     if (!ac) return;
 
-    auto it = ac->accountIndex.find(account);
-    if (it == ac->accountIndex.end())
+    AccountHandle handle = AccountKeyTable::find(account);
+    if (handle >= ac->accountIndex.size())
         return;
 
-    for (auto jt = it->second.begin(), jend = it->second.end();
-         jt != jend;  ++jt)
-        onAgent(ac->at(*jt));
+    for (int i: ac->accountIndex[handle])
+        onAgent(ac->at(i));
 }
 
 AgentInfoEntry
@@ -2679,11 +2990,11 @@ submitToPostAuctionService(std::shared_ptr<Auction> auction,
     event.bidResponse = bid;
 
     Message<SubmittedAuctionEvent> message(std::move(event));
-    postAuctionEndpoint.sendMessage("AUCTION", message.toString());
+    postAuctionEndpoint.sendMessage(auction->id,
+                                    "AUCTION", message.toString());
 
-    if (auction.unique()) {
-        auctionGraveyard.tryPush(auction);
-    }
+    if (auction.unique())
+        retireAuction(auction);
 }
 
 void
@@ -2740,7 +3051,8 @@ Router::
 expireDebugInfo()
 {
     boost::unique_lock<ML::Spinlock> guard(debugLock);
-    debugInfo.expire();
+    debugInfo.expire([] (const Id &, AuctionDebugInfo &) { return Date(); },
+                     Date::now(), 1024);
 }
 
 void
@@ -2801,6 +3113,7 @@ startExchange(const std::string & type,
               const Json::Value & config)
 {
     auto exchange = ExchangeConnector::create(type, *this, type);
+    exchange->threadPlacement = threadPlacement;
     exchange->configure(config);
     exchange->start();
 
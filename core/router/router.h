@@ -15,18 +15,23 @@
 #include "jml/utils/filter_streams.h"
 #include "soa/service/zmq_named_pub_sub.h"
 #include "soa/service/socket_per_thread.h"
-#include "soa/service/timeout_map.h"
+#include "timer_wheel.h"
 #include "soa/service/pending_list.h"
 #include "soa/service/loop_monitor.h"
 #include "augmentation_loop.h"
 #include "router_types.h"
+#include "auction_deduplicator.h"
+#include "rtbkit/common/frequency_cap_store.h"
 #include "soa/gc/gc_lock.h"
 #include "jml/utils/ring_buffer.h"
 #include "jml/arch/wakeup_fd.h"
 #include "jml/utils/smart_ptr_utils.h"
 #include <unordered_set>
 #include <thread>
+#include <atomic>
 #include "rtbkit/common/exchange_connector.h"
+#include "rtbkit/common/binary_event_log.h"
+#include "rtbkit/common/post_auction_proxy.h"
 #include "rtbkit/core/agent_configuration/blacklist.h"
 #include "rtbkit/core/agent_configuration/agent_configuration_listener.h"
 #include "rtbkit/core/agent_configuration/agent_config.h"
@@ -47,9 +52,11 @@ struct Accountant;
 /** A single entry in the agent info structure. */
 struct AgentInfoEntry {
     std::string name;
+    AgentHandle handle;
     std::shared_ptr<const AgentConfig> config;
     std::shared_ptr<const AgentStatus> status;
     std::shared_ptr<AgentStats> stats;
+    std::shared_ptr<AccountMetrics> metrics;
 
     bool valid() const { return config && stats; }
 
@@ -64,7 +71,8 @@ struct AgentInfoEntry {
 */
 struct AllAgentInfo : public std::vector<AgentInfoEntry> {
     std::unordered_map<std::string, int> agentIndex;
-    std::unordered_map<AccountKey, std::vector<int> > accountIndex;
+    /** Agents for each account, indexed by account handle. */
+    std::vector<std::vector<int> > accountIndex;
 };
 
 /*****************************************************************************/
@@ -126,6 +134,25 @@ struct Router : public ServiceBase,
     std::shared_ptr<Banker> getBanker() const;
     void setBanker(const std::shared_ptr<Banker> & newBanker);
 
+    /** Run the router's threads (the router loop under "router", its
+        message loops under the names they have in the loop monitor and its
+        exchange connectors under "exchange.<type>") where the given
+        placement says.  Must be called before init().
+    */
+    void setThreadPlacement(const std::shared_ptr<ThreadPlacement> & placement);
+
+    /** Drop the requests that are copies of one received shortly before,
+        as configured by the given "deduplication" section (see
+        AuctionDeduplicator).  Must be called before init().
+    */
+    void setDeduplication(const Json::Value & config);
+
+    /** Remember the frequency cap counts of up to the given number of
+        (user, campaign or account) pairs; 0 turns frequency capping off.
+        Defaults to 2^20, which takes 64MB.  Must be called before init().
+    */
+    void setFrequencyCapCapacity(size_t capacity);
+
     /** Initialize all of the internal data structures and configuration. */
     void init();
 
@@ -354,6 +381,21 @@ protected:
     // don't have to run in the main loop
     boost::scoped_ptr<boost::thread> cleanupThread;
 
+    std::shared_ptr<ThreadPlacement> threadPlacement;
+
+    /** Recognizes copies of requests; null if they're not suppressed. */
+    std::unique_ptr<AuctionDeduplicator> deduplicator;
+
+    /** Counts of wins and impressions per user for the agents' frequency
+        caps; null if capping is off.  Only written to by the thread of
+        frequencyCapUpdates.
+    */
+    size_t frequencyCapCapacity;
+    std::unique_ptr<FrequencyCapStore> frequencyCaps;
+
+    /** Increments of the counts published by the post auction loops. */
+    ZmqNamedMultipleSubscriber frequencyCapUpdates;
+
     typedef std::recursive_mutex Lock;
     typedef std::unique_lock<Lock> Guard;
 
@@ -363,8 +405,8 @@ public:
     // Connection to the agents
     ZmqNamedClientBus agentEndpoint;
 
-    // Connection to the post auction loop
-    ZmqNamedProxy postAuctionEndpoint;
+    // Connection to the post auction loop (or its shards)
+    PostAuctionProxy postAuctionEndpoint;
 
     void updateAllAgents();
 
@@ -372,10 +414,52 @@ public:
     typedef std::map<std::string, AgentInfo> Agents;
     Agents agents;
 
+    /** Dense table of the agents, indexed by AgentHandle::slot.  The bid
+        path carries handles and goes through this table instead of looking
+        agents up by name.  Freed slots are reused with a new generation.
+    */
+    struct AgentSlot {
+        AgentSlot()
+            : info(0), generation(0)
+        {
+        }
+
+        AgentInfo * info;   ///< Points into agents; null if the slot is free
+        std::string name;
+        uint32_t generation;
+    };
+
+    std::vector<AgentSlot> agentSlots;
+    std::vector<uint32_t> freeAgentSlots;
+
+    /** Return the agent with the given name, adding it and giving it a slot
+        if it's not known yet.
+    */
+    AgentInfo & getOrAddAgent(const std::string & name);
+
+    /** Remove the agent, freeing its slot. */
+    void removeAgent(Agents::iterator it);
+
+    /** Return the agent for the handle, or null if it's gone. */
+    AgentInfo * getAgent(AgentHandle handle) const
+    {
+        if (handle.slot >= agentSlots.size())
+            return 0;
+        const AgentSlot & slot = agentSlots[handle.slot];
+        if (slot.generation != handle.generation)
+            return 0;
+        return slot.info;
+    }
+
+    const std::string & getAgentName(AgentHandle handle) const
+    {
+        ExcAssertLess(handle.slot, agentSlots.size());
+        return agentSlots[handle.slot].name;
+    }
+
     ML::RingBufferSRMW<std::pair<std::string, std::shared_ptr<const AgentConfig> > > configBuffer;
     ML::RingBufferSRMW<std::shared_ptr<AugmentationInfo> > startBiddingBuffer;
     ML::RingBufferSRMW<std::shared_ptr<Auction> > submittedBuffer;
-    ML::RingBufferSWMR<std::shared_ptr<Auction> > auctionGraveyard;
 
     ML::Wakeup_Fd wakeupMainLoop;
 
@@ -385,8 +469,10 @@ public:
     LoopMonitor loopMonitor;
     LoadStabilizer loadStabilizer;
 
-    /** List of auctions we're currently tracking as active. */
-    typedef TimeoutMap<Id, AuctionInfo> InFlight;
+    /** List of auctions we're currently tracking as active, indexed by
+        the time they expire.
+    */
+    typedef TimerWheel<Id, AuctionInfo> InFlight;
     InFlight inFlight;
 
     /** Add the given auction to our data structures. */
@@ -396,13 +482,72 @@ public:
     DutyCycleEntry dutyCycleCurrent;
     std::vector<DutyCycleEntry> dutyCycleHistory;
 
+    typedef std::vector<std::shared_ptr<Auction> > AuctionBatch;
+
+    /** Auctions whose last reference is held by the router, waiting to be
+        handed to the cleanup thread.  They're handed over a batch at a time
+        so that the main loop only pays for one push per batch.  Router
+        thread only.
+    */
+    std::shared_ptr<AuctionBatch> retiredAuctions;
+
+    /** Number of retired auctions in a batch. */
+    size_t retiredAuctionsBatch;
+
+    /** Batches of retired auctions for the cleanup thread to destroy. */
+    ML::RingBufferSWMR<std::shared_ptr<AuctionBatch> > auctionGraveyard;
+
+    /** Hand over an auction that the router is done with for destruction
+        by the cleanup thread.  Must be called from the router thread.
+    */
+    void retireAuction(const std::shared_ptr<Auction> & auction);
+
+    /** Hand the retired auctions over to the cleanup thread now, even if
+        the batch isn't full.  Must be called from the router thread.
+    */
+    void flushRetiredAuctions();
+
+    /** Destroy a batch of retired auctions and record how much memory they
+        held.  Called from the cleanup thread.
+    */
+    void destroyAuctions(AuctionBatch & batch);
+
+    /** Number of auctions waiting in startBiddingBuffer. */
+    std::atomic<int> numStartBiddingQueued;
+
+    /** Moving mean and variance of the time between an auction being
+        parsed and it being sent to the agents.
+    */
+    double routerLatencyMeanMs, routerLatencyVarMs;
+
+    /** Has an auction updated the latency since the load was last
+        published?  If not, the estimate decays so that the admission
+        controllers don't keep turning everything away after a spike.
+    */
+    bool routerLatencySampled;
+
+    /** Number of auctions augmenting or waiting to start bidding at which
+        we consider the router's queues full and shed everything.
+    */
+    size_t maxQueuedAuctions;
+
+    /** Publish the current load of the router to the admission controllers
+        of the exchange connectors.
+    */
+    void publishLoad(double dutyCycle);
+
     void run();
 
     void handleAgentMessage(const std::vector<std::string> & message);
 
     void checkDeadAgents();
 
-    void checkExpiredAuctions();
+    /** Expire in flight auctions, blacklist entries and debug info that
+        are due.  Called on every iteration of the main loop; each kind of
+        entry is expired at most maxEntries at a time, so that a backlog
+        doesn't stall the loop.
+    */
+    void checkExpiredAuctions(size_t maxEntries = 1024);
 
     void returnErrorResponse(const std::vector<std::string> & message,
                              const std::string & error);
@@ -439,6 +584,9 @@ public:
     /** An agent bid on an auction.  Arrange for this bid to be recorded. */
     void doBid(const std::vector<std::string> & message);
 
+    /** Same, for an agent that was already looked up from the message. */
+    void doBid(const std::vector<std::string> & message, AgentInfo & info);
+
     /** An agent responded to a ping message.  Arrange for the ping time
         to be recorded. */
     void doPong(int level, const std::vector<std::string> & message);
@@ -570,8 +718,8 @@ public:
                         const std::string & exception,
                         Args... args)
     {
-        logger.publish("ROUTERERROR", Date::now().print(5),
-                       function, exception, args...);
+        eventLog.publish("ROUTERERROR", Date::now(),
+                         function, exception, args...);
         recordHit("error.%s", function);
     }
 
@@ -594,7 +742,7 @@ public:
     {
         using namespace std;
         //cerr << "********* logging message to " << channel << endl;
-        logger.publish(channel, Date::now().print(5), args...);
+        eventLog.publish(channel, Date::now(), args...);
     }
 
     /** Log a given message to the given channel. */
@@ -603,7 +751,7 @@ public:
     {
         using namespace std;
         //cerr << "********* logging message to " << channel << endl;
-        logger.publish(channel, args...);
+        eventLog.publish(channel, Date(), args...);
     }
 
     /*************************************************************************/
@@ -645,11 +793,34 @@ public:
 
     ZmqNamedPublisher logger;
 
+    /** Batches the logged messages into binary events sent on logger.  Flushed
+        by the main loop every 10ms.
+    */
+    BinaryEventPublisher eventLog;
+
+    /** Counters of the hot paths, whose names are resolved once.  Flushed
+        to carbon every second by the main loop.
+    */
+    MetricRegistry metrics;
+    MetricFamily exchangeRequests;
+    MetricFamily exchangeImpressions;
+    MetricFamily bidErrorReasons;
+
+    /** Suppressed copies, as <first exchange>.<copy exchange>.suppressed */
+    MetricFamily duplicates;
+
+    /** Metrics of each account, indexed by account handle.  Only touched
+        by the main loop.
+    */
+    std::vector<std::shared_ptr<AccountMetrics> > accountMetrics;
+
+    std::shared_ptr<AccountMetrics> getAccountMetrics(AccountHandle account);
+
     /** Debug only */
     bool doDebug;
 
     mutable ML::Spinlock debugLock;
-    TimeoutMap<Id, AuctionDebugInfo> debugInfo;
+    TimerWheel<Id, AuctionDebugInfo> debugInfo;
 
     uint64_t numAuctions;
     uint64_t numBids;
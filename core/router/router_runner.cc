@@ -40,6 +40,7 @@ static inline Json::Value loadJsonFromFile(const std::string & filename)
 RouterRunner::
 RouterRunner() :
     exchangeConfigurationFile("examples/router-config.json"),
+    frequencyCapSlots(1 << 20),
     lossSeconds(15.0),
     logAuctions(false),
     logBids(false)
@@ -61,6 +62,16 @@ doOptions(int argc, char ** argv,
          "URI to publish logs to")
         ("exchange-configuration,x", value<string>(&exchangeConfigurationFile),
          "configuration file with exchange data")
+        ("thread-placement", value<string>(&threadPlacementFile),
+         "file with the CPUs and NUMA nodes of the router's threads; its "
+         "threadPlacement section if it has one (like a launch config)")
+        ("deduplication", value<string>(&deduplicationFile),
+         "file with the fingerprint, window and policy used to drop copies "
+         "of requests coming from several exchanges; its deduplication "
+         "section if it has one")
+        ("frequency-cap-slots", value<size_t>(&frequencyCapSlots),
+         "number of (user, campaign) counts kept for the agents' frequency "
+         "caps; 0 turns frequency capping off")
         ("log-auctions", value<bool>(&logAuctions)->zero_tokens(),
          "log auction requests")
         ("log-bids", value<bool>(&logBids)->zero_tokens(),
@@ -97,13 +108,40 @@ init()
 
     exchangeConfig = loadJsonFromFile(exchangeConfigurationFile);
 
-    router = std::make_shared<Router>(proxies, serviceName, lossSeconds,
-    								  true, logAuctions, logBids);
+    if (!threadPlacementFile.empty()) {
+        Json::Value config = loadJsonFromFile(threadPlacementFile);
+        if (config.isMember("threadPlacement"))
+            config = config["threadPlacement"];
+        threadPlacement = std::make_shared<ThreadPlacement>(config);
+    }
+
+    {
+        // The router's ring buffers are built with it; put them on the
+        // node of the router loop, which consumes them.
+        ThreadPlacement::LocalAllocation local(threadPlacement.get(), "router");
+        router = std::make_shared<Router>(proxies, serviceName, lossSeconds,
+                                          true, logAuctions, logBids);
+    }
+
+    if (threadPlacement)
+        router->setThreadPlacement(threadPlacement);
+
+    if (!deduplicationFile.empty()) {
+        Json::Value config = loadJsonFromFile(deduplicationFile);
+        if (config.isMember("deduplication"))
+            config = config["deduplication"];
+        router->setDeduplication(config);
+    }
+
+    router->setFrequencyCapCapacity(frequencyCapSlots);
+
     router->init();
 
     banker = std::make_shared<SlaveBanker>(proxies->zmqContext,
                                            proxies->config,
                                            router->serviceName() + ".slaveBanker");
+    if (threadPlacement)
+        threadPlacement->placeLoop(*banker, "slaveBanker");
 
     router->setBanker(banker);
     router->bindTcp();
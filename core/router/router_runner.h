@@ -29,6 +29,9 @@ struct RouterRunner {
 
     //std::string routerConfigurationFile;
     std::string exchangeConfigurationFile;
+    std::string threadPlacementFile;
+    std::string deduplicationFile;
+    size_t frequencyCapSlots;
     float lossSeconds;
 
     bool logAuctions;
@@ -41,6 +44,7 @@ struct RouterRunner {
     std::shared_ptr<ServiceProxies> proxies;
     std::shared_ptr<SlaveBanker> banker;
     std::shared_ptr<Router> router;
+    std::shared_ptr<ThreadPlacement> threadPlacement;
     Json::Value exchangeConfig;
 
     void init();
@@ -45,10 +45,14 @@ init()
                                           p::_1, p::_2, p::_3);
     config.init();
     config.bindTcp();
+    if (threadPlacement)
+        threadPlacement->placeLoop(config, "agentConfiguration");
     config.start();
 
     masterBanker.init(std::make_shared<RedisBankerPersistence>(redis));
     masterBanker.bindTcp();
+    if (threadPlacement)
+        threadPlacement->placeLoop(masterBanker, "masterBanker");
     masterBanker.start();
 
     budgetController.init(getServices()->config);
@@ -58,6 +62,8 @@ init()
         {
             auto res = make_shared<SlaveBanker>(
                     getZmqContext(), getServices()->config, name);
+            if (threadPlacement)
+                threadPlacement->placeLoop(*res, "slaveBanker." + name);
             res->start();
             return res;
         };
@@ -68,13 +74,19 @@ init()
     postAuctionLoop.init();
     postAuctionLoop.setBanker(makeSlaveBanker("postAuction"));
     postAuctionLoop.bindTcp();
+    if (threadPlacement)
+        postAuctionLoop.setThreadPlacement(threadPlacement);
 
+    if (threadPlacement)
+        router.setThreadPlacement(threadPlacement);
     router.init();
     router.setBanker(makeSlaveBanker("router"));
     router.bindTcp();
 
     monitor.init({"router", "postAuction", "masterBanker"});
     monitor.bindTcp();
+    if (threadPlacement)
+        threadPlacement->placeLoop(monitor, "monitor");
     monitor.start();
 
     initialized = true;
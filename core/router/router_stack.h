@@ -170,6 +170,13 @@ struct RouterStack: public ServiceBase {
 
     MonitorEndpoint monitor;
 
+    /** Where the threads of the stack run: those of the router (see
+        Router::setThreadPlacement), then "postAuction",
+        "agentConfiguration", "masterBanker", "slaveBanker.<name>" and
+        "monitor".  Set before init().
+    */
+    std::shared_ptr<ThreadPlacement> threadPlacement;
+
     bool initialized;
 };
 
@@ -153,7 +153,7 @@ AgentStats()
       exchangeFiltered(0),
       segmentsMissing(0), segmentFiltered(0),
       augmentationTagsExcluded(0), userBlacklisted(0), notEnoughTime(0),
-      requiredIdMissing(0),
+      requiredIdMissing(0), frequencyCapped(0),
       intoFilters(0), passedStaticFilters(0),
       passedStaticPhase1(0), passedStaticPhase2(0), passedStaticPhase3(0),
       passedDynamicFilters(0),
@@ -184,6 +184,7 @@ toJson() const
     result["tooManyInFlight"] = tooManyInFlight;
     result["requiredIdMissing"] = requiredIdMissing;
     result["notEnoughTime"] = notEnoughTime;
+    result["frequencyCapped"] = frequencyCapped;
 
     result["filter_noSpots"] = noSpots;
     result["filter_skippedBidProbability"] = skippedBidProbability;
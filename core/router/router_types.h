@@ -11,9 +11,11 @@
 #include "rtbkit/common/bid_request.h"
 #include "rtbkit/common/auction.h"
 #include "jml/stats/distribution.h"
+#include "jml/utils/exc_assert.h"
 #include <set>
 #include "rtbkit/common/currency.h"
 #include "rtbkit/common/bids.h"
+#include "rtbkit/common/metric_registry.h"
 
 
 namespace RTBKIT {
@@ -51,9 +53,9 @@ struct AgentStats {
     uint64_t invalid;
     uint64_t noBudget;
 
-    CurrencyPool totalBid;
-    CurrencyPool totalBidOnWins;
-    CurrencyPool totalSpent;
+    CurrencyTotals totalBid;
+    CurrencyTotals totalBidOnWins;
+    CurrencyTotals totalSpent;
 
     uint64_t tooManyInFlight;
     uint64_t noSpots;
@@ -71,6 +73,7 @@ struct AgentStats {
     uint64_t userBlacklisted;
     uint64_t notEnoughTime;
     uint64_t requiredIdMissing;
+    uint64_t frequencyCapped;
 
     uint64_t intoFilters;
     uint64_t passedStaticFilters;
@@ -92,6 +95,61 @@ struct AgentStats {
 };
 
 
+/** Per account counters of the router.  Created when the first agent of the
+    account is configured and shared by all of its agents.
+*/
+struct AccountMetrics {
+    AccountMetrics(MetricRegistry & registry, const std::string & account)
+        : bids(registry.counter("accounts." + account + ".bids")),
+          droppedBids(registry.counter("accounts." + account + ".droppedBids")),
+          bidErrors(registry.counter("accounts." + account
+                                     + ".bidErrors.total")),
+          bidErrorReasons(registry, "accounts." + account + ".bidErrors."),
+          filters(registry, "accounts." + account + ".filter."),
+          bidResponseTimeMs(registry.counter("accounts." + account
+                                             + ".bidResponseTimeMs"))
+    {
+    }
+
+    MetricHandle bids;
+    MetricHandle droppedBids;
+    MetricHandle bidErrors;
+    MetricFamily bidErrorReasons;
+    MetricFamily filters;
+    MetricHandle bidResponseTimeMs;
+};
+
+
+/** Dense handle on an agent known to the router: the index of its slot in
+    the router's agent table, and the generation of the slot so that a
+    handle that outlives its agent is recognized as stale.  Handles are
+    given out when the agent is configured.
+*/
+struct AgentHandle {
+    enum : uint32_t { NoSlot = 0xffffffff };
+
+    AgentHandle(uint32_t slot = NoSlot, uint32_t generation = 0)
+        : slot(slot), generation(generation)
+    {
+    }
+
+    uint32_t slot;
+    uint32_t generation;
+
+    bool valid() const { return slot != NoSlot; }
+
+    bool operator == (const AgentHandle & other) const
+    {
+        return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator != (const AgentHandle & other) const
+    {
+        return !operator == (other);
+    }
+};
+
+
 struct AgentStatus {
     AgentStatus()
         : dead(false), numBidsInFlight(0)
@@ -125,10 +183,14 @@ struct AgentInfo {
     std::shared_ptr<AgentConfig> config;
     std::shared_ptr<AgentStatus> status;
     std::shared_ptr<AgentStats> stats;
+    std::shared_ptr<AccountMetrics> metrics;
     double throttleProbability;
 
     /** Address of the zeromq socket for this agent. */
     std::string address;
+
+    /** Slot of the agent in the router's agent table. */
+    AgentHandle handle;
     
     /** Encode the given bid request ready to be sent to the given
         agent in its configured format.
@@ -194,41 +256,25 @@ struct AgentInfo {
         status->dead = false;
     }
 
-    template<typename Fn>
-    void forEachInFlight(const Fn & fn) const
-    {
-        for (auto it = bidsInFlight.begin(), end = bidsInFlight.end();
-             it != end;  ++it) {
-            fn(it->first, it->second);
-        }
-    }
+    /* Which auctions an agent is bidding on is recorded in the auctions'
+       own lists of bidders; the agent only keeps count.
+    */
 
     size_t numBidsInFlight() const
     {
-        // DEBUG
-        if (status->numBidsInFlight != bidsInFlight.size())
-            throw ML::Exception("numBidsInFlight is wrong");
         return status->numBidsInFlight;
     }
-    
-    bool expireBidInFlight(const Id & id)
+
+    void expireBidInFlight()
     {
-        bool result = bidsInFlight.erase(id);
-        status->numBidsInFlight = bidsInFlight.size();
-        return result;
+        ExcAssertGreater(status->numBidsInFlight, 0);
+        --status->numBidsInFlight;
     }
 
-    // Returns true if it was successfully inserted
-    bool trackBidInFlight(const Id & id, Date date = Date::now())
+    void trackBidInFlight()
     {
-        bool result = bidsInFlight.insert(std::make_pair(id, date)).second;
-        status->numBidsInFlight = bidsInFlight.size();
-        return result;
+        ++status->numBidsInFlight;
     }
-
-private:
-    std::map<Id, Date> bidsInFlight;  /// Auctions in which we're participating
-    //std::set<std::pair<Id, Id> > awaitingResult;  ///< Auctions which are awaiting a win/loss result
 };
 
 /** Information about one of the agents in a round robin group. */
@@ -239,6 +285,7 @@ struct PotentialBidder {
     PotentialBidder() : inFlightProp(NULL_PROP) {}
 
     std::string agent;
+    AgentHandle handle;
     float inFlightProp;
     BiddableSpots imp;
     std::shared_ptr<const AgentConfig> config;
@@ -293,7 +340,21 @@ struct AuctionInfo : public AuctionInfoBase {
     {
     }
 
-    std::map<std::string, BidInfo> bidders;  ///< List of bidders
+    /** Agents that the auction was sent to and which haven't bid yet.
+        There are rarely more than a few, so they're kept in a small
+        array and searched by handle.
+    */
+    typedef ML::compact_vector<std::pair<AgentHandle, BidInfo>, 4, uint32_t>
+        Bidders;
+    Bidders bidders;
+
+    Bidders::iterator findBidder(AgentHandle agent)
+    {
+        for (auto it = bidders.begin(), end = bidders.end();  it != end;  ++it)
+            if (it->first == agent)
+                return it;
+        return bidders.end();
+    }
 
 };
 
@@ -4,6 +4,7 @@ LIBRTB_ROUTER_SOURCES := \
 	augmentation_loop.cc \
 	router.cc \
 	router_types.cc \
+	auction_deduplicator.cc \
 	router_stack.cc
 
 LIBRTB_ROUTER_LINK := \
@@ -0,0 +1,133 @@
+/* auction_deduplicator_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test for the suppression of copies of requests.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/router/auction_deduplicator.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+namespace {
+
+BidRequest request(const std::string & exchange, int user, double floor)
+{
+    BidRequest result;
+    result.exchange = exchange;
+    result.url = Url("http://www.example.com/page.html");
+    result.userIds.add(Id(user), ID_PROVIDER);
+
+    AdSpot spot;
+    spot.formats.push_back(Format(300, 250));
+    spot.reservePrice = USD_CPM(floor);
+    result.imp.push_back(spot);
+
+    return result;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_first_policy )
+{
+    AuctionDeduplicator dedup;
+    Date now = Date::now();
+
+    BOOST_CHECK(!dedup.check(request("rubicon", 1, 1.0), now).duplicate);
+
+    auto copy = dedup.check(request("appnexus", 1, 1.0),
+                            now.plusSeconds(0.010));
+    BOOST_CHECK(copy.duplicate);
+    BOOST_CHECK_EQUAL(copy.firstExchange, "rubicon");
+
+    // Another user, or the same one once the window has passed
+    BOOST_CHECK(!dedup.check(request("appnexus", 2, 1.0), now).duplicate);
+    BOOST_CHECK(!dedup.check(request("appnexus", 1, 1.0),
+                             now.plusSeconds(0.5)).duplicate);
+
+    // Nothing to tell requests apart by
+    BidRequest empty;
+    BOOST_CHECK_EQUAL(dedup.fingerprint(empty), 0);
+    BOOST_CHECK(!dedup.check(empty, now).duplicate);
+    BOOST_CHECK(!dedup.check(empty, now).duplicate);
+
+    Json::Value stats = dedup.getStats();
+    BOOST_CHECK_EQUAL(stats["checked"].asInt(), 6);
+    BOOST_CHECK_EQUAL(stats["suppressed"].asInt(), 1);
+    BOOST_CHECK_EQUAL(stats["unfingerprinted"].asInt(), 2);
+}
+
+BOOST_AUTO_TEST_CASE( test_same_exchange )
+{
+    AuctionDeduplicator dedup;
+    Date now = Date::now();
+
+    // Two slots of the same size on the page, from the same exchange, are
+    // both auctioned
+    BidRequest first = request("rubicon", 1, 1.0);
+    first.auctionId = Id("auction1");
+    first.imp[0].id = Id(1);
+    BidRequest second = request("rubicon", 1, 1.0);
+    second.auctionId = Id("auction2");
+    second.imp[0].id = Id(2);
+    BOOST_REQUIRE_EQUAL(dedup.fingerprint(first), dedup.fingerprint(second));
+
+    BOOST_CHECK(!dedup.check(first, now).duplicate);
+    BOOST_CHECK(!dedup.check(second, now.plusSeconds(0.001)).duplicate);
+
+    // Another exchange's copy still isn't
+    auto copy = dedup.check(request("appnexus", 1, 1.0),
+                            now.plusSeconds(0.002));
+    BOOST_CHECK(copy.duplicate);
+    BOOST_CHECK_EQUAL(copy.firstExchange, "rubicon");
+
+    Json::Value stats = dedup.getStats();
+    BOOST_CHECK_EQUAL(stats["sameExchange"].asInt(), 1);
+    BOOST_CHECK_EQUAL(stats["suppressed"].asInt(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_cheapest_policy )
+{
+    AuctionDeduplicator dedup(Json::parse("{\"policy\":\"cheapest\","
+                                          "\"windowMs\":50}"));
+    Date now = Date::now();
+
+    BOOST_CHECK(!dedup.check(request("rubicon", 1, 2.0), now).duplicate);
+    BOOST_CHECK(dedup.check(request("appnexus", 1, 3.0), now).duplicate);
+
+    // A cheaper copy goes through, after which the old floor is too high
+    BOOST_CHECK(!dedup.check(request("openx", 1, 1.0), now).duplicate);
+    auto copy = dedup.check(request("appnexus", 1, 2.0), now);
+    BOOST_CHECK(copy.duplicate);
+    BOOST_CHECK_EQUAL(copy.firstExchange, "openx");
+
+    BOOST_CHECK_EQUAL(dedup.getStats()["cheaperCopies"].asInt(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_configuration )
+{
+    AuctionDeduplicator dedup(Json::parse("{\"fields\":[\"ipAddress\"],"
+                                          "\"capacity\":1000}"));
+    BOOST_CHECK_EQUAL(dedup.capacity(), 1024);
+
+    // Only the configured fields count
+    auto first = request("rubicon", 1, 1.0);
+    auto second = request("appnexus", 2, 1.0);
+    first.ipAddress = second.ipAddress = "10.0.0.1";
+    BOOST_CHECK_EQUAL(dedup.fingerprint(first), dedup.fingerprint(second));
+
+    BOOST_CHECK_THROW(AuctionDeduplicator(Json::parse("{\"policy\":\"x\"}")),
+                      std::exception);
+    BOOST_CHECK_THROW(AuctionDeduplicator(Json::parse("{\"fields\":[]}")),
+                      std::exception);
+    BOOST_CHECK_THROW(AuctionDeduplicator(Json::parse("{\"windowMs\":0}")),
+                      std::exception);
+    BOOST_CHECK_THROW(AuctionDeduplicator(Json::parse("{\"unknown\":1}")),
+                      std::exception);
+}
@@ -9,3 +9,5 @@ $(eval $(call nodejs_test,rtb_new_format_test,bid_request sync_utils))
 $(eval $(call test,pending_list_test,types,boost))
 #$(eval $(call test,router_banker_test,rtb_router dataflow bidding_agent,boost))
 #$(eval $(call test,augmentation_test,rtb_router bid_request augmentor_base,boost))
+$(eval $(call test,timer_wheel_test,types,boost))
+$(eval $(call test,auction_deduplicator_test,rtb_router,boost))
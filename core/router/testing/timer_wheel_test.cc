@@ -0,0 +1,203 @@
+/* timer_wheel_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test for the timer wheel.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/router/timer_wheel.h"
+#include <random>
+#include <map>
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+struct Value {
+    Value(int i = 0)
+        : i(i)
+    {
+    }
+
+    int i;
+};
+
+Date start = Date::fromSecondsSinceEpoch(1370000000);
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_timer_wheel_basics )
+{
+    TimerWheel<int, Value> wheel(0.001, start);
+
+    wheel.insert(1, 1, start.plusSeconds(0.010));
+    wheel.insert(2, 2, start.plusSeconds(0.500));
+    wheel.insert(3, 3, start.plusSeconds(100.0));
+    BOOST_CHECK_THROW(wheel.insert(1, 1, start), std::exception);
+    BOOST_CHECK_EQUAL(wheel.size(), 3);
+    BOOST_CHECK_EQUAL(wheel.access(1, start).i, 1);
+
+    vector<int> expired;
+    auto onExpire = [&] (int key, Value & value)
+        {
+            expired.push_back(key);
+            return Date();
+        };
+
+    BOOST_CHECK_EQUAL(wheel.expire(onExpire, start.plusSeconds(0.005))
+                      .numExpired, 0);
+    BOOST_CHECK_EQUAL(wheel.expire(onExpire, start.plusSeconds(0.010))
+                      .numExpired, 1);
+    BOOST_CHECK_EQUAL(expired, vector<int>({ 1 }));
+
+    // Erased entries don't expire
+    wheel.erase(2);
+    wheel.expire(onExpire, start.plusSeconds(1.0));
+    BOOST_CHECK_EQUAL(expired.size(), 1);
+
+    // Rescheduled entries expire at their new time
+    wheel.updateTimeout(3, start.plusSeconds(2.0));
+    auto stats = wheel.expire(onExpire, start.plusSeconds(2.5));
+    BOOST_CHECK_EQUAL(expired, vector<int>({ 1, 3 }));
+    BOOST_CHECK_CLOSE(stats.maxLateness, 0.5, 0.001);
+    BOOST_CHECK(wheel.empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_timer_wheel_bounded_slices )
+{
+    TimerWheel<int, Value> wheel(0.001, start);
+
+    for (unsigned i = 0;  i < 1000;  ++i)
+        wheel.insert(i, i, start.plusSeconds(0.001 * (i % 10)));
+
+    size_t total = 0;
+    auto onExpire = [&] (int key, Value & value) { return Date(); };
+
+    for (;;) {
+        auto stats = wheel.expire(onExpire, start.plusSeconds(1.0), 64);
+        BOOST_CHECK_LE(stats.numExpired, 64);
+        total += stats.numExpired;
+        if (stats.done) break;
+    }
+
+    BOOST_CHECK_EQUAL(total, 1000);
+    BOOST_CHECK(wheel.empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_timer_wheel_reschedule_from_callback )
+{
+    TimerWheel<int, Value> wheel(0.001, start);
+    wheel.insert(1, 0, start.plusSeconds(0.001));
+
+    // Keep the entry alive three times, as the blacklist does
+    auto onExpire = [&] (int key, Value & value)
+        {
+            if (++value.i == 3)
+                return Date();
+            return start.plusSeconds(value.i * 10.0);
+        };
+
+    BOOST_CHECK_EQUAL(wheel.expire(onExpire, start.plusSeconds(5.0))
+                      .numExpired, 1);
+    BOOST_CHECK_EQUAL(wheel.size(), 1);
+    BOOST_CHECK_EQUAL(wheel.expire(onExpire, start.plusSeconds(15.0))
+                      .numExpired, 1);
+    BOOST_CHECK_EQUAL(wheel.expire(onExpire, start.plusSeconds(25.0))
+                      .numExpired, 1);
+    BOOST_CHECK(wheel.empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_timer_wheel_idle )
+{
+    TimerWheel<int, Value> wheel(0.001, start);
+
+    vector<int> expired;
+    auto onExpire = [&] (int key, Value & value)
+        {
+            expired.push_back(key);
+            return Date();
+        };
+
+    // Leave stale records behind in every level, then skip over them while
+    // the wheel is empty
+    for (int i = 0;  i < 4;  ++i)
+        wheel.insert(i, i, start.plusSeconds(0.001 * (1 << (8 * i))));
+    for (int i = 0;  i < 4;  ++i)
+        wheel.erase(i);
+
+    for (double t: { 0.5, 1.0, 100.0, 100.5 })
+        BOOST_CHECK_EQUAL(wheel.expire(onExpire, start.plusSeconds(t))
+                          .numExpired, 0);
+
+    // The same keys added afterwards expire once, at their own time
+    Date now = start.plusSeconds(100.5);
+    for (int i = 0;  i < 4;  ++i)
+        wheel.insert(i, i, now.plusSeconds(0.001 * (1 << (8 * i))));
+
+    wheel.expire(onExpire, now.plusSeconds(0.300));
+    BOOST_CHECK_EQUAL(expired, vector<int>({ 0, 1 }));
+    wheel.expire(onExpire, now.plusSeconds(20000.0));
+    BOOST_CHECK_EQUAL(expired, vector<int>({ 0, 1, 2, 3 }));
+    BOOST_CHECK(wheel.empty());
+}
+
+/** Compare against a sorted index over a long random run that crosses
+    every level of the wheel.
+*/
+BOOST_AUTO_TEST_CASE( test_timer_wheel_random )
+{
+    TimerWheel<int, Value> wheel(0.001, start);
+    map<int, Date> reference;
+
+    std::mt19937 rng(1);
+    Date now = start;
+
+    for (unsigned step = 0;  step < 20000;  ++step) {
+        int key = rng() % 5000;
+        double delay = (rng() % 4 == 0)
+            ? (rng() % 100000) * 1.0 : (rng() % 1000) * 0.001;
+        Date timeout = now.plusSeconds(delay);
+
+        auto it = wheel.find(key);
+        if (it == wheel.end())
+            wheel.insert(key, key, timeout);
+        else if (rng() % 2)
+            wheel.updateTimeout(it, timeout);
+        else {
+            wheel.erase(key);
+            reference.erase(key);
+            timeout = Date();
+        }
+        if (timeout != Date())
+            reference[key] = timeout;
+
+        double elapsed = (rng() % 5000) * 0.001;
+        if (step % 100 == 0)
+            elapsed *= 100;
+        now = now.plusSeconds(elapsed);
+
+        auto onExpire = [&] (int key, Value & value)
+            {
+                BOOST_REQUIRE(reference.count(key));
+                // Expiry has the resolution of a tick
+                BOOST_REQUIRE(reference[key] < now.plusSeconds(0.001));
+                reference.erase(key);
+                return Date();
+            };
+        wheel.expire(onExpire, now);
+
+        if (step % 100 == 0) {
+            for (auto & r: reference)
+                BOOST_REQUIRE_MESSAGE(r.second.plusSeconds(0.001) > now,
+                                      "key " << r.first << " not expired");
+        }
+        BOOST_REQUIRE_EQUAL(wheel.size(), reference.size());
+    }
+}
@@ -0,0 +1,313 @@
+/* timer_wheel.h                                                   -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Map of entries with an expiry, indexed by a hierarchical timer wheel.
+*/
+
+#ifndef __rtb_router__timer_wheel_h__
+#define __rtb_router__timer_wheel_h__
+
+#include "soa/types/date.h"
+#include "jml/arch/exception.h"
+#include <unordered_map>
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+
+namespace RTBKIT {
+
+using Datacratic::Date;
+
+
+/*****************************************************************************/
+/* TIMER WHEEL                                                               */
+/*****************************************************************************/
+
+/** Map from a key to a value with an expiry date, with the same interface
+    as TimeoutMap.
+
+    Expiries are kept in a hierarchical timer wheel (four levels of 256
+    slots each, by default a millisecond per tick) instead of a sorted
+    index, so that inserting, rescheduling and removing an entry are
+    constant time and expiry can be done in bounded slices: expire() can
+    be told to stop after a given number of entries and picks up where it
+    left off on the next call.
+
+    Entries removed or rescheduled before they expire leave a stale record
+    in their old slot, which is dropped when that slot is reached.
+
+    Each expired entry is passed to the callback, which returns Date() to
+    have it removed or a new expiry to keep it.
+*/
+
+template<typename Key, typename Value, typename Hash = std::hash<Key> >
+struct TimerWheel {
+
+    enum {
+        BITS_PER_LEVEL = 8,
+        SLOTS_PER_LEVEL = 1 << BITS_PER_LEVEL,
+        NUM_LEVELS = 4
+    };
+
+    /** Create a wheel whose ticks are the given number of seconds long,
+        starting at the given time.
+    */
+    TimerWheel(double resolution = 0.001, Date start = Date::now())
+        : resolution(resolution),
+          currentTick(toTick(start)),
+          nextSeq(0),
+          numRecords(0)
+    {
+        if (resolution <= 0.0)
+            throw ML::Exception("invalid timer wheel resolution");
+        for (auto & level: levels)
+            level.resize(SLOTS_PER_LEVEL);
+    }
+
+    struct Node : public Value {
+        Node(const Value & value, Date timeout, uint64_t seq)
+            : Value(value), timeout(timeout), seq(seq)
+        {
+        }
+
+        Date timeout;
+        uint64_t seq;   ///< Identifies the live record in the wheel
+    };
+
+    typedef std::unordered_map<Key, Node, Hash> Nodes;
+    typedef typename Nodes::iterator iterator;
+    typedef typename Nodes::const_iterator const_iterator;
+
+    /** Result of a call to expire(). */
+    struct ExpiryStats {
+        ExpiryStats()
+            : numExpired(0), maxLateness(0.0), done(true)
+        {
+        }
+
+        size_t numExpired;
+        double maxLateness;  ///< Seconds past its expiry of the latest entry
+        bool done;           ///< False if there are more entries due
+    };
+
+    iterator begin() { return nodes.begin(); }
+    iterator end() { return nodes.end(); }
+    const_iterator begin() const { return nodes.begin(); }
+    const_iterator end() const { return nodes.end(); }
+
+    size_t size() const { return nodes.size(); }
+    bool empty() const { return nodes.empty(); }
+
+    iterator find(const Key & key) { return nodes.find(key); }
+    const_iterator find(const Key & key) const { return nodes.find(key); }
+    size_t count(const Key & key) const { return nodes.count(key); }
+
+    /** Insert a new entry.  It is an error for the key to already exist. */
+    Node & insert(const Key & key, const Value & value, Date timeout)
+    {
+        auto res = nodes.insert(std::make_pair(key, Node(value, timeout, 0)));
+        if (!res.second)
+            throw ML::Exception("TimerWheel: key already exists");
+        schedule(res.first);
+        return res.first->second;
+    }
+
+    /** Return the entry for the key, creating it with the given timeout if
+        it doesn't exist.  The timeout of an existing entry is unchanged.
+    */
+    Node & access(const Key & key, Date timeout)
+    {
+        auto it = nodes.find(key);
+        if (it != nodes.end())
+            return it->second;
+        return insert(key, Value(), timeout);
+    }
+
+    bool erase(const Key & key)
+    {
+        return nodes.erase(key);
+    }
+
+    void erase(iterator it)
+    {
+        nodes.erase(it);
+    }
+
+    void updateTimeout(iterator it, Date timeout)
+    {
+        it->second.timeout = timeout;
+        schedule(it);
+    }
+
+    void updateTimeout(const Key & key, Date timeout)
+    {
+        auto it = nodes.find(key);
+        if (it == nodes.end())
+            throw ML::Exception("TimerWheel: updating timeout of unknown key");
+        updateTimeout(it, timeout);
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        for (auto & level: levels)
+            for (auto & slot: level)
+                slot.clear();
+        numRecords = 0;
+    }
+
+    /** Expire everything that's due at the given time, without a callback.
+     */
+    ExpiryStats expire(Date now = Date::now())
+    {
+        return expire([] (const Key &, Value &) { return Date(); }, now);
+    }
+
+    /** Pass the entries that expire up to the given time to the callback,
+        stopping after maxEntries of them.
+    */
+    template<typename Callback>
+    ExpiryStats expire(const Callback & callback, Date now = Date::now(),
+                       size_t maxEntries = std::numeric_limits<size_t>::max())
+    {
+        ExpiryStats stats;
+        uint64_t target = toTick(now);
+
+        // Nothing to expire; skip over the idle ticks.  Stale records
+        // are only left behind the first time, so the slots are only
+        // walked then.
+        if (nodes.empty() && currentTick < target) {
+            if (numRecords != 0)
+                clear();
+            currentTick = target;
+        }
+
+        while (currentTick <= target) {
+            Slot & slot = levels[0][currentTick % SLOTS_PER_LEVEL];
+
+            while (!slot.empty()) {
+                if (stats.numExpired == maxEntries) {
+                    stats.done = false;
+                    return stats;
+                }
+
+                Record record = slot.back();
+                slot.pop_back();
+                --numRecords;
+
+                auto it = nodes.find(record.key);
+                if (it == nodes.end() || it->second.seq != record.seq)
+                    continue;  // removed or rescheduled
+
+                ++stats.numExpired;
+                stats.maxLateness
+                    = std::max(stats.maxLateness,
+                               it->second.timeout.secondsUntil(now));
+
+                // The callback may insert into the map, which invalidates
+                // iterators but not references.
+                Date newTimeout = callback(it->first, it->second);
+
+                it = nodes.find(record.key);
+                if (it == nodes.end() || it->second.seq != record.seq)
+                    continue;  // the callback dealt with it
+
+                if (newTimeout == Date())
+                    nodes.erase(it);
+                else updateTimeout(it, newTimeout);
+            }
+
+            // Stay on the current tick, as more can be added to it
+            if (currentTick == target)
+                break;
+
+            ++currentTick;
+            cascade();
+        }
+
+        return stats;
+    }
+
+private:
+    struct Record {
+        Key key;
+        uint64_t seq;
+    };
+
+    typedef std::vector<Record> Slot;
+
+    double resolution;
+    uint64_t currentTick;
+    uint64_t nextSeq;
+    size_t numRecords;  ///< Records in the slots, including stale ones
+    Nodes nodes;
+    std::vector<Slot> levels[NUM_LEVELS];
+
+    uint64_t toTick(Date date) const
+    {
+        double ticks = std::floor(date.secondsSinceEpoch() / resolution);
+        return ticks > 0 ? ticks : 0;
+    }
+
+    /** Put a record for the node in the slot for its timeout.  Anything
+        already due goes in the current slot.  Otherwise it goes in the
+        lowest level that shares the current tick's higher order digits,
+        so that it is cascaded down when the wheel reaches it.
+    */
+    void schedule(iterator it)
+    {
+        it->second.seq = ++nextSeq;
+        place(Record{ it->first, it->second.seq }, toTick(it->second.timeout));
+    }
+
+    void place(const Record & record, uint64_t tick)
+    {
+        ++numRecords;
+
+        if (tick <= currentTick) {
+            levels[0][currentTick % SLOTS_PER_LEVEL].push_back(record);
+            return;
+        }
+
+        int level = 0;
+        while (level < NUM_LEVELS - 1
+               && (tick >> (BITS_PER_LEVEL * (level + 1)))
+                   != (currentTick >> (BITS_PER_LEVEL * (level + 1))))
+            ++level;
+
+        unsigned slot = (tick >> (BITS_PER_LEVEL * level)) % SLOTS_PER_LEVEL;
+        levels[level][slot].push_back(record);
+    }
+
+    /** Called as the current tick advances.  When a level's digit rolls
+        over, the records in its new slot are redistributed to the levels
+        below; higher levels go first as they feed the lower ones.
+    */
+    void cascade()
+    {
+        for (int level = NUM_LEVELS - 1;  level > 0;  --level) {
+            uint64_t lowBits = (uint64_t(1) << (BITS_PER_LEVEL * level)) - 1;
+            if (currentTick & lowBits)
+                continue;
+
+            unsigned index = (currentTick >> (BITS_PER_LEVEL * level))
+                % SLOTS_PER_LEVEL;
+            Slot records;
+            records.swap(levels[level][index]);
+            numRecords -= records.size();
+
+            for (auto & record: records) {
+                auto it = nodes.find(record.key);
+                if (it == nodes.end() || it->second.seq != record.seq)
+                    continue;
+                place(record, toTick(it->second.timeout));
+            }
+        }
+    }
+};
+
+} // namespace RTBKIT
+
+#endif /* __rtb_router__timer_wheel_h__ */
@@ -75,6 +75,9 @@ int main(int argc, char * argv[])
     eventsOutput->open("./logs/%F/events-%F-%T.log", rotationInterval);
     logger.addOutput(eventsOutput, boost::regex("WIN|CLICK|EXTERNALWIN"), boost::regex());
 
+    // The ad server publishes these as binary events
+    logger.forwardBinaryEventsAsText = true;
+
     logger.unsafeDisableMonitor();
     logger.connectAllServiceProviders("adServer", "logger");
     logger.start();
@@ -13,6 +13,7 @@
 #include "rtbkit/core/agent_configuration/agent_config.h"
 #include "rtbkit/plugins/augmentor/augmentor_base.h"
 #include "rtbkit/common/bid_request.h"
+#include "rtbkit/common/binary_event_log.h"
 #include "soa/service/zmq_named_pub_sub.h"
 #include "jml/utils/exc_assert.h"
 
@@ -104,21 +105,34 @@ init()
 
     palEvents.init(getServices()->config);
 
-    /* This lambda will get called when the post auction loop receives a win
-       on an auction.
+    /* This lambda will get called with each batch of events logged by the
+       post auction loop; we're only interested in its wins.  Decoded as
+       text, the events have the fields the MATCHEDWIN messages used to have.
     */
     palEvents.messageHandler = [&] (const vector<zmq::message_t>& msg)
         {
-            RTBKIT::AccountKey account(msg[19].toString());
-            RTBKIT::UserIds uids =
-                RTBKIT::UserIds::createFromString(msg[15].toString());
+            if (msg.size() != 2) return;
 
-            storage->inc(account, uids);
-            recordHit("wins");
+            auto onEvent = [&] (const RTBKIT::BinaryEvent & event)
+                {
+                    if (event.channelStr() != "MATCHEDWIN") return;
+                    vector<string> fields = event.toText();
+
+                    RTBKIT::AccountKey account(fields.at(19));
+                    RTBKIT::UserIds uids =
+                        RTBKIT::UserIds::createFromString(fields.at(15));
+
+                    storage->inc(account, uids);
+                    recordHit("wins");
+                };
+
+            RTBKIT::forEachBinaryEvent((const char *)msg[1].data(),
+                                       msg[1].size(), onEvent);
         };
 
     palEvents.connectAllServiceProviders(
-            "rtbPostAuctionService", "logger", {"MATCHEDWIN"});
+            "rtbPostAuctionService", "logger",
+            { RTBKIT::BinaryEventChannel });
     addSource("FrequencyCapAugmentor::palEvents", palEvents);
 }
 
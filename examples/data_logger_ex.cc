@@ -45,7 +45,8 @@ void
 setupOutputs(
         DataLogger& logger,
         const string& logDir,
-        const string& rotationInterval)
+        const string& rotationInterval,
+        const string& binaryFile)
 {
 
     // Log the various error messages generated by our stack to the a log file.
@@ -79,6 +80,20 @@ setupOutputs(
     logger.addOutput(
             strategyOutput,
             boost::regex("MATCHEDWIN|MATCHEDIMPRESSION|MATCHEDCLICK"));
+
+    // The post auction loop publishes these as binary events, so they need
+    // to be decoded for the outputs above.
+    logger.forwardBinaryEventsAsText = true;
+
+
+    // Keep every event of the router and the post auction loop in a block
+    // compressed binary file that can be read back a time range at a time
+    // (see binary_event_log_to_text).
+    if (!binaryFile.empty()) {
+        auto binaryOutput = make_shared<BinaryEventFileOutput>();
+        binaryOutput->open(logDir + "/" + binaryFile);
+        logger.addBinaryOutput(binaryOutput);
+    }
 }
 
 
@@ -91,6 +106,7 @@ int main (int argc, char** argv)
     ServiceProxyArguments serviceArgs;
     string logDir = "data_logger";
     string rotationInterval = "1h";
+    string binaryFile;
 
     using namespace boost::program_options;
 
@@ -99,7 +115,10 @@ int main (int argc, char** argv)
         ("log-dir,d", value<string>(&logDir),
                 "Directory where the folders should be stored.")
         ("rotation-interval,r", value<string>(&rotationInterval),
-                "Interval between each log rotation.");
+                "Interval between each log rotation.")
+        ("binary-file,b", value<string>(&binaryFile),
+                "File of the log directory to also write the binary events "
+                "to.");
 
     options_description allOptions;
     allOptions.add(loggerOptions).add(serviceArgs.makeProgramOptions());
@@ -119,7 +138,7 @@ int main (int argc, char** argv)
     // Initialize the logger and it's outputs.
     DataLogger logger("data_logger", serviceProxies);
     logger.init();
-    setupOutputs(logger, logDir, rotationInterval);
+    setupOutputs(logger, logDir, rotationInterval, binaryFile);
 
     // Subscribe to the message stream coming from the adServer, the router and
     // the post auction loop.
@@ -164,8 +164,9 @@ struct AuctionJS
         HandleScope scope;
         try {
             const auto & auction = *getShared(info.This());
+            // The router may still be recording responses
             vector<vector<Auction::Response> > responses
-                = auction.getResponses();
+                = auction.getSnapshot().responses;
 
             vector<vector<Json::Value> > respjson(responses.size());
             for (unsigned spotNum = 0;  spotNum < responses.size();
@@ -15,6 +15,7 @@
 #include <boost/make_shared.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include "rtbkit/openrtb/openrtb_parsing.h"
+#include "node_buffer.h"
 
 
 using namespace std;
@@ -40,6 +41,49 @@ void to_js(JS::JSValue & value, const Format & f)
 }
 
 
+/*****************************************************************************/
+/* PROPERTY CACHE                                                            */
+/*****************************************************************************/
+
+/* The objects handed out for the nested parts of a bid request (segments,
+   user ids, structures and arrays) are views over the C++ object, so the
+   one made the first time a property is read stays valid and can be handed
+   out again instead of being rebuilt on every read.  They are kept as
+   hidden values of the object they were read from; a setter that replaces
+   the underlying value drops its entry.
+*/
+
+template<typename Fn>
+v8::Handle<v8::Value>
+getCachedProperty(const v8::Handle<v8::Object> & This,
+                  const v8::Handle<v8::String> & property,
+                  const Fn & compute)
+{
+    v8::Local<v8::Value> cached = This->GetHiddenValue(property);
+    if (!cached.IsEmpty())
+        return cached;
+
+    v8::Handle<v8::Value> result = compute();
+
+    // Only wrapped C++ objects (which have internal fields) are views onto
+    // the request.  Scalars and plain objects, like those converted from
+    // JSON, are copies; caching them would hand out stale values once the
+    // field changes, so they are converted on every read.
+    if (!result.IsEmpty() && result->IsObject()
+        && v8::Handle<v8::Object>::Cast(result)->InternalFieldCount() > 0)
+        This->SetHiddenValue(property, result);
+
+    return result;
+}
+
+void
+dropCachedProperty(const v8::Handle<v8::Object> & This,
+                   const v8::Handle<v8::String> & property)
+{
+    This->DeleteHiddenValue(property);
+}
+
+
 /*****************************************************************************/
 /* SEGMENT LIST JS                                                           */
 /*****************************************************************************/
@@ -101,6 +145,11 @@ struct SegmentListJS
             ->SetAccessor(String::NewSymbol("length"), lengthGetter,
                           0, v8::Handle<v8::Value>(), DEFAULT,
                           PropertyAttribute(ReadOnly | DontEnum | DontDelete));
+
+        t->InstanceTemplate()
+            ->SetAccessor(String::NewSymbol("ints"), intsGetter,
+                          0, v8::Handle<v8::Value>(), DEFAULT,
+                          PropertyAttribute(ReadOnly | DontEnum | DontDelete));
                           
         t->InstanceTemplate()
             ->SetIndexedPropertyHandler(getIndexed, setIndexed, queryIndexed,
@@ -261,6 +310,38 @@ struct SegmentListJS
             return v8::Integer::New(getShared(info.This())->size());
         } HANDLE_JS_EXCEPTIONS;
     }
+
+    /** Integer segments as an indexed object over a Buffer that holds a
+        copy of them.  The copy is owned by the returned object, so it
+        stays valid (and writing to it has no effect on the list) whatever
+        happens to the list afterwards.  Being a copy, it isn't cached.
+    */
+    static v8::Handle<v8::Value>
+    intsGetter(v8::Local<v8::String> property,
+               const AccessorInfo & info)
+    {
+        try {
+            auto segs = getShared(info.This());
+            size_t n = segs->ints.size();
+
+            node::Buffer * buffer = node::Buffer::New(n * sizeof(int));
+            if (n)
+                memcpy(node::Buffer::Data(buffer), &segs->ints[0],
+                       n * sizeof(int));
+
+            static int empty = 0;
+            void * data = n ? node::Buffer::Data(buffer) : &empty;
+
+            v8::Local<v8::Object> result = v8::Object::New();
+            result->SetIndexedPropertiesToExternalArrayData
+                (data, kExternalIntArray, n);
+            result->Set(String::NewSymbol("length"), v8::Integer::New(n),
+                        PropertyAttribute(ReadOnly | DontEnum));
+            result->SetHiddenValue(String::NewSymbol("buffer"),
+                                   buffer->handle_);
+            return result;
+        } HANDLE_JS_EXCEPTIONS;
+    }
 };
 
 std::shared_ptr<SegmentList>
@@ -303,15 +384,20 @@ from_js(const JSValue & value, SegmentList *)
 
 void to_js(JS::JSValue & value, const UserIds & uids)
 {
-    to_js(value, static_cast<const std::map<std::string, Id> &>(uids));
+    std::map<std::string, Id> ids;
+    for (auto & entry: uids)
+        ids[entry.first.str()] = entry.second;
+    to_js(value, ids);
 }
 
 UserIds 
 from_js(const JSValue & value, UserIds *)
 {
+    auto ids = from_js(value, (std::map<std::string, Id> *)0);
+
     UserIds result;
-    static_cast<std::map<std::string, Id> &>(result)
-        = from_js(value, (std::map<std::string, Id> *)0);
+    for (auto & entry: ids)
+        result.add(entry.second, entry.first);
     return result;
 }
 
@@ -365,9 +451,14 @@ struct SegmentsBySourceJS
             SegmentsBySource * segs = getShared(info.This());
 
             string strIdx = to_string(index);
-            return (segs->count(strIdx) > 0
-                    ? JS::toJS(segs->at(strIdx))
-                    : NULL_HANDLE);
+            auto source = InternedName::find(strIdx);
+            if (!segs->count(source))
+                return NULL_HANDLE;
+
+            auto getList = [&] () { return JS::toJS(segs->at(source)); };
+            return getCachedProperty(info.This(),
+                                     v8::String::New(strIdx.c_str()),
+                                     getList);
         } HANDLE_JS_EXCEPTIONS;
     }
 
@@ -388,7 +479,7 @@ struct SegmentsBySourceJS
         SegmentsBySource * segs = getShared(info.This());
 
         string strIdx = to_string(index);
-        return (segs->count(strIdx) > 0
+        return (segs->count(InternedName::find(strIdx)) > 0
                 ? v8::Integer::New(ReadOnly | DontDelete)
                 : NULL_HANDLE);
     }
@@ -424,14 +515,15 @@ struct SegmentsBySourceJS
                 return scope.Close(object_prop);
             
             // Is it a column name?
-            string name = cstr(property);
+            auto name = InternedName::find(cstr(property));
             
             SegmentsBySource * segs = getShared(info.This());
             
             if (!segs->count(name))
                 return NULL_HANDLE;
 
-            return scope.Close(JS::toJS(segs->find(name)->second));
+            auto getList = [&] () { return JS::toJS(segs->find(name)->second); };
+            return scope.Close(getCachedProperty(info.This(), property, getList));
         } HANDLE_JS_EXCEPTIONS;
     }
 
@@ -462,6 +554,7 @@ struct SegmentsBySourceJS
                 throw ML::Exception("can't set to null segments");
 
             (*segs)[name] = segs2;
+            dropCachedProperty(info.This(), property);
             
             return v8::Undefined();
         } HANDLE_JS_EXCEPTIONS;
@@ -475,7 +568,7 @@ struct SegmentsBySourceJS
             || property->IsUndefined())
             throw ML::Exception("queryNamed: invalid property");
 
-        string name = cstr(property);
+        auto name = InternedName::find(cstr(property));
 
         SegmentsBySource * segs = getShared(info.This());
         
@@ -494,10 +587,11 @@ struct SegmentsBySourceJS
             || property->IsUndefined())
             throw ML::Exception("queryNamed: invalid property");
 
-        string name = cstr(property);
+        auto name = InternedName::find(cstr(property));
 
         SegmentsBySource * segs = getShared(info.This());
 
+        dropCachedProperty(info.This(), property);
         return v8::Boolean::New(segs->erase(name));
     }
 
@@ -519,7 +613,7 @@ struct SegmentsBySourceJS
             for (auto it = segs->begin(), end = segs->end();
                  it != end;  ++it,++i) {
                 v8::Local<Integer> key = v8::Integer::New(i);
-                v8::Handle<Value>  val = JS::toJS(it->first);
+                v8::Handle<Value>  val = JS::toJS(it->first.str());
                 result->Set(key, val);
             }
             
@@ -583,7 +677,7 @@ struct UserIdsJS
                 return scope.Close(object_prop);
             
             // Is it a column name?
-            string name = cstr(property);
+            auto name = InternedName::find(cstr(property));
             
             UserIds * ids = getShared(info.This());
             
@@ -633,7 +727,7 @@ struct UserIdsJS
             || property->IsUndefined())
             throw ML::Exception("queryNamed: invalid property");
 
-        string name = cstr(property);
+        auto name = InternedName::find(cstr(property));
 
         UserIds * ids = getShared(info.This());
         
@@ -652,7 +746,7 @@ struct UserIdsJS
             || property->IsUndefined())
             throw ML::Exception("queryNamed: invalid property");
 
-        string name = cstr(property);
+        auto name = InternedName::find(cstr(property));
 
         UserIds * ids = getShared(info.This());
 
@@ -677,7 +771,7 @@ struct UserIdsJS
             for (auto it = ids->begin(), end = ids->end();
                  it != end;  ++it,++i) {
                 v8::Local<Integer> key = v8::Integer::New(i);
-                v8::Handle<Value>  val = JS::toJS(it->first);
+                v8::Handle<Value>  val = JS::toJS(it->first.str());
                 result->Set(key, val);
             }
             
@@ -1070,6 +1164,24 @@ struct Init {
 
 } // file scope
 
+/** Convert values of type T straight to their JS equivalent, rather than
+    printing them to JSON and converting that.
+*/
+template<typename T>
+bool
+setDirectConverter(JSConverters & converters, const ValueDescription & desc)
+{
+    if (*desc.type != typeid(T))
+        return false;
+
+    converters.toJs = [] (const void * field, std::shared_ptr<void>)
+        -> v8::Handle<v8::Value>
+        {
+            return JS::toJS(*reinterpret_cast<const T *>(field));
+        };
+    return true;
+}
+
 void
 initJsConverters(const ValueDescription & desc)
 {
@@ -1289,7 +1401,15 @@ initJsConverters(const ValueDescription & desc)
 
     //   Does it have any parent classes?
 
-    // Is it an arithmetic type?
+    // Is it an arithmetic type or a string?
+    if (!converters->toJs) {
+        setDirectConverter<std::string>(*converters, desc)
+            || setDirectConverter<bool>(*converters, desc)
+            || setDirectConverter<int>(*converters, desc)
+            || setDirectConverter<unsigned>(*converters, desc)
+            || setDirectConverter<int64_t>(*converters, desc)
+            || setDirectConverter<double>(*converters, desc);
+    }
 
     // Default goes through JSON
     if (!converters->fromJs) {
@@ -1349,11 +1469,15 @@ struct PropertyAccessViaDescription {
             const ValueDescription * vd
                 = reinterpret_cast<const ValueDescription *>
                 (v8::External::Unwrap(info.Data()));
-            auto p = Base::getSharedPtr(info.This());
-            Obj * o = p.get();
-            const StructureDescriptionBase::FieldDescription & fd
-                = vd->getField(cstr(property));
-            return getFromJs(addOffset(o, fd.offset), *fd.description, p);
+            auto getField = [&] ()
+                {
+                    auto p = Base::getSharedPtr(info.This());
+                    Obj * o = p.get();
+                    const StructureDescriptionBase::FieldDescription & fd
+                        = vd->getField(cstr(property));
+                    return getFromJs(addOffset(o, fd.offset), *fd.description, p);
+                };
+            return getCachedProperty(info.This(), property, getField);
         } HANDLE_JS_EXCEPTIONS;
     }
 
@@ -1369,6 +1493,7 @@ struct PropertyAccessViaDescription {
             Obj * o = Base::getShared(info.This());
             const StructureDescriptionBase::FieldDescription & fd
                 = vd->getField(cstr(property));
+            dropCachedProperty(info.This(), property);
             setFromJs(addOffset(o, fd.offset), value, *fd.description);
         } HANDLE_JS_EXCEPTIONS_SETTER;
     }
@@ -1532,6 +1657,15 @@ struct BidRequestJS
                     new BidRequestJS(args.This(), br);
                     
                 }
+                else if (node::Buffer::HasInstance(args[0])) {
+                    // Reconstitute from the binary form made by toBuffer()
+                    v8::Handle<v8::Object> buffer = args[0]->ToObject();
+                    string serialized(node::Buffer::Data(buffer),
+                                      node::Buffer::Length(buffer));
+                    auto br = std::make_shared<BidRequest>
+                        (BidRequest::createFromString(serialized));
+                    new BidRequestJS(args.This(), br);
+                }
                 else if (args[0]->IsString()) {
                     // Parse from a string
                     //cerr << "parse string" << endl;
@@ -1598,6 +1732,7 @@ struct BidRequestJS
 
         NODE_SET_PROTOTYPE_METHOD(t, "getSegmentsFromSource",
                                   getSegmentsFromSource);
+        NODE_SET_PROTOTYPE_METHOD(t, "toBuffer", toBuffer);
 
         t->InstanceTemplate()
             ->SetAccessor(String::NewSymbol("segments"), segmentsGetter,
@@ -1633,18 +1768,46 @@ struct BidRequestJS
         } HANDLE_JS_EXCEPTIONS;
     }
 
+    static void
+    freeSerialized(char * data, void * hint)
+    {
+        delete reinterpret_cast<std::string *>(hint);
+    }
+
+    /** Return the request in its binary serialized form, as a Buffer that
+        takes over the serialized string rather than copying it.
+    */
+    static Handle<v8::Value>
+    toBuffer(const Arguments & args)
+    {
+        try {
+            std::unique_ptr<std::string> serialized
+                (new std::string(getShared(args.This())->serializeToString()));
+            node::Buffer * buffer
+                = node::Buffer::New(const_cast<char *>(serialized->data()),
+                                    serialized->size(),
+                                    freeSerialized, serialized.get());
+            serialized.release();
+            return buffer->handle_;
+        } HANDLE_JS_EXCEPTIONS;
+    }
+
     static v8::Handle<v8::Value>
     segmentsGetter(v8::Local<v8::String> property,
                   const v8::AccessorInfo & info)
     {
         try {
-            v8::Handle<v8::Value> segs
-                = SegmentsBySourceJS::toJS
-                (ML::make_unowned_std_sp(getShared(info.This())->segments));
-            SegmentsBySourceJS * wrapper
-                = SegmentsBySourceJS::getWrapper(segs);
-            wrapper->owner_ = getSharedPtr(info.This());
-            return segs;
+            auto getSegments = [&] ()
+                {
+                    v8::Handle<v8::Value> segs
+                        = SegmentsBySourceJS::toJS
+                        (ML::make_unowned_std_sp(getShared(info.This())->segments));
+                    SegmentsBySourceJS * wrapper
+                        = SegmentsBySourceJS::getWrapper(segs);
+                    wrapper->owner_ = getSharedPtr(info.This());
+                    return segs;
+                };
+            return getCachedProperty(info.This(), property, getSegments);
         } HANDLE_JS_EXCEPTIONS;
     }
 
@@ -1654,6 +1817,7 @@ struct BidRequestJS
                   const v8::AccessorInfo & info)
     {
         try {
+            dropCachedProperty(info.This(), property);
             if (SegmentsBySourceJS::tmpl->HasInstance(value)) {
                 getShared(info.This())->segments
                     = *SegmentsBySourceJS::getShared(value);
@@ -1675,13 +1839,17 @@ struct BidRequestJS
                   const v8::AccessorInfo & info)
     {
         try {
-            v8::Handle<v8::Value> segs
-                = SegmentsBySourceJS::toJS
-                (ML::make_unowned_std_sp(getShared(info.This())->restrictions));
-            SegmentsBySourceJS * wrapper
-                = SegmentsBySourceJS::getWrapper(segs);
-            wrapper->owner_ = getSharedPtr(info.This());
-            return segs;
+            auto getRestrictions = [&] ()
+                {
+                    v8::Handle<v8::Value> segs
+                        = SegmentsBySourceJS::toJS
+                        (ML::make_unowned_std_sp(getShared(info.This())->restrictions));
+                    SegmentsBySourceJS * wrapper
+                        = SegmentsBySourceJS::getWrapper(segs);
+                    wrapper->owner_ = getSharedPtr(info.This());
+                    return segs;
+                };
+            return getCachedProperty(info.This(), property, getRestrictions);
         } HANDLE_JS_EXCEPTIONS;
     }
 
@@ -1691,6 +1859,7 @@ struct BidRequestJS
                        const v8::AccessorInfo & info)
     {
         try {
+            dropCachedProperty(info.This(), property);
             if (SegmentsBySourceJS::tmpl->HasInstance(value)) {
                 getShared(info.This())->restrictions
                     = *SegmentsBySourceJS::getShared(value);
@@ -1712,8 +1881,12 @@ struct BidRequestJS
                   const v8::AccessorInfo & info)
     {
         try {
-            auto owner = getSharedPtr(info.This());
-            return UserIdsJS::toJS(owner->userIds, owner);
+            auto getUserIds = [&] ()
+                {
+                    auto owner = getSharedPtr(info.This());
+                    return UserIdsJS::toJS(owner->userIds, owner);
+                };
+            return getCachedProperty(info.This(), property, getUserIds);
         } HANDLE_JS_EXCEPTIONS;
     }
 
@@ -1747,8 +1920,12 @@ struct BidRequestJS
                   const v8::AccessorInfo & info)
     {
         try {
-            auto owner = getSharedPtr(info.This());
-            return LocationJS::toJS(owner->location, owner);
+            auto getLocation = [&] ()
+                {
+                    auto owner = getSharedPtr(info.This());
+                    return LocationJS::toJS(owner->location, owner);
+                };
+            return getCachedProperty(info.This(), property, getLocation);
         } HANDLE_JS_EXCEPTIONS;
     }
 
@@ -15,3 +15,5 @@ $(eval $(call library,mock_adserver,mock_adserver_connector.cc mock_win_source.c
 $(eval $(call library,standard_adserver,standard_adserver_connector.cc standard_win_source.cc,adserver_connector bid_test_utils))
 $(eval $(call program,adserver_runner,adserver_connector boost_program_options services))
 
+
+$(eval $(call include_sub_make,adserver_testing,testing,adserver_testing.mk))
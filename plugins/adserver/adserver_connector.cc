@@ -43,21 +43,8 @@ init(shared_ptr<ConfigurationService> config)
     registerServiceProvider(serviceName_, { "adServer" });
     services->config->removePath(serviceName());
 
-    toPostAuctionService_.init(config, ZMQ_XREQ);
-    toPostAuctionService_.connectToServiceClass("rtbPostAuctionService",
-                                                "events");
-
-#if 0 // later, for when we have multiple
-
-    toPostAuctionServices_.init(getServices()->config, name);
-    toPostAuctionServices_.connectHandler = [=] (const string & connectedTo) {
-        cerr << "AdServerConnector is connected to post auction service "
-        << connectedTo << endl;
-    };
-    toPostAuctionServices_.connectAllServiceProviders("rtbPostAuctionService",
-                                                      "agents");
-    toPostAuctionServices_.connectToServiceClass();
-#endif
+    toPostAuctionService_.init(config);
+    toPostAuctionService_.connect("events");
 }
 
 void
@@ -108,7 +95,7 @@ publishWin(const Id & auctionId,
     event.bidTimestamp = bidTimestamp;
 
     string str = ML::DB::serializeToString(event);
-    toPostAuctionService_.sendMessage("WIN", str);
+    toPostAuctionService_.sendMessage(auctionId, "WIN", str);
 }
 
 void
@@ -133,7 +120,7 @@ publishLoss(const Id & auctionId,
     event.bidTimestamp = bidTimestamp;
 
     string str = ML::DB::serializeToString(event);
-    toPostAuctionService_.sendMessage("LOSS", str);
+    toPostAuctionService_.sendMessage(auctionId, "LOSS", str);
 }
 
 void
@@ -158,7 +145,7 @@ publishCampaignEvent(const string & label,
     event.metadata = impressionMeta;
 
     string str = ML::DB::serializeToString(event);
-    toPostAuctionService_.sendMessage("EVENT", str);
+    toPostAuctionService_.sendMessage(auctionId, "EVENT", str);
 }
 
 void
@@ -15,6 +15,7 @@
 #include "rtbkit/common/json_holder.h"
 #include "rtbkit/common/bid_request.h"
 #include "rtbkit/common/account_key.h"
+#include "rtbkit/common/post_auction_proxy.h"
 
 
 namespace RTBKIT {
@@ -95,11 +96,9 @@ struct AdServerConnector : public Datacratic::ServiceBase {
     static void registerFactory(std::string const & name, Factory factory);
 
 private:
-    // Connection to the post auction loops
-    ZmqNamedProxy toPostAuctionService_;
-
-    // later... when we have multiple services
-    //ZmqMultipleNamedClientBusProxy toPostAuctionServices;
+    // Connection to the post auction loops; messages are routed to the
+    // shard that owns the auction
+    PostAuctionProxy toPostAuctionService_;
 };
 
 } // namespace RTBKIT
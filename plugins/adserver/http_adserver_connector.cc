@@ -19,15 +19,38 @@ using namespace RTBKIT;
 
 HttpAdServerConnectionHandler::
 HttpAdServerConnectionHandler(HttpAdServerHttpEndpoint & endpoint,
-                              const HttpAdServerRequestCb & requestCb)
-    : endpoint_(endpoint), requestCb_(requestCb)
+                              const HttpAdServerRequestCb & requestCb,
+                              const HttpAdServerPayloadCb & payloadCb)
+    : endpoint_(endpoint), requestCb_(requestCb), payloadCb_(payloadCb)
 {
 }
 
+void
+HttpAdServerConnectionHandler::
+handleHttpPayload(const HttpHeader & header, const string & payload)
+{
+    if (!payloadCb_) {
+        JsonConnectionHandler::handleHttpPayload(header, payload);
+        return;
+    }
+
+    auto handler = [&] () { this->payloadCb_(header, payload); };
+    processRequest(handler, payload);
+}
+
 void
 HttpAdServerConnectionHandler::
 handleJson(const HttpHeader & header, const Json::Value & json,
            const string & jsonStr)
+{
+    auto handler = [&] () { this->requestCb_(header, json, jsonStr); };
+    processRequest(handler, jsonStr);
+}
+
+void
+HttpAdServerConnectionHandler::
+processRequest(const std::function<void ()> & handler,
+               const string & rqStr)
 {
     string resultMsg;
 
@@ -43,20 +66,20 @@ handleJson(const HttpHeader & header, const Json::Value & json,
     };
 
     try {
-        requestCb_(header, json, jsonStr);
+        handler();
         resultMsg = ("HTTP/1.1 200 OK\r\n"
                      "Content-Type: none\r\n"
                      "Content-Length: 0\r\n"
                      "\r\n");
     }
     catch (const exception & exc) {
-        cerr << "error parsing adserver request " << json << ": "
+        cerr << "error parsing adserver request " << rqStr << ": "
              << exc.what() << endl;
         endpoint_.doEvent("error.rqParsingError");
 
         Json::Value responseJson;
         responseJson["error"] = "error parsing AdServer message";
-        responseJson["message"] = json;
+        responseJson["message"] = rqStr;
         responseJson["details"] = exc.what();
 
         string response = responseJson.toString();
@@ -84,12 +107,20 @@ HttpAdServerHttpEndpoint(int port, const HttpAdServerRequestCb & requestCb)
 {
 }
 
+HttpAdServerHttpEndpoint::
+HttpAdServerHttpEndpoint(int port, const HttpAdServerPayloadCb & payloadCb)
+    : HttpEndpoint("adserver-ep-" + to_string(port)),
+      port_(port), payloadCb_(payloadCb)
+{
+}
+
 HttpAdServerHttpEndpoint::
 HttpAdServerHttpEndpoint(HttpAdServerHttpEndpoint && otherEndpoint)
 : HttpEndpoint("adserver-ep-" + to_string(otherEndpoint.port_))
 {
     port_ = otherEndpoint.port_;
     requestCb_ = otherEndpoint.requestCb_;
+    payloadCb_ = otherEndpoint.payloadCb_;
 }
 
 HttpAdServerHttpEndpoint::
@@ -105,6 +136,7 @@ operator = (const HttpAdServerHttpEndpoint& other)
     if (this != &other) {
         port_ = other.port_;
         requestCb_ = other.requestCb_;
+        payloadCb_ = other.payloadCb_;
     }
 
     return *this;
@@ -122,7 +154,8 @@ shared_ptr<ConnectionHandler>
 HttpAdServerHttpEndpoint::
 makeNewHandler()
 {
-    return std::make_shared<HttpAdServerConnectionHandler>(*this, requestCb_);
+    return std::make_shared<HttpAdServerConnectionHandler>(*this, requestCb_,
+                                                           payloadCb_);
 }
 
 
@@ -144,6 +177,13 @@ registerEndpoint(int port, const HttpAdServerRequestCb & requestCb)
     endpoints_.emplace_back(port, requestCb);
 }
 
+void
+HttpAdServerConnector::
+registerPayloadEndpoint(int port, const HttpAdServerPayloadCb & payloadCb)
+{
+    endpoints_.emplace_back(port, payloadCb);
+}
+
 void
 HttpAdServerConnector::
 init(const shared_ptr<ConfigurationService> & config)
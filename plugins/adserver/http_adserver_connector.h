@@ -28,10 +28,21 @@ typedef std::function<void (const HttpHeader & header,
                             const std::string & jsonStr)>
     HttpAdServerRequestCb;
 
+/** Callback that receives the raw body of the request, for handlers that
+    parse it themselves instead of going through a Json::Value.
+*/
+typedef std::function<void (const HttpHeader & header,
+                            const std::string & payload)>
+    HttpAdServerPayloadCb;
+
 struct HttpAdServerConnectionHandler
     : public Datacratic::JsonConnectionHandler {
     HttpAdServerConnectionHandler(HttpAdServerHttpEndpoint & endpoint,
-                                  const HttpAdServerRequestCb & requestCb);
+                                  const HttpAdServerRequestCb & requestCb,
+                                  const HttpAdServerPayloadCb & payloadCb);
+
+    virtual void handleHttpPayload(const HttpHeader & header,
+                                   const std::string & payload);
 
     virtual void handleJson(const HttpHeader & header,
                             const Json::Value & json,
@@ -40,6 +51,14 @@ struct HttpAdServerConnectionHandler
 private:
     HttpAdServerHttpEndpoint & endpoint_;
     const HttpAdServerRequestCb & requestCb_;
+    const HttpAdServerPayloadCb & payloadCb_;
+
+    /** Run the request handler and send back a 200, or a 400 describing
+        the error if it threw.  The connection stays open for the next
+        request.
+    */
+    void processRequest(const std::function<void ()> & handler,
+                        const std::string & rqStr);
 };
 
 
@@ -50,6 +69,8 @@ private:
 struct HttpAdServerHttpEndpoint : public Datacratic::HttpEndpoint {
     HttpAdServerHttpEndpoint(int port,
                              const HttpAdServerRequestCb & requestCb);
+    HttpAdServerHttpEndpoint(int port,
+                             const HttpAdServerPayloadCb & payloadCb);
     HttpAdServerHttpEndpoint(HttpAdServerHttpEndpoint && otherEndpoint);
 
     ~HttpAdServerHttpEndpoint();
@@ -80,6 +101,7 @@ struct HttpAdServerHttpEndpoint : public Datacratic::HttpEndpoint {
 private:
     int port_;
     HttpAdServerRequestCb requestCb_;
+    HttpAdServerPayloadCb payloadCb_;
 };
         
 /****************************************************************************/
@@ -96,6 +118,12 @@ struct HttpAdServerConnector : public AdServerConnector {
 
     void registerEndpoint(int port, const HttpAdServerRequestCb & requestCb);
 
+    /** Register an endpoint whose handler receives the raw request body
+        instead of a parsed Json::Value.
+    */
+    void registerPayloadEndpoint(int port,
+                                 const HttpAdServerPayloadCb & payloadCb);
+
     void init(const std::shared_ptr<ConfigurationService> & config);
     void shutdown();
 
@@ -6,6 +6,7 @@
 #include "rtbkit/common/account_key.h"
 #include "rtbkit/common/currency.h"
 #include "rtbkit/common/json_holder.h"
+#include "jml/utils/json_parsing.h"
 
 #include "standard_adserver_connector.h"
 
@@ -17,6 +18,89 @@ using namespace boost::program_options;
 using namespace RTBKIT;
 
 
+namespace {
+
+/** Skip over the JSON value at the current position without building it. */
+void skipJsonValue(ML::Parse_Context & context)
+{
+    skipJsonWhitespace(context);
+
+    if (*context == '{') {
+        expectJsonObject(context, [] (const std::string & key,
+                                      ML::Parse_Context & context) {
+                skipJsonValue(context);
+            });
+    }
+    else if (*context == '[') {
+        expectJsonArray(context, [] (int index, ML::Parse_Context & context) {
+                skipJsonValue(context);
+            });
+    }
+    else if (context.match_literal('"')) {
+        while (!context.match_literal('"')) {
+            if (context.eof())
+                context.exception("unterminated JSON string");
+            if (*context == '\\')
+                ++context;
+            ++context;
+        }
+    }
+    else if (!context.match_literal("null")
+             && !context.match_literal("true")
+             && !context.match_literal("false"))
+        context.expect_double();
+}
+
+/** Return the text of the JSON value at the current position, as a slice of
+    the request body.
+*/
+std::string expectRawJson(ML::Parse_Context & context,
+                          const std::string & payload)
+{
+    skipJsonWhitespace(context);
+    size_t start = context.get_offset();
+    skipJsonValue(context);
+    return payload.substr(start, context.get_offset() - start);
+}
+
+/** Call onObject for each notification of a request body, which is either
+    a single JSON object or an array of objects.  onObject is given each
+    field of the object in turn; onDone is called once an object is
+    complete.
+*/
+void forEachNotification(const std::string & payload,
+                         const std::function<void (const std::string &,
+                                                   ML::Parse_Context &)>
+                         & onField,
+                         const std::function<void ()> & onDone)
+{
+    ML::Parse_Context context("payload", payload.c_str(), payload.size());
+    skipJsonWhitespace(context);
+
+    auto onObject = [&] (ML::Parse_Context & context) {
+        expectJsonObject(context, onField);
+        onDone();
+    };
+
+    if (*context == '[') {
+        expectJsonArray(context, [&] (int index, ML::Parse_Context & context) {
+                onObject(context);
+            });
+    }
+    else onObject(context);
+
+    skipJsonWhitespace(context);
+    context.expect_eof();
+}
+
+Date expectTimestamp(ML::Parse_Context & context)
+{
+    return Date::fromSecondsSinceEpoch(context.expect_double());
+}
+
+} // file scope
+
+
 /* STANDARDADSERVERARGUMENTS */
 boost::program_options::options_description
 StandardAdServerArguments::
@@ -52,7 +136,8 @@ StandardAdServerConnector::
 StandardAdServerConnector(std::shared_ptr<ServiceProxies> & proxy,
                            const string & serviceName)
     : HttpAdServerConnector(serviceName, proxy),
-      publisher_(proxy->zmqContext)
+      publisher_(proxy->zmqContext),
+      eventLog_(publisher_, 65536, 3 /* timestamp digits, as in text */)
 {
 }
 
@@ -60,7 +145,8 @@ StandardAdServerConnector::
 StandardAdServerConnector(std::shared_ptr<ServiceProxies> const & proxies,
                           Json::Value const & json) :
     HttpAdServerConnector(json.get("name", "standard-adserver").asString(), proxies),
-    publisher_(getServices()->zmqContext) {
+    publisher_(getServices()->zmqContext),
+    eventLog_(publisher_, 65536, 3 /* timestamp digits, as in text */) {
     int winPort = json.get("winPort", 18143).asInt();
     int eventsPort = json.get("eventsPort", 18144).asInt();
     int externalWinPort = json.get("externalWinPort", 18145).asInt();
@@ -82,18 +168,16 @@ init(int winsPort, int eventsPort, int externalPort)
     shared_ptr<ServiceProxies> services = getServices();
 
     auto onWinRq = [=] (const HttpHeader & header,
-                        const Json::Value & json,
-                        const std::string & jsonStr) {
-        this->handleWinRq(header, json, jsonStr);
+                        const std::string & payload) {
+        this->handleWinRq(header, payload);
     };
-    registerEndpoint(winsPort, onWinRq);
+    registerPayloadEndpoint(winsPort, onWinRq);
 
     auto onDeliveryRq = [=] (const HttpHeader & header,
-                        const Json::Value & json,
-                        const std::string & jsonStr) {
-        this->handleDeliveryRq(header, json, jsonStr);
+                             const std::string & payload) {
+        this->handleDeliveryRq(header, payload);
     };
-    registerEndpoint(eventsPort, onDeliveryRq);
+    registerPayloadEndpoint(eventsPort, onDeliveryRq);
 
     auto onExternalWinRq = [=] (const HttpHeader & header,
                         const Json::Value & json,
@@ -121,109 +205,160 @@ void
 StandardAdServerConnector::
 shutdown()
 {
+    eventLog_.flush();
     publisher_.shutdown();
     HttpAdServerConnector::shutdown();
 }
 
-void
+std::vector<StandardWinNotification>
 StandardAdServerConnector::
-handleWinRq(const HttpHeader & header,
-            const Json::Value & json, const std::string & jsonStr)
+parseWins(const std::string & payload)
 {
-    Date timestamp = Date::fromSecondsSinceEpoch(json["timestamp"].asDouble());
-    Date bidTimestamp;
-    if (json.isMember("bidTimestamp")) {
-        bidTimestamp
-            = Date::fromSecondsSinceEpoch(json["bidTimestamp"].asDouble());
-    }
-    string auctionIdStr(json["auctionId"].asString());
-    string adSpotIdStr(json["adSpotId"].asString());
-    string accountKeyStr(json["accountId"].asString());
-    double winPriceDbl(json["winPrice"].asDouble());
-    double dataCostDbl(json["dataCost"].asDouble());
+    std::vector<StandardWinNotification> result;
+    StandardWinNotification win;
+
+    auto onField = [&] (const std::string & field,
+                        ML::Parse_Context & context) {
+        if (field == "timestamp")
+            win.timestamp = expectTimestamp(context);
+        else if (field == "bidTimestamp")
+            win.bidTimestamp = expectTimestamp(context);
+        else if (field == "auctionId")
+            win.auctionId = Id(expectJsonStringAscii(context));
+        else if (field == "adSpotId")
+            win.adSpotId = Id(expectJsonStringAscii(context));
+        else if (field == "accountId")
+            win.accountKey = expectJsonStringAscii(context);
+        else if (field == "winPrice")
+            win.winPrice = context.expect_double();
+        else if (field == "dataCost")
+            win.dataCost = context.expect_double();
+        else if (field == "winMeta")
+            win.meta = expectRawJson(context, payload);
+        else skipJsonValue(context);
+    };
 
-    Id auctionId(auctionIdStr);
-    Id adSpotId(adSpotIdStr);
-    AccountKey accountKey(accountKeyStr);
-    USD_CPM winPrice(winPriceDbl);
-    USD_CPM dataCost(dataCostDbl);
+    auto onDone = [&] () {
+        result.push_back(std::move(win));
+        win = StandardWinNotification();
+    };
+
+    forEachNotification(payload, onField, onDone);
+    return result;
+}
+
+std::vector<StandardDeliveryNotification>
+StandardAdServerConnector::
+parseDeliveries(const std::string & payload)
+{
+    std::vector<StandardDeliveryNotification> result;
+    StandardDeliveryNotification delivery;
+
+    auto onField = [&] (const std::string & field,
+                        ML::Parse_Context & context) {
+        if (field == "timestamp")
+            delivery.timestamp = expectTimestamp(context);
+        else if (field == "auctionId") {
+            delivery.auctionId = Id(expectJsonStringAscii(context));
+            delivery.hasAuctionId = true;
+        }
+        else if (field == "adSpotId")
+            delivery.adSpotId = Id(expectJsonStringAscii(context));
+        else if (field == "userId") {
+            delivery.userId = Id(expectJsonStringAscii(context));
+            delivery.hasUserId = true;
+        }
+        else if (field == "event")
+            delivery.event = expectJsonStringAscii(context);
+        else if (field == "payout") {
+            skipJsonWhitespace(context);
+            size_t start = context.get_offset();
+            delivery.payout = context.expect_double();
+            delivery.payoutJson = "{\"payout\":"
+                + payload.substr(start, context.get_offset() - start) + "}";
+        }
+        else skipJsonValue(context);
+    };
 
-    UserIds userIds;
+    auto onDone = [&] () {
+        if (delivery.event == "click") {
+            if (!delivery.hasAuctionId)
+                throw ML::Exception("click events must have auction/spot ids");
+        }
+        else if (delivery.event != "conversion")
+            throw ML::Exception("invalid event type: '" + delivery.event + "'");
 
-    const Json::Value & meta = json["winMeta"];
+        result.push_back(std::move(delivery));
+        delivery = StandardDeliveryNotification();
+    };
 
-    publishWin(auctionId, adSpotId, winPrice, timestamp, meta, userIds,
-               accountKey, bidTimestamp);
-    publisher_.publish("WIN", timestamp.print(3), auctionIdStr,
-                       adSpotIdStr, accountKeyStr,
-                       winPrice.toString(), dataCost.toString(), meta);
+    forEachNotification(payload, onField, onDone);
+    return result;
 }
 
 void
 StandardAdServerConnector::
-handleDeliveryRq(const HttpHeader & header,
-                 const Json::Value & json, const std::string & jsonStr)
+handleWinRq(const HttpHeader & header, const std::string & payload)
 {
-    Date timestamp = Date::fromSecondsSinceEpoch(json["timestamp"].asDouble());
-    Date bidTimestamp;
-    if (json.isMember("bidTimestamp")) {
-        bidTimestamp
-            = Date::fromSecondsSinceEpoch(json["bidTimestamp"].asDouble());
-    }
-    int matchType(0); /* 1: campaign, 2: user, 0: none */
-    string auctionIdStr, adSpotIdStr, userIdStr;
-    Id auctionId, adSpotId, userId;
-    UserIds userIds;
-    
-    if (json.isMember("auctionId")) {
-        auctionIdStr = json["auctionId"].asString();
-        adSpotIdStr = json["adSpotId"].asString();
-        auctionId = Id(auctionIdStr);
-        adSpotId = Id(adSpotIdStr);
-        matchType = 1;
-    }
-    if (json.isMember("userId")) {
-        userIdStr = json["userId"].asString();
-        userId = Id(userIdStr);
-        if (!matchType)
-            matchType = 2;
+    auto wins = parseWins(payload);
+
+    for (const StandardWinNotification & win: wins) {
+        USD_CPM winPrice(win.winPrice);
+        USD_CPM dataCost(win.dataCost);
+        UserIds userIds;
+
+        publishWin(win.auctionId, win.adSpotId, winPrice, win.timestamp,
+                   win.meta, userIds, AccountKey(win.accountKey),
+                   win.bidTimestamp);
+        eventLog_.publish("WIN", win.timestamp, win.auctionId, win.adSpotId,
+                          win.accountKey, winPrice.toString(),
+                          dataCost.toString(), win.meta.toString());
     }
 
-    string event(json["event"].asString());
-    if (event == "click") {
-        if (matchType != 1) {
-            throw ML::Exception("click events must have auction/spot ids");
+    eventLog_.flush();
+}
+
+void
+StandardAdServerConnector::
+handleDeliveryRq(const HttpHeader & header, const std::string & payload)
+{
+    auto deliveries = parseDeliveries(payload);
+
+    for (const StandardDeliveryNotification & delivery: deliveries) {
+        UserIds userIds;
+
+        if (delivery.event == "click") {
+            publishCampaignEvent("CLICK", delivery.auctionId,
+                                 delivery.adSpotId, delivery.timestamp,
+                                 JsonHolder(), userIds);
+            eventLog_.publish("CLICK", delivery.timestamp, delivery.auctionId,
+                              delivery.adSpotId, userIds.toString());
+            continue;
         }
-        publishCampaignEvent("CLICK", auctionId, adSpotId, timestamp,
-                             Json::Value(), userIds);
-        publisher_.publish("CLICK", timestamp.print(3), auctionIdStr,
-                           adSpotIdStr, userIds.toString());
-    }
-    else if (event == "conversion") {
-        Json::Value meta;
-        meta["payout"] = json["payout"];
-        USD_CPM payout(json["payout"].asDouble());
-
-        if (matchType == 1) {
-            publishCampaignEvent("CONVERSION", auctionId, adSpotId,
-                                 timestamp, meta, userIds);
-            publisher_.publish("CONVERSION", timestamp.print(3), "campaign", 
-                               auctionIdStr, adSpotIdStr, payout.toString());
+
+        USD_CPM payout(delivery.payout);
+
+        if (delivery.hasAuctionId) {
+            publishCampaignEvent("CONVERSION", delivery.auctionId,
+                                 delivery.adSpotId, delivery.timestamp,
+                                 delivery.payoutJson, userIds);
+            eventLog_.publish("CONVERSION", delivery.timestamp, "campaign",
+                              delivery.auctionId, delivery.adSpotId,
+                              payout.toString());
         }
-        else if (matchType == 2) {
-            publishUserEvent("CONVERSION", userId,
-                             timestamp, meta, userIds);
-            publisher_.publish("CONVERSION", timestamp.print(3), "user",
-                               auctionId.toString(), payout.toString());
+        else if (delivery.hasUserId) {
+            publishUserEvent("CONVERSION", delivery.userId,
+                             delivery.timestamp, delivery.payoutJson, userIds);
+            eventLog_.publish("CONVERSION", delivery.timestamp, "user",
+                              delivery.auctionId, payout.toString());
         }
         else {
-            publisher_.publish("CONVERSION", timestamp.print(3), "unmatched",
-                               auctionId.toString(), payout.toString());
+            eventLog_.publish("CONVERSION", delivery.timestamp, "unmatched",
+                              delivery.auctionId, payout.toString());
         }
     }
-    else {
-        throw ML::Exception("invalid event type: '" + event + "'");
-    }
+
+    eventLog_.flush();
 }
 
 void
@@ -243,9 +378,10 @@ handleExternalWinRq(const HttpHeader & header,
     USD_CPM dataCost(dataCostDbl);
     Json::Value bidRequest = json["bidRequest"];
 
-    publisher_.publish("EXTERNALWIN", now.print(3), auctionIdStr,
-                       std::to_string(price), dataCost.toString(),
-                       boost::trim_copy(bidRequest.toString()));
+    eventLog_.publish("EXTERNALWIN", now, auctionIdStr,
+                      std::to_string(price), dataCost.toString(),
+                      boost::trim_copy(bidRequest.toString()));
+    eventLog_.flush();
 }
 
 namespace {
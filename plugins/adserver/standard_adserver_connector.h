@@ -18,6 +18,8 @@
 #include "soa/service/zmq_named_pub_sub.h"
 #include "soa/types/date.h"
 
+#include "rtbkit/common/binary_event_log.h"
+#include "rtbkit/common/json_holder.h"
 #include "rtbkit/plugins/adserver/http_adserver_connector.h"
 
 namespace RTBKIT {
@@ -34,6 +36,43 @@ struct StandardAdServerArguments : ServiceProxyArguments
     int externalWinPort;
 };
 
+/** A win notification, as parsed from the body of a win request. */
+struct StandardWinNotification
+{
+    StandardWinNotification()
+        : winPrice(0.0), dataCost(0.0)
+    {
+    }
+
+    Date timestamp;
+    Date bidTimestamp;
+    Id auctionId;
+    Id adSpotId;
+    std::string accountKey;
+    double winPrice;
+    double dataCost;
+    JsonHolder meta;
+};
+
+/** A click or conversion, as parsed from the body of an events request. */
+struct StandardDeliveryNotification
+{
+    StandardDeliveryNotification()
+        : hasAuctionId(false), hasUserId(false), payout(0.0)
+    {
+    }
+
+    Date timestamp;
+    Id auctionId;
+    Id adSpotId;
+    Id userId;
+    bool hasAuctionId;
+    bool hasUserId;
+    std::string event;
+    double payout;
+    JsonHolder payoutJson;
+};
+
 struct StandardAdServerConnector : public HttpAdServerConnector
 {
     StandardAdServerConnector(shared_ptr<Datacratic::ServiceProxies> & proxy,
@@ -46,13 +85,31 @@ struct StandardAdServerConnector : public HttpAdServerConnector
     void start();
     void shutdown();
 
-    /** Handle events received on the win port */
-    void handleWinRq(const HttpHeader & header,
-                     const Json::Value & json, const string & jsonStr);
+    /** Handle events received on the win port.  The body is either a
+        single win notification or a JSON array of them, and is parsed
+        directly without building a Json::Value.  Nothing is published
+        unless the whole body is valid, so that a rejected batch can be
+        retried as a whole.
+    */
+    void handleWinRq(const HttpHeader & header, const string & payload);
+
+    /** Handle events received on the events port.  Like wins, events can be
+        sent one by one or as an array.
+    */
+    void handleDeliveryRq(const HttpHeader & header, const string & payload);
 
-    /** Handle events received on the events port */
-    void handleDeliveryRq(const HttpHeader & header,
-                          const Json::Value & json, const string & jsonStr);
+    /** Parse the body of a win request.  Throws if any of the notifications
+        is malformed.
+    */
+    static std::vector<StandardWinNotification>
+    parseWins(const string & payload);
+
+    /** Parse the body of an events request.  Throws if any of the
+        notifications is malformed or has an invalid event type, or if a
+        click has no auction id.
+    */
+    static std::vector<StandardDeliveryNotification>
+    parseDeliveries(const string & payload);
 
     /** Handle events received on the external wins port */
     void handleExternalWinRq(const HttpHeader & header,
@@ -60,6 +117,9 @@ struct StandardAdServerConnector : public HttpAdServerConnector
     
     /** */
     Datacratic::ZmqNamedPublisher publisher_;
+
+    /** Events logged for the data logger, batched per request. */
+    BinaryEventPublisher eventLog_;
 };
 
 } // namespace RTBKIT
@@ -0,0 +1,4 @@
+# adserver_testing.mk
+
+$(eval $(call test,standard_adserver_parse_test,standard_adserver,boost))
+$(eval $(call test,standard_adserver_bench,standard_adserver,boost manual))
@@ -0,0 +1,165 @@
+/* standard_adserver_bench.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Wins per second that the standard ad server connector can ingest on one
+   core: parsing the body of the request and encoding the event for the
+   data logger, compared to building a Json::Value and the text message
+   as was done before.  Publishing itself isn't included.
+
+   Each measurement is written to stdout as a single line of JSON:
+
+       {"bench":"wins","parser":"streaming","batch":100,
+        "iterations":200000,"nsPerOp":456.7,"opsPerSec":2189621.1}
+
+   where an op is one win.  The number of iterations is scaled by the
+   ADSERVER_BENCH_SCALE environment variable.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/adserver/standard_adserver_connector.h"
+#include "rtbkit/common/binary_event_log.h"
+#include "rtbkit/common/account_key.h"
+#include "rtbkit/common/currency.h"
+#include "jml/utils/environment.h"
+#include "jml/arch/timers.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+Env_Option<int> benchScale("ADSERVER_BENCH_SCALE", 1);
+
+namespace {
+
+const string sampleWin =
+    "{\"timestamp\":1368153863.008,\"bidTimestamp\":1368153862.95,"
+    "\"auctionId\":\"85885bb0-b91b-11e2-c4cf-7fba90171555\","
+    "\"adSpotId\":\"156331815539876686\","
+    "\"accountId\":\"hello:world\",\"winPrice\":1.25,\"dataCost\":0.1,"
+    "\"winMeta\":{\"creative\":12,\"tags\":[\"a\",\"b\"]}}";
+
+string makeBody(int batch)
+{
+    if (batch == 1)
+        return sampleWin;
+
+    string result = "[";
+    for (int i = 0;  i < batch;  ++i)
+        result += (i ? "," : "") + sampleWin;
+    return result + "]";
+}
+
+void report(const string & parser, int batch, uint64_t wins, double elapsed)
+{
+    Json::Value params;
+    params["bench"] = "wins";
+    params["parser"] = parser;
+    params["batch"] = batch;
+    params["iterations"] = (Json::UInt64)wins;
+    params["nsPerOp"] = elapsed * 1e9 / wins;
+    params["opsPerSec"] = wins / elapsed;
+    cout << params.toStringNoNewLine() << endl;
+}
+
+/** What the connector did with a win before: build a Json::Value of the
+    body and read it into the types that are published, then format the
+    text message for the data logger.  Returns the size of the message so
+    that nothing is optimized away.
+*/
+size_t jsonWin(const Json::Value & json)
+{
+    Date timestamp = Date::fromSecondsSinceEpoch(json["timestamp"].asDouble());
+    Date bidTimestamp
+        = Date::fromSecondsSinceEpoch(json["bidTimestamp"].asDouble());
+    string auctionIdStr(json["auctionId"].asString());
+    string adSpotIdStr(json["adSpotId"].asString());
+    string accountKeyStr(json["accountId"].asString());
+
+    Id auctionId(auctionIdStr);
+    Id adSpotId(adSpotIdStr);
+    AccountKey accountKey(accountKeyStr);
+    USD_CPM winPrice(json["winPrice"].asDouble());
+    USD_CPM dataCost(json["dataCost"].asDouble());
+
+    vector<string> message = {
+        "WIN", timestamp.print(3), auctionIdStr, adSpotIdStr, accountKeyStr,
+        winPrice.toString(), dataCost.toString(), json["winMeta"].toString()
+    };
+
+    size_t result = bidTimestamp.secondsSinceEpoch() + accountKey.size()
+        + auctionId.hash() + adSpotId.hash();
+    for (auto & field: message)
+        result += field.size();
+    return result;
+}
+
+double benchJson(const string & body, uint64_t iterations, size_t & total)
+{
+    Timer timer;
+    for (uint64_t i = 0;  i < iterations;  ++i) {
+        Json::Value json = Json::parse(body);
+        if (json.isArray()) {
+            for (unsigned j = 0;  j < json.size();  ++j)
+                total += jsonWin(json[j]);
+        }
+        else total += jsonWin(json);
+    }
+    return timer.elapsed_wall();
+}
+
+double benchStreaming(const string & body, uint64_t iterations,
+                      size_t & total)
+{
+    BinaryEventWriter writer(3);
+
+    Timer timer;
+    for (uint64_t i = 0;  i < iterations;  ++i) {
+        auto wins = StandardAdServerConnector::parseWins(body);
+        for (auto & win: wins) {
+            AccountKey accountKey(win.accountKey);
+            USD_CPM winPrice(win.winPrice);
+            USD_CPM dataCost(win.dataCost);
+            writer.add("WIN", win.timestamp, win.auctionId, win.adSpotId,
+                       win.accountKey, winPrice.toString(),
+                       dataCost.toString(), win.meta.toString());
+            total += accountKey.size();
+        }
+        total += writer.release().size();
+    }
+    return timer.elapsed_wall();
+}
+
+} // file scope
+
+
+BOOST_AUTO_TEST_CASE( bench_wins )
+{
+    size_t total = 0;
+
+    for (int batch: { 1, 10, 100 }) {
+        string body = makeBody(batch);
+        uint64_t iterations = 200000 * benchScale / batch;
+        uint64_t wins = iterations * batch;
+
+        // Each iteration handles the whole batch
+        BOOST_REQUIRE_EQUAL(StandardAdServerConnector::parseWins(body).size(),
+                            batch);
+
+        double json = benchJson(body, iterations, total);
+        report("json", batch, wins, json);
+
+        double streaming = benchStreaming(body, iterations, total);
+        report("streaming", batch, wins, streaming);
+
+        cerr << "batch " << batch << ": streaming is "
+             << json / streaming << " times as fast" << endl;
+    }
+
+    BOOST_CHECK_NE(total, 0);
+}
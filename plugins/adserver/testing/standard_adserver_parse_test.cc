@@ -0,0 +1,89 @@
+/* standard_adserver_parse_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test for the parsing of win and event requests by the standard ad server
+   connector.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/adserver/standard_adserver_connector.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( test_parse_wins )
+{
+    string single = "{\"timestamp\": 1368153863.5, \"auctionId\": \"a1\","
+        " \"adSpotId\": \"s1\", \"accountId\": \"campaign:strategy\","
+        " \"winPrice\": 1.5, \"unknown\": {\"x\": [1, \"]\", null]},"
+        " \"winMeta\": {\"key\": [1, 2]}}";
+
+    auto wins = StandardAdServerConnector::parseWins(single);
+    BOOST_REQUIRE_EQUAL(wins.size(), 1);
+    BOOST_CHECK_EQUAL(wins[0].timestamp.secondsSinceEpoch(), 1368153863.5);
+    BOOST_CHECK_EQUAL(wins[0].auctionId, Id("a1"));
+    BOOST_CHECK_EQUAL(wins[0].adSpotId, Id("s1"));
+    BOOST_CHECK_EQUAL(wins[0].accountKey, "campaign:strategy");
+    BOOST_CHECK_EQUAL(wins[0].winPrice, 1.5);
+    BOOST_CHECK_EQUAL(wins[0].dataCost, 0.0);
+    BOOST_CHECK_EQUAL(wins[0].meta.toString(), "{\"key\": [1, 2]}");
+
+    // Fields don't carry over from one entry of a batch to the next
+    wins = StandardAdServerConnector::parseWins(
+            " [" + single + ", {\"auctionId\": \"a2\", \"dataCost\": 2}] ");
+    BOOST_REQUIRE_EQUAL(wins.size(), 2);
+    BOOST_CHECK_EQUAL(wins[1].auctionId, Id("a2"));
+    BOOST_CHECK_EQUAL(wins[1].accountKey, "");
+    BOOST_CHECK_EQUAL(wins[1].winPrice, 0.0);
+    BOOST_CHECK_EQUAL(wins[1].dataCost, 2.0);
+    BOOST_CHECK(!wins[1].meta.isNonNull());
+
+    BOOST_CHECK_THROW(StandardAdServerConnector::parseWins(
+                              "[" + single + ", {\"auctionId\": }]"),
+                      std::exception);
+    BOOST_CHECK_THROW(StandardAdServerConnector::parseWins(single + "{}"),
+                      std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_parse_deliveries )
+{
+    string click = "{\"event\": \"click\", \"auctionId\": \"a1\","
+        " \"adSpotId\": \"s1\", \"timestamp\": 1368153863}";
+    string conversion = "{\"event\": \"conversion\", \"userId\": \"u1\","
+        " \"payout\": 0.25}";
+
+    auto deliveries = StandardAdServerConnector::parseDeliveries(
+            "[" + click + "," + conversion + "]");
+    BOOST_REQUIRE_EQUAL(deliveries.size(), 2);
+    BOOST_CHECK_EQUAL(deliveries[0].event, "click");
+    BOOST_CHECK(deliveries[0].hasAuctionId);
+    BOOST_CHECK(!deliveries[0].hasUserId);
+    BOOST_CHECK_EQUAL(deliveries[1].event, "conversion");
+    BOOST_CHECK(!deliveries[1].hasAuctionId);
+    BOOST_CHECK_EQUAL(deliveries[1].userId, Id("u1"));
+    BOOST_CHECK_EQUAL(deliveries[1].payout, 0.25);
+    BOOST_CHECK_EQUAL(deliveries[1].payoutJson.toString(),
+                      "{\"payout\":0.25}");
+
+    // A bad entry anywhere rejects the whole batch
+    BOOST_CHECK_THROW(StandardAdServerConnector::parseDeliveries(
+                              "[" + click + ", {\"event\": \"view\"}]"),
+                      std::exception);
+    BOOST_CHECK_THROW(StandardAdServerConnector::parseDeliveries(
+                              "[" + conversion + ", {\"event\": \"click\"}]"),
+                      std::exception);
+
+    // Payouts must be numbers
+    BOOST_CHECK_THROW(StandardAdServerConnector::parseDeliveries(
+                              "{\"event\": \"conversion\", \"payout\": \"1\"}"),
+                      std::exception);
+    BOOST_CHECK_THROW(StandardAdServerConnector::parseDeliveries(
+                              "{\"event\": \"conversion\", \"payout\": null}"),
+                      std::exception);
+}
@@ -66,17 +66,30 @@ init()
 {
     responseQueue.onEvent = [=] (const Response& resp)
         {
-            const AugmentationRequest& request = resp.first;
-            const AugmentationList& response = resp.second;
-
-            toRouters.sendMessage(
-                    request.router,
-                    "RESPONSE",
-                    "1.0",
-                    request.startTime,
-                    request.id.toString(),
-                    request.augmentor,
-                    chomp(response.toJson().toString()));
+            const AugmentationRequest& request = resp.request;
+            const AugmentationList& response = resp.list;
+
+            if (resp.cacheable) {
+                toRouters.sendMessage(
+                        request.router,
+                        "RESPONSE",
+                        "1.0",
+                        request.startTime,
+                        request.id.toString(),
+                        request.augmentor,
+                        chomp(response.toJson().toString()));
+            }
+            else {
+                toRouters.sendMessage(
+                        request.router,
+                        "RESPONSE",
+                        "1.0",
+                        request.startTime,
+                        request.id.toString(),
+                        request.augmentor,
+                        chomp(response.toJson().toString()),
+                        "nocache");
+            }
 
             recordHit("messages.RESPONSE");
         };
@@ -150,9 +163,11 @@ configureAndWait()
 
 void
 Augmentor::
-respond(const AugmentationRequest & request, const AugmentationList & response)
+respond(const AugmentationRequest & request,
+        const AugmentationList & response,
+        bool cacheable)
 {
-    if (responseQueue.tryPush(make_pair(request, response)))
+    if (responseQueue.tryPush(Response { request, response, cacheable }))
         return;
 
     cerr << "Dropping augmentation response: response queue is full" << endl;
@@ -180,7 +195,8 @@ handleRouterMessage(const std::string & router,
                         message.at(7), // startTime
                         message.at(3), // auctionId
                         message.at(2), // augmentor
-                        "null");       // response
+                        "null",        // response
+                        "nocache");
 
                 recordHit("shedMessages");
                 return;
@@ -86,9 +86,15 @@ struct Augmentor : public ServiceBase, public MessageLoop {
     /** Function to be called on an augmentation request. */
     OnRequest onRequest;
 
-    /** Function to be called to respond to an augmentation request. */
+    /** Function to be called to respond to an augmentation request.
+
+        Responses can be cached by the router for the TTL configured by the
+        agents; pass cacheable = false for responses that must not be reused
+        (errors, partial results, ...).
+    */
     void respond(const AugmentationRequest & request,
-                 const AugmentationList & response);
+                 const AugmentationList & response,
+                 bool cacheable = true);
 
     double sampleLoad() { return loopMonitor.sampleLoad().load; }
     double shedProbability() { return loadStabilizer.shedProbability(); }
@@ -98,7 +104,11 @@ private:
 
     ZmqMultipleNamedClientBusProxy toRouters;
 
-    typedef std::pair<AugmentationRequest, AugmentationList> Response;
+    struct Response {
+        AugmentationRequest request;
+        AugmentationList list;
+        bool cacheable;
+    };
     TypedMessageSink<Response> responseQueue;
 
 public:
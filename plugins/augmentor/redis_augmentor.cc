@@ -11,6 +11,8 @@
 #include <boost/range/irange.hpp>
 #include "redis_augmentor.h"
 #include "jml/utils/exc_assert.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include <mutex>
 using namespace std;
 
 namespace RTBKIT {
@@ -21,6 +23,38 @@ RedisAugmentor::
 {
 }
 
+namespace {
+
+/** Formats the value the same way as the JSON conversion (minus quotes and
+    newlines) would.  Returns false if the string contains characters that
+    JSON would escape, in which case the caller must fall back on the JSON
+    path.
+*/
+bool directValue(const char * data, size_t len, std::string & out)
+{
+    out.clear();
+    out.reserve(len);
+    for (size_t i = 0;  i < len;  ++i) {
+        unsigned char c = data[i];
+        if (c == '\\' || c < 0x20 || c >= 0x80)
+            return false;
+        if (c != '"') out += c;
+    }
+    return true;
+}
+
+bool directValue(const std::string & str, std::string & out)
+{
+    return directValue(str.c_str(), str.size(), out);
+}
+
+bool directValue(const Utf8String & str, std::string & out)
+{
+    return directValue(str.rawData(), str.rawLength(), out);
+}
+
+} // file scope
+
 /** Sets up the internal components of the augmentor.
 
     Note that AsyncAugmentorBase is a MessageLoop so we can attach all our
@@ -33,103 +67,332 @@ init(int nthreads)
 {
     AsyncAugmentor::init(nthreads);
     /* Manages all the communications with the AgentConfigurationService. */
+    agent_config_.onConfigChange = [=] (std::string agent,
+                                        std::shared_ptr<const AgentConfig> config)
+        {
+            this->onConfigChange(agent, config);
+        };
     agent_config_.init(getServices()->config);
     addSource("RedisAugmentor::agentConfig", agent_config_);
+
+    if (batchWindow_ > 0.0) {
+        addPeriodic("RedisAugmentor::flushBatch", batchWindow_,
+                    [=] (uint64_t) { this->flushBatch(); });
+    }
 }
 
+RedisAugmentor::CompiledKey::Getter
+RedisAugmentor::
+compileGetter(const std::string & path)
+{
+    typedef CompiledKey::Getter Getter;
+
+    if (path == "id")
+        return [] (const BidRequest & br, std::string & out)
+            {
+                return directValue(br.auctionId.toString(), out);
+            };
+
+    auto stringGetter = [] (const std::string BidRequest::* field) -> Getter
+        {
+            return [=] (const BidRequest & br, std::string & out)
+                {
+                    if ((br.*field).empty()) {
+                        out.clear();
+                        return true;
+                    }
+                    return directValue(br.*field, out);
+                };
+        };
+
+    if (path == "exchange")  return stringGetter(&BidRequest::exchange);
+    if (path == "provider")  return stringGetter(&BidRequest::provider);
+    if (path == "ipAddress") return stringGetter(&BidRequest::ipAddress);
+
+    if (path == "url")
+        return [] (const BidRequest & br, std::string & out)
+            {
+                if (br.url.empty()) {
+                    out.clear();
+                    return true;
+                }
+                return directValue(br.url.toString(), out);
+            };
+
+    if (path == "language")
+        return [] (const BidRequest & br, std::string & out)
+            {
+                return directValue(br.language, out);
+            };
+
+    auto locationGetter = [] (const std::string Location::* field) -> Getter
+        {
+            return [=] (const BidRequest & br, std::string & out)
+                {
+                    return directValue(br.location.*field, out);
+                };
+        };
+
+    if (path == "location.countryCode")
+        return locationGetter(&Location::countryCode);
+    if (path == "location.regionCode")
+        return locationGetter(&Location::regionCode);
+    if (path == "location.postalCode")
+        return locationGetter(&Location::postalCode);
+
+    if (path == "location.dma")
+        return [] (const BidRequest & br, std::string & out)
+            {
+                if (br.location.dma == -1) out.clear();
+                else out = to_string(br.location.dma);
+                return true;
+            };
+
+    static const string userIdsPrefix = "userIds.";
+    if (path.compare(0, userIdsPrefix.size(), userIdsPrefix) == 0) {
+        string domain = path.substr(userIdsPrefix.size());
+        if (domain.find('.') == string::npos && !domain.empty()) {
+            InternedName name(domain);
+            return [=] (const BidRequest & br, std::string & out)
+                {
+                    auto it = br.userIds.find(name);
+                    if (it == br.userIds.end()) {
+                        out.clear();
+                        return true;
+                    }
+                    return directValue(it->second.toString(), out);
+                };
+        }
+    }
+
+    return Getter();
+}
 
 void
 RedisAugmentor::
-onRequest(const AugmentationRequest & request, SendResponseCB sendResponse)
+onConfigChange(const std::string & agent,
+               std::shared_ptr<const AgentConfig> config)
 {
-    ML::Timer tm;
+    std::shared_ptr<CompiledAgent> compiled;
+
+    if (config) {
+        const AugmentationConfig * redisConfig = nullptr;
+        for (const auto & aug : config->augmentations) {
+            if (aug.name == "redis") {
+                redisConfig = &aug;
+                break;
+            }
+        }
+
+        const Json::Value * aug_l = nullptr;
+        if (redisConfig && redisConfig->config.isObject()
+            && redisConfig->config.isMember("aug-list"))
+            aug_l = &redisConfig->config["aug-list"];
+
+        if (aug_l && aug_l->type() == Json::arrayValue && aug_l->size()) {
+            compiled = std::make_shared<CompiledAgent>();
+            compiled->account = config->account;
+
+            static const string prefix = "RTBkit:aug" ;
+            for (auto i: boost::irange (0, (int)aug_l->size()))
+            {
+                auto key = aug_l->atIndex(i).asString();
+                if (key.empty()) continue;
+
+                CompiledKey ck;
+                ck.name = key;
+                ck.redisPrefix = prefix + ":" + key + ":";
 
+                // prefix root path (.) if absent.
+                auto root_key = key[0] == '.' ? key : "."+key;
+                ck.getter = compileGetter(root_key.substr(1));
+                ck.path = std::make_shared<Json::Path>(root_key);
+
+                compiled->keys.emplace_back(std::move(ck));
+            }
+        }
+    }
+
+    std::lock_guard<ML::Spinlock> guard(compiledLock_);
+
+    auto newCompiled = std::make_shared<CompiledAgents>(*compiled_);
+    if (compiled)
+        (*newCompiled)[agent] = compiled;
+    else newCompiled->erase(agent);
+
+    compiled_ = newCompiled;
+}
+
+void
+RedisAugmentor::
+onRequest(const AugmentationRequest & request, SendResponseCB sendResponse)
+{
     recordHit("requests");
 
+    std::shared_ptr<const CompiledAgents> compiled;
+    {
+        std::lock_guard<ML::Spinlock> guard(compiledLock_);
+        compiled = compiled_;
+    }
+
     // we build an *ordered* map indexed by Redis keys, pointing
-    // at set of account keys. It will be captured by copy by the
-    // Redis lambda call back, and used in order to build the
-    // augmentation list.
-    map<string,set<RTBKIT::AccountKey>> jobs;
-    auto br = request.bidRequest->toJson();
+    // at set of account keys. It will be used once the Redis results are
+    // in to build the augmentation list.
+    PendingLookup lookup;
+    lookup.startTime = Date::now();
+
+    const BidRequest & br = *request.bidRequest;
+
+    // Only built if one of the keys can't be read directly.
+    std::unique_ptr<Json::Value> brJson;
+    string value;
+
     for (const string& agent : request.agents)
     {
-        RTBKIT::AgentConfigEntry c  = agent_config_.getAgentEntry(agent);
-
-        /* When a new agent comes online there's a race condition where the
-           router may send us a bid request for that agent before we receive
-           its configuration. This check keeps us safe in that scenario. */
-        if (!c.valid())
+        auto it = compiled->find(agent);
+        if (it == compiled->end())
         {
-            recordHit("unknownConfig");
+            /* When a new agent comes online there's a race condition where
+               the router may send us a bid request for that agent before we
+               receive its configuration. This check keeps us safe in that
+               scenario. */
+            if (!agent_config_.getAgentEntry(agent).valid())
+                recordHit("unknownConfig");
+            else recordHit ("noRedisAugAgentConfig");
             continue;
         }
 
-        // FIXME avoid converting the thing in Json::Value
-        const auto& aug_c = c.config->toJson(false);
-        const auto& aug_l = aug_c.atStr("augmentations").atStr("redis").atStr("config").atStr("aug-list");
-        if (!aug_l || aug_l.type() != Json::arrayValue || !aug_l.size())
-        {
-            recordHit ("noRedisAugAgentConfig");
-            continue ;
-        }
-        int n = aug_l.size();
-        static const string prefix = "RTBkit:aug" ;
-        for (auto i: boost::irange (0,n))
+        const CompiledAgent & c = *it->second;
+
+        for (const CompiledKey & key : c.keys)
         {
-            auto key = aug_l.atIndex(i).asString();
-            if (key.empty()) continue;
-            // prefix root path (.) if absent.
-            auto root_key = key[0] == '.' ? key : "."+key;
-            Json::Value v = Json::Path(root_key).make(br);
-            if (!v) continue;
-            auto v_str = v.toString();
-            string vv_str ;
-            copy_if(v_str.begin(), v_str.end(),  back_inserter(vv_str), [](const char& c) {
-                return c!='\n'&&c!='"';
-            });
-            jobs[prefix+":"+key+":"+vv_str].insert (c.config->account);
+            if (!key.getter || !key.getter(br, value)) {
+                if (!brJson)
+                    brJson.reset(new Json::Value(br.toJson()));
+
+                Json::Value v = key.path->make(*brJson);
+                if (!v) continue;
+                auto v_str = v.toString();
+                value.clear();
+                copy_if(v_str.begin(), v_str.end(), back_inserter(value),
+                        [](const char& c) { return c!='\n'&&c!='"'; });
+            }
+            else if (value.empty()) continue;
+
+            lookup.jobs[key.redisPrefix + value].insert (c.account);
         }
     }
 
-    if (jobs.empty())
+    if (lookup.jobs.empty())
     {
         recordHit ("noRedisKeys");
         sendResponse(AugmentationList());
         return;
     }
 
+    lookup.request = request;
+    lookup.sendResponse = std::move(sendResponse);
+    queueLookup(std::move(lookup));
+}
+
+void
+RedisAugmentor::
+queueLookup(PendingLookup && lookup)
+{
+    if (batchWindow_ <= 0.0) {
+        std::vector<PendingLookup> lookups;
+        lookups.emplace_back(std::move(lookup));
+        sendLookups(std::move(lookups));
+        return;
+    }
+
+    std::vector<PendingLookup> full;
+    {
+        std::lock_guard<ML::Spinlock> guard(batchLock_);
+        batch_.emplace_back(std::move(lookup));
+        if (batch_.size() >= maxBatchSize_)
+            full.swap(batch_);
+    }
+
+    if (!full.empty())
+        sendLookups(std::move(full));
+}
+
+void
+RedisAugmentor::
+flushBatch()
+{
+    std::vector<PendingLookup> lookups;
+    {
+        std::lock_guard<ML::Spinlock> guard(batchLock_);
+        lookups.swap(batch_);
+    }
+
+    if (!lookups.empty())
+        sendLookups(std::move(lookups));
+}
+
+void
+RedisAugmentor::
+sendLookups(std::vector<PendingLookup> && lookups)
+{
+    // Dedup the keys across all the requests; the map gives each one its
+    // index in the pipelined command.
+    auto keyIndex = std::make_shared<std::map<std::string, int> >();
+    for (const auto& lookup: lookups)
+        for (const auto& job: lookup.jobs)
+            keyIndex->insert(make_pair(job.first, 0));
+
+    vector<Redis::Command> cmds;
+    cmds.reserve(keyIndex->size());
+    for (auto& ii: *keyIndex) {
+        ii.second = cmds.size();
+        cmds.emplace_back (Redis::GET(ii.first));
+    }
+
+    recordLevel(lookups.size(), "batch.requests");
+    recordLevel(cmds.size(), "batch.keys");
+
+    auto pending = std::make_shared<std::vector<PendingLookup> >(
+            std::move(lookups));
+
     auto doResponse = [=](const Redis::Results& results) {
-        ExcAssertEqual (results.size(), jobs.size());
-        AugmentationList auglret;
-        if (results)
+        if (!results)
+        {
+            cerr << "RedisAugmentor::onRequest::lambda(doResponse) error: " << results.error() << endl ;
+            recordHit("redisError."+results.error());
+        }
+        else ExcAssertEqual (results.size(), keyIndex->size());
+
+        Date now = Date::now();
+
+        for (const auto& lookup: *pending)
         {
-            auto i=0;
-            for (const auto& ii: jobs)
+            recordOutcome(now.secondsSince(lookup.startTime) * 1000.0,
+                          "redisResponseMs");
+
+            AugmentationList auglret;
+            if (!results)
+            {
+                // Don't let the router reuse an empty answer due to an error
+                respond(lookup.request, auglret, false /* cacheable */);
+                continue;
+            }
+
+            for (const auto& ii: lookup.jobs)
             {
-                const auto& res = results.at(i).reply().asString();
+                int index = keyIndex->find(ii.first)->second;
+                const auto& res = results.at(index).reply().asString();
                 if (!res.empty())
                     for (const auto& jj: ii.second)
                         auglret[jj].data.atStr(ii.first) = res;
-                ++i;
             }
+            lookup.sendResponse(auglret);
         }
-        else
-        {
-            cerr << "RedisAugmentor::onRequest::lambda(doResponse) error: " << results.error() << endl ;
-            recordHit("redisError."+results.error());
-        }
-        recordOutcome(tm.elapsed_wall() * 1000.0, "redisResponseMs");
-        sendResponse(auglret);
     };
 
-    // build a vector of commands
-    vector<Redis::Command> cmds;
-    for (auto& ii: jobs)
-        cmds.emplace_back (Redis::GET(ii.first));
-
     // and post it
     redis_->queueMulti(cmds, doResponse, 0.004);
-
 }
+
 } /* namespace RTBKIT */
@@ -9,9 +9,11 @@
 #define REDIS_AUGMENTOR_H_
 
 #include <string>
+#include <unordered_map>
 #include "augmentor_base.h"
 #include "soa/service/redis.h"
 #include "rtbkit/core/agent_configuration/agent_configuration_listener.h"
+#include "jml/arch/spinlock.h"
 
 namespace RTBKIT {
 
@@ -27,6 +29,9 @@ public:
         : RTBKIT::AsyncAugmentor(augmentorName,serviceName,proxies)
         , agent_config_ (proxies->zmqContext)
         , redis_(std::make_shared<Redis::AsyncConnection>(redis))
+        , compiled_ (std::make_shared<CompiledAgents>())
+        , batchWindow_ (0.0)
+        , maxBatchSize_ (256)
     {
     }
 
@@ -37,6 +42,9 @@ public:
         : RTBKIT::AsyncAugmentor(augmentorName,serviceName,proxies)
         , agent_config_ (proxies->zmqContext)
         , redis_(redis)
+        , compiled_ (std::make_shared<CompiledAgents>())
+        , batchWindow_ (0.0)
+        , maxBatchSize_ (256)
     {
     }
 
@@ -47,6 +55,9 @@ public:
         : RTBKIT::AsyncAugmentor(augmentorName,serviceName,parent)
         , agent_config_ (parent.getZmqContext())
         , redis_(std::make_shared<Redis::AsyncConnection>(redis))
+        , compiled_ (std::make_shared<CompiledAgents>())
+        , batchWindow_ (0.0)
+        , maxBatchSize_ (256)
     {
     }
 
@@ -57,15 +68,80 @@ public:
         : RTBKIT::AsyncAugmentor(augmentorName,serviceName,parent)
         , agent_config_ (parent.getZmqContext())
         , redis_ (redis)
+        , compiled_ (std::make_shared<CompiledAgents>())
+        , batchWindow_ (0.0)
+        , maxBatchSize_ (256)
     {
     }
 
     void init(int nthreads);
     virtual ~RedisAugmentor() ;
+
+    /** Lookups from concurrent requests are held for up to window seconds
+        (or until maxBatchSize requests are waiting) so that they can be sent
+        to Redis as a single pipelined command with duplicate keys removed.
+        A window of 0, the default, sends each request on its own and
+        doesn't run the flush timer.  Must be called before init().
+    */
+    void setBatching(double window, size_t maxBatchSize)
+    {
+        batchWindow_ = window;
+        maxBatchSize_ = maxBatchSize;
+    }
+
 private:
     void onRequest(const AugmentationRequest & request, SendResponseCB sendResponse);
+
+    /** A key from an agent's aug-list, compiled when the agent's config
+        arrives.  Keys on well known fields are read straight from the
+        BidRequest; the others are resolved on its JSON version.
+    */
+    struct CompiledKey {
+        std::string name;        ///< Path as written in the aug-list
+        std::string redisPrefix; ///< Redis key up to the value
+        std::shared_ptr<const Json::Path> path; ///< Used when no getter
+
+        typedef std::function<bool (const BidRequest &, std::string &)> Getter;
+        Getter getter;           ///< Returns false to fall back on path
+    };
+
+    struct CompiledAgent {
+        AccountKey account;
+        std::vector<CompiledKey> keys;
+    };
+
+    typedef std::unordered_map<std::string, std::shared_ptr<const CompiledAgent> >
+        CompiledAgents;
+
+    void onConfigChange(const std::string & agent,
+                        std::shared_ptr<const AgentConfig> config);
+
+    static CompiledKey::Getter compileGetter(const std::string & path);
+
+    /** Redis key to the accounts that are interested in its value. */
+    typedef std::map<std::string, std::set<AccountKey> > Jobs;
+
+    struct PendingLookup {
+        AugmentationRequest request;
+        SendResponseCB sendResponse;
+        Jobs jobs;
+        Date startTime;
+    };
+
+    void queueLookup(PendingLookup && lookup);
+    void flushBatch();
+    void sendLookups(std::vector<PendingLookup> && lookups);
+
     RTBKIT::AgentConfigurationListener agent_config_;
     std::shared_ptr<Redis::AsyncConnection> redis_ ;
+
+    ML::Spinlock compiledLock_;
+    std::shared_ptr<const CompiledAgents> compiled_;
+
+    ML::Spinlock batchLock_;
+    std::vector<PendingLookup> batch_;
+    double batchWindow_;
+    size_t maxBatchSize_;
 };
 
 } /* namespace RTBKIT */
@@ -0,0 +1,191 @@
+/** redis_augmentor_bench.cc                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Throughput of the redis augmentor against a local Redis, with and without
+    batching of the lookups of concurrent requests.
+
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/testing/test_agent.h"
+#include "rtbkit/plugins/augmentor/redis_augmentor.h"
+#include "rtbkit/core/agent_configuration/agent_configuration_service.h"
+#include "soa/service/testing/redis_temporary_server.h"
+#include "jml/db/persistent.h"
+#include "jml/arch/timers.h"
+#include "soa/service/redis.h"
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <thread>
+#include <set>
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+static const string sampleBr =
+    "{\"id\":\"85885bb0-b91b-11e2-c4cf-7fba90171555\",\"timestamp\":1368153863.008756,\"isTest\":false,\"url\":\"http://myonlinearcade.com/\",\"ipAddress\":\"166.13.20.21\",\"userAgent\":\"Mozilla/5.0 (Windows NT 6.1; WOW64; rv:19.0) Gecko/20100101 Firefox/20.0\",\"language\":\"fr\",\"protocolVersion\":\"0.3\",\"exchange\":\"appnexus\",\"provider\":\"appnexus\",\"winSurcharges\":{\"surcharge\":{\"USD/1M\":50}},\"winSurchageMicros\":{\"surcharge\":{\"USD/1M\":50}},\"location\":{\"countryCode\":\"CA\",\"regionCode\":\"QC\",\"cityName\":\"Laval\",\"postalCode\":\"0\",\"dma\":0,\"timezoneOffsetMinutes\":-1},\"segments\":{\"appnexus\":[\"memberId1357\"],\"browser\":[\"Mozilla Firefox\"],\"device_type\":[\"Computer\"],\"os\":[\"Microsoft Windows 7\"]},\"userIds\":{\"an\":\"5273283952213481305\",\"xchg\":\"5273283952213481305\"},\"imp\":[{\"id\":\"156331815539876686\",\"banner\":{\"w\":728,\"h\":90},\"formats\":[\"728x90\"]}],\"spots\":[{\"id\":\"156331815539876686\",\"banner\":{\"w\":728,\"h\":90},\"formats\":[\"728x90\"]}]}";
+
+static std::atomic<size_t> instances(0);
+std::string instancedName(const std::string& prefix)
+{
+    return prefix + to_string(instances.fetch_add(1));
+}
+
+/** Sends bursts of AUGMENT messages and counts the responses. */
+struct BurstAugmentationLoop : public ServiceBase, public MessageLoop
+{
+    BurstAugmentationLoop(const std::shared_ptr<ServiceProxies>& proxies,
+                          const set<string> & agentNames) :
+        ServiceBase(instancedName("bench-aug-loop-"), proxies),
+        toAug(proxies->zmqContext),
+        sent(0), recv(0)
+    {
+        std::ostringstream agentStr;
+        ML::DB::Store_Writer writer(agentStr);
+        writer.save(agentNames);
+        agents = agentStr.str();
+    }
+
+    void start()
+    {
+        registerServiceProvider(serviceName(), { "rtbRouterAugmentation" });
+
+        toAug.init(getServices()->config, serviceName() + "/augmentors");
+        toAug.bindTcp(getServices()->ports->getRange("augmentors"));
+
+        toAug.clientMessageHandler = [&] (const vector<string> & message) {
+            if (message[1] == "RESPONSE") recv++;
+        };
+
+        addSource("BenchAugLoop::toAug", toAug);
+
+        MessageLoop::start();
+    }
+
+    void sendBurst(size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i) {
+            toAug.sendMessage(
+                "redis-augmentation", "AUGMENT", "1.0", "redis-augmentation",
+                to_string(random()), "datacratic", sampleBr,
+                agents, Date::now());
+            sent++;
+        }
+    }
+
+    ZmqNamedClientBus toAug;
+    string agents;
+    std::atomic<size_t> sent, recv;
+};
+
+static void
+runBench(const Redis::Address & redis, double window, size_t maxBatchSize)
+{
+    enum {
+        NumAgents = 8,
+        NumRequests = 50000,
+        BurstSize = 500,
+        RedisThreads = 4
+    };
+
+    auto proxies = make_shared<ServiceProxies>();
+
+    AgentConfigurationService agentConfig(proxies, instancedName("config-"));
+    agentConfig.unsafeDisableMonitor();
+    agentConfig.init();
+    agentConfig.bindTcp();
+    agentConfig.start();
+
+    vector<std::shared_ptr<TestAgent> > agents;
+    set<string> agentNames;
+    for (size_t i = 0;  i < NumAgents;  ++i) {
+        auto agent = make_shared<TestAgent>(proxies, instancedName("agent-"));
+        agent->config.account = { "benchCampaign", to_string(i) };
+
+        AugmentationConfig aug_conf;
+        aug_conf.name = "redis";
+        Json::Value av(Json::arrayValue);
+        av.append("id");
+        av.append("url");
+        av.append("exchange");
+        av.append("userIds.xchg");
+        av.append("winSurcharges.surcharge.USD/1M");
+        aug_conf.config["aug-list"] = av;
+        agent->config.addAugmentation(aug_conf);
+
+        agent->init();
+        agent->start();
+        agent->doConfig(agent->config);
+
+        agentNames.insert(agent->serviceName());
+        agents.push_back(agent);
+    }
+
+    RedisAugmentor aug("redis-augmentation", "redis-augmentation",
+                       proxies, redis);
+    aug.setBatching(window, maxBatchSize);
+    aug.init(RedisThreads);
+    aug.start();
+
+    BurstAugmentationLoop loop(proxies, agentNames);
+    loop.start();
+
+    this_thread::sleep_for(chrono::milliseconds(500));
+
+    ML::Timer timer;
+
+    while (loop.sent < NumRequests) {
+        loop.sendBurst(BurstSize);
+        while (loop.sent - loop.recv > 4 * BurstSize)
+            this_thread::yield();
+    }
+
+    Date deadline = Date::now().plusSeconds(10.0);
+    while (loop.recv < loop.sent && Date::now() < deadline)
+        this_thread::yield();
+
+    double elapsed = timer.elapsed_wall();
+
+    cerr << "window=" << window * 1000.0 << "ms"
+         << " maxBatchSize=" << maxBatchSize
+         << " sent=" << loop.sent
+         << " recv=" << loop.recv
+         << " elapsed=" << elapsed << "s"
+         << " rate=" << loop.recv / elapsed << "/s"
+         << endl;
+
+    loop.shutdown();
+    aug.shutdown();
+    for (auto & agent : agents)
+        agent->shutdown();
+    agentConfig.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE( redisAugmentorBench )
+{
+    Redis::RedisTemporaryServer redis;
+    {
+        using namespace Redis;
+        AsyncConnection async_redis(redis);
+        Command mset(MSET);
+        mset.addArg("RTBkit:aug:winSurcharges.surcharge.USD/1M:50");
+        mset.addArg(123.45);
+        mset.addArg("RTBkit:aug:id:85885bb0-b91b-11e2-c4cf-7fba90171555");
+        mset.addArg(9876);
+        mset.addArg("RTBkit:aug:url:http://myonlinearcade.com/");
+        mset.addArg("JSCRIPT");
+
+        Result result = async_redis.exec(mset);
+        BOOST_CHECK_EQUAL(result.ok(), true);
+    }
+
+    runBench(redis, 0.0, 1);
+    runBench(redis, 0.0005, 64);
+    runBench(redis, 0.0005, 256);
+    runBench(redis, 0.002, 1024);
+}
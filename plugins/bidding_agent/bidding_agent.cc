@@ -62,7 +62,9 @@ BiddingAgent(std::shared_ptr<ServiceProxies> proxies,
       toPostAuctionServices(getZmqContext()),
       toConfigurationAgent(getZmqContext()),
       toRouterChannel(65536),
-      requiresAllCB(true)
+      requiresAllCB(true),
+      requestCacheSize(0),
+      requestCacheSeq(0)
 {
 }
 
@@ -75,7 +77,9 @@ BiddingAgent(ServiceBase& parent,
       toPostAuctionServices(getZmqContext()),
       toConfigurationAgent(getZmqContext()),
       toRouterChannel(65536),
-      requiresAllCB(true)
+      requiresAllCB(true),
+      requestCacheSize(0),
+      requestCacheSeq(0)
 {
 }
 
@@ -403,6 +407,8 @@ handleBidRequest(const std::string & fromRouter,
         requests[id].fromRouter = fromRouter;
     }
 
+    cacheRequest(id, br, augmentations);
+
     callback(timestamp, id, br, bids, timeLeftMs, augmentations, wcm);
 }
 
@@ -426,11 +432,78 @@ handleResult(const std::vector<std::string>& msg, ResultCbFn& callback)
     callback(result);
 
     if (result.result == BS_DROPPEDBID) {
-        lock_guard<mutex> guard (requestsLock);
-        requests.erase(Id(msg[3]));
+        {
+            lock_guard<mutex> guard (requestsLock);
+            requests.erase(result.auctionId);
+        }
+        lock_guard<mutex> guard (requestCacheLock);
+        requestCache.erase(result.auctionId);
     }
 }
 
+void
+BiddingAgent::
+enableRequestCache(size_t maxEntries)
+{
+    lock_guard<mutex> guard (requestCacheLock);
+
+    requestCacheSize = maxEntries;
+    if (!requestCacheSize) {
+        requestCache.clear();
+        requestCacheOrder.clear();
+    }
+}
+
+void
+BiddingAgent::
+cacheRequest(const Id & id,
+             const std::shared_ptr<BidRequest> & request,
+             const Json::Value & augmentations)
+{
+    lock_guard<mutex> guard (requestCacheLock);
+    if (!requestCacheSize) return;
+
+    CachedRequest & entry = requestCache[id];
+    entry.request = request;
+    entry.augmentations = augmentations;
+    entry.bids = Bids();
+    entry.metadata = Json::Value();
+    entry.seq = ++requestCacheSeq;
+    requestCacheOrder.push_back(make_pair(id, entry.seq));
+
+    // Ids of entries that were already dropped or cached again are still
+    // in the order queue, which bounds both.  Only the latest entry for an
+    // id evicts it.
+    while (requestCacheOrder.size() > requestCacheSize) {
+        auto it = requestCache.find(requestCacheOrder.front().first);
+        if (it != requestCache.end()
+            && it->second.seq == requestCacheOrder.front().second)
+            requestCache.erase(it);
+        requestCacheOrder.pop_front();
+    }
+}
+
+bool
+BiddingAgent::
+rehydrate(BidResult & result) const
+{
+    lock_guard<mutex> guard (requestCacheLock);
+
+    auto it = requestCache.find(result.auctionId);
+    if (it == requestCache.end()) {
+        recordHit("requestCache.misses");
+        return false;
+    }
+
+    const CachedRequest & entry = it->second;
+    result.request = entry.request;
+    result.augmentations = entry.augmentations;
+    result.ourBid = entry.bids;
+    result.metadata = entry.metadata;
+    recordHit("requestCache.hits");
+    return true;
+}
+
 void
 BiddingAgent::
 handleError(const std::vector<std::string>& msg, ErrorCbFn& callback)
@@ -503,6 +576,24 @@ doBid(Id id, const Bids & bids, const Json::Value & jsonMeta, const WinCostModel
 
     recordLevel((afterSend - beforeSend) * 1000.0, "timeTakenMs");
 
+    {
+        lock_guard<mutex> guard (requestCacheLock);
+
+        auto it = requestCache.find(id);
+        if (it != requestCache.end()) {
+            // No result will come back for an auction we didn't bid on
+            bool anyBid = false;
+            for (const Bid & bid : bids)
+                anyBid = anyBid || !bid.isNullBid();
+
+            if (anyBid) {
+                it->second.bids = bids;
+                it->second.metadata = jsonMeta;
+            }
+            else requestCache.erase(it);
+        }
+    }
+
     toRouterChannel.push(RouterMessage(
                     fromRouter, "BID", { id.toString(), response, model, meta }));
 
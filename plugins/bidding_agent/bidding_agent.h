@@ -31,6 +31,8 @@
 #include <vector>
 #include <thread>
 #include <map>
+#include <unordered_map>
+#include <deque>
 
 
 namespace RTBKIT {
@@ -113,6 +115,27 @@ struct BiddingAgent : public ServiceBase, public MessageLoop {
     void doPong(const std::string & fromRouter, Date sent, Date received,
                 const std::vector<std::string> & payload);
 
+    /** Keep the bid request, augmentations, bids and metadata of the last
+        maxEntries auctions that were bid on so that results received in
+        the lightweight format can be filled in locally with
+        rehydrate(). A size of 0, the default, disables the cache.
+
+        Entries are dropped in the order they were added, so the cache has
+        to be large enough to cover the delay of the slowest win
+        notification at the agent's bid rate.
+     */
+    void enableRequestCache(size_t maxEntries);
+
+    /** Fill in the request, bids, metadata and augmentations of a result
+        that was received without them from the request cache. Returns false
+        if the auction isn't in the cache anymore, in which case the result
+        is left untouched.
+
+        Meant to be called from the result callbacks, only for the results
+        that need more than the ids and the price.
+     */
+    bool rehydrate(BidResult & result) const;
+
 
     /**************************************************************************/
     /* CALLBACKS                                                              */
@@ -254,6 +277,26 @@ private:
     std::map<Id, RequestStatus> requests;
     std::mutex requestsLock; // Protects concurrent writes to requests
 
+    struct CachedRequest {
+        std::shared_ptr<BidRequest> request;
+        Json::Value augmentations;
+        Bids bids;
+        Json::Value metadata;
+        uint64_t seq;   ///< Identifies its live entry in requestCacheOrder
+    };
+
+    size_t requestCacheSize;
+    uint64_t requestCacheSeq;
+    std::unordered_map<Id, CachedRequest> requestCache;
+    // Insertion order, for eviction; an id that was cached again also has
+    // an older entry, which is skipped
+    std::deque<std::pair<Id, uint64_t> > requestCacheOrder;
+    mutable std::mutex requestCacheLock;
+
+    void cacheRequest(const Id & id,
+                      const std::shared_ptr<BidRequest> & request,
+                      const Json::Value & augmentations);
+
     bool requiresAllCB;
 
 
@@ -271,8 +314,14 @@ private:
 
     // void doHeartbeat();
 
+protected:
+    /** Dispatch a message received from a router to the callbacks.  Tests
+        call it directly to play the router's side.
+    */
     void handleRouterMessage(const std::string & fromRouter,
                              const std::vector<std::string>& msg);
+
+private:
     void handleError(const std::vector<std::string>& msg, ErrorCbFn& callback);
     void handleBidRequest(const std::string & fromRouter,
             const std::vector<std::string>& msg, BidRequestCbFn& callback);
@@ -8,3 +8,5 @@ LIBRTB_ROUTER_PROXY_LINK := \
 	ACE arch utils jsoncpp boost_thread zmq opstats bid_request services
 
 $(eval $(call library,bidding_agent,$(LIBRTB_ROUTER_PROXY_SOURCES),$(LIBRTB_ROUTER_PROXY_LINK)))
+
+$(eval $(call include_sub_make,bidding_agent_testing,testing,bidding_agent_testing.mk))
@@ -0,0 +1,3 @@
+# bidding_agent_testing.mk
+
+$(eval $(call test,request_cache_test,bidding_agent,boost))
@@ -0,0 +1,153 @@
+/* request_cache_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test for the bidding agent's request cache, which fills in lightweight
+   bid results locally.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/bidding_agent/bidding_agent.h"
+#include "rtbkit/common/win_cost_model.h"
+
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+namespace {
+
+/** Agent that is fed messages directly instead of through a router.  It
+    bids USD_CPM(2) on every request whose id doesn't start with "nobid",
+    and keeps the last result it was given.
+*/
+struct TestAgent : public BiddingAgent {
+
+    TestAgent()
+        : BiddingAgent(std::make_shared<ServiceProxies>(), "test_agent")
+    {
+        onBidRequest = [=] (double timestamp, const Id & id,
+                            std::shared_ptr<BidRequest> request,
+                            Bids bids, double timeLeftMs,
+                            const Json::Value & augmentations,
+                            const WinCostModel & wcm)
+            {
+                if (id.toString().find("nobid") != 0)
+                    bids[0].bid(0, USD_CPM(2));
+                Json::Value meta;
+                meta["id"] = id.toString();
+                doBid(id, bids, meta);
+            };
+
+        auto onResult = [=] (const BidResult & result)
+            {
+                lastResult = result;
+            };
+        onWin = onLoss = onNoBudget = onTooLate = onInvalidBid
+            = onDroppedBid = onResult;
+    }
+
+    void auction(const string & id)
+    {
+        BidRequest request;
+        request.auctionId = Id(id);
+        request.exchange = "test";
+        request.imp.emplace_back();
+        request.imp[0].id = Id(1);
+
+        handleRouterMessage("router", {
+                "AUCTION", "1368153863", id, "datacratic",
+                request.toJsonStr(), "[{\"spot\":0,\"creatives\":[0]}]",
+                "50", "{\"random\":{}}",
+                WinCostModel().toJson().toString() });
+    }
+
+    /** Send a lightweight result for the auction, as the router and the
+        post auction loop do, and return it rehydrated.
+    */
+    bool result(const string & status, const string & id)
+    {
+        handleRouterMessage("router", {
+                status, "1368153864", "guaranteed", id, "0",
+                USD_CPM(1).toString() });
+
+        BOOST_CHECK_EQUAL(lastResult.auctionId, Id(id));
+        BOOST_CHECK(!lastResult.request);
+        return rehydrate(lastResult);
+    }
+
+    BidResult lastResult;
+};
+
+} // file scope
+
+
+BOOST_AUTO_TEST_CASE( test_request_cache_hit_and_miss )
+{
+    TestAgent agent;
+
+    // Without a cache nothing can be rehydrated
+    agent.auction("a0");
+    BOOST_CHECK(!agent.result("WIN", "a0"));
+
+    agent.enableRequestCache(2);
+
+    agent.auction("a1");
+    BOOST_REQUIRE(agent.result("WIN", "a1"));
+    const BidResult & result = agent.lastResult;
+    BOOST_REQUIRE(result.request);
+    BOOST_CHECK_EQUAL(result.request->auctionId, Id("a1"));
+    BOOST_REQUIRE_EQUAL(result.ourBid.size(), 1);
+    BOOST_CHECK_EQUAL(result.ourBid[0].price, USD_CPM(2));
+    BOOST_CHECK_EQUAL(result.metadata["id"].asString(), "a1");
+    BOOST_CHECK(result.augmentations.isMember("random"));
+
+    // A result for an auction we never saw
+    BOOST_CHECK(!agent.result("LOSS", "unknown"));
+
+    // Auctions that weren't bid on aren't kept
+    agent.auction("nobid1");
+    BOOST_CHECK(!agent.result("LOSS", "nobid1"));
+
+    // Dropped bids are removed once their callback has run
+    agent.auction("a2");
+    BOOST_CHECK(!agent.result("DROPPEDBID", "a2"));
+
+    // The oldest entries are evicted first
+    agent.auction("a3");
+    agent.auction("a4");
+    agent.auction("a5");
+    BOOST_CHECK(!agent.result("WIN", "a3"));
+    BOOST_CHECK(agent.result("WIN", "a4"));
+    BOOST_CHECK(agent.result("WIN", "a5"));
+
+    agent.enableRequestCache(0);
+    BOOST_CHECK(!agent.result("WIN", "a5"));
+}
+
+BOOST_AUTO_TEST_CASE( test_request_cache_same_id )
+{
+    TestAgent agent;
+    agent.enableRequestCache(2);
+
+    // Caching an id again moves it to the back, so the older entry for it
+    // doesn't evict it
+    agent.auction("a1");
+    agent.auction("a2");
+    agent.auction("a1");
+    agent.auction("a3");
+    BOOST_CHECK(agent.result("WIN", "a1"));
+    BOOST_CHECK(!agent.result("WIN", "a2"));
+    BOOST_CHECK(agent.result("WIN", "a3"));
+
+    // Nor does the entry of an id that was dropped and cached again
+    agent.auction("a4");
+    BOOST_CHECK(!agent.result("DROPPEDBID", "a4"));
+    agent.auction("a4");
+    agent.auction("a5");
+    BOOST_CHECK(agent.result("WIN", "a4"));
+    BOOST_CHECK(agent.result("WIN", "a5"));
+}
@@ -0,0 +1,305 @@
+/* binary_event_file.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Block compressed, indexed files of binary events.
+*/
+
+#include "binary_event_file.h"
+#include "jml/arch/exception.h"
+#include <zlib.h>
+
+
+using namespace std;
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* BINARY EVENT FILE OUTPUT                                                  */
+/*****************************************************************************/
+
+BinaryEventFileOutput::
+BinaryEventFileOutput(const boost::regex & channels)
+    : channels(channels),
+      numEvents_(0), rawBytes_(0), compressedBytes_(0)
+{
+}
+
+BinaryEventFileOutput::
+~BinaryEventFileOutput()
+{
+    close();
+}
+
+void
+BinaryEventFileOutput::
+open(const std::string & filename)
+{
+    close();
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    stream.open(filename.c_str(),
+                std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!stream)
+        throw ML::Exception("couldn't open binary event file " + filename);
+
+    this->filename = filename;
+    index.clear();
+}
+
+void
+BinaryEventFileOutput::
+close()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!stream.is_open())
+        return;
+
+    BinaryEventFileTrailer trailer;
+    trailer.indexOffset = stream.tellp();
+    trailer.numBlocks = index.size();
+    trailer.magic = BinaryEventFileTrailer::Magic;
+
+    stream.write((const char *)index.data(),
+                 index.size() * sizeof(BinaryEventBlockIndex));
+    stream.write((const char *)&trailer, sizeof(trailer));
+    stream.close();
+
+    if (!stream)
+        throw ML::Exception("error closing binary event file " + filename);
+}
+
+bool
+BinaryEventFileOutput::
+matches(const BinaryEvent & event)
+{
+    channelKey.assign(event.channel, event.channelLength);
+
+    auto it = channelMatches.find(channelKey);
+    if (it == channelMatches.end()) {
+        bool match = boost::regex_match(channelKey, channels);
+        it = channelMatches.insert(make_pair(channelKey, match)).first;
+    }
+
+    return it->second;
+}
+
+void
+BinaryEventFileOutput::
+writeBatch(const char * data, size_t length)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!stream.is_open())
+        return;
+
+    uint32_t numMatching = 0, numTotal = 0;
+    int64_t firstTimestamp = BinaryEventWriter::NoTimestamp;
+    int64_t lastTimestamp = BinaryEventWriter::NoTimestamp;
+
+    // First pass: see what matches.  Most of the time everything or
+    // nothing does.
+    forEachBinaryEvent(data, length, [&] (const BinaryEvent & event)
+        {
+            ++numTotal;
+            if (!matches(event))
+                return;
+            ++numMatching;
+            if (event.timestamp != BinaryEventWriter::NoTimestamp) {
+                if (firstTimestamp == BinaryEventWriter::NoTimestamp)
+                    firstTimestamp = event.timestamp;
+                lastTimestamp = event.timestamp;
+            }
+        });
+
+    if (numMatching == 0)
+        return;
+
+    if (numMatching == numTotal) {
+        writeBlock(data, length, numMatching, firstTimestamp, lastTimestamp);
+        return;
+    }
+
+    // Some of the events are for other outputs; rebuild a batch with only
+    // our own.
+    filtered.clear();
+    filtered.append(data, sizeof(BinaryEventBatchHeader));
+
+    forEachBinaryEvent(data, length, [&] (const BinaryEvent & event)
+        {
+            if (matches(event))
+                filtered.append(event.start, event.length());
+        });
+
+    auto & header = *(BinaryEventBatchHeader *)&filtered[0];
+    header.numEvents = numMatching;
+    header.eventBytes = filtered.size() - sizeof(BinaryEventBatchHeader);
+
+    writeBlock(filtered.c_str(), filtered.size(), numMatching,
+               firstTimestamp, lastTimestamp);
+}
+
+void
+BinaryEventFileOutput::
+writeBlock(const char * data, size_t length,
+           uint32_t numEvents,
+           int64_t firstTimestamp, int64_t lastTimestamp)
+{
+    uLongf compressedLength = compressBound(length);
+    compressed.resize(compressedLength);
+
+    int res = compress2((Bytef *)&compressed[0], &compressedLength,
+                        (const Bytef *)data, length, Z_BEST_SPEED);
+    if (res != Z_OK)
+        throw ML::Exception("error compressing binary events: %d", res);
+
+    BinaryEventBlockIndex entry;
+    entry.offset = stream.tellp();
+    entry.firstTimestamp = firstTimestamp;
+    entry.lastTimestamp = lastTimestamp;
+    entry.numEvents = numEvents;
+    entry.reserved = 0;
+
+    BinaryEventBlockHeader header;
+    header.magic = BinaryEventBlockHeader::Magic;
+    header.compressedLength = compressedLength;
+    header.rawLength = length;
+    header.numEvents = numEvents;
+
+    stream.write((const char *)&header, sizeof(header));
+    stream.write(compressed.c_str(), compressedLength);
+    if (!stream)
+        throw ML::Exception("error writing binary event file " + filename);
+
+    index.push_back(entry);
+
+    numEvents_ += numEvents;
+    rawBytes_ += length;
+    compressedBytes_ += compressedLength;
+}
+
+
+/*****************************************************************************/
+/* BINARY EVENT FILE READER                                                  */
+/*****************************************************************************/
+
+BinaryEventFileReader::
+BinaryEventFileReader(const std::string & filename)
+    : stream(filename.c_str(), std::ios::in | std::ios::binary)
+{
+    if (!stream)
+        throw ML::Exception("couldn't open binary event file " + filename);
+
+    BinaryEventFileTrailer trailer;
+
+    stream.seekg(0, std::ios::end);
+    int64_t fileSize = stream.tellg();
+
+    if (fileSize >= (int64_t)sizeof(trailer)) {
+        stream.seekg(fileSize - sizeof(trailer));
+        stream.read((char *)&trailer, sizeof(trailer));
+
+        if (stream && trailer.magic == BinaryEventFileTrailer::Magic) {
+            index.resize(trailer.numBlocks);
+            stream.seekg(trailer.indexOffset);
+            stream.read((char *)index.data(),
+                        index.size() * sizeof(BinaryEventBlockIndex));
+            if (!stream)
+                throw ML::Exception("couldn't read binary event file index");
+            return;
+        }
+    }
+
+    // No index; the file wasn't closed properly
+    stream.clear();
+    scanBlocks();
+}
+
+void
+BinaryEventFileReader::
+scanBlocks()
+{
+    stream.seekg(0, std::ios::end);
+    uint64_t fileSize = stream.tellg();
+    stream.seekg(0);
+
+    for (;;) {
+        BinaryEventBlockIndex entry;
+        entry.offset = stream.tellg();
+
+        BinaryEventBlockHeader header;
+        stream.read((char *)&header, sizeof(header));
+        if (!stream || header.magic != BinaryEventBlockHeader::Magic)
+            break;
+
+        entry.firstTimestamp = entry.lastTimestamp
+            = BinaryEventWriter::NoTimestamp;
+        entry.numEvents = header.numEvents;
+        entry.reserved = 0;
+
+        if (entry.offset + sizeof(header) + header.compressedLength > fileSize)
+            break;  // truncated last block
+
+        stream.seekg(header.compressedLength, std::ios::cur);
+
+        index.push_back(entry);
+    }
+
+    stream.clear();
+}
+
+std::string
+BinaryEventFileReader::
+readBlock(const BinaryEventBlockIndex & block)
+{
+    stream.seekg(block.offset);
+
+    BinaryEventBlockHeader header;
+    stream.read((char *)&header, sizeof(header));
+    if (!stream || header.magic != BinaryEventBlockHeader::Magic)
+        throw ML::Exception("bad binary event block header");
+
+    std::string compressed(header.compressedLength, '\0');
+    stream.read(&compressed[0], compressed.size());
+    if (!stream)
+        throw ML::Exception("truncated binary event block");
+
+    std::string result(header.rawLength, '\0');
+    uLongf length = result.size();
+    int res = uncompress((Bytef *)&result[0], &length,
+                         (const Bytef *)compressed.c_str(),
+                         compressed.size());
+    if (res != Z_OK || length != header.rawLength)
+        throw ML::Exception("error decompressing binary event block: %d",
+                            res);
+
+    return result;
+}
+
+void
+BinaryEventFileReader::
+forEachEvent(const std::function<void (const BinaryEvent &)> & onEvent,
+             Date start, Date end)
+{
+    int64_t startUs = start == Date()
+        ? INT64_MIN : start.secondsSinceEpoch() * 1000000.0;
+    int64_t endUs = end == Date()
+        ? INT64_MAX : end.secondsSinceEpoch() * 1000000.0;
+
+    for (auto & block: index) {
+        bool timestamped
+            = block.firstTimestamp != BinaryEventWriter::NoTimestamp;
+        if (timestamped
+            && (block.lastTimestamp < startUs
+                || block.firstTimestamp >= endUs))
+            continue;
+
+        std::string batch = readBlock(block);
+        forEachBinaryEvent(batch.c_str(), batch.size(), onEvent);
+    }
+}
+
+} // namespace RTBKIT
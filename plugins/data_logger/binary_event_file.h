@@ -0,0 +1,158 @@
+/* binary_event_file.h                                             -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Block compressed, indexed files of binary events.
+*/
+
+#pragma once
+
+#include "rtbkit/common/binary_event_log.h"
+#include <boost/regex.hpp>
+#include <unordered_map>
+#include <fstream>
+#include <mutex>
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* BINARY EVENT FILE FORMAT                                                  */
+/*****************************************************************************/
+
+/** A binary event file is a sequence of zlib compressed batches (as sent by
+    a BinaryEventPublisher), followed by an index of the blocks so that a
+    time range can be read without decompressing the whole file.
+
+    file    := block* index trailer
+    block   := BinaryEventBlockHeader compressed-batch
+    index   := BinaryEventBlockIndex * numBlocks
+    trailer := BinaryEventFileTrailer
+
+    A file that wasn't closed properly has no index; it can still be read
+    sequentially.
+*/
+
+struct BinaryEventBlockHeader {
+    enum { Magic = 0x42425452 };  ///< "RTBB"
+
+    uint32_t magic;
+    uint32_t compressedLength;
+    uint32_t rawLength;
+    uint32_t numEvents;
+} __attribute__((__packed__));
+
+struct BinaryEventBlockIndex {
+    uint64_t offset;         ///< Offset of the BinaryEventBlockHeader
+    int64_t firstTimestamp;  ///< Of the first timestamped event, in us
+    int64_t lastTimestamp;   ///< Of the last timestamped event, in us
+    uint32_t numEvents;
+    uint32_t reserved;
+} __attribute__((__packed__));
+
+struct BinaryEventFileTrailer {
+    enum { Magic = 0x49425452 };  ///< "RTBI"
+
+    uint64_t indexOffset;
+    uint32_t numBlocks;
+    uint32_t magic;
+} __attribute__((__packed__));
+
+
+/*****************************************************************************/
+/* BINARY EVENT FILE OUTPUT                                                  */
+/*****************************************************************************/
+
+/** Writes the batches of binary events received by the data logger to a
+    file.  Batches that only contain matching channels are compressed
+    straight from the received message; others have the non matching events
+    filtered out first.
+
+    The channel filter is a regex, but it's only evaluated once per distinct
+    channel name.
+
+    Thread safe.
+*/
+
+struct BinaryEventFileOutput {
+
+    BinaryEventFileOutput(const boost::regex & channels = boost::regex(".*"));
+
+    ~BinaryEventFileOutput();
+
+    void open(const std::string & filename);
+
+    /** Write the index and close the file. */
+    void close();
+
+    /** Write the matching events of the given batch. */
+    void writeBatch(const char * data, size_t length);
+
+    /** Number of events written to the file so far. */
+    uint64_t numEvents() const { return numEvents_; }
+
+    /** Number of (uncompressed, compressed) bytes written so far. */
+    std::pair<uint64_t, uint64_t> bytesWritten() const
+    {
+        return std::make_pair(rawBytes_, compressedBytes_);
+    }
+
+private:
+    boost::regex channels;
+    std::unordered_map<std::string, bool> channelMatches;
+    std::string channelKey;
+
+    bool matches(const BinaryEvent & event);
+
+    std::mutex lock;
+    std::ofstream stream;
+    std::string filename;
+    std::vector<BinaryEventBlockIndex> index;
+    std::string compressed;
+    std::string filtered;
+
+    uint64_t numEvents_;
+    uint64_t rawBytes_;
+    uint64_t compressedBytes_;
+
+    void writeBlock(const char * data, size_t length,
+                    uint32_t numEvents,
+                    int64_t firstTimestamp, int64_t lastTimestamp);
+};
+
+
+/*****************************************************************************/
+/* BINARY EVENT FILE READER                                                  */
+/*****************************************************************************/
+
+/** Reads back a file written by BinaryEventFileOutput. */
+
+struct BinaryEventFileReader {
+
+    BinaryEventFileReader(const std::string & filename);
+
+    /** Index of the blocks of the file.  Rebuilt by scanning the file if it
+        wasn't closed properly.
+    */
+    const std::vector<BinaryEventBlockIndex> & blocks() const
+    {
+        return index;
+    }
+
+    /** Return the decompressed batch of the given block. */
+    std::string readBlock(const BinaryEventBlockIndex & block);
+
+    /** Call onEvent for every event of every block that may contain events
+        in [start, end).  Passing Date() means no bound.
+    */
+    void forEachEvent(const std::function<void (const BinaryEvent &)> & onEvent,
+                      Date start = Date(), Date end = Date());
+
+private:
+    std::ifstream stream;
+    std::vector<BinaryEventBlockIndex> index;
+
+    void scanBlocks();
+};
+
+} // namespace RTBKIT
@@ -0,0 +1,90 @@
+/* binary_event_log_to_text.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Converts binary event files written by the data logger back to the text
+   format of the logger's file outputs.
+*/
+
+#include "binary_event_file.h"
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/positional_options.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <iostream>
+
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+int main(int argc, char ** argv)
+{
+    vector<string> files;
+    string channels = ".*";
+    string start, end;
+
+    using namespace boost::program_options;
+
+    options_description options("Options");
+    options.add_options()
+        ("channels,c", value<string>(&channels),
+         "Regex of the channels to convert")
+        ("start,s", value<string>(&start),
+         "Only convert events at or after this date")
+        ("end,e", value<string>(&end),
+         "Only convert events before this date")
+        ("file", value<vector<string> >(&files),
+         "Binary event files to convert")
+        ("help,h", "Prints this message");
+
+    positional_options_description positional;
+    positional.add("file", -1);
+
+    variables_map vm;
+    store(command_line_parser(argc, argv)
+          .options(options).positional(positional).run(), vm);
+    notify(vm);
+
+    if (vm.count("help") || files.empty()) {
+        cerr << "usage: " << argv[0] << " [options] file..." << endl
+             << options << endl;
+        return 1;
+    }
+
+    boost::regex channelRegex(channels);
+    Date startDate = start.empty() ? Date() : Date::parseDefaultUtc(start);
+    Date endDate = end.empty() ? Date() : Date::parseDefaultUtc(end);
+
+    int64_t startUs = start.empty()
+        ? INT64_MIN : startDate.secondsSinceEpoch() * 1000000.0;
+    int64_t endUs = end.empty()
+        ? INT64_MAX : endDate.secondsSinceEpoch() * 1000000.0;
+
+    auto onEvent = [&] (const BinaryEvent & event)
+        {
+            if (event.timestamp != BinaryEventWriter::NoTimestamp
+                && (event.timestamp < startUs || event.timestamp >= endUs))
+                return;
+
+            if (!boost::regex_match(event.channelStr(), channelRegex))
+                return;
+
+            // Same layout as the logger's text file outputs: one message per
+            // line, fields separated by tabs
+            auto fields = event.toText();
+            for (unsigned i = 0;  i < fields.size();  ++i) {
+                if (i != 0) cout << '\t';
+                cout << fields[i];
+            }
+            cout << '\n';
+        };
+
+    for (auto & file: files) {
+        BinaryEventFileReader reader(file);
+        reader.forEachEvent(onEvent, startDate, endDate);
+    }
+
+    return 0;
+}
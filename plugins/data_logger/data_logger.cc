@@ -8,6 +8,7 @@
 
 
 #include "data_logger.h"
+#include "rtbkit/common/frequency_cap_store.h"
 
 
 using namespace std;
@@ -19,6 +20,7 @@ DataLogger(const string & serviceName, std::shared_ptr<ServiceProxies> proxies,
            bool monitor, size_t bufferSize)
     : ServiceBase(serviceName, proxies),
       Logger(proxies->zmqContext, bufferSize),
+      forwardBinaryEventsAsText(false),
       multipleSubscriber(proxies->zmqContext),
       monitorProviderClient(proxies->zmqContext, *this),
       monitor_(monitor),
@@ -42,6 +44,22 @@ init()
     multipleSubscriber.init(getServices()->config);
     multipleSubscriber.messageHandler
         = [&] (vector<zmq::message_t> && msg) {
+        auto isChannel = [&] (const string & channel)
+        {
+            return msg.size() == 2
+                && msg[0].size() == channel.size()
+                && !memcmp(msg[0].data(), channel.c_str(), channel.size());
+        };
+
+        if (isChannel(BinaryEventChannel)) {
+            this->handleBinaryEvents(msg[1]);
+            return;
+        }
+
+        // binary counts for the routers' frequency caps; not for the logs
+        if (isChannel(FrequencyCapChannel))
+            return;
+
         // forward to logger class
         vector<string> s;
         s.reserve(msg.size());
@@ -85,6 +103,40 @@ connectAllServiceProviders(const string & serviceClass, const string & epName)
     multipleSubscriber.connectAllServiceProviders(serviceClass, epName);
 }
 
+void
+DataLogger::
+addBinaryOutput(std::shared_ptr<BinaryEventFileOutput> output)
+{
+    std::lock_guard<std::mutex> guard(binaryOutputsLock);
+    binaryOutputs.push_back(output);
+}
+
+void
+DataLogger::
+handleBinaryEvents(const zmq::message_t & batch)
+{
+    const char * data = (const char *)batch.data();
+    size_t length = batch.size();
+
+    try {
+        {
+            std::lock_guard<std::mutex> guard(binaryOutputsLock);
+            for (auto & output: binaryOutputs)
+                output->writeBatch(data, length);
+        }
+
+        if (!forwardBinaryEventsAsText)
+            return;
+
+        forEachBinaryEvent(data, length, [&] (const BinaryEvent & event)
+            {
+                this->logMessageNoTimestamp(event.toText());
+            });
+    } catch (const std::exception & exc) {
+        recordHit("binaryEvents.badBatch");
+    }
+}
+
 /** MonitorProvider interface */
 string
 DataLogger::
@@ -18,6 +18,7 @@
 #include "rtbkit/core/monitor/monitor_provider.h"
 
 #include "soa/logger/logger.h"
+#include "binary_event_file.h"
 
 namespace RTBKIT {
 
@@ -38,6 +39,19 @@ struct DataLogger : public Datacratic::ServiceBase,
     void connectAllServiceProviders(const std::string & serviceClass,
                                     const std::string & epName);
 
+    /** Add an output that writes the binary events published by the router
+        and the post auction loop as they are received.  Batches that can't
+        be decoded are dropped and counted as binaryEvents.badBatch.
+    */
+    void addBinaryOutput(std::shared_ptr<BinaryEventFileOutput> output);
+
+    /** Whether binary events are also decoded and passed on to the
+        (text) logger outputs in the format they had before they were
+        binary.  This decodes every event, so it's only worth it for
+        loggers with text outputs for them.  Defaults to false.
+    */
+    bool forwardBinaryEventsAsText;
+
     void unsafeDisableMonitor() {
         monitorProviderClient.inhibit_ = true;
     }
@@ -58,6 +72,12 @@ struct DataLogger : public Datacratic::ServiceBase,
 
     bool monitor_;
     LoopMonitor loopMonitor_;
+
+private:
+    void handleBinaryEvents(const zmq::message_t & batch);
+
+    std::mutex binaryOutputsLock;
+    std::vector<std::shared_ptr<BinaryEventFileOutput> > binaryOutputs;
 };
 
 } // namespace RTKBIT
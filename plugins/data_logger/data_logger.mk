@@ -2,9 +2,14 @@
 # Sunil Rottoo 
 
 LIBRTBKIT_DATA_LOGGER_SOURCES := \
-	data_logger.cc
+	data_logger.cc \
+	binary_event_file.cc
 
 LIBRTBKIT_DATA_LOGGER_LINK := \
-	ACE arch utils logger boost_thread zmq opstats services monitor
+	ACE arch utils logger boost_thread zmq opstats services monitor rtb z
 
 $(eval $(call library,data_logger,$(LIBRTBKIT_DATA_LOGGER_SOURCES),$(LIBRTBKIT_DATA_LOGGER_LINK)))
+
+$(eval $(call program,binary_event_log_to_text,data_logger boost_program_options boost_regex))
+
+$(eval $(call include_sub_make,data_logger_testing,testing,data_logger_testing.mk))
@@ -0,0 +1,104 @@
+/** binary_event_file_test.cc                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Tests for the binary event files written by the data logger.
+
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/plugins/data_logger/binary_event_file.h"
+#include "jml/utils/environment.h"
+
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+Env_Option<string> tmpDir("TMP", "./tmp");
+
+Date base = Date::fromSecondsSinceEpoch(1368153863.0);
+
+/** Batch of a WIN and a LOSS, count seconds after base. */
+string makeBatch(int count)
+{
+    BinaryEventWriter writer;
+    writer.add("WIN", base.plusSeconds(count), "auction", count);
+    writer.add("LOSS", base.plusSeconds(count), "auction", count);
+    return writer.release();
+}
+
+vector<vector<string> > readAll(BinaryEventFileReader & reader,
+                                Date start = Date(), Date end = Date())
+{
+    vector<vector<string> > result;
+    reader.forEachEvent([&] (const BinaryEvent & event)
+                        {
+                            result.push_back(event.toText());
+                        },
+                        start, end);
+    return result;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( binaryEventFileRoundTrip )
+{
+    BOOST_REQUIRE_EQUAL(system(("mkdir -p " + tmpDir.get()).c_str()), 0);
+    string filename = tmpDir.get() + "/binary_event_file_test.rtbe";
+
+    {
+        // Only the wins go to the file
+        BinaryEventFileOutput output(boost::regex("WIN"));
+        output.open(filename);
+        for (unsigned i = 0;  i < 3;  ++i) {
+            string batch = makeBatch(i * 100);
+            output.writeBatch(batch.c_str(), batch.size());
+        }
+        BOOST_CHECK_EQUAL(output.numEvents(), 3);
+    }
+
+    BinaryEventFileReader reader(filename);
+    BOOST_REQUIRE_EQUAL(reader.blocks().size(), 3);
+
+    auto events = readAll(reader);
+    BOOST_REQUIRE_EQUAL(events.size(), 3);
+    for (unsigned i = 0;  i < 3;  ++i) {
+        BOOST_CHECK_EQUAL(events[i][0], "WIN");
+        BOOST_CHECK_EQUAL(events[i].back(), to_string(i * 100));
+    }
+
+    // Blocks outside of the time range aren't read
+    events = readAll(reader, base.plusSeconds(50), base.plusSeconds(150));
+    BOOST_REQUIRE_EQUAL(events.size(), 1);
+    BOOST_CHECK_EQUAL(events[0].back(), "100");
+
+    // A file that wasn't closed has no index, but its blocks can still be
+    // read by scanning it
+    string unclosed = tmpDir.get() + "/binary_event_file_test_unclosed.rtbe";
+    {
+        ifstream in(filename.c_str(), ios::binary);
+        string contents((istreambuf_iterator<char>(in)),
+                        istreambuf_iterator<char>());
+
+        BinaryEventFileTrailer trailer;
+        memcpy(&trailer, &contents[contents.size() - sizeof(trailer)],
+               sizeof(trailer));
+
+        // Cut off the index and leave half of a block behind
+        ofstream out(unclosed.c_str(), ios::binary);
+        out.write(contents.c_str(), trailer.indexOffset);
+        out.write(contents.c_str(), sizeof(BinaryEventBlockHeader) + 2);
+    }
+
+    BinaryEventFileReader scanned(unclosed);
+    BOOST_CHECK_EQUAL(scanned.blocks().size(), 3);
+    BOOST_CHECK_EQUAL(readAll(scanned).size(), 3);
+}
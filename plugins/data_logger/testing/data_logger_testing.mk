@@ -0,0 +1,8 @@
+#------------------------------------------------------------------------------#
+# data_logger_testing.mk
+# Copyright (c) 2013 Datacratic.  All rights reserved.
+#
+# Makefile for the data logger tests.
+#------------------------------------------------------------------------------#
+
+$(eval $(call test,binary_event_file_test,data_logger,boost))
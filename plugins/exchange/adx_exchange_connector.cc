@@ -13,6 +13,7 @@
 #include <unordered_set>
 #include <type_traits>
 #include <string>
+#include <cctype>    // isalnum
 #include <iterator>  // back_inserter
 #include <algorithm> // transform
 #include <boost/any.hpp>
@@ -73,6 +74,62 @@ typedef ::BidResponse GoogleBidResponse ;
 
 namespace {
 
+/**
+ *    Message &threadMessage ()
+ *
+ *    protocol buffer message owned by the calling thread.  Parsing into
+ *    (or serializing from) the same message each time keeps the memory
+ *    of its repeated and string fields, so that after the first few
+ *    requests a thread no longer allocates for them.  The messages live
+ *    as long as the (long lived) exchange threads.
+ */
+template<typename Message>
+Message &
+threadMessage ()
+{
+    static __thread Message * message = 0;
+    if (!message)
+        message = new Message();
+    return *message;
+}
+
+/**
+ *    Id binaryToId ()
+ *
+ *    turns one of Google's binary ids into an Id.  The 16 byte ids
+ *    (BidRequest.id, and most hosted match data) are stored directly as the
+ *    128 bit value that parsing their lowercase hex representation would
+ *    give; anything else goes through hex.
+ */
+Id
+binaryToId (const std::string& bytes)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    if (bytes.size() == 16)
+    {
+        const unsigned char* pc = reinterpret_cast<const unsigned char*>(bytes.data());
+        uint64_t high = 0, low = 0;
+        for (auto i=0 ; i<8 ; ++i) high = (high << 8) | pc[i];
+        for (auto i=8 ; i<16 ; ++i) low = (low << 8) | pc[i];
+
+        Id result;
+        result.type = Id::HEX128LC;
+        result.val1 = low;
+        result.val2 = high;
+        return result;
+    }
+
+    std::string hex(bytes.size() * 2, '0');
+    for (auto i=0 ; i<bytes.size(); ++i)
+    {
+        unsigned char c = bytes[i];
+        hex[2*i]   = digits[c >> 4];
+        hex[2*i+1] = digits[c & 15];
+    }
+    return Id(hex);
+}
+
 /**
  *    void ParseGbrMobile ()
  *
@@ -347,8 +404,9 @@ parseBidRequest(HttpAuctionHandler & connection,
         return std::shared_ptr<BidRequest> ();
     }
 
-    // Try and parse the protocol buffer payload
-    GoogleBidRequest gbr;
+    // Try and parse the protocol buffer payload, into this thread's
+    // message so that its buffers are reused from one request to the next
+    auto& gbr = threadMessage<GoogleBidRequest>();
     if (!gbr.ParseFromString (payload))
     {
         connection.sendErrorResponse("couldn't decode BidRequest message");
@@ -370,18 +428,8 @@ parseBidRequest(HttpAuctionHandler & connection,
 
     auto& br = *res ;
 
-    // TODO: check reuse
-    auto binary_to_hexstr = [] (const std::string& str)
-    {
-        std::ostringstream os;
-        os << std::hex << std::setfill('0');
-        const unsigned char* pc = reinterpret_cast<const unsigned char*>(str.c_str()) ;
-        for (auto i=0 ; i<str.size(); i++,pc++) os << std::setw(2) << int(*pc) ;
-        return os.str() ;
-    };
-
-    // TODO couldn't get Id() to represent correctly [required bytes id = 2;]
-    br.auctionId = Id (binary_to_hexstr(gbr.id()));
+    // [required bytes id = 2;] is 16 bytes
+    br.auctionId = binaryToId (gbr.id());
     // AdX is a second price auction type.
 
     br.timestamp = Date::now();
@@ -470,7 +518,7 @@ parseBidRequest(HttpAuctionHandler & connection,
 
     if (gbr.has_hosted_match_data())
     {
-        br.user->buyeruid = Id(binary_to_hexstr(gbr.hosted_match_data()));
+        br.user->buyeruid = binaryToId(gbr.hosted_match_data());
     }
 
     if (gbr.has_cookie_age_seconds())
@@ -536,23 +584,78 @@ parseBidRequest(HttpAuctionHandler & connection,
 }
 
 namespace {
+
+typedef AdXExchangeConnector::CreativeInfo::Fragment Fragment;
+
+/**
+ *   split the input string around its "${K}" macros, K being made
+ *   of word characters.  An unterminated "${" is literal text.
+ */
+vector<Fragment>
+compileTemplate (const string& in)
+{
+    vector<Fragment> result;
+    string text;
+
+    for (size_t pos = 0; pos < in.size(); )
+    {
+        size_t end = pos + 2;
+        if (in.compare(pos, 2, "${") == 0)
+            while (end < in.size() && (isalnum(in[end]) || in[end] == '_'))
+                ++end;
+
+        if (end > pos + 2 && end < in.size() && in[end] == '}')
+        {
+            result.push_back({ text, in.substr(pos + 2, end - pos - 2) });
+            text.clear();
+            pos = end + 1;
+        }
+        else text += in[pos++];
+    }
+
+    result.push_back({ text, "" });
+    return result;
+}
+
+bool
+usesAgentMacros (const vector<Fragment>& fragments)
+{
+    for (auto& fragment: fragments)
+        if (!fragment.macro.empty() && fragment.macro != "AUCTION_ID")
+            return true;
+    return false;
+}
+
 /**
  *   with dict = {{"K1","V1"}, {"K2","V2"}, ...}
- *   return a copy of the input string, in which all the
- *   occurrences of the string "${Ki}" are replaced
- *   by the string "Vi"
+ *   return the template in which all the "${Ki}" macros are replaced
+ *   by the string "Vi"; AUCTION_ID is the auction id, and macros that
+ *   are not in the dictionary are replaced by nothing.
  */
 string
-myFormat (const string& in, unordered_map<string,string>& dict)
+expandTemplate (const vector<Fragment>& fragments,
+                const unordered_map<string,string>& dict,
+                const string& auctionId)
 {
-    auto format_dict = [&](smatch const& what) {
-        return dict[what[1].str()];
-    };
-    static sregex envar = "${" >> (s1 = +_w) >> "}";
-    auto rc = regex_replace(in, envar, format_dict);
-    return rc;
-}
+    string result;
+    for (auto& fragment: fragments)
+    {
+        result += fragment.text;
+        if (fragment.macro.empty())
+            continue;
+        if (fragment.macro == "AUCTION_ID")
+        {
+            result += auctionId;
+            continue;
+        }
+        auto it = dict.find(fragment.macro);
+        if (it != dict.end())
+            result += it->second;
+    }
+    return result;
 }
+
+} // file scope
 /**
  *  prepare a Google BidResponse.
  *  Will handle
@@ -568,10 +671,12 @@ getResponse(const HttpAuctionHandler & connection,
     if (current->hasError())
         return getErrorResponse(connection, auction, current->error + ": " + current->details);
 
-    GoogleBidResponse gresp ;
+    auto& gresp = threadMessage<GoogleBidResponse>();
+    gresp.Clear();
     gresp.set_processing_time_ms(static_cast<uint32_t>(auction.timeUsed()*1000));
 
     auto en = exchangeName();
+    auto auctionId = auction.id.toString();
 
     // Create a spot for each of the bid responses
     for (auto spotNum: boost::irange(0UL, current->responses.size()))
@@ -602,20 +707,23 @@ getResponse(const HttpAuctionHandler & connection,
 
         // 1. take care of the agent defined macros,
         // passed along with every bid response, as a
-        // stringified JSON object (a la Python)
+        // stringified JSON object (a la Python).  Only
+        // creatives whose templates use them pay for this.
         unordered_map<string,string> dict;
-        auto 	vals = Json::parse (resp.meta);
-        for (auto name: vals.getMemberNames())
-            dict[name] = vals.atStr(name).asString();
-
-        // 2. enrich the above dictionary, with
-        // ExchangeConnector specific variables
-        dict["AUCTION_ID"] = auction.id.toString();
+        if (crinfo->uses_agent_macros_ && !resp.meta.empty())
+        {
+            auto vals = Json::parse (resp.meta);
+            for (auto name: vals.getMemberNames())
+                dict[name] = vals.atStr(name).asString();
+        }
 
-        // 3. populate, substituting whenever necessary
+        // 2. populate, substituting whenever necessary; AUCTION_ID
+        // is the ExchangeConnector specific variable
         ad->set_buyer_creative_id(crinfo->buyer_creative_id_);
-        ad->set_html_snippet(myFormat(crinfo->html_snippet_,dict));
-        ad->add_click_through_url(myFormat(crinfo->click_through_url_,dict)) ;
+        ad->set_html_snippet(expandTemplate(crinfo->html_snippet_fragments_,
+                                            dict, auctionId));
+        ad->add_click_through_url(expandTemplate(crinfo->click_through_url_fragments_,
+                                                 dict, auctionId));
         adslot->set_max_cpm_micros(MicroUSD_CPM(resp.price.maxPrice));
         adslot->set_id(auction.request->imp[spotNum].id.toInt());
     }
@@ -755,6 +863,13 @@ getCreativeCompatibility(const Creative & creative,
         });
     }
 
+    // Split the templates so that responses don't need to look for macros
+    crinfo->html_snippet_fragments_ = compileTemplate(crinfo->html_snippet_);
+    crinfo->click_through_url_fragments_ = compileTemplate(crinfo->click_through_url_);
+    crinfo->uses_agent_macros_
+        = usesAgentMacros(crinfo->html_snippet_fragments_)
+        || usesAgentMacros(crinfo->click_through_url_fragments_);
+
     // Cache the information
     result.info = crinfo;
 
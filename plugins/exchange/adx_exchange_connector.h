@@ -10,6 +10,7 @@
 
 #include <sstream>
 #include <unordered_set>
+#include <vector>
 
 #include "rtbkit/plugins/exchange/http_exchange_connector.h"
 
@@ -100,6 +101,23 @@ struct AdXExchangeConnector: public HttpExchangeConnector {
         std::unordered_set<int32_t> vendor_type_ ;  ///< Vendor Type
         std::unordered_set<int32_t> category_ ;     ///< Category
         std::unordered_set<int32_t> attribute_;     ///< Attribute
+
+        /** Piece of a snippet or click through url up to the next ${MACRO}
+            that it references.  Templates are split into fragments when
+            the creative is configured, so that building a response is a
+            matter of concatenation.
+        */
+        struct Fragment {
+            std::string text;   ///< Literal text before the macro
+            std::string macro;  ///< Macro name; empty for the trailing text
+        };
+
+        std::vector<Fragment> html_snippet_fragments_;
+        std::vector<Fragment> click_through_url_fragments_;
+
+        /// Do the templates use macros defined by the agent in its bid
+        /// meta?  If not, the meta is never looked at.
+        bool uses_agent_macros_;
     };
 
     virtual bool
@@ -8,6 +8,7 @@
 #include "rtbkit/plugins/bid_request/fbx_parsing.h"
 #include "rtbkit/plugins/bid_request/fbx_bid_request.h"
 #include "rtbkit/plugins/exchange/http_auction_handler.h"
+#include "rtbkit/plugins/exchange/response_writer.h"
 
 using namespace Datacratic;
 /*
@@ -118,31 +119,40 @@ getResponse(const HttpAuctionHandler & connection,
         return getErrorResponse(connection, auction,
                                 current->error + ": " + current->details);
 
-    FBX::BidResponse response;
-    response.requestId = auction.id;
+    // Same fields as an FBX::BidResponse, written directly
+    auto & writer = JsonResponseWriter::forThisThread();
+    writer.clear();
 
-    // Create a spot for each of the bid responses
+    writer.raw("{");
+    writer.key("requestId");
+    writer.id(auction.id);
+    writer.raw(",");
+    writer.key("bids");
+    writer.raw("[");
+
+    // Create a bid for each of the bid responses
+    bool first = true;
     for (unsigned spotNum = 0; spotNum < current->responses.size(); ++spotNum) {
         if (!current->hasValidResponse(spotNum))
             continue;
 
-        const Auction::Data * data = auction.getCurrentData();
-
-        auto & resp = data->winningResponse(spotNum);
+        auto & resp = current->winningResponse(spotNum);
 
-        response.bids.emplace_back();
-        auto & bid = response.bids.back();
+        if (!first) writer.raw(",");
+        first = false;
 
-        bid.adId = Id(resp.creativeId);
-        bid.bidNative.val = USD_CPM(resp.price.maxPrice);
+        writer.raw("{");
+        writer.key("adId");
+        writer.id(Id(resp.creativeId));
+        writer.raw(",");
+        writer.key("bidNative");
+        writer.number(double(USD_CPM(resp.price.maxPrice)));
+        writer.raw("}");
     }
 
-    static Datacratic::DefaultDescription<FBX::BidResponse> desc;
-    std::ostringstream stream;
-    StreamJsonPrintingContext context(stream);
-    desc.printJsonTyped(&response, context);
+    writer.raw("]}");
 
-    return HttpResponse(200, "application/json", stream.str());
+    return HttpResponse(200, "application/json", writer.str());
 }
 
 } // namespace RTBKIT
@@ -166,14 +166,11 @@ getResponse(const HttpAuctionHandler & connection,
     if (current->hasError())
         return getErrorResponse(connection, auction, current->error + ": " + current->details);
     
-    OpenRTB::BidResponse response;
-    response.id = auction.id;
-
-    std::map<Id, int> seatToBid;
+    auto & writer = OpenRTBResponseWriter::forThisThread();
 
     string en = exchangeName();
 
-    // Create a spot for each of the bid responses
+    // Create a bid for each of the bid responses
     for (unsigned spotNum = 0; spotNum < current->responses.size();
          ++spotNum) {
         if (!current->hasValidResponse(spotNum))
@@ -188,14 +185,11 @@ getResponse(const HttpAuctionHandler & connection,
             = std::static_pointer_cast<const AgentConfig>
             (resp.agentConfig).get();
 
-        // Get the exchange specific data for this campaign (if it exists)
-        bool cpinfo_ok = false;
-        Id seat("gumgum_dummy_seat"); 
-        try {
-            auto cpinfo = config->getProviderData<CampaignInfo>(en);
-            seat = cpinfo->seat;
-            cpinfo_ok = true;
-        } catch(ML::Exception& ex) {}
+        // Get the exchange specific data for this campaign (if it exists);
+        // bids without a seat are grouped together
+        Id seat;
+        if (config->providerData.count(en))
+            seat = config->getProviderData<CampaignInfo>(en)->seat;
 
         // Put in the fixed parts from the creative
         int creativeIndex = resp.agentCreativeIndex;
@@ -203,58 +197,68 @@ getResponse(const HttpAuctionHandler & connection,
         auto & creative = config->creatives.at(creativeIndex);
 
         // Get the exchange specific data for this creative (if it exists)
-        bool crinfo_ok = false;
-        Id adid; 
-        std::string adm; 
-        std::string nurl; 
-        try {
-            auto crinfo = creative.getProviderData<CreativeInfo>(en);
-            adid = crinfo->adid;
-            adm = crinfo->adm;
-            nurl = crinfo->nurl;
-            crinfo_ok = true;
-        } catch(ML::Exception& ex) {}
-
-        // Find the index in the seats array
-        int seatIndex = -1;
-        {
-            auto it = seatToBid.find(seat);
-            if (it == seatToBid.end()) {
-                seatIndex = seatToBid.size();
-                seatToBid[seat] = seatIndex;
-                response.seatbid.emplace_back();
-                if(cpinfo_ok) response.seatbid.back().seat = seat;
-            }
-            else seatIndex = it->second;
-        }
-        
-        // Get the seatBid object
-        OpenRTB::SeatBid & seatBid = response.seatbid.at(seatIndex);
-        
-        // Add a new bid to the array
-        seatBid.bid.emplace_back();
-        auto & b = seatBid.bid.back();
-        
+        const std::string * fragment = nullptr;
+        if (creative.providerData.count(en))
+            fragment
+                = &creative.getProviderData<CreativeInfo>(en)->bidFragment;
+
         // Put in the variable parts
-        b.id = Id(auction.id, auction.request->imp[0].id);
-        b.impid = auction.request->imp[spotNum].id;
-        b.price.val = USD_CPM(resp.price.maxPrice);
-        if(crinfo_ok && adid != Id("")) b.adid = adid;
-        if(crinfo_ok && !adm.empty()) b.adm = adm;
-        if(crinfo_ok && !nurl.empty()) b.nurl = nurl;
+        writer.addBid(seat,
+                      Id(auction.id, auction.request->imp[0].id),
+                      auction.request->imp[spotNum].id,
+                      USD_CPM(resp.price.maxPrice),
+                      Id(),
+                      fragment);
     }
 
-    if (seatToBid.empty())
+    if (writer.empty())
         return HttpResponse(204, "none", "{}");
 
-    static Datacratic::DefaultDescription<OpenRTB::BidResponse> desc;
-    std::ostringstream stream;
-    StreamJsonPrintingContext context(stream);
-    desc.printJsonTyped(&response, context);
+    return HttpResponse(200, "application/json", writer.write(auction.id));
+}
+
+ExchangeConnector::ExchangeCompatibility
+GumgumExchangeConnector::
+getCampaignCompatibility(const AgentConfig & config,
+                         bool includeReasons) const
+{
+    ExchangeCompatibility result;
+    result.setCompatible();
+
+    auto cpinfo = std::make_shared<CampaignInfo>();
 
-    cerr << Json::parse(stream.str());
+    const Json::Value & pconf = config.providerConfig["gumgum"];
+    if (pconf.isMember("seat"))
+        cpinfo->seat = Id(pconf["seat"].asString());
 
-    return HttpResponse(200, "application/json", stream.str());
+    result.info = cpinfo;
+    return result;
+}
+
+ExchangeConnector::ExchangeCompatibility
+GumgumExchangeConnector::
+getCreativeCompatibility(const Creative & creative,
+                         bool includeReasons) const
+{
+    ExchangeCompatibility result;
+    result.setCompatible();
+
+    auto crinfo = std::make_shared<CreativeInfo>();
+
+    const Json::Value & pconf = creative.providerConfig["gumgum"];
+    if (pconf.isMember("adid"))
+        crinfo->adid = Id(pconf["adid"].asString());
+    crinfo->adm = pconf.get("adm", "").asString();
+    crinfo->nurl = pconf.get("nurl", "").asString();
+
+    OpenRTB::Bid fixed;
+    fixed.adid = crinfo->adid;
+    fixed.adm = crinfo->adm;
+    fixed.nurl = crinfo->nurl;
+    crinfo->bidFragment = OpenRTBResponseWriter::renderFragment(fixed);
+
+    result.info = crinfo;
+    return result;
 }
 
 HttpResponse
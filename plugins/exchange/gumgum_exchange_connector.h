@@ -7,6 +7,7 @@
 #pragma once
 
 #include "rtbkit/plugins/exchange/http_exchange_connector.h"
+#include "rtbkit/plugins/exchange/response_writer.h"
 
 namespace RTBKIT {
 
@@ -62,11 +63,23 @@ struct GumgumExchangeConnector: public HttpExchangeConnector {
         Id seat;                ///< ID of the exchange seat
     };
 
+    virtual ExchangeCompatibility
+    getCampaignCompatibility(const AgentConfig & config,
+                             bool includeReasons) const;
+
     struct CreativeInfo {
         Id adid;                ///< ID for ad to be service if bid wins 
         std::string adm;        ///< Actual XHTML ad markup
         std::string nurl;       ///< Win notice URL
+        std::string bidFragment; ///< The above, rendered for the response
     };
+
+    /** All of the gumgum creative fields are optional; creatives are always
+        compatible.
+    */
+    virtual ExchangeCompatibility
+    getCreativeCompatibility(const Creative & creative,
+                             bool includeReasons) const;
 };
 
 
@@ -42,7 +42,8 @@ recordRequest(HttpHeader const & headers, std::string const & body) {
         stream.open(filename);
     }
 
-    stream << headers << body << std::endl;
+    stream << ML::format("# %.6f\n", Date::now().secondsSinceEpoch())
+           << headers << body << std::endl;
     ++requestCount;
     if(requestCount == requestLimit) {
         stream.close();
@@ -63,6 +64,18 @@ unsigned
 HttpAuctionLogger::
 parse(const std::string & filename,
       const std::function<void(const std::string &)> & callback)
+{
+    auto onRequest = [&] (const std::string & request, Date)
+        {
+            callback(request);
+        };
+    return parseTimed(filename, onRequest);
+}
+
+unsigned
+HttpAuctionLogger::
+parseTimed(const std::string & filename,
+           const std::function<void(const std::string &, Date)> & callback)
 {
     cerr << "reading packets from " << filename << endl;
 
@@ -75,10 +88,14 @@ parse(const std::string & filename,
         try {
             Parse_Context::Hold_Token hold(context);
 
+            Date timestamp;
             while (context) {
                 Parse_Context::Revert_Token token(context);
                 if (context.match_literal("POST")) break;
                 token.ignore();
+                if (context.match_literal("# "))
+                    timestamp = Date::fromSecondsSinceEpoch
+                        (context.expect_double());
                 context.expect_line();
             }
 
@@ -114,7 +131,7 @@ parse(const std::string & filename,
 
             context.match_eol();
 
-            callback(request);
+            callback(request, timestamp);
             ++count;
         }
         catch (const std::exception & exc) {
@@ -136,7 +153,8 @@ long HttpAuctionHandler::destroyed = 0;
 
 HttpAuctionHandler::
 HttpAuctionHandler()
-    : hasTimer(false), disconnected(false), servingRequest(false)
+    : hasTimer(false), disconnected(false), servingRequest(false),
+      ingressThread(0), ingressInFlight(false)
 {
     atomic_add(created, 1);
 }
@@ -233,6 +251,11 @@ onDisassociate()
 
     cancelTimer();
 
+    if (ingressInFlight) {
+        endpoint->ingressFinished(ingressThread);
+        ingressInFlight = false;
+    }
+
     /* We need to make sure that the handler doesn't try to send us
        anything. */
     if (auction && !auction->tooLate()) {
@@ -339,9 +362,21 @@ handleHttpPayload(const HttpHeader & header,
             timeAvailableMs, "ms");
 
 
-    if (timeAvailableMs - networkTimeMs < 5.0) {
+    AdmissionDecision decision
+        = endpoint->admission.admit(timeAvailableMs - networkTimeMs, now);
+
+    if (decision == AD_DROP) {
+        // The router is too loaded for requests of this exchange, or the
+        // exchange is over its quota; shed it before we spend any time
+        // parsing it.
+        doEvent("auctionEarlyDrop.shed");
+        dropAuction("load shedding");
+        return;
+    }
+
+    if (decision == AD_NO_BID) {
         // Do an early drop of the bid request without even creating an
-        // auction
+        // auction; it wouldn't make it through the router in time
 
         doEvent("auctionEarlyDrop.timeLeftMs",
                 ET_OUTCOME,
@@ -368,6 +403,8 @@ handleHttpPayload(const HttpHeader & header,
             if (!auction || auction->isZombie)
                 return;  // Was already externally terminated; this is invalid
 
+            this->auctionFinished = Date::now();
+
             if (this->transport().lockedByThisThread())
                 this->sendResponse();
             else {
@@ -459,6 +496,13 @@ handleHttpPayload(const HttpHeader & header,
     auction->doneParsing = Date::now();
 
     ML::atomic_add(endpoint->numAuctions, 1);
+
+    // The response is written by this same thread, whichever thread
+    // finishes the auction
+    ingressThread = endpoint->ingressThread();
+    endpoint->ingressStarted(ingressThread);
+    ingressInFlight = true;
+
     endpoint->onNewAuction(auction);
 }
 
@@ -496,6 +540,14 @@ sendResponse()
     
     cancelTimer();
 
+    const auto * ingress = &endpoint->ingressThreads[ingressThread];
+    if (ingressInFlight) {
+        endpoint->ingressFinished(ingressThread);
+        ingressInFlight = false;
+        endpoint->recordOutcome(before.secondsSince(auctionFinished) * 1000.0,
+                                ingress->responseQueueName);
+    }
+
     endpoint->onAuctionDone(auction);
 
     //cerr << "sendResponse " << this << ": disconnected "
@@ -525,12 +577,13 @@ sendResponse()
                      << endl;
 
             this->doEvent("auctionResponseSent");
-            this->doEvent("auctionTotalTimeMs",
-                          ET_OUTCOME,
-                          Date::now().secondsSince(this->firstData) * 1000.0,
-                          "ms");
+            double totalTimeMs
+                = Date::now().secondsSince(this->firstData) * 1000.0;
+            this->doEvent("auctionTotalTimeMs", ET_OUTCOME, totalTimeMs, "ms");
+            this->endpoint->recordOutcome(totalTimeMs,
+                                          ingress->totalTimeName);
 
-            if (random() % 1000 == 0) {
+            if (this->endpoint->shouldRecycleConnection()) {
                 this->transport().closeWhenHandlerFinished();
             }
             else {
@@ -555,7 +608,7 @@ dropAuction(const std::string & reason)
 {
     auto onSendFinished = [=] ()
         {
-            if (random() % 1000 == 0) {
+            if (this->endpoint->shouldRecycleConnection()) {
                 this->transport().closeWhenHandlerFinished();
             }
             else {
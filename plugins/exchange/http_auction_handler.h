@@ -25,7 +25,8 @@ struct HttpAuctionLogger :
 {
     HttpAuctionLogger(std::string const & filename, int count);
 
-    /// adds a request to the log file
+    /// adds a request to the log file, preceded by a line with the time
+    /// at which it was received
     void recordRequest(HttpHeader const & headers, std::string const & body);
 
     void close();
@@ -34,6 +35,12 @@ struct HttpAuctionLogger :
     static unsigned parse(const std::string & filename,
                           const std::function<void(const std::string &)> & callback);
 
+    /// parse a log file, also passing the time at which each request was
+    /// received (or Date() for logs written without it)
+    static unsigned
+    parseTimed(const std::string & filename,
+               const std::function<void(const std::string &, Date)> & callback);
+
 private:
     /// make sure requests are serialized
     std::mutex lock;
@@ -71,6 +78,10 @@ struct HttpAuctionHandler
     bool disconnected;
     bool servingRequest;  ///< Are we currently, actively serving a request?
 
+    int ingressThread;    ///< Event loop thread the auction came in on
+    bool ingressInFlight; ///< Auction is counted on its ingress thread
+    Date auctionFinished; ///< When the auction handed back its response
+
     virtual void handleHttpPayload(const HttpHeader & header,
                                    const std::string & payload);
 
@@ -14,6 +14,7 @@
 #include "jml/utils/set_utils.h"
 #include "jml/utils/vector_utils.h"
 #include "jml/arch/timers.h"
+#include "jml/compiler/compiler.h"
 #include "rtbkit/core/router/router.h"
 #include <set>
 
@@ -61,8 +62,10 @@ postConstructorInit()
     pingTimeUnknownHostsMs = 20;
     auctionVerb = "POST";
     auctionResource = "/";
+    recycleConnectionsEvery = 1000;
 
     numServingRequest = 0;
+    numIngressThreads = 0;
 
     // Link up events
     onTransportOpen = [=] (TransportBase *)
@@ -92,7 +95,11 @@ void
 HttpExchangeConnector::
 configure(const Json::Value & parameters)
 {
-    getParam(parameters, numThreads, "numThreads");
+    if (parameters.isMember("numThreads")
+        && parameters["numThreads"].isString()
+        && parameters["numThreads"].asString() == "auto")
+        numThreads = 0;
+    else getParam(parameters, numThreads, "numThreads");
     getParam(parameters, realTimePriority, "realTimePriority");
     getParam(parameters, listenPort, "listenPort");
     getParam(parameters, bindHost, "bindHost");
@@ -102,6 +109,10 @@ configure(const Json::Value & parameters)
     getParam(parameters, auctionVerb, "auctionVerb");
     getParam(parameters, pingTimesByHostMs, "pingTimesByHostMs");
     getParam(parameters, pingTimeUnknownHostsMs, "pingTimeUnknownHostsMs");
+    getParam(parameters, recycleConnectionsEvery, "recycleConnectionsEvery");
+
+    if (parameters.isMember("admission"))
+        admission.configure(parameters["admission"]);
 }
 
 void
@@ -129,7 +140,11 @@ void
 HttpExchangeConnector::
 start()
 {
-    PassiveEndpoint::init(listenPort, bindHost, numThreads, true,
+    int threads = numThreads;
+    if (threads <= 0)
+        threads = std::max<int>(1, std::thread::hardware_concurrency());
+
+    PassiveEndpoint::init(listenPort, bindHost, threads, true,
                           performNameLookup, backlog);
     if (realTimePriority > -1) {
         PassiveEndpoint::makeRealTime(realTimePriority);
@@ -219,9 +234,67 @@ getServiceStatus() const
     BOOST_FOREACH(auto cnt, peerCounts)
         result["hostConnections"][cnt.first] = cnt.second;
 
+    for (int i = 0;  i < numIngressThreads;  ++i)
+        result["ingressThreads"][i]["inFlight"]
+            = ingressThreads[i].inFlight.load();
+
     return result;
 }
 
+int
+HttpExchangeConnector::
+ingressThread()
+{
+    // Event loop threads only ever serve the one endpoint
+    static __thread const HttpExchangeConnector * owner = 0;
+    static __thread int index = -1;
+
+    if (JML_LIKELY(owner == this))
+        return index;
+
+    Guard guard(ingressLock);
+
+    auto it = ingressThreadIndex.find(std::this_thread::get_id());
+    if (it == ingressThreadIndex.end()) {
+        int n = numIngressThreads;
+        if (n < MaxIngressThreads) {
+            auto & stats = ingressThreads[n];
+            stats.inFlightName = ML::format("ingress.thread%d.inFlight", n);
+            stats.responseQueueName
+                = ML::format("ingress.thread%d.responseQueueMs", n);
+            stats.totalTimeName
+                = ML::format("ingress.thread%d.totalTimeMs", n);
+            numIngressThreads = n + 1;
+        }
+        else n = MaxIngressThreads - 1;
+
+        it = ingressThreadIndex
+            .insert(make_pair(std::this_thread::get_id(), n)).first;
+
+        // The thread is placed as it serves its first request
+        if (threadPlacement)
+            threadPlacement->apply("exchange." + serviceName(), n);
+    }
+
+    owner = this;
+    index = it->second;
+    return index;
+}
+
+void
+HttpExchangeConnector::
+ingressStarted(int thread)
+{
+    ingressThreads[thread].inFlight.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+HttpExchangeConnector::
+ingressFinished(int thread)
+{
+    ingressThreads[thread].inFlight.fetch_sub(1, std::memory_order_relaxed);
+}
+
 std::shared_ptr<BidRequest>
 HttpExchangeConnector::
 parseBidRequest(HttpAuctionHandler & connection,
@@ -320,6 +393,10 @@ HttpExchangeConnector::
 periodicCallback(uint64_t numWakeups) const
 {
     recordLevel(numConnections(), "httpConnections");
+
+    for (int i = 0;  i < numIngressThreads;  ++i)
+        recordLevel(ingressThreads[i].inFlight.load(),
+                    ingressThreads[i].inFlightName);
 }
 
 } // namespace RTBKIT
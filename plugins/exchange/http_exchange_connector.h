@@ -14,6 +14,9 @@
 #include "soa/service/stats_events.h"
 #include "rtbkit/common/auction.h"
 #include <limits>
+#include <atomic>
+#include <thread>
+#include <map>
 #include "rtbkit/common/exchange_connector.h"
 #include <boost/algorithm/string.hpp>
 
@@ -206,6 +209,44 @@ struct HttpExchangeConnector
     /** Method invoked every second for accounting */
     virtual void periodicCallback(uint64_t numWakeups) const;
 
+
+    /*************************************************************************/
+    /* INGRESS THREADS                                                       */
+    /*************************************************************************/
+
+    enum { MaxIngressThreads = 256 };
+
+    /** Per event loop thread view of the auctions coming in.  A connection
+        stays on the event loop that accepted it, so these show how evenly
+        the exchange's connections are spread and how long finished
+        auctions wait for their thread to write the response.
+    */
+    struct IngressThreadStats {
+        IngressThreadStats()
+            : inFlight(0)
+        {
+        }
+
+        std::atomic<int> inFlight;      ///< Auctions waiting for a response
+        std::string inFlightName;
+        std::string responseQueueName;
+        std::string totalTimeName;
+    };
+
+    /** Index of the calling event loop thread, from 0 to the number of
+        threads (capped to MaxIngressThreads - 1).  Cheap after the first
+        call on a given thread, which is also when the thread is placed
+        according to the connector's threadPlacement.
+    */
+    int ingressThread();
+
+    /** Should a connection that just sent a response be closed? */
+    bool shouldRecycleConnection() const
+    {
+        return recycleConnectionsEvery > 0
+            && random() % recycleConnectionsEvery == 0;
+    }
+
 protected:
     virtual std::shared_ptr<ConnectionHandler> makeNewHandler();
     virtual std::shared_ptr<HttpAuctionHandler> makeNewHandlerShared();
@@ -232,7 +273,7 @@ protected:
     int numServingRequest;  ///< How many connections are serving a request
 
     /// Configuration parameters
-    int numThreads;         
+    int numThreads;         ///< Event loop threads; 0 for one per core
     int realTimePriority;
     PortRange listenPort;
     std::string bindHost;
@@ -241,6 +282,13 @@ protected:
     std::string auctionResource;
     std::string auctionVerb;
 
+    /** One in how many responses closes its connection, which spreads the
+        exchange's connections back over the event loop threads.  0 keeps
+        connections (and so their thread) for as long as the exchange
+        does.
+    */
+    int recycleConnectionsEvery;
+
     /// The ping time to known hosts in milliseconds
     std::unordered_map<std::string, float> pingTimesByHostMs;
 
@@ -256,6 +304,16 @@ private:
     std::set<std::shared_ptr<HttpAuctionHandler> > handlers;
     void finishedWithHandler(std::shared_ptr<HttpAuctionHandler> handler);
 
+    Lock ingressLock;
+    std::map<std::thread::id, int> ingressThreadIndex;
+    std::atomic<int> numIngressThreads;
+    IngressThreadStats ingressThreads[MaxIngressThreads];
+
+    /** Account for an auction started on, and answered by, an event loop
+        thread. */
+    void ingressStarted(int thread);
+    void ingressFinished(int thread);
+
     /** Common code from all constructors. */
     void postConstructorInit();
 };
@@ -158,28 +158,22 @@ getResponse(const HttpAuctionHandler & connection,
         return getErrorResponse(connection, auction,
                                 current->error + ": " + current->details);
 
-    OpenRTB::BidResponse response;
-    response.id = auction.id;
+    auto & writer = OpenRTBResponseWriter::forThisThread();
 
-    response.ext = getResponseExt(connection, auction);
-
-    // Create a spot for each of the bid responses
+    // Create a bid for each of the bid responses
     for (unsigned spotNum = 0; spotNum < current->responses.size(); ++spotNum) {
         if (!current->hasValidResponse(spotNum))
             continue;
 
-        setSeatBid(auction, spotNum, response);
+        writeBid(auction, spotNum, writer);
     }
 
-    if (response.seatbid.empty())
+    if (writer.empty())
         return HttpResponse(204, "none", "");
 
-    static Datacratic::DefaultDescription<OpenRTB::BidResponse> desc;
-    std::ostringstream stream;
-    StreamJsonPrintingContext context(stream);
-    desc.printJsonTyped(&response, context);
-
-    return HttpResponse(200, "application/json", stream.str());
+    return HttpResponse(200, "application/json",
+                        writer.write(auction.id,
+                                     getResponseExt(connection, auction)));
 }
 
 Json::Value
@@ -220,31 +214,20 @@ getBidSourceConfiguration() const
 
 void
 OpenRTBExchangeConnector::
-setSeatBid(Auction const & auction,
-           int spotNum,
-           OpenRTB::BidResponse & response) const
+writeBid(Auction const & auction,
+         int spotNum,
+         OpenRTBResponseWriter & writer) const
 {
     const Auction::Data * data = auction.getCurrentData();
 
     // Get the winning bid
     auto & resp = data->winningResponse(spotNum);
 
-    int seatIndex = 0;
-    if(response.seatbid.empty()) {
-        response.seatbid.emplace_back();
-    }
-
-    OpenRTB::SeatBid & seatBid = response.seatbid.at(seatIndex);
-
-    // Add a new bid to the array
-    seatBid.bid.emplace_back();
-
-    // Put in the variable parts
-    auto & b = seatBid.bid.back();
-    b.cid = Id(resp.agent);
-    b.id = Id(auction.id, auction.request->imp[0].id);
-    b.impid = auction.request->imp[spotNum].id;
-    b.price.val = USD_CPM(resp.price.maxPrice);
+    writer.addBid(Id(),
+                  Id(auction.id, auction.request->imp[0].id),
+                  auction.request->imp[spotNum].id,
+                  USD_CPM(resp.price.maxPrice),
+                  Id(resp.agent));
 }
 
 } // namespace RTBKIT
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "rtbkit/plugins/exchange/http_exchange_connector.h"
+#include "rtbkit/plugins/exchange/response_writer.h"
 
 namespace RTBKIT {
 
@@ -60,9 +61,12 @@ struct OpenRTBExchangeConnector : public HttpExchangeConnector {
     virtual std::string getBidSourceConfiguration() const;
 
 private:
-    virtual void setSeatBid(Auction const & auction,
-                            int spotNum,
-                            OpenRTB::BidResponse & response) const;
+    /** Add the winning bid for the given spot to the response.  The
+        default writes the ids and the price, on no particular seat.
+    */
+    virtual void writeBid(Auction const & auction,
+                          int spotNum,
+                          OpenRTBResponseWriter & writer) const;
 
     virtual Json::Value
     getResponseExt(const HttpAuctionHandler & connection,
@@ -0,0 +1,246 @@
+/* response_writer.cc
+   Copyright (c) 2013 Datacratic Inc.  All rights reserved.
+
+   Direct writers for the JSON bid responses of exchange connectors.
+*/
+
+#include "response_writer.h"
+#include <boost/algorithm/string/trim.hpp>
+#include <cstdio>
+
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* JSON RESPONSE WRITER                                                      */
+/*****************************************************************************/
+
+void
+JsonResponseWriter::
+string(const std::string & str)
+{
+    buffer += '"';
+
+    for (unsigned char c: str) {
+        switch (c) {
+        case '"':  buffer += "\\\"";  break;
+        case '\\': buffer += "\\\\";  break;
+        case '\n': buffer += "\\n";   break;
+        case '\r': buffer += "\\r";   break;
+        case '\t': buffer += "\\t";   break;
+        case '\b': buffer += "\\b";   break;
+        case '\f': buffer += "\\f";   break;
+        default:
+            if (c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                buffer += escaped;
+            }
+            else buffer += c;  // UTF-8 goes through unchanged
+        }
+    }
+
+    buffer += '"';
+}
+
+void
+JsonResponseWriter::
+number(double val)
+{
+    char str[32];
+    int n = snprintf(str, sizeof(str), "%.10g", val);
+    buffer.append(str, n);
+}
+
+void
+JsonResponseWriter::
+number(int64_t val)
+{
+    char str[32];
+    int n = snprintf(str, sizeof(str), "%lld", (long long)val);
+    buffer.append(str, n);
+}
+
+void
+JsonResponseWriter::
+value(const Json::Value & val)
+{
+    Json::FastWriter writer;
+    std::string str = writer.write(val);
+    boost::trim_right(str);
+    buffer += str;
+}
+
+JsonResponseWriter &
+JsonResponseWriter::
+forThisThread()
+{
+    // Lives as long as the thread's event loop, which is the process
+    static __thread JsonResponseWriter * writer = 0;
+    if (!writer)
+        writer = new JsonResponseWriter();
+    return *writer;
+}
+
+
+/*****************************************************************************/
+/* OPENRTB RESPONSE WRITER                                                   */
+/*****************************************************************************/
+
+void
+OpenRTBResponseWriter::
+addBid(const Id & seat,
+       const Id & bidId,
+       const Id & impId,
+       double price,
+       const Id & cid,
+       const std::string * fragment)
+{
+    bids.push_back({ seat, bidId, impId, price, cid, fragment });
+}
+
+const std::string &
+OpenRTBResponseWriter::
+write(const Id & auctionId, const Json::Value & ext)
+{
+    clear();
+
+    raw("{");
+    key("id");
+    id(auctionId);
+    raw(",");
+    key("seatbid");
+    raw("[");
+
+    // One seat bid per distinct seat, in the order in which they came
+    written.assign(bids.size(), false);
+
+    for (unsigned i = 0;  i < bids.size();  ++i) {
+        if (written[i]) continue;
+
+        const Id & seat = bids[i].seat;
+
+        if (i != 0) raw(",");
+        raw("{");
+        key("bid");
+        raw("[");
+
+        bool first = true;
+        for (unsigned j = i;  j < bids.size();  ++j) {
+            const PendingBid & bid = bids[j];
+            if (written[j] || bid.seat != seat) continue;
+            written[j] = true;
+
+            if (!first) raw(",");
+            first = false;
+
+            raw("{");
+            key("id");
+            id(bid.bidId);
+            raw(",");
+            key("impid");
+            id(bid.impId);
+            raw(",");
+            key("price");
+            number(bid.price);
+            if (bid.cid) {
+                raw(",");
+                key("cid");
+                id(bid.cid);
+            }
+            if (bid.fragment)
+                raw(*bid.fragment);
+            raw("}");
+        }
+
+        raw("]");
+        if (seat) {
+            raw(",");
+            key("seat");
+            id(seat);
+        }
+        raw("}");
+    }
+
+    raw("]");
+
+    if (!ext.isNull()) {
+        raw(",");
+        key("ext");
+        value(ext);
+    }
+
+    raw("}");
+
+    bids.clear();
+    return buffer;
+}
+
+std::string
+OpenRTBResponseWriter::
+renderFragment(const OpenRTB::Bid & bid)
+{
+    JsonResponseWriter writer;
+
+    auto field = [&] (const char * name)
+        {
+            writer.raw(",");
+            writer.key(name);
+        };
+
+    if (bid.adid) {
+        field("adid");
+        writer.id(bid.adid);
+    }
+    if (!bid.nurl.empty()) {
+        field("nurl");
+        writer.string(bid.nurl);
+    }
+    if (!bid.adm.empty()) {
+        field("adm");
+        writer.string(bid.adm);
+    }
+    if (!bid.adomain.empty()) {
+        field("adomain");
+        writer.raw("[");
+        for (unsigned i = 0;  i < bid.adomain.size();  ++i) {
+            if (i != 0) writer.raw(",");
+            writer.string(bid.adomain[i]);
+        }
+        writer.raw("]");
+    }
+    if (!bid.iurl.empty()) {
+        field("iurl");
+        writer.string(bid.iurl);
+    }
+    if (bid.crid) {
+        field("crid");
+        writer.id(bid.crid);
+    }
+    if (!bid.attr.empty()) {
+        field("attr");
+        writer.raw("[");
+        for (unsigned i = 0;  i < bid.attr.size();  ++i) {
+            if (i != 0) writer.raw(",");
+            writer.number(int64_t(bid.attr[i].val));
+        }
+        writer.raw("]");
+    }
+
+    return writer.str();
+}
+
+OpenRTBResponseWriter &
+OpenRTBResponseWriter::
+forThisThread()
+{
+    // Lives as long as the thread's event loop, which is the process
+    static __thread OpenRTBResponseWriter * writer = 0;
+    if (!writer)
+        writer = new OpenRTBResponseWriter();
+    writer->reset();
+    return *writer;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,146 @@
+/* response_writer.h                                               -*- C++ -*-
+   Copyright (c) 2013 Datacratic Inc.  All rights reserved.
+
+   Direct writers for the JSON bid responses of exchange connectors.
+*/
+
+#pragma once
+
+#include "soa/types/id.h"
+#include "soa/jsoncpp/json.h"
+#include "openrtb/openrtb.h"
+#include <string>
+#include <vector>
+
+
+namespace RTBKIT {
+
+using Datacratic::Id;
+
+
+/*****************************************************************************/
+/* JSON RESPONSE WRITER                                                      */
+/*****************************************************************************/
+
+/** Appends JSON to a buffer that is kept from one response to the next, for
+    exchange connectors that write their responses directly instead of
+    building an object graph and printing it through its value description.
+
+    Punctuation is left to the caller.
+*/
+
+struct JsonResponseWriter {
+
+    JsonResponseWriter()
+    {
+        buffer.reserve(4096);
+    }
+
+    /** Start a new response, keeping the buffer's memory. */
+    void clear() { buffer.clear(); }
+
+    const std::string & str() const { return buffer; }
+
+    void raw(char c) { buffer += c; }
+    void raw(const char * str) { buffer += str; }
+    void raw(const std::string & str) { buffer += str; }
+
+    /** Write "name": */
+    void key(const char * name)
+    {
+        buffer += '"';
+        buffer += name;
+        buffer += "\":";
+    }
+
+    /** Write a quoted, escaped string. */
+    void string(const std::string & str);
+
+    /** Write an id as a string. */
+    void id(const Id & id) { string(id.toString()); }
+
+    void number(double val);
+    void number(int64_t val);
+
+    /** Write a JSON value in its compact form. */
+    void value(const Json::Value & val);
+
+    /** Writer owned by the calling thread. */
+    static JsonResponseWriter & forThisThread();
+
+protected:
+    std::string buffer;
+};
+
+
+/*****************************************************************************/
+/* OPENRTB RESPONSE WRITER                                                   */
+/*****************************************************************************/
+
+/** Writes an OpenRTB bid response.
+
+    The fields of a bid that only depend on the creative (markup, advertiser
+    domains, creative id...) are rendered once, when the creative is
+    configured, by renderFragment(); per bid only the ids and the price are
+    written around them.
+
+    Bids are added in any order and grouped by seat when the response is
+    written.  Use forThisThread() to get a writer whose buffers are reused
+    by every response sent from the calling thread.
+*/
+
+struct OpenRTBResponseWriter : public JsonResponseWriter {
+
+    /** Add a bid on the given impression to the response.  The fragment
+        must outlive the call to write().
+    */
+    void addBid(const Id & seat,
+                const Id & bidId,
+                const Id & impId,
+                double price,
+                const Id & cid = Id(),
+                const std::string * fragment = nullptr);
+
+    bool empty() const { return bids.empty(); }
+
+    /** Drop the bids and text of a response that was started but never
+        written, for instance because adding one of its bids threw.
+    */
+    void reset()
+    {
+        clear();
+        bids.clear();
+    }
+
+    /** Write the response with all the bids added since the last one and
+        return it.  The writer is ready for the next response.
+    */
+    const std::string &
+    write(const Id & auctionId, const Json::Value & ext = Json::Value());
+
+    /** Render the creative specific fields of a bid (adid, nurl, adm,
+        adomain, iurl, crid and attr; the ones that are set) as a fragment
+        to be passed to addBid().
+    */
+    static std::string renderFragment(const OpenRTB::Bid & bid);
+
+    /** Writer owned by the calling thread, reset so that nothing is left
+        over from a previous response that wasn't written.
+    */
+    static OpenRTBResponseWriter & forThisThread();
+
+private:
+    struct PendingBid {
+        Id seat;
+        Id bidId;
+        Id impId;
+        double price;
+        Id cid;
+        const std::string * fragment;
+    };
+
+    std::vector<PendingBid> bids;
+    std::vector<char> written;
+};
+
+} // namespace RTBKIT
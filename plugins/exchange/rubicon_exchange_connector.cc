@@ -147,6 +147,13 @@ getCreativeCompatibility(const Creative & creative,
             ("creative[].providerConfig.rubicon.adomain is empty",
              includeReasons);
 
+    // Render the fixed part of the bids on this creative
+    OpenRTB::Bid fixed;
+    fixed.adm = crinfo->adm;
+    fixed.adomain = crinfo->adomain;
+    fixed.crid = crinfo->crid;
+    crinfo->bidFragment = OpenRTBResponseWriter::renderFragment(fixed);
+
     // Cache the information
     result.info = crinfo;
 
@@ -197,9 +204,9 @@ decodeWinPrice(const std::string & sharedSecret,
 
 void
 RubiconExchangeConnector::
-setSeatBid(Auction const & auction,
-           int spotNum,
-           OpenRTB::BidResponse & response) const
+writeBid(Auction const & auction,
+         int spotNum,
+         OpenRTBResponseWriter & writer) const
 {
     const Auction::Data * current = auction.getCurrentData();
     
@@ -224,34 +231,13 @@ setSeatBid(Auction const & auction,
     // Get the exchange specific data for this creative
     auto crinfo = creative.getProviderData<CreativeInfo>(en);
 
-    // Find the index in the seats array
-    int seatIndex = 0;
-    while(response.seatbid.size() != seatIndex) {
-        if(response.seatbid[seatIndex].seat == cpinfo->seat) break;
-        ++seatIndex;
-    }
-
-    // Create if required
-    if(seatIndex == response.seatbid.size()) {
-        response.seatbid.emplace_back();
-        response.seatbid.back().seat = cpinfo->seat;
-    }
-
-    // Get the seatBid object
-    OpenRTB::SeatBid & seatBid = response.seatbid.at(seatIndex);
-    
-    // Add a new bid to the array
-    seatBid.bid.emplace_back();
-    auto & b = seatBid.bid.back();
-    
-    // Put in the variable parts
-    b.cid = Id(resp.agent);
-    b.id = Id(auction.id, auction.request->imp[0].id);
-    b.impid = auction.request->imp[spotNum].id;
-    b.price.val = USD_CPM(resp.price.maxPrice);
-    b.adm = crinfo->adm;
-    b.adomain = crinfo->adomain;
-    b.crid = crinfo->crid;
+    // Put in the variable parts; the writer groups the bids by seat
+    writer.addBid(cpinfo->seat,
+                  Id(auction.id, auction.request->imp[0].id),
+                  auction.request->imp[spotNum].id,
+                  USD_CPM(resp.price.maxPrice),
+                  Id(resp.agent),
+                  &crinfo->bidFragment);
 }
 
 } // namespace RTBKIT
@@ -52,6 +52,9 @@ struct RubiconExchangeConnector: public OpenRTBExchangeConnector {
         Id crid;                                        ///< Creative ID
         OpenRTB::List<OpenRTB::CreativeAttribute> attr; ///< Creative attributes
         std::string ext_creativeapi;                    ///< Creative API
+
+        /// adm, adomain and crid, pre-rendered for the bid response
+        std::string bidFragment;
     };
 
     virtual ExchangeCompatibility
@@ -63,9 +66,9 @@ struct RubiconExchangeConnector: public OpenRTBExchangeConnector {
                                 const std::string & winPriceStr);
 
 private:
-    virtual void setSeatBid(Auction const & auction,
-                            int spotNum,
-                            OpenRTB::BidResponse & response) const;
+    virtual void writeBid(Auction const & auction,
+                          int spotNum,
+                          OpenRTBResponseWriter & writer) const;
 };
 
 
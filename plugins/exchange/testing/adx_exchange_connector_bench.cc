@@ -0,0 +1,203 @@
+/* adx_exchange_connector_bench.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Cost of decoding AdX bid requests and encoding bid responses in the AdX
+   exchange connector.  Set ADX_BENCH_CAPTURE to a file written by the
+   connector's request logging to replay recorded payloads; otherwise
+   payloads are synthesized.  The correctness checks live in
+   adx_exchange_connector_test.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/exchange/adx_exchange_connector.h"
+#include "rtbkit/plugins/exchange/http_auction_handler.h"
+#include "rtbkit/plugins/exchange/realtime-bidding.pb.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include "rtbkit/common/auction.h"
+#include "jml/utils/environment.h"
+#include "jml/arch/timers.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+
+// RTBKIT::BidRequest would clash with Google's ::BidRequest
+using RTBKIT::AdXExchangeConnector;
+using RTBKIT::AgentConfig;
+using RTBKIT::Auction;
+using RTBKIT::Creative;
+using RTBKIT::HttpAuctionHandler;
+using RTBKIT::HttpAuctionLogger;
+using RTBKIT::USD_CPM;
+
+typedef ::BidRequest GoogleBidRequest;
+
+
+Env_Option<string> captureFile("ADX_BENCH_CAPTURE", "");
+
+
+/*****************************************************************************/
+/* PAYLOADS                                                                  */
+/*****************************************************************************/
+
+/** Protobuf bodies of the requests in a capture file. */
+vector<string> loadCapture(const string & filename)
+{
+    vector<string> result;
+
+    auto onRequest = [&] (const string & request)
+        {
+            auto pos = request.find("\r\n\r\n");
+            if (pos != string::npos)
+                result.push_back(request.substr(pos + 4));
+        };
+
+    HttpAuctionLogger::parse(filename, onRequest);
+    return result;
+}
+
+/** Web requests with one or two slots, as AdX typically sends them. */
+vector<string> synthesize(unsigned count)
+{
+    vector<string> result;
+
+    for (unsigned i = 0;  i < count;  ++i) {
+        GoogleBidRequest gbr;
+
+        string id(16, '\0');
+        for (unsigned j = 0;  j < 16;  ++j)
+            id[j] = (i * 31 + j * 17) & 0xff;
+        gbr.set_id(id);
+        gbr.set_ip(string("\xc0\xa8\x01", 3));
+        gbr.set_google_user_id("CAESEHv8j3YlHhGI5xWNs1jA7cE" + to_string(i % 100));
+        gbr.set_hosted_match_data(string(16, (char)(i & 0xff)));
+        gbr.set_user_agent("Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36");
+        gbr.set_url("http://www.example" + to_string(i % 50) + ".com/news");
+        gbr.set_seller_network_id(1000 + i % 10);
+        gbr.set_detected_language("en");
+
+        for (unsigned j = 0;  j < 3;  ++j) {
+            auto vertical = gbr.add_detected_vertical();
+            vertical->set_id(10 + (i + j) % 20);
+            vertical->set_weight(0.3);
+        }
+
+        for (unsigned j = 0;  j < 1 + i % 2;  ++j) {
+            auto slot = gbr.add_adslot();
+            slot->set_id(j + 1);
+            slot->add_width(300);
+            slot->add_height(250);
+            slot->set_ad_block_key(123456789 + i);
+            slot->add_allowed_vendor_type(42);
+            slot->add_excluded_attribute(7);
+            slot->add_excluded_sensitive_category(3);
+        }
+
+        result.push_back(gbr.SerializeAsString());
+    }
+
+    return result;
+}
+
+/** Creative that uses the auction id and an agent defined macro. */
+Creative adxCreative(bool withAgentMacro)
+{
+    Creative creative = Creative::sampleBB;
+    Json::Value & adx = creative.providerConfig["adx"];
+    adx["externalId"] = "creative-1";
+    adx["htmlTemplate"]
+        = "<a href=\"%%CLICK_URL_UNESC%%http://adserver.com/click?"
+          "auction=${AUCTION_ID}\"><img src=\"http://adserver.com/"
+          "img.png?price=%%WINNING_PRICE%%"
+        + string(withAgentMacro ? "&segment=${SEGMENT}" : "")
+        + "\"/></a>";
+    adx["clickThroughUrl"] = "http://adserver.com/landing";
+    adx["agencyId"] = 1;
+    adx["vendorType"] = "42";
+    adx["attribute"] = "";
+    adx["sensitiveCategory"] = "";
+    return creative;
+}
+
+
+/*****************************************************************************/
+/* BENCHMARKS                                                                */
+/*****************************************************************************/
+
+BOOST_AUTO_TEST_CASE( bench_adx_parse_and_respond )
+{
+    auto proxies = std::make_shared<ServiceProxies>();
+    AdXExchangeConnector connector("adx", proxies);
+
+    vector<string> payloads = captureFile.get().empty()
+        ? synthesize(1000) : loadCapture(captureFile);
+    BOOST_REQUIRE(!payloads.empty());
+
+    HttpAuctionHandler connection;
+    HttpHeader header;
+    header.contentType = "application/octet-stream";
+
+    enum { NumPasses = 100 };
+
+    vector<std::shared_ptr<RTBKIT::BidRequest> > requests;
+    Timer parseTimer;
+    for (unsigned pass = 0;  pass < NumPasses;  ++pass) {
+        for (auto & payload: payloads) {
+            auto br = connector.parseBidRequest(connection, header, payload);
+            if (pass == 0 && br)
+                requests.push_back(br);
+        }
+    }
+    double parseTime = parseTimer.elapsed_wall();
+
+    BOOST_REQUIRE(!requests.empty());
+
+    cerr << "parse:   " << parseTime * 1e9 / (NumPasses * payloads.size())
+         << "ns/request over " << payloads.size() << " payloads" << endl;
+
+    for (bool withAgentMacro: { false, true }) {
+        Creative creative = adxCreative(withAgentMacro);
+        auto compat = connector.getCreativeCompatibility(creative, true);
+        BOOST_REQUIRE(compat.isCompatible);
+        creative.providerData["adx"] = compat.info;
+
+        auto config = std::make_shared<AgentConfig>();
+        config->account = { "campaign", "strategy" };
+        config->creatives.push_back(creative);
+
+        string meta = withAgentMacro ? "{\"SEGMENT\":\"sports\"}" : "null";
+
+        vector<std::shared_ptr<Auction> > auctions;
+        for (auto & request: requests) {
+            auto auction = std::make_shared<Auction>(
+                    &connector, [] (std::shared_ptr<Auction>) {}, request,
+                    "", "adx", Date::now(), Date::now().plusSeconds(1));
+            for (unsigned spot = 0;  spot < request->imp.size();  ++spot) {
+                Auction::Response response(
+                        Auction::Price(USD_CPM(1)), 1, config->account,
+                        false, "agent", "", meta, config,
+                        RTBKIT::SegmentList(), 0);
+                auction->setResponse(spot, response);
+            }
+            auctions.push_back(auction);
+        }
+
+        size_t totalBytes = 0;
+        Timer respondTimer;
+        for (unsigned pass = 0;  pass < NumPasses;  ++pass)
+            for (auto & auction: auctions)
+                totalBytes += connector.getResponse(connection, header,
+                                                    *auction).body.size();
+        double respondTime = respondTimer.elapsed_wall();
+
+        BOOST_CHECK_GT(totalBytes, 0);
+
+        cerr << "respond" << (withAgentMacro ? " (agent macro): " : ":   ")
+             << respondTime * 1e9 / (NumPasses * auctions.size())
+             << "ns/response" << endl;
+    }
+}
@@ -0,0 +1,157 @@
+/* adx_exchange_connector_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test that the AdX exchange connector decodes auction ids and expands the
+   macros of its precompiled creative templates.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/exchange/adx_exchange_connector.h"
+#include "rtbkit/plugins/exchange/http_auction_handler.h"
+#include "rtbkit/plugins/exchange/realtime-bidding.pb.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include "rtbkit/common/auction.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+
+// RTBKIT::BidRequest would clash with Google's ::BidRequest
+using RTBKIT::AdXExchangeConnector;
+using RTBKIT::AgentConfig;
+using RTBKIT::Auction;
+using RTBKIT::Creative;
+using RTBKIT::HttpAuctionHandler;
+using RTBKIT::USD_CPM;
+
+typedef ::BidRequest GoogleBidRequest;
+typedef ::BidResponse GoogleBidResponse;
+
+
+namespace {
+
+string hexOf(const string & bytes)
+{
+    string result;
+    for (unsigned char c: bytes)
+        result += ML::format("%02x", (int)c);
+    return result;
+}
+
+/** Request with two 300x250 slots and a binary auction id. */
+string makeRequest()
+{
+    GoogleBidRequest gbr;
+
+    string id(16, '\0');
+    for (unsigned j = 0;  j < 16;  ++j)
+        id[j] = (j * 17 + 3) & 0xff;
+    gbr.set_id(id);
+    gbr.set_ip(string("\xc0\xa8\x01", 3));
+    gbr.set_google_user_id("CAESEHv8j3YlHhGI5xWNs1jA7cE");
+    gbr.set_user_agent("Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36");
+    gbr.set_url("http://www.example.com/news");
+    gbr.set_seller_network_id(1000);
+
+    for (unsigned j = 0;  j < 2;  ++j) {
+        auto slot = gbr.add_adslot();
+        slot->set_id(j + 1);
+        slot->add_width(300);
+        slot->add_height(250);
+        slot->set_ad_block_key(123456789);
+        slot->add_allowed_vendor_type(42);
+    }
+
+    return gbr.SerializeAsString();
+}
+
+Creative adxCreative(bool withAgentMacro)
+{
+    Creative creative = Creative::sampleBB;
+    Json::Value & adx = creative.providerConfig["adx"];
+    adx["externalId"] = "creative-1";
+    adx["htmlTemplate"]
+        = "<a href=\"%%CLICK_URL_UNESC%%http://adserver.com/click?"
+          "auction=${AUCTION_ID}\"><img src=\"http://adserver.com/"
+          "img.png?price=%%WINNING_PRICE%%"
+        + string(withAgentMacro ? "&segment=${SEGMENT}" : "")
+        + "\"/></a>";
+    adx["clickThroughUrl"] = "http://adserver.com/landing";
+    adx["agencyId"] = 1;
+    adx["vendorType"] = "42";
+    adx["attribute"] = "";
+    adx["sensitiveCategory"] = "";
+    return creative;
+}
+
+} // file scope
+
+
+BOOST_AUTO_TEST_CASE( test_adx_auction_id_and_templates )
+{
+    auto proxies = std::make_shared<ServiceProxies>();
+    AdXExchangeConnector connector("adx", proxies);
+
+    HttpAuctionHandler connection;
+    HttpHeader header;
+    header.contentType = "application/octet-stream";
+
+    // The 16 byte auction id is decoded as its hex representation would be
+    string payload = makeRequest();
+    GoogleBidRequest gbr;
+    BOOST_REQUIRE(gbr.ParseFromString(payload));
+    auto request = connector.parseBidRequest(connection, header, payload);
+    BOOST_REQUIRE(request);
+    BOOST_CHECK_EQUAL(request->auctionId, Id(hexOf(gbr.id())));
+    BOOST_CHECK_EQUAL(request->auctionId.toString(), hexOf(gbr.id()));
+    BOOST_REQUIRE_EQUAL(request->imp.size(), 2);
+
+    for (bool withAgentMacro: { false, true }) {
+        Creative creative = adxCreative(withAgentMacro);
+        auto compat = connector.getCreativeCompatibility(creative, true);
+        BOOST_REQUIRE(compat.isCompatible);
+        creative.providerData["adx"] = compat.info;
+
+        auto config = std::make_shared<AgentConfig>();
+        config->account = { "campaign", "strategy" };
+        config->creatives.push_back(creative);
+
+        string meta = withAgentMacro ? "{\"SEGMENT\":\"sports\"}" : "null";
+
+        auto auction = std::make_shared<Auction>(
+                &connector, [] (std::shared_ptr<Auction>) {}, request,
+                "", "adx", Date::now(), Date::now().plusSeconds(1));
+        for (unsigned spot = 0;  spot < request->imp.size();  ++spot) {
+            Auction::Response response(
+                    Auction::Price(USD_CPM(1)), 1, config->account,
+                    false, "agent", "", meta, config,
+                    RTBKIT::SegmentList(), 0);
+            auction->setResponse(spot, response);
+        }
+
+        // Our macros are expanded in every snippet; AdX's are left alone.
+        // The response message is reused, so this also checks that nothing
+        // is left over from the previous response.
+        for (unsigned i = 0;  i < 2;  ++i) {
+            auto response = connector.getResponse(connection, header,
+                                                  *auction);
+            GoogleBidResponse gresp;
+            BOOST_REQUIRE(gresp.ParseFromString(response.body));
+            BOOST_REQUIRE_EQUAL(gresp.ad_size(), request->imp.size());
+
+            for (unsigned j = 0;  j < gresp.ad_size();  ++j) {
+                const string & snippet = gresp.ad(j).html_snippet();
+                BOOST_CHECK(snippet.find("auction=" + auction->id.toString())
+                            != string::npos);
+                BOOST_CHECK(snippet.find("%%WINNING_PRICE%%") != string::npos);
+                BOOST_CHECK_EQUAL(snippet.find("${"), string::npos);
+                BOOST_CHECK_EQUAL(snippet.find("segment=sports")
+                                  != string::npos, withAgentMacro);
+            }
+        }
+    }
+}
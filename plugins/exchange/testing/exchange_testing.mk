@@ -2,3 +2,8 @@
 
 $(eval $(call test,rubicon_exchange_connector_test,rubicon_exchange bid_test_utils openrtb_exchange openrtb_bid_request bidding_agent rtb_router cairomm-1.0 cairo sigc-2.0,boost manual))
 $(eval $(call test,gumgum_exchange_connector_test,gumgum_exchange bid_test_utils openrtb_bid_request bidding_agent rtb_router cairomm-1.0 cairo sigc-2.0,boost))
+$(eval $(call test,adx_exchange_connector_test,adx_exchange exchange agent_configuration protobuf,boost))
+$(eval $(call test,adx_exchange_connector_bench,adx_exchange exchange agent_configuration protobuf,boost manual))
+$(eval $(call test,http_ingress_bench,openrtb_exchange exchange,boost manual))
+$(eval $(call test,response_writer_test,exchange,boost))
+$(eval $(call test,response_writer_bench,exchange openrtb,boost manual))
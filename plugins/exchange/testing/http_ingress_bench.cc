@@ -0,0 +1,263 @@
+/* http_ingress_bench.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Local load test of the HTTP ingress of an exchange connector: throughput
+   and latency percentiles against the number of event loop threads.
+
+   Auctions are finished by a separate thread, as the router would, so that
+   responses go through the hand-off back to the connection's own event
+   loop.  INGRESS_BENCH_MAX_THREADS caps the number of event loop threads
+   (defaults to the number of cores) and INGRESS_BENCH_CLIENTS sets the
+   number of keep-alive client connections.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/exchange/openrtb_exchange_connector.h"
+#include "rtbkit/common/auction.h"
+#include "jml/utils/environment.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/exception.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <algorithm>
+#include <thread>
+#include <deque>
+#include <mutex>
+#include <atomic>
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+Env_Option<int> maxThreads("INGRESS_BENCH_MAX_THREADS", 0);
+Env_Option<int> numClients("INGRESS_BENCH_CLIENTS", 64);
+
+
+/*****************************************************************************/
+/* AUCTION FINISHER                                                          */
+/*****************************************************************************/
+
+/** Stands in for the router: finishes each auction, without bids, from its
+    own thread.
+*/
+struct AuctionFinisher {
+    AuctionFinisher()
+        : shutdown(false), thread([=] () { this->run(); })
+    {
+    }
+
+    ~AuctionFinisher()
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            shutdown = true;
+        }
+        cond.notify_one();
+        thread.join();
+    }
+
+    void push(std::shared_ptr<Auction> auction)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            auctions.push_back(std::move(auction));
+        }
+        cond.notify_one();
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<std::shared_ptr<Auction> > auctions;
+    bool shutdown;
+    std::thread thread;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        for (;;) {
+            cond.wait(guard, [&] () { return shutdown || !auctions.empty(); });
+            if (shutdown) return;
+
+            std::deque<std::shared_ptr<Auction> > toFinish;
+            toFinish.swap(auctions);
+
+            guard.unlock();
+            for (auto & auction: toFinish)
+                auction->finish();
+            guard.lock();
+        }
+    }
+};
+
+
+/*****************************************************************************/
+/* CLIENT                                                                    */
+/*****************************************************************************/
+
+const string requestBody
+    = "{\"id\":\"1\",\"tmax\":100,"
+      "\"imp\":[{\"id\":\"1\",\"banner\":{\"w\":300,\"h\":250}}],"
+      "\"site\":{\"id\":\"1\",\"page\":\"http://example.com/\"},"
+      "\"device\":{\"ua\":\"Mozilla/5.0\",\"ip\":\"10.0.0.1\"},"
+      "\"user\":{\"id\":\"abcdef\"}}";
+
+const string request
+    = "POST /auctions HTTP/1.1\r\n"
+      "Content-Type: application/json\r\n"
+      "x-openrtb-version: 2.1\r\n"
+      + ML::format("Content-Length: %zd\r\n", requestBody.size())
+      + "\r\n" + requestBody;
+
+/** A keep-alive connection sending one request at a time, until told to
+    stop; returns the latency of each response in milliseconds.
+*/
+vector<double> runClient(int port, const std::atomic<bool> & stop)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+        throw ML::Exception(errno, "socket");
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == -1)
+        throw ML::Exception(errno, "connect");
+
+    vector<double> latencies;
+    string buffer;
+    char chunk[4096];
+
+    while (!stop) {
+        Date sent = Date::now();
+        if (send(fd, request.c_str(), request.size(), MSG_NOSIGNAL)
+            != (ssize_t)request.size())
+            break;
+
+        // Read the header, then as much body as it announces
+        size_t headerEnd = string::npos, length = 0;
+        for (;;) {
+            if (headerEnd == string::npos) {
+                headerEnd = buffer.find("\r\n\r\n");
+                if (headerEnd != string::npos) {
+                    headerEnd += 4;
+                    string header = buffer.substr(0, headerEnd);
+                    std::transform(header.begin(), header.end(),
+                                   header.begin(), ::tolower);
+                    auto pos = header.find("content-length:");
+                    if (pos != string::npos)
+                        length = atoi(header.c_str() + pos + 15);
+                }
+            }
+            if (headerEnd != string::npos
+                && buffer.size() >= headerEnd + length)
+                break;
+
+            ssize_t res = recv(fd, chunk, sizeof(chunk), 0);
+            if (res <= 0) {
+                ::close(fd);
+                return latencies;
+            }
+            buffer.append(chunk, res);
+        }
+
+        buffer.erase(0, headerEnd + length);
+        latencies.push_back(Date::now().secondsSince(sent) * 1000.0);
+    }
+
+    ::close(fd);
+    return latencies;
+}
+
+
+/*****************************************************************************/
+/* BENCHMARK                                                                 */
+/*****************************************************************************/
+
+BOOST_AUTO_TEST_CASE( bench_http_ingress_scaling )
+{
+    int cores = maxThreads.get() > 0 ? maxThreads.get()
+        : std::max<int>(1, std::thread::hardware_concurrency());
+
+    vector<int> threadCounts;
+    for (int n = 1;  n < cores;  n *= 2)
+        threadCounts.push_back(n);
+    threadCounts.push_back(cores);
+
+    cerr << "threads  requests/s    p50ms    p99ms  p99.9ms" << endl;
+
+    for (int threads: threadCounts) {
+        auto proxies = std::make_shared<ServiceProxies>();
+        AuctionFinisher finisher;
+
+        auto connector = std::make_shared<OpenRTBExchangeConnector>
+            ("connector", proxies);
+        connector->configureHttp(threads, -1, "127.0.0.1", false,
+                                 DEF_BACKLOG, "/auctions");
+
+        // Connections stay on the thread that accepted them
+        Json::Value config;
+        config["recycleConnectionsEvery"] = 0;
+        connector->configure(config);
+
+        connector->onNewAuction = [&] (std::shared_ptr<Auction> auction)
+            {
+                finisher.push(auction);
+            };
+        connector->onAuctionDone = [] (std::shared_ptr<Auction>) {};
+        connector->enableUntil(Date::positiveInfinity());
+        connector->start();
+        int port = connector->port();
+
+        std::atomic<bool> stop(false);
+        vector<vector<double> > results(numClients.get());
+        vector<std::thread> clients;
+        for (int i = 0;  i < numClients.get();  ++i)
+            clients.emplace_back([&, i] () {
+                    results[i] = runClient(port, stop);
+                });
+
+        double duration = 5.0;
+        ML::sleep(duration);
+        stop = true;
+        for (auto & client: clients)
+            client.join();
+
+        vector<double> latencies;
+        for (auto & r: results)
+            latencies.insert(latencies.end(), r.begin(), r.end());
+        BOOST_REQUIRE(!latencies.empty());
+        std::sort(latencies.begin(), latencies.end());
+
+        auto percentile = [&] (double p)
+            {
+                return latencies[std::min<size_t>(latencies.size() - 1,
+                                                  latencies.size() * p)];
+            };
+
+        cerr << ML::format("%7d %11.0f %8.3f %8.3f %8.3f",
+                           threads, latencies.size() / duration,
+                           percentile(0.5), percentile(0.99),
+                           percentile(0.999))
+             << endl;
+        cerr << connector->getServiceStatus()["ingressThreads"] << endl;
+
+        connector->shutdown();
+    }
+}
@@ -0,0 +1,102 @@
+/* response_writer_bench.cc
+   Copyright (c) 2013 Datacratic Inc.  All rights reserved.
+
+   Cost of writing OpenRTB bid responses of 1 to 10 impressions directly,
+   compared to building an OpenRTB::BidResponse and printing it through its
+   value description.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/exchange/response_writer.h"
+#include "openrtb/openrtb_parsing.h"
+#include "soa/types/json_printing.h"
+#include "jml/arch/timers.h"
+#include <sstream>
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( bench_openrtb_response_writer )
+{
+    // A typical creative, as a Rubicon campaign would configure it
+    OpenRTB::Bid fixed;
+    fixed.adm = "<a href=\"http://adserver.com/click?auction=${AUCTION_ID}\">"
+                "<img src=\"http://adserver.com/img.png?"
+                "price=${AUCTION_PRICE:BF}\"/></a>";
+    fixed.adomain = { "advertiser.com" };
+    fixed.crid = Id("creative-1234");
+    string fragment = OpenRTBResponseWriter::renderFragment(fixed);
+
+    Id auctionId("3b9f2d0a-8e6c-4b1a-9d2f-7c1e5a0f4b21");
+    Id seat("seat-42");
+    Id agent("agent_1234");
+
+    enum { NumIterations = 100000 };
+
+    cerr << "imps   object graph ns   writer ns   bytes" << endl;
+
+    for (unsigned numImps = 1;  numImps <= 10;  ++numImps) {
+        double graphTime, writerTime;
+        size_t bytes = 0;
+
+        {
+            static DefaultDescription<OpenRTB::BidResponse> desc;
+
+            Timer timer;
+            for (unsigned i = 0;  i < NumIterations;  ++i) {
+                OpenRTB::BidResponse response;
+                response.id = auctionId;
+                response.seatbid.emplace_back();
+                response.seatbid.back().seat = seat;
+
+                for (unsigned imp = 0;  imp < numImps;  ++imp) {
+                    auto & seatBid = response.seatbid.back();
+                    seatBid.bid.emplace_back();
+                    auto & b = seatBid.bid.back();
+                    b.cid = agent;
+                    b.id = Id(auctionId, Id(1));
+                    b.impid = Id(imp + 1);
+                    b.price.val = 1.25 + imp;
+                    b.adm = fixed.adm;
+                    b.adomain = fixed.adomain;
+                    b.crid = fixed.crid;
+                }
+
+                std::ostringstream stream;
+                StreamJsonPrintingContext context(stream);
+                desc.printJsonTyped(&response, context);
+                bytes += stream.str().size();
+            }
+            graphTime = timer.elapsed_wall();
+        }
+
+        {
+            auto & writer = OpenRTBResponseWriter::forThisThread();
+
+            Timer timer;
+            for (unsigned i = 0;  i < NumIterations;  ++i) {
+                for (unsigned imp = 0;  imp < numImps;  ++imp)
+                    writer.addBid(seat, Id(auctionId, Id(1)), Id(imp + 1),
+                                  1.25 + imp, agent, &fragment);
+                bytes = writer.write(auctionId).size();
+            }
+            writerTime = timer.elapsed_wall();
+        }
+
+        BOOST_CHECK_GT(bytes, 0);
+
+        cerr << ML::format("%4d %17.0f %11.0f %7zd",
+                           numImps,
+                           graphTime * 1e9 / NumIterations,
+                           writerTime * 1e9 / NumIterations,
+                           bytes)
+             << endl;
+    }
+}
@@ -0,0 +1,98 @@
+/* response_writer_test.cc
+   Copyright (c) 2013 Datacratic Inc.  All rights reserved.
+
+   Tests for the direct bid response writers.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/exchange/response_writer.h"
+
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( test_render_fragment )
+{
+    OpenRTB::Bid fixed;
+    fixed.adm = "<a href=\"http://ad.com/?p=${AUCTION_PRICE}\">\n\tad</a>";
+    fixed.adomain = { "ad.com", "ads.com" };
+    fixed.crid = Id("creative-1");
+
+    string fragment = OpenRTBResponseWriter::renderFragment(fixed);
+    BOOST_CHECK_EQUAL(fragment[0], ',');
+
+    // The fragment's fields round trip through a JSON parser
+    Json::Value parsed = Json::parse("{\"x\":0" + fragment + "}");
+    BOOST_CHECK_EQUAL(parsed["adm"].asString(), fixed.adm);
+    BOOST_CHECK_EQUAL(parsed["adomain"].size(), 2);
+    BOOST_CHECK_EQUAL(parsed["adomain"][1].asString(), "ads.com");
+    BOOST_CHECK_EQUAL(parsed["crid"].asString(), "creative-1");
+    BOOST_CHECK(!parsed.isMember("nurl"));
+    BOOST_CHECK(!parsed.isMember("adid"));
+}
+
+BOOST_AUTO_TEST_CASE( test_openrtb_response_writer )
+{
+    OpenRTB::Bid fixed;
+    fixed.adm = "markup";
+    string fragment = OpenRTBResponseWriter::renderFragment(fixed);
+
+    OpenRTBResponseWriter writer;
+    BOOST_CHECK(writer.empty());
+
+    // Bids on two seats, interleaved
+    writer.addBid(Id("seat1"), Id("b1"), Id("1"), 1.5, Id("agent"), &fragment);
+    writer.addBid(Id("seat2"), Id("b2"), Id("2"), 0.25);
+    writer.addBid(Id("seat1"), Id("b3"), Id("3"), 2.0, Id(), &fragment);
+    BOOST_CHECK(!writer.empty());
+
+    Json::Value ext;
+    ext["key"] = "value";
+
+    Json::Value response = Json::parse(writer.write(Id("auction"), ext));
+    BOOST_CHECK(writer.empty());
+
+    BOOST_CHECK_EQUAL(response["id"].asString(), "auction");
+    BOOST_CHECK_EQUAL(response["ext"]["key"].asString(), "value");
+    BOOST_REQUIRE_EQUAL(response["seatbid"].size(), 2);
+
+    const Json::Value & seat1 = response["seatbid"][0];
+    BOOST_CHECK_EQUAL(seat1["seat"].asString(), "seat1");
+    BOOST_REQUIRE_EQUAL(seat1["bid"].size(), 2);
+    BOOST_CHECK_EQUAL(seat1["bid"][0]["id"].asString(), "b1");
+    BOOST_CHECK_EQUAL(seat1["bid"][0]["impid"].asString(), "1");
+    BOOST_CHECK_EQUAL(seat1["bid"][0]["price"].asDouble(), 1.5);
+    BOOST_CHECK_EQUAL(seat1["bid"][0]["cid"].asString(), "agent");
+    BOOST_CHECK_EQUAL(seat1["bid"][0]["adm"].asString(), "markup");
+    BOOST_CHECK_EQUAL(seat1["bid"][1]["id"].asString(), "b3");
+    BOOST_CHECK(!seat1["bid"][1].isMember("cid"));
+
+    const Json::Value & seat2 = response["seatbid"][1];
+    BOOST_CHECK_EQUAL(seat2["seat"].asString(), "seat2");
+    BOOST_CHECK_EQUAL(seat2["bid"][0]["price"].asDouble(), 0.25);
+    BOOST_CHECK(!seat2["bid"][0].isMember("adm"));
+
+    // The next response starts from scratch; no seat means no seat field
+    writer.addBid(Id(), Id("b4"), Id("1"), 1.0);
+    response = Json::parse(writer.write(Id("auction2")));
+    BOOST_CHECK_EQUAL(response["id"].asString(), "auction2");
+    BOOST_REQUIRE_EQUAL(response["seatbid"].size(), 1);
+    BOOST_CHECK(!response["seatbid"][0].isMember("seat"));
+    BOOST_CHECK(!response.isMember("ext"));
+
+    // A response abandoned half way leaves nothing behind for the thread's
+    // next one
+    auto & threadWriter = OpenRTBResponseWriter::forThisThread();
+    threadWriter.addBid(Id("seat1"), Id("b5"), Id("1"), 1.0, Id(), &fragment);
+    BOOST_CHECK(OpenRTBResponseWriter::forThisThread().empty());
+    threadWriter.addBid(Id("seat1"), Id("b6"), Id("1"), 1.0);
+    response = Json::parse(threadWriter.write(Id("auction3")));
+    BOOST_REQUIRE_EQUAL(response["seatbid"].size(), 1);
+    BOOST_REQUIRE_EQUAL(response["seatbid"][0]["bid"].size(), 1);
+    BOOST_CHECK_EQUAL(response["seatbid"][0]["bid"][0]["id"].asString(), "b6");
+}
@@ -0,0 +1,197 @@
+/** bid_request_containers_bench.cc                                 -*- C++ -*-
+    Copyright (c) 2013 Datacratic.  All rights reserved.
+
+    Allocations and time taken to fill in the user ids and segments of a
+    bid request and to filter it on them, compared to the std::map keyed by
+    strings that they used to be.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/bid_request.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include "rtbkit/core/router/router_types.h"
+#include "rtbkit/testing/generic_exchange_connector.h"
+#include "jml/arch/timers.h"
+#include "jml/arch/format.h"
+
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+/******************************************************************************/
+/* ALLOCATION COUNTING                                                        */
+/******************************************************************************/
+
+namespace {
+
+size_t numAllocations = 0;
+
+} // file scope
+
+void * operator new (size_t size)
+{
+    ++numAllocations;
+    void * result = malloc(size ? size : 1);
+    if (!result)
+        throw std::bad_alloc();
+    return result;
+}
+
+void operator delete (void * ptr) noexcept
+{
+    free(ptr);
+}
+
+
+/******************************************************************************/
+/* UTILITIES                                                                  */
+/******************************************************************************/
+
+namespace {
+
+enum { NumIterations = 100000 };
+
+const char * domains[] = { "xchg", "prov", "dmp1", "cookieSync" };
+const char * sources[] = { "dmp1", "dmp2", "contextual", "retargeting" };
+
+typedef std::map<std::string, Id> OldUserIds;
+typedef std::map<std::string, std::shared_ptr<SegmentList> > OldSegments;
+
+void fill(OldUserIds & ids)
+{
+    for (unsigned i = 0;  i < 4;  ++i)
+        ids[domains[i]] = Id(i + 1);
+}
+
+void fill(UserIds & ids)
+{
+    for (unsigned i = 0;  i < 4;  ++i)
+        ids.add(Id(i + 1), domains[i]);
+}
+
+template<typename Segments>
+void fill(Segments & segs)
+{
+    for (unsigned i = 0;  i < 4;  ++i) {
+        auto & list = segs[sources[i]];
+        list = std::make_shared<SegmentList>();
+        for (unsigned j = 0;  j < 4;  ++j)
+            list->add(int(i * 10 + j));
+        list->sort();
+    }
+}
+
+/** What the static filters of a campaign with required ids and segment
+    filters for two of the sources look up in the request.
+*/
+template<typename Ids, typename Segments, typename Key>
+bool lookup(const Ids & ids, const Segments & segs,
+            const std::vector<Key> & requiredIds,
+            const std::vector<Key> & segmentSources)
+{
+    for (auto & domain: requiredIds)
+        if (!ids.count(domain))
+            return false;
+    for (auto & source: segmentSources) {
+        auto it = segs.find(source);
+        if (it == segs.end() || !it->second->contains(int(1)))
+            return false;
+    }
+    return true;
+}
+
+template<typename Fn>
+void bench(const std::string & what, const Fn & fn)
+{
+    size_t before = numAllocations;
+    Timer timer;
+    for (unsigned i = 0;  i < NumIterations;  ++i)
+        fn();
+    double elapsed = timer.elapsed_wall();
+    cerr << ML::format("%-30s %8.1fns %6.1f allocations",
+                       what.c_str(), elapsed * 1e9 / NumIterations,
+                       (numAllocations - before) * 1.0 / NumIterations)
+         << endl;
+}
+
+} // file scope
+
+
+/******************************************************************************/
+/* BENCHES                                                                    */
+/******************************************************************************/
+
+BOOST_AUTO_TEST_CASE( bench_fill_and_lookup )
+{
+    bench("fill old user ids", [] () { OldUserIds ids;  fill(ids); });
+    bench("fill user ids", [] () { UserIds ids;  fill(ids); });
+    bench("fill old segments", [] () { OldSegments segs;  fill(segs); });
+    bench("fill segments", [] () { SegmentsBySource segs;  fill(segs); });
+
+    OldUserIds oldIds;  fill(oldIds);
+    OldSegments oldSegs;  fill(oldSegs);
+    vector<string> oldRequired = { "prov", "cookieSync" };
+    vector<string> oldSegmentSources = { "dmp1", "contextual" };
+
+    UserIds ids;  fill(ids);
+    SegmentsBySource segs;  fill(segs);
+    vector<InternedName> required = { "prov", "cookieSync" };
+    vector<InternedName> segmentSources = { "dmp1", "contextual" };
+
+    bool found = true;
+    bench("lookup old containers", [&] ()
+          {
+              found &= lookup(oldIds, oldSegs, oldRequired,
+                               oldSegmentSources);
+          });
+    bench("lookup containers", [&] ()
+          {
+              found &= lookup(ids, segs, required, segmentSources);
+          });
+    BOOST_CHECK(found);
+}
+
+BOOST_AUTO_TEST_CASE( bench_static_filters )
+{
+    GenericExchangeConnector exchange;
+
+    AgentConfig config;
+    config.account = { "hello", "world" };
+    config.creatives.push_back(Creative::sampleLB);
+    config.requiredIds = { "prov", "cookieSync" };
+    config.segments["dmp1"].include.add(1);
+    config.segments["contextual"].exclude.add(100);
+    config.segments["dmp1"].include.sort();
+    config.segments["contextual"].exclude.sort();
+
+    config.providerData[exchange.exchangeName()]
+        = exchange.getCampaignCompatibility(config, true).info;
+    for (auto & creative: config.creatives)
+        creative.providerData[exchange.exchangeName()]
+            = exchange.getCreativeCompatibility(creative, true).info;
+
+    BidRequest request;
+    AdSpot spot;
+    spot.id = Id(1);
+    spot.formats.emplace_back(728, 90);
+    request.imp.push_back(spot);
+    fill(request.userIds);
+    fill(request.segments);
+
+    AgentStats stats;
+    size_t biddable = 0;
+    bench("static filters", [&] ()
+          {
+              AgentConfig::RequestFilterCache cache(request);
+              biddable += !config.isBiddableRequest(&exchange, request, stats,
+                                                    cache).empty();
+          });
+    BOOST_CHECK_EQUAL(biddable, NumIterations);
+}
@@ -0,0 +1,76 @@
+/* bid_request_js_bench.js
+ * Copyright (c) 2013 Datacratic.  All rights reserved.
+ *
+ * Bids per second of a trivial agent reading a bid request, either after
+ * converting the whole request to a plain object or through the lazy
+ * accessors of the wrapped request.
+ */
+
+var assert = require('assert');
+var brm    = require('bid_request');
+
+var request
+    = {"!!CV": "RTBKIT-JSON-1.0",
+       "exchange": "zeExchange",
+       "id": "148ce45e066a4ef2e6e4b927dc881ad6f209cf4b",
+       "imp": [{"banner": {"h": 250, "w": 300}, "formats": ["300x250"], "id": "1"},
+               {"banner": {"h": 90, "w": 728}, "formats": ["728x90"], "id": "2"}],
+       "ipAddress": "666.21.123.234",
+       "language": "en",
+       "location": {"cityName": "Chicago", "countryCode": "US",
+                    "regionCode": "IL"},
+       "provider": "zeProvider",
+       "segments": {"100": [1, 43, 125, 200, 201, 202, 300, 301],
+                    "segid": ["Atext", "text1"]},
+       "timestamp": 1366768734.7632546,
+       "url": "http://domain.com/",
+       "userIds": {"prov": "somid", "xchg": "localid"}};
+
+var numRequests = 100000;
+
+var buffer = new brm.BidRequest(JSON.stringify(request), "datacratic").toBuffer();
+
+/** The agent: bid on every spot if the user is in segment 43. */
+function eagerAgent(br)
+{
+    var obj = br.toJSON();
+    var segs = obj.segments["100"];
+    var bids = 0;
+    for (var i = 0;  i < obj.imp.length;  ++i) {
+        if (segs.indexOf(43) != -1 && obj.userIds.prov)
+            ++bids;
+    }
+    return bids;
+}
+
+function lazyAgent(br)
+{
+    var segs = br.segments["100"].ints;
+    var bids = 0;
+    for (var i = 0;  i < br.imp.length;  ++i) {
+        var found = false;
+        for (var j = 0;  j < segs.length && !found;  ++j)
+            found = segs[j] == 43;
+        if (found && br.userIds.prov)
+            ++bids;
+    }
+    return bids;
+}
+
+function run(name, agent)
+{
+    var start = Date.now();
+    var bids = 0;
+    for (var i = 0;  i < numRequests;  ++i)
+        bids += agent(new brm.BidRequest(buffer));
+    var elapsed = (Date.now() - start) / 1000.0;
+
+    assert.equal(bids, numRequests * request.imp.length);
+    console.log(name + ": " + Math.round(numRequests / elapsed)
+                + " requests/s");
+    return elapsed;
+}
+
+var eager = run("eager", eagerAgent);
+var lazy = run("lazy", lazyAgent);
+console.log("speedup: " + (eager / lazy).toFixed(2) + "x");
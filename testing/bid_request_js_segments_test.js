@@ -107,6 +107,35 @@ var segmentsTest = {
                "'text1' must be present in segments['segid']");
         assert("Atext" in segidValues,
                "'Atext' must be present in segments['segid']");
+    },
+    checkIntsCopy: function(x) {
+        var ints = x.segments["100"].ints;
+        assert.equal(ints.length, 3);
+        assert.equal(ints[0], 1);
+        assert.equal(ints[1], 43);
+        assert.equal(ints[2], 125);
+        assert.equal(x.segments["segid"].ints.length, 0);
+
+        // The ints are a copy; writing to it doesn't change the list, and
+        // it stays valid when the list grows
+        ints[0] = 7;
+        assert.equal(x.segments["100"].ints[0], 1);
+        x.segments["100"].add("200");
+        assert.equal(ints.length, 3);
+        assert.equal(ints[2], 125);
+        assert.equal(x.segments["100"].ints.length, 4);
+    },
+    checkCachedAccessors: function(x) {
+        assert(x.segments === x.segments, "segments must be cached");
+        assert(x.segments["100"] === x.segments["100"],
+               "segment lists must be cached");
+        assert(x.userIds === x.userIds, "userIds must be cached");
+    },
+    checkBuffer: function(x) {
+        var copy = new brm.BidRequest(x.toBuffer());
+        assert.equal(copy.id, x.id);
+        assert.equal(copy.segments["100"].ints[1], 43);
+        assert.equal(copy.userIds.prov, x.userIds.prov);
     }
 };
 
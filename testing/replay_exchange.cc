@@ -0,0 +1,670 @@
+/* replay_exchange.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Open loop load generator that replays captured or synthesized bid
+   requests against an exchange connector, optionally backed by a local
+   router stack, and reports throughput and latency percentiles.
+*/
+
+#include "rtbkit/plugins/exchange/http_auction_handler.h"
+#include "rtbkit/common/testing/bid_request_synth.h"
+#include "rtbkit/common/testing/exchange_source.h"
+#include "rtbkit/core/router/router_stack.h"
+#include "rtbkit/testing/test_agent.h"
+#include "rtbkit/examples/augmentor_ex.h"
+#include "jml/arch/exception.h"
+#include "jml/arch/format.h"
+#include "jml/arch/timers.h"
+#include "jml/utils/filter_streams.h"
+#include "jml/utils/file_functions.h"
+#include "soa/jsoncpp/json.h"
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <deque>
+#include <algorithm>
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+/*****************************************************************************/
+/* REPLAY REQUEST                                                            */
+/*****************************************************************************/
+
+/** A complete HTTP request to send, with the time at which it was originally
+    received if it came from a capture.
+*/
+struct ReplayRequest {
+    std::string http;
+    Date timestamp;
+};
+
+std::vector<ReplayRequest>
+loadCapture(const std::string & filename)
+{
+    std::vector<ReplayRequest> result;
+
+    auto onRequest = [&] (const std::string & request, Date timestamp)
+        {
+            result.push_back({ request, timestamp });
+        };
+
+    HttpAuctionLogger::parseTimed(filename, onRequest);
+    return result;
+}
+
+std::vector<ReplayRequest>
+synthesize(const std::string & modelFile, int count,
+           const std::string & resource,
+           const std::vector<std::string> & headers)
+{
+    BidRequestSynth synth;
+    ML::filter_istream stream(modelFile);
+    synth.load(stream);
+
+    std::vector<ReplayRequest> result;
+    result.reserve(count);
+
+    for (int i = 0;  i < count;  ++i) {
+        std::string body = synth.generate().toStringNoNewLine();
+
+        std::string http
+            = "POST " + resource + " HTTP/1.1\r\n"
+            + "Content-Type: application/json\r\n"
+            + ML::format("Content-Length: %zd\r\n", body.size());
+        for (auto & header: headers)
+            http += header + "\r\n";
+        http += "\r\n" + body;
+
+        result.push_back({ http, Date() });
+    }
+
+    return result;
+}
+
+
+/*****************************************************************************/
+/* REPLAY STATS                                                              */
+/*****************************************************************************/
+
+struct ReplayStats {
+    ReplayStats()
+        : sent(0), bids(0), noBids(0), errors(0), timeouts(0), dropped(0)
+    {
+    }
+
+    uint64_t sent;
+    uint64_t bids;        ///< 200 responses with a body
+    uint64_t noBids;      ///< 204 responses or 200 with no body
+    uint64_t errors;      ///< Any other response, or a broken connection
+    uint64_t timeouts;    ///< No response within the timeout
+    uint64_t dropped;     ///< Never sent as the backlog was full
+
+    /// Latency in milliseconds of each response, measured from the time at
+    /// which its request was due rather than from when it was sent
+    std::vector<double> latencies;
+
+    Json::Value toJson(double elapsed) const
+    {
+        Json::Value result;
+
+        uint64_t responses = bids + noBids;
+
+        result["elapsedSeconds"] = elapsed;
+        result["sent"] = (Json::UInt64)sent;
+        result["responses"] = (Json::UInt64)responses;
+        result["bids"] = (Json::UInt64)bids;
+        result["noBids"] = (Json::UInt64)noBids;
+        result["errors"] = (Json::UInt64)errors;
+        result["timeouts"] = (Json::UInt64)timeouts;
+        result["dropped"] = (Json::UInt64)dropped;
+        result["throughput"] = responses / elapsed;
+        result["bidRate"] = responses ? 1.0 * bids / responses : 0.0;
+
+        std::vector<double> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+
+        auto percentile = [&] (double p) -> double
+            {
+                if (sorted.empty())
+                    return 0.0;
+                size_t index = std::min<size_t>(p * sorted.size(),
+                                                sorted.size() - 1);
+                return sorted[index];
+            };
+
+        Json::Value & latency = result["latencyMs"];
+        latency["p50"] = percentile(0.5);
+        latency["p90"] = percentile(0.9);
+        latency["p99"] = percentile(0.99);
+        latency["p999"] = percentile(0.999);
+        latency["max"] = sorted.empty() ? 0.0 : sorted.back();
+
+        return result;
+    }
+};
+
+
+/*****************************************************************************/
+/* REPLAY DRIVER                                                             */
+/*****************************************************************************/
+
+/** Sends requests over a fixed number of keep-alive connections on a
+    schedule that doesn't depend on the responses (open loop).  A request
+    that is due while all connections are busy waits in a backlog, and its
+    latency includes the time spent there, so that a slow server shows up
+    as high latency rather than as a lower request rate.
+*/
+
+struct ReplayDriver {
+
+    ReplayDriver(const std::string & host, int port,
+                 int numConnections, double timeoutMs, size_t maxBacklog)
+        : host(host), port(port), timeoutMs(timeoutMs),
+          maxBacklog(maxBacklog), connections(numConnections)
+    {
+        epollFd = epoll_create(1);
+        if (epollFd == -1)
+            throw ML::Exception(errno, "epoll_create");
+
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        int res = getaddrinfo(host.c_str(), std::to_string(port).c_str(),
+                              &hints, &addr);
+        if (res != 0)
+            throw ML::Exception("couldn't resolve " + host + ": "
+                                + gai_strerror(res));
+
+        for (auto & c: connections)
+            connect(c);
+    }
+
+    ~ReplayDriver()
+    {
+        for (auto & c: connections)
+            if (c.fd != -1)
+                ::close(c.fd);
+        freeaddrinfo(addr);
+        ::close(epollFd);
+    }
+
+    /** Send the requests.  due(i) returns the time, relative to the start,
+        at which the ith request is to be sent.
+    */
+    ReplayStats run(const std::vector<ReplayRequest> & requests,
+                    const std::function<double (size_t)> & due,
+                    size_t numToSend)
+    {
+        ReplayStats stats;
+        Date start = Date::now();
+        size_t next = 0;
+
+        for (;;) {
+            Date now = Date::now();
+
+            // Everything that is due goes to the backlog
+            while (next < numToSend
+                   && start.plusSeconds(due(next)) <= now) {
+                if (backlog.size() >= maxBacklog)
+                    ++stats.dropped;
+                else backlog.push_back({ next, start.plusSeconds(due(next)) });
+                ++next;
+            }
+
+            // ... and from there to any idle connection
+            for (auto & c: connections) {
+                if (backlog.empty())
+                    break;
+                if (c.busy || c.fd == -1)
+                    continue;
+                send(c, requests[backlog.front().index % requests.size()].http,
+                     backlog.front().due);
+                backlog.pop_front();
+                ++stats.sent;
+            }
+
+            // Time out requests that have waited too long for a response
+            for (auto & c: connections) {
+                if (c.busy && now.secondsSince(c.due) * 1000.0 > timeoutMs) {
+                    ++stats.timeouts;
+                    reconnect(c);
+                }
+            }
+
+            bool busy = !backlog.empty();
+            for (auto & c: connections)
+                busy = busy || c.busy;
+            if (next == numToSend && !busy)
+                break;
+
+            int waitMs = 1;
+            if (next < numToSend && backlog.empty()) {
+                double untilNext = now.secondsUntil(start.plusSeconds(due(next)));
+                waitMs = std::max(0, std::min(10, int(untilNext * 1000)));
+            }
+
+            epoll_event events[64];
+            int numEvents = epoll_wait(epollFd, events, 64, waitMs);
+            if (numEvents == -1 && errno != EINTR)
+                throw ML::Exception(errno, "epoll_wait");
+
+            for (int i = 0;  i < numEvents;  ++i) {
+                Connection & c = connections[events[i].data.u32];
+                if (events[i].events & EPOLLOUT)
+                    flush(c);
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    receive(c, stats);
+            }
+        }
+
+        double elapsed = Date::now().secondsSince(start);
+        lastElapsed = elapsed;
+        return stats;
+    }
+
+    double lastElapsed;
+
+private:
+    struct Connection {
+        Connection()
+            : fd(-1), busy(false), written(0)
+        {
+        }
+
+        int fd;
+        bool busy;
+        Date due;
+        std::string out;
+        size_t written;
+        std::string in;
+    };
+
+    struct Pending {
+        size_t index;
+        Date due;
+    };
+
+    std::string host;
+    int port;
+    double timeoutMs;
+    size_t maxBacklog;
+    addrinfo * addr;
+    int epollFd;
+    std::vector<Connection> connections;
+    std::deque<Pending> backlog;
+
+    void connect(Connection & c)
+    {
+        c = Connection();
+
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == -1)
+            throw ML::Exception(errno, "socket");
+
+        int flag = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+        if (::connect(fd, addr->ai_addr, addr->ai_addrlen) == -1) {
+            ::close(fd);
+            throw ML::Exception(errno, "connect to %s:%d", host.c_str(), port);
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = &c - &connections[0];
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1)
+            throw ML::Exception(errno, "epoll_ctl");
+
+        c.fd = fd;
+    }
+
+    void reconnect(Connection & c)
+    {
+        if (c.fd != -1)
+            ::close(c.fd);
+        c.fd = -1;
+        connect(c);
+    }
+
+    void send(Connection & c, const std::string & request, Date due)
+    {
+        c.busy = true;
+        c.due = due;
+        c.out = request;
+        c.written = 0;
+        c.in.clear();
+        flush(c);
+    }
+
+    void flush(Connection & c)
+    {
+        while (c.written < c.out.size()) {
+            ssize_t res = ::write(c.fd, c.out.data() + c.written,
+                                  c.out.size() - c.written);
+            if (res == -1) {
+                if (errno == EAGAIN)
+                    break;
+                throw ML::Exception(errno, "write");
+            }
+            c.written += res;
+        }
+
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | (c.written < c.out.size() ? EPOLLOUT : 0);
+        event.data.u32 = &c - &connections[0];
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &event);
+    }
+
+    void receive(Connection & c, ReplayStats & stats)
+    {
+        char buffer[65536];
+
+        for (;;) {
+            ssize_t res = ::read(c.fd, buffer, sizeof(buffer));
+            if (res == -1 && errno == EAGAIN)
+                break;
+            if (res <= 0) {
+                // Connection closed or broken; anything in flight is lost
+                if (c.busy)
+                    ++stats.errors;
+                reconnect(c);
+                return;
+            }
+            c.in.append(buffer, res);
+        }
+
+        if (!c.busy)
+            return;
+
+        size_t endOfHeader = c.in.find("\r\n\r\n");
+        if (endOfHeader == std::string::npos)
+            return;
+
+        int status = 0;
+        sscanf(c.in.c_str(), "HTTP/%*d.%*d %d", &status);
+
+        size_t contentLength = 0;
+        std::string header = c.in.substr(0, endOfHeader);
+        std::transform(header.begin(), header.end(), header.begin(), ::tolower);
+        size_t pos = header.find("\r\ncontent-length:");
+        if (pos != std::string::npos)
+            contentLength = strtoul(header.c_str() + pos + 17, nullptr, 10);
+
+        if (c.in.size() < endOfHeader + 4 + contentLength)
+            return;
+
+        stats.latencies.push_back(Date::now().secondsSince(c.due) * 1000.0);
+
+        if (status == 200 && contentLength > 0)
+            ++stats.bids;
+        else if (status == 200 || status == 204)
+            ++stats.noBids;
+        else ++stats.errors;
+
+        c.busy = false;
+        c.in.erase(0, endOfHeader + 4 + contentLength);
+
+        if (header.find("\r\nconnection: close") != std::string::npos)
+            reconnect(c);
+    }
+};
+
+
+/*****************************************************************************/
+/* LOCAL STACK                                                               */
+/*****************************************************************************/
+
+/** A router stack with a bidding agent that bids on everything, and
+    optionally the frequency cap augmentor, to replay against.
+*/
+
+struct LocalStack {
+
+    LocalStack(std::shared_ptr<ServiceProxies> proxies)
+        : stack(proxies, "replay-router"),
+          agent(proxies, "replay-agent"),
+          augmentor(proxies, "frequency-cap-ex")
+    {
+    }
+
+    void start(const Json::Value & exchangeConfig, bool augment)
+    {
+        stack.init();
+        for (auto & exchange: exchangeConfig)
+            stack.router.startExchange(exchange);
+        stack.start();
+
+        AccountKey account = agent.config.account;
+        stack.budgetController.addAccountSync(account);
+        stack.budgetController.setBudgetSync(account[0], USD(1000));
+        stack.budgetController.topupTransferSync(account, USD(100));
+
+        augmentor.init();
+        augmentor.start();
+
+        agent.init();
+        agent.strictMode(false);
+        agent.onWin.clear();
+        agent.onLoss.clear();
+        agent.onNoBudget.clear();
+        agent.onTooLate.clear();
+
+        if (augment) {
+            AugmentationConfig augConfig;
+            augConfig.name = "frequency-cap-ex";
+            augConfig.required = true;
+            augConfig.config = Json::Value(42);
+            augConfig.filters.include.push_back("pass-frequency-cap-ex");
+            agent.config.addAugmentation(augConfig);
+        }
+
+        // Replayed captures can repeat auction ids, so this doesn't go
+        // through TestAgent's bookkeeping of bids in flight
+        agent.onBidRequest = [&] (double timestamp,
+                                  const Id & id,
+                                  std::shared_ptr<BidRequest> br,
+                                  Bids bids,
+                                  double timeLeftMs,
+                                  const Json::Value & augmentations,
+                                  const WinCostModel & wcm)
+            {
+                for (Bid & bid: bids) {
+                    if (!bid.availableCreatives.empty())
+                        bid.bid(bid.availableCreatives[0], USD_CPM(1));
+                }
+                agent.BiddingAgent::doBid(id, bids, Json::Value(), wcm);
+            };
+
+        agent.start();
+
+        // Give the banker and the agent configuration time to propagate
+        ML::sleep(2.1);
+    }
+
+    void shutdown()
+    {
+        agent.shutdown();
+        augmentor.shutdown();
+        stack.shutdown();
+    }
+
+    RouterStack stack;
+    TestAgent agent;
+    FrequencyCapAugmentor augmentor;
+};
+
+
+/*****************************************************************************/
+/* MAIN                                                                      */
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+    using namespace boost::program_options;
+
+    string captureFile;
+    string synthModel;
+    int synthCount = 10000;
+    string resource = "/auctions";
+    vector<string> headers;
+    string target = "localhost:12339";
+    int numConnections = 32;
+    double qps = 0.0;
+    double speed = 0.0;
+    double duration = 0.0;
+    double timeoutMs = 1000.0;
+    size_t maxBacklog = 10000;
+    string localConfig;
+    bool augment = false;
+    string outputFile;
+
+    options_description configuration_options("Replay options");
+    configuration_options.add_options()
+        ("capture,c", value(&captureFile),
+         "capture file written by HttpAuctionLogger")
+        ("synth-model,m", value(&synthModel),
+         "BidRequestSynth model to generate requests from")
+        ("synth-count", value(&synthCount),
+         "number of distinct requests to generate from the model")
+        ("resource", value(&resource),
+         "HTTP resource for generated requests")
+        ("header", value(&headers),
+         "extra HTTP header for generated requests (repeatable)")
+        ("target,t", value(&target),
+         "host:port of the exchange connector")
+        ("connections,n", value(&numConnections),
+         "number of concurrent connections")
+        ("qps,q", value(&qps),
+         "send at this fixed rate of requests per second")
+        ("speed,s", value(&speed),
+         "replay a capture at this multiple of its recorded rate")
+        ("duration,d", value(&duration),
+         "seconds to run for, looping over the requests (default: once)")
+        ("timeout-ms", value(&timeoutMs),
+         "time after which a request with no response counts as a timeout")
+        ("max-backlog", value(&maxBacklog),
+         "requests waiting for a connection before new ones are dropped")
+        ("local-stack", value(&localConfig),
+         "start a local router stack with the given exchange configuration")
+        ("augment", value(&augment)->zero_tokens(),
+         "make the local agent require the frequency cap augmentor")
+        ("output,o", value(&outputFile),
+         "write the JSON report to this file as well as stdout");
+
+    options_description all_opt;
+    all_opt.add(configuration_options);
+    all_opt.add_options()
+        ("help,h", "print this message");
+
+    variables_map vm;
+    store(command_line_parser(argc, argv)
+          .options(all_opt)
+          .run(),
+          vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cerr << all_opt << endl;
+        exit(1);
+    }
+
+    if (captureFile.empty() == synthModel.empty()) {
+        cerr << "exactly one of 'capture' and 'synth-model' is required" << endl;
+        exit(1);
+    }
+
+    if ((qps > 0.0) == (speed > 0.0)) {
+        cerr << "exactly one of 'qps' and 'speed' is required" << endl;
+        exit(1);
+    }
+
+    std::vector<ReplayRequest> requests
+        = captureFile.empty()
+        ? synthesize(synthModel, synthCount, resource, headers)
+        : loadCapture(captureFile);
+
+    if (requests.empty()) {
+        cerr << "no requests to replay" << endl;
+        exit(1);
+    }
+
+    std::function<double (size_t)> due;
+    size_t numToSend = requests.size();
+
+    if (qps > 0.0) {
+        due = [=] (size_t i) { return i / qps; };
+        if (duration > 0.0)
+            numToSend = duration * qps;
+    }
+    else {
+        Date first = requests.front().timestamp;
+        double span = requests.back().timestamp.secondsSince(first);
+        if (first == Date() || span <= 0.0) {
+            cerr << "capture has no timestamps; use 'qps' instead" << endl;
+            exit(1);
+        }
+
+        // Loops over the capture keep the spacing between the last and first
+        // requests the same as the average spacing
+        double period = span * requests.size() / (requests.size() - 1);
+        due = [=,&requests] (size_t i)
+            {
+                size_t n = requests.size();
+                double offset = requests[i % n].timestamp.secondsSince(first);
+                return ((i / n) * period + offset) / speed;
+            };
+        if (duration > 0.0)
+            numToSend = duration * speed / period * requests.size();
+    }
+
+    std::shared_ptr<LocalStack> local;
+    if (!localConfig.empty()) {
+        ML::File_Read_Buffer buf(localConfig);
+        Json::Value config = Json::parse(string(buf.start(), buf.end()));
+        local = std::make_shared<LocalStack>(std::make_shared<ServiceProxies>());
+        local->start(config, augment);
+    }
+
+    NetworkAddress address(target);
+    ReplayDriver driver(address.host, address.port, numConnections,
+                        timeoutMs, maxBacklog);
+    ReplayStats stats = driver.run(requests, due, numToSend);
+
+    Json::Value report = stats.toJson(driver.lastElapsed);
+    report["connections"] = numConnections;
+    if (qps > 0.0)
+        report["targetQps"] = qps;
+    else report["speed"] = speed;
+    if (local)
+        report["router"] = local->stack.getStats();
+
+    cout << report.toStyledString();
+    if (!outputFile.empty()) {
+        ML::filter_ostream stream(outputFile);
+        stream << report.toStyledString();
+    }
+
+    if (local)
+        local->shutdown();
+
+    return 0;
+}
@@ -0,0 +1,467 @@
+/* router_bench.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Microbenchmarks for the stages of the router's auction hot path.
+
+   Each measurement is written to stdout as a single line of JSON:
+
+       {"bench":"preprocessAuction","agents":100,"filters":"mixed",
+        "iterations":20000,"nsPerOp":1234.5,"opsPerSec":810045.3}
+
+   so that the output of successive runs can be collected and compared
+   across commits.  The number of iterations is scaled by the
+   ROUTER_BENCH_SCALE environment variable.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/router/router.h"
+#include "rtbkit/core/banker/null_banker.h"
+#include "rtbkit/core/banker/account.h"
+#include "rtbkit/core/agent_configuration/blacklist.h"
+#include "rtbkit/common/augmentation.h"
+#include "rtbkit/common/bids.h"
+#include "rtbkit/plugins/bid_request/openrtb_bid_request.h"
+#include "rtbkit/plugins/bid_request/appnexus_bid_request.h"
+#include "rtbkit/plugins/bid_request/fbx_bid_request.h"
+#include "rtbkit/testing/generic_exchange_connector.h"
+#include "jml/utils/filter_streams.h"
+#include "jml/utils/environment.h"
+#include "jml/arch/timers.h"
+#include <thread>
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+Env_Option<int> benchScale("ROUTER_BENCH_SCALE", 1);
+
+
+/*****************************************************************************/
+/* UTILITIES                                                                 */
+/*****************************************************************************/
+
+/** Write out one measurement.  params contains whatever identifies the
+    configuration that was measured.
+*/
+void report(const std::string & bench,
+            Json::Value params,
+            uint64_t iterations,
+            double elapsed)
+{
+    params["bench"] = bench;
+    params["iterations"] = (Json::UInt64)iterations;
+    params["nsPerOp"] = elapsed * 1e9 / iterations;
+    params["opsPerSec"] = iterations / elapsed;
+    cout << params.toStringNoNewLine() << endl;
+}
+
+std::string loadFile(const std::string & filename)
+{
+    ML::filter_istream stream(filename);
+
+    string result;
+
+    while (stream) {
+        string line;
+        getline(stream, line);
+        result += line + "\n";
+    }
+
+    return result;
+}
+
+/** Agent configuration for the given filter mix:
+
+    - open: no filters; every agent bids on every request
+    - mixed: a host filter, language filter and a segment filter that
+      most requests pass
+    - selective: a segment filter that lets through about one request
+      in fifty
+*/
+Json::Value agentConfigJson(unsigned agentNum, const std::string & filters)
+{
+    Json::Value config;
+    config["account"][0] = "campaign" + to_string(agentNum);
+    config["account"][1] = "strategy";
+    config["creatives"][0] = Creative::sampleBB.toJson();
+    config["bidProbability"] = 1.0;
+    config["maxInFlight"] = 1000000;
+
+    if (filters == "mixed") {
+        config["hostFilter"]["exclude"][0] = "excluded.com";
+        config["languageFilter"]["include"][0] = "en";
+        config["segmentFilter"]["bench"]["exclude"][0] = 99;
+    }
+    else if (filters == "selective") {
+        config["segmentFilter"]["bench"]["include"][0] = (int)(agentNum % 50);
+        config["segmentFilter"]["bench"]["excludeIfNotPresent"] = true;
+    }
+    else if (filters != "open")
+        throw ML::Exception("unknown filter mix " + filters);
+
+    return config;
+}
+
+/** A 300x250 request from a user in a few of the 50 segments that the
+    selective agents look for.
+*/
+std::shared_ptr<BidRequest> benchRequest(unsigned requestNum)
+{
+    auto request = std::make_shared<BidRequest>();
+    request->auctionId = Id(requestNum + 1);
+    request->exchange = "rtbkit";
+    request->language = "en";
+    request->url = Url("http://site" + to_string(requestNum % 20) + ".com/");
+    request->timestamp = Date::now().secondsSinceEpoch();
+    request->userIds.add(Id(requestNum % 1000 + 1), ID_EXCHANGE);
+    request->userIds.add(Id(requestNum % 1000 + 1), ID_PROVIDER);
+
+    AdSpot spot;
+    spot.id = Id(1);
+    spot.formats.emplace_back(300, 250);
+    request->imp.push_back(spot);
+
+    auto segments = std::make_shared<SegmentList>();
+    for (unsigned i = 0;  i < 3;  ++i)
+        segments->add((int)((requestNum * 7 + i * 13) % 50));
+    segments->sort();
+    request->segments["bench"] = segments;
+
+    return request;
+}
+
+
+/*****************************************************************************/
+/* ROUTER STAGES                                                             */
+/*****************************************************************************/
+
+/** Time preprocessAuction, doStartBidding and doBid for a router with the
+    given number of agents configured with the given filter mix.  The
+    stages are timed separately over the same batch of auctions.
+*/
+void benchRouterStages(unsigned numAgents, const std::string & filters)
+{
+    unsigned numAuctions = 20000 * benchScale / max(1u, numAgents / 10);
+
+    auto proxies = std::make_shared<ServiceProxies>();
+    Router router(proxies, "router-bench");
+    router.unsafeDisableMonitor();
+    router.init();
+    router.setBanker(std::make_shared<NullBanker>(true));
+
+    auto exchange = std::make_shared<GenericExchangeConnector>(proxies);
+    router.addExchange(exchange);
+
+    for (unsigned i = 0;  i < numAgents;  ++i) {
+        auto config = std::make_shared<AgentConfig>(
+                AgentConfig::createFromJson(agentConfigJson(i, filters)));
+        router.doConfig("agent" + to_string(i), config);
+    }
+
+    Date start = Date::now();
+    Date expiry = start.plusSeconds(3600);
+    auto onAuctionDone = [] (std::shared_ptr<Auction> auction) {};
+
+    vector<std::shared_ptr<Auction> > auctions;
+    for (unsigned i = 0;  i < numAuctions;  ++i) {
+        auto request = benchRequest(i);
+        auctions.push_back(std::make_shared<Auction>(
+                exchange.get(), onAuctionDone, request,
+                request->toJsonStr(), "datacratic", start, expiry));
+    }
+
+    Json::Value params;
+    params["agents"] = numAgents;
+    params["filters"] = filters;
+
+    vector<std::shared_ptr<AugmentationInfo> > augInfos;
+    augInfos.reserve(numAuctions);
+
+    Timer prepro;
+    for (auto & auction: auctions)
+        augInfos.push_back(router.preprocessAuction(auction));
+    report("preprocessAuction", params, numAuctions, prepro.elapsed_wall());
+
+    // Every agent is in its own round robin group, so each potential bidder
+    // is sent the auction and can bid on it.
+    vector<vector<string> > bids;
+    uint64_t numStarted = 0;
+    for (auto & augInfo: augInfos) {
+        if (!augInfo) continue;
+        ++numStarted;
+        string auctionId = augInfo->auction->id.toString();
+        for (auto & group: augInfo->potentialGroups) {
+            Bids agentBids;
+            Bid bid;
+            bid.spotIndex = 0;
+            bid.availableCreatives.push_back(0);
+            bid.bid(0, USD_CPM(1));
+            agentBids.push_back(bid);
+
+            bids.push_back({ group.at(0).agent, "BID", auctionId,
+                             agentBids.toJson().toStringNoNewLine(),
+                             WinCostModel().toJson().toStringNoNewLine() });
+        }
+    }
+
+    if (numStarted) {
+        Timer startBidding;
+        for (auto & augInfo: augInfos)
+            if (augInfo) router.doStartBidding(augInfo);
+
+        Json::Value fanOut = params;
+        fanOut["bidders"] = (double)bids.size() / numStarted;
+        report("doStartBidding", fanOut, numStarted,
+               startBidding.elapsed_wall());
+    }
+
+    if (!bids.empty()) {
+        Timer doBid;
+        for (auto & message: bids)
+            router.doBid(message);
+        report("doBid", params, bids.size(), doBid.elapsed_wall());
+    }
+
+    router.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE( bench_router_stages )
+{
+    for (string filters: { "open", "mixed", "selective" })
+        for (unsigned numAgents: { 10, 100, 1000, 5000 })
+            benchRouterStages(numAgents, filters);
+}
+
+
+/*****************************************************************************/
+/* DYNAMIC FILTERS                                                           */
+/*****************************************************************************/
+
+BOOST_AUTO_TEST_CASE( bench_blacklist )
+{
+    unsigned numLookups = 1000000 * benchScale;
+
+    for (unsigned numUsers: { 100, 10000 }) {
+        AgentConfig config;
+        config.account = { "campaign", "strategy" };
+        config.blacklistType = BL_USER_SITE;
+        config.blacklistScope = BL_AGENT;
+        config.blacklistTime = 3600;
+
+        // Half of the users are blacklisted
+        Blacklist blacklist;
+        vector<std::shared_ptr<BidRequest> > requests;
+        for (unsigned i = 0;  i < numUsers;  ++i) {
+            // benchRequest() only has 1000 distinct users; give each of
+            // these its own exchange id
+            requests.push_back(benchRequest(i));
+            UserIds & userIds = requests.back()->userIds;
+            userIds.set(Id(i + 1), UserIds::domainName(ID_EXCHANGE));
+            userIds.setStatic(Id(i + 1), ID_EXCHANGE);
+            if (i % 2 == 0)
+                blacklist.add(*requests.back(), "agent", config);
+        }
+
+        unsigned numMatches = 0;
+        Timer timer;
+        for (unsigned i = 0;  i < numLookups;  ++i)
+            numMatches += blacklist.matches(*requests[i % numUsers],
+                                            "agent", config);
+        double elapsed = timer.elapsed_wall();
+
+        BOOST_CHECK_EQUAL(numMatches, (numLookups + 1) / 2);
+
+        Json::Value params;
+        params["users"] = numUsers;
+        report("Blacklist::matches", params, numLookups, elapsed);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( bench_augmentation_filter_for_account )
+{
+    unsigned numLookups = 200000 * benchScale;
+
+    for (unsigned numAccounts: { 10, 1000 }) {
+        AugmentationList list;
+        list.insertGlobal(Augmentation({ "global" }));
+
+        vector<AccountKey> accounts;
+        for (unsigned i = 0;  i < numAccounts;  ++i) {
+            AccountKey campaign{ "campaign" + to_string(i) };
+            AccountKey strategy = campaign.childKey("strategy");
+            list[campaign] = Augmentation({ "pass" });
+            list[strategy] = Augmentation({ "pass-" + to_string(i) });
+            accounts.push_back(strategy);
+        }
+
+        size_t numTags = 0;
+        Timer timer;
+        for (unsigned i = 0;  i < numLookups;  ++i)
+            numTags += list.filterForAccount(accounts[i % numAccounts])
+                .tags.size();
+        double elapsed = timer.elapsed_wall();
+
+        BOOST_CHECK_EQUAL(numTags, numLookups * 3);
+
+        Json::Value params;
+        params["accounts"] = numAccounts;
+        report("AugmentationList::filterForAccount", params, numLookups,
+               elapsed);
+    }
+}
+
+
+/*****************************************************************************/
+/* SHADOW ACCOUNTS                                                           */
+/*****************************************************************************/
+
+BOOST_AUTO_TEST_CASE( bench_shadow_accounts_contention )
+{
+    enum { NumAccounts = 100 };
+    unsigned numBidsPerThread = 200000 * benchScale;
+
+    Accounts master;
+    ShadowAccounts shadow;
+    vector<AccountKey> keys;
+
+    for (unsigned i = 0;  i < NumAccounts;  ++i) {
+        AccountKey budget{"campaign" + to_string(i)};
+        AccountKey key = budget.childKey("strategy");
+        master.createBudgetAccount(budget);
+        master.setBudget(budget, USD(1000));
+        master.createSpendAccount(key);
+        master.setBalance(key, USD(100), AT_NONE);
+        shadow.activateAccount(key);
+        keys.push_back(key);
+    }
+    shadow.syncFrom(master);
+
+    for (unsigned numThreads: { 1, 2, 4, 8 }) {
+        std::atomic<uint64_t> numAuthorized(0);
+
+        auto runThread = [&] (unsigned threadNum)
+            {
+                string item = "auction-spot-agent" + to_string(threadNum);
+                uint64_t authorized = 0;
+                for (unsigned i = 0;  i < numBidsPerThread;  ++i) {
+                    const AccountKey & key = keys[(i + threadNum) % NumAccounts];
+                    if (shadow.authorizeBid(key, item, MicroUSD(1))) {
+                        ++authorized;
+                        shadow.cancelBid(key, item);
+                    }
+                }
+                numAuthorized += authorized;
+            };
+
+        Timer timer;
+        vector<std::thread> threads;
+        for (unsigned i = 0;  i < numThreads;  ++i)
+            threads.emplace_back(runThread, i);
+        for (auto & thread: threads)
+            thread.join();
+        double elapsed = timer.elapsed_wall();
+
+        uint64_t numBids = (uint64_t)numThreads * numBidsPerThread;
+        BOOST_CHECK_EQUAL(numAuthorized.load(), numBids);
+
+        // Each iteration is an authorizeBid plus a cancelBid
+        Json::Value params;
+        params["threads"] = numThreads;
+        report("ShadowAccounts::authorizeBid", params, numBids, elapsed);
+    }
+}
+
+
+/*****************************************************************************/
+/* BID REQUEST PARSING                                                       */
+/*****************************************************************************/
+
+BOOST_AUTO_TEST_CASE( bench_bid_request_parsing )
+{
+    unsigned numParses = 20000 * benchScale;
+
+    typedef std::function<BidRequest * (const std::string &)> Parser;
+
+    string openRtb
+        = loadFile("rtbkit/plugins/bid_request/testing/openrtb2_req.json");
+    std::unique_ptr<BidRequest> canonical(
+            OpenRtbBidRequestParser::parseBidRequest(openRtb, "openrtb"));
+
+    // The parsers linked into the router; the canonical format is fed with
+    // the openrtb request converted to it.
+    vector<tuple<string, string, Parser> > parsers = {
+        make_tuple("datacratic", canonical->toJsonStr(),
+                   [] (const std::string & str)
+                   {
+                       return BidRequest::parse("datacratic", str);
+                   }),
+        make_tuple("openrtb", openRtb,
+                   [] (const std::string & str)
+                   {
+                       return OpenRtbBidRequestParser
+                           ::parseBidRequest(str, "openrtb", "openrtb");
+                   }),
+        make_tuple("appnexus",
+                   loadFile("rtbkit/plugins/bid_request/testing/"
+                            "appnexus_parent_bid_request.json"),
+                   [] (const std::string & str)
+                   {
+                       return AppNexusBidRequestParser
+                           ::parseBidRequest(str, "appnexus", "appnexus");
+                   }),
+        make_tuple("fbx",
+                   loadFile("rtbkit/plugins/bid_request/testing/fbx1_req.json"),
+                   [] (const std::string & str)
+                   {
+                       return FbxBidRequestParser
+                           ::parseBidRequest(str, "fbx", "fbx");
+                   })
+    };
+
+    for (auto & entry: parsers) {
+        const string & format = get<0>(entry);
+        const string & payload = get<1>(entry);
+        const Parser & parse = get<2>(entry);
+
+        Json::Value params;
+        params["format"] = format;
+        params["bytes"] = (int)payload.size();
+
+        Timer parseTimer;
+        for (unsigned i = 0;  i < numParses;  ++i)
+            std::unique_ptr<BidRequest> request(parse(payload));
+        report("BidRequest::parse", params, numParses,
+               parseTimer.elapsed_wall());
+
+        std::unique_ptr<BidRequest> request(parse(payload));
+
+        size_t totalBytes = 0;
+        Timer jsonTimer;
+        for (unsigned i = 0;  i < numParses;  ++i)
+            totalBytes += request->toJsonStr().size();
+        report("BidRequest::toJsonStr", params, numParses,
+               jsonTimer.elapsed_wall());
+
+        string serialized = request->serializeToString();
+
+        Timer serializeTimer;
+        for (unsigned i = 0;  i < numParses;  ++i)
+            totalBytes += request->serializeToString().size();
+        report("BidRequest::serializeToString", params, numParses,
+               serializeTimer.elapsed_wall());
+
+        Timer deserializeTimer;
+        for (unsigned i = 0;  i < numParses;  ++i)
+            totalBytes += BidRequest::createFromString(serialized).imp.size();
+        report("BidRequest::createFromString", params, numParses,
+               deserializeTimer.elapsed_wall());
+
+        BOOST_CHECK_GT(totalBytes, 0);
+    }
+}
@@ -213,3 +213,96 @@ BOOST_AUTO_TEST_CASE( hourOfWeek )
     auto request = basicRequest();
     auto config = basicConfig();
 }
+
+BOOST_AUTO_TEST_CASE( frequencyCapJson )
+{
+    FrequencyCap cap;
+    BOOST_CHECK(!cap.enabled());
+
+    Json::Value json;
+    json["count"] = 3;
+    json["windowSeconds"] = 7200.0;
+    json["scope"] = "account";
+    json["event"] = "impression";
+    cap.fromJson(json);
+
+    BOOST_CHECK(cap.enabled());
+    BOOST_CHECK_EQUAL(cap.count, 3);
+    BOOST_CHECK_EQUAL(cap.windowSeconds, 7200.0);
+    BOOST_CHECK_EQUAL(cap.scope, FCS_ACCOUNT);
+    BOOST_CHECK_EQUAL(cap.event, FCE_IMPRESSION);
+
+    FrequencyCap copy;
+    copy.fromJson(cap.toJson());
+    BOOST_CHECK_EQUAL(copy.toJson(), cap.toJson());
+    BOOST_CHECK_EQUAL(copy.scope, FCS_ACCOUNT);
+    BOOST_CHECK_EQUAL(copy.event, FCE_IMPRESSION);
+
+    auto checkInvalid = [] (const string & key, const Json::Value & value)
+        {
+            Json::Value json;
+            json[key] = value;
+            FrequencyCap cap;
+            BOOST_CHECK_THROW(cap.fromJson(json), std::exception);
+        };
+
+    checkInvalid("windowSeconds", 0.0);
+    checkInvalid("windowSeconds", FrequencyCapStore::MaxWindowSeconds + 1.0);
+
+    // Windows are whole clock hours
+    checkInvalid("windowSeconds", 60.0);
+    checkInvalid("windowSeconds", 5400.0);
+    checkInvalid("scope", "user");
+    checkInvalid("event", "click");
+    checkInvalid("counts", 3);
+
+    json["windowSeconds"] = FrequencyCapStore::MaxWindowSeconds;
+    cap.fromJson(json);
+    BOOST_CHECK_EQUAL(cap.windowSeconds, FrequencyCapStore::MaxWindowSeconds);
+}
+
+BOOST_AUTO_TEST_CASE( frequencyCap )
+{
+    FrequencyCapStore store(1024);
+    uint32_t bucket = 1000;
+
+    auto config = basicConfig();
+    config.frequencyCap.count = 2;
+    config.frequencyCap.windowSeconds = 2 * 3600.0;
+    config.frequencyCap.update(config.account);
+    const FrequencyCap & cap = config.frequencyCap;
+
+    UserIds ids;
+    ids.add(Id("user1"), ID_EXCHANGE);
+    uint64_t user = FrequencyCapStore::userKey(ids);
+    uint64_t key = FrequencyCapStore::key(user, cap.scopeKey);
+
+    BOOST_CHECK(!cap.isCapped(store, user, bucket));
+
+    store.add(key, bucket - 2);
+    store.add(key, bucket - 1);
+    BOOST_CHECK(!cap.isCapped(store, user, bucket));
+
+    store.add(key, bucket);
+    BOOST_CHECK(cap.isCapped(store, user, bucket));
+
+    // The oldest event falls out of the window
+    BOOST_CHECK(!cap.isCapped(store, user, bucket + 1));
+
+    // Users without ids aren't capped
+    BOOST_CHECK(!cap.isCapped(store, 0, bucket));
+
+    // Other accounts of the campaign share its cap, unless it's for the
+    // whole account
+    FrequencyCap other = cap;
+    other.update(AccountKey("hello:other"));
+    BOOST_CHECK(other.isCapped(store, user, bucket));
+    other.scope = FCS_ACCOUNT;
+    other.update(AccountKey("hello:other"));
+    BOOST_CHECK(!other.isCapped(store, user, bucket));
+
+    // No cap
+    FrequencyCap none;
+    none.update(config.account);
+    BOOST_CHECK(!none.isCapped(store, user, bucket));
+}
@@ -8,6 +8,7 @@
 
 $(eval $(call vowscoffee_test,bid_request_js_test,bid_request))
 $(eval $(call vowsjs_test,bid_request_js_segments_test,bid_request))
+$(eval $(call nodejs_test,bid_request_js_bench,bid_request,,,manual))
 $(eval $(call test,agent_configuration_test,rtb_router bidding_agent,boost))
 $(eval $(call test,augmentation_list_test,rtb,boost))
 $(eval $(call test,historical_bid_request_test,bid_request,boost))
@@ -15,8 +16,11 @@ $(eval $(call test,historical_bid_request_test,bid_request,boost))
 $(eval $(call library,integration_test_utils,generic_exchange_connector.cc mock_exchange.cc,rtb_router bid_test_utils exchange))
 
 $(eval $(call test,static_filtering_test,agent_configuration rtb_router integration_test_utils,boost))
+$(eval $(call test,bid_request_containers_bench,agent_configuration rtb_router integration_test_utils,boost manual))
 $(eval $(call test,win_cost_model_test,openrtb_exchange bidding_agent integration_test_utils,boost))
+$(eval $(call test,router_bench,rtb_router banker integration_test_utils openrtb_bid_request appnexus_bid_request fbx_bid_request,boost manual))
 
 $(eval $(call program,mock_exchange_runner,integration_test_utils boost_program_options utils))
 $(eval $(call program,json_feeder,curlpp boost_program_options utils))
 $(eval $(call program,json_listener,boost_program_options services utils))
+$(eval $(call program,replay_exchange,rtb_router bidding_agent exchange bid_request_synth bid_test_utils augmentor_ex boost_program_options services utils))